@@ -0,0 +1,40 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_BENCH_HPP_
+#define _MTB_BENCH_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+//! Runs `func` `repeat` times and returns the shortest time (in seconds).
+template<typename Func>
+double mtb_bench_time(int repeat, Func &&func)
+{
+	double best = std::numeric_limits<double>::max();
+
+	for (int r = 0; r < repeat; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		best = std::min(best, elapsed.count());
+	}
+
+	return best;
+}
+
+//! Keeps the compiler from removing the computation of a value that is not used.
+template<typename T>
+inline void mtb_bench_keep(const T &value)
+{
+	asm volatile("" : : "r"(&value) : "memory");
+}
+
+#endif /* _MTB_BENCH_HPP_ */
@@ -0,0 +1,130 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Throughput of the byte shuffle, the LZ codec and the chunks of the kChunkedEncoding
+// (single thread), in GB/s of uncompressed entries. The entries belong to a banded matrix
+// with sorted rows and a few distinct values, split in chunks of MTB_CHUNK_SIZE entries.
+//
+// Usage: compress_bench [number of entries] [repetitions]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../include/mtb_compress.hpp"
+#include "../include/mtb_encoding.hpp"
+#include "bench.hpp"
+
+using namespace mtb;
+
+static void bench_index_size(char index_size, uint64_t count, int repeat)
+{
+	MTBHeader header{kGeneralSparse, kReal, 8, count / 8, count / 8, count};
+	header.version = 2;
+	header.index_size = index_size;
+	header.encoding = kChunkedEncoding;
+
+	uint64_t entry_size = mtb_entry_size(header);
+	uint64_t value_size = mtb_entry_size(header.datatype, header.type_size) - 2 * sizeof(uint64_t);
+	uint64_t nchunks = (count + MTB_CHUNK_SIZE - 1) / MTB_CHUNK_SIZE;
+	uint64_t size = count * entry_size;
+	std::mt19937_64 rng(42);
+
+	std::vector<char> raw(count * (2 * sizeof(uint64_t) + value_size)), plain(size);
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t row = i / 8, col = std::min(header.ncols - 1, row + rng() % 64);
+		double val = (double) (rng() % 16) * 0.5;
+
+		char *entry = raw.data() + i * (2 * sizeof(uint64_t) + value_size);
+		std::memcpy(entry, &row, sizeof(uint64_t));
+		std::memcpy(entry + sizeof(uint64_t), &col, sizeof(uint64_t));
+		std::memcpy(entry + 2 * sizeof(uint64_t), &val, sizeof(double));
+	}
+
+	mtb_narrow_indices(raw.data(), plain.data(), count, index_size, value_size);
+
+	// Shuffled, compressed and decompressed buffers of each chunk
+	std::vector<char> shuffled(size), out(raw.size()), scratch;
+	std::vector<std::vector<char>> lz(nchunks), chunks(nchunks);
+	std::vector<uint64_t> lz_sizes(nchunks), chunk_sizes(nchunks);
+
+	auto for_chunks = [&](auto &&func) {
+		for (uint64_t c = 0; c < nchunks; ++c)
+		{
+			uint64_t first = c * MTB_CHUNK_SIZE;
+			func(c, first, std::min<uint64_t>(MTB_CHUNK_SIZE, count - first));
+		}
+	};
+
+	double shuffle = mtb_bench_time(repeat, [&]() {
+		for_chunks([&](uint64_t, uint64_t first, uint64_t n) {
+			mtb_shuffle(plain.data() + first * entry_size, shuffled.data() + first * entry_size, n, entry_size);
+		});
+	});
+
+	double unshuffle = mtb_bench_time(repeat, [&]() {
+		for_chunks([&](uint64_t, uint64_t first, uint64_t n) {
+			mtb_unshuffle(shuffled.data() + first * entry_size, plain.data() + first * entry_size, n, entry_size);
+		});
+	});
+
+	double compress = mtb_bench_time(repeat, [&]() {
+		for_chunks([&](uint64_t c, uint64_t first, uint64_t n) {
+			lz[c].resize(mtb_lz_bound(n * entry_size));
+			lz_sizes[c] = mtb_lz_compress(shuffled.data() + first * entry_size, n * entry_size, lz[c].data());
+		});
+	});
+
+	double decompress = mtb_bench_time(repeat, [&]() {
+		for_chunks([&](uint64_t c, uint64_t first, uint64_t n) {
+			mtb_lz_decompress(lz[c].data(), lz_sizes[c], shuffled.data() + first * entry_size, n * entry_size);
+		});
+	});
+
+	double compress_chunk = mtb_bench_time(repeat, [&]() {
+		for_chunks([&](uint64_t c, uint64_t first, uint64_t n) {
+			chunk_sizes[c] = mtb_compress_chunk(plain.data() + first * entry_size, n, header, chunks[c], scratch);
+		});
+	});
+
+	double decompress_chunk = mtb_bench_time(repeat, [&]() {
+		for_chunks([&](uint64_t c, uint64_t first, uint64_t n) {
+			mtb_decompress_chunk(chunks[c].data(), chunk_sizes[c],
+			                     out.data() + first * (2 * sizeof(uint64_t) + value_size), n, header, scratch);
+		});
+	});
+
+	if (out != raw) throw std::runtime_error("Error: Wrong decompressed entries!");
+
+	uint64_t compressed_size = 0;
+	for (uint64_t c = 0; c < nchunks; ++c)
+		compressed_size += chunk_sizes[c];
+
+	std::printf("index size %d: %lu chunks, ratio %.2f\n", index_size, nchunks, (double) size / compressed_size);
+	std::printf("  %-22s %8.2f GB/s\n", "mtb_shuffle", size / shuffle * 1e-9);
+	std::printf("  %-22s %8.2f GB/s\n", "mtb_unshuffle", size / unshuffle * 1e-9);
+	std::printf("  %-22s %8.2f GB/s\n", "mtb_lz_compress", size / compress * 1e-9);
+	std::printf("  %-22s %8.2f GB/s\n", "mtb_lz_decompress", size / decompress * 1e-9);
+	std::printf("  %-22s %8.2f GB/s\n", "mtb_compress_chunk", size / compress_chunk * 1e-9);
+	std::printf("  %-22s %8.2f GB/s\n", "mtb_decompress_chunk", size / decompress_chunk * 1e-9);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 22);
+	int repeat = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+	std::printf("%lu entries, best of %d runs\n\n", count, repeat);
+
+	bench_index_size(8, count, repeat);
+	bench_index_size(4, count, repeat);
+
+	return 0;
+}
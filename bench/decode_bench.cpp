@@ -0,0 +1,211 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Decoding throughput of each MTB entry layout, in GB/s of raw entries. The generic
+// column is the per-entry decoder used by mtb_read_data before the specialized
+// kernels (a switch on the datatype for every entry); the kernel column is
+// mtb_decode_entries. The expansion kernels of mtb_expand_records are timed for
+// each instruction set supported by the CPU, next to a memcpy of 24-byte records.
+//
+// Usage: decode_bench [number of entries] [repetitions]
+
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "bench.hpp"
+
+using namespace mtb;
+
+// Per-entry decoder with a runtime switch on the datatype
+template<typename T>
+static const char *generic_decode(const char *ptr, Triplet<T> *data, uint64_t count, char mat_type,
+                                  char datatype, char type_size)
+{
+	uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+
+	for (uint64_t i = 0; i < count * step_size; i += step_size)
+	{
+		uint64_t row, col;
+
+		std::memcpy(&row, ptr, sizeof(uint64_t));
+		ptr += sizeof(uint64_t);
+
+		std::memcpy(&col, ptr, sizeof(uint64_t));
+		ptr += sizeof(uint64_t);
+
+		data[i].row = row;
+		data[i].col = col;
+
+		switch (datatype)
+		{
+			case kPattern:
+				data[i].val = (T) 1.0;
+				break;
+
+			case kInteger:
+			{
+				int64_t val = 0;
+				std::memcpy(&val, ptr, type_size);
+				ptr += type_size;
+				data[i].val = (T) val;
+				break;
+			}
+
+			case kReal:
+				if (type_size == 8)
+				{
+					double val;
+					std::memcpy(&val, ptr, type_size);
+					data[i].val = (T) val;
+
+				} else
+				{
+					float val;
+					std::memcpy(&val, ptr, type_size);
+					data[i].val = (T) val;
+				}
+
+				ptr += type_size;
+				break;
+
+			case kComplex:
+				if constexpr (is_complex<T>())
+				{
+					if (type_size == 8)
+					{
+						double val[2];
+						std::memcpy(val, ptr, 2 * type_size);
+						data[i].val = T(val[0], val[1]);
+
+					} else
+					{
+						float val[2];
+						std::memcpy(val, ptr, 2 * type_size);
+						data[i].val = T(val[0], val[1]);
+					}
+				}
+
+				ptr += 2 * type_size;
+				break;
+
+			default:
+				throw std::runtime_error("Error: Unsupported MTB type!");
+		}
+
+		if (mat_type == kSymmetricSparse && col < row)
+		{
+			data[i + 1].row = col;
+			data[i + 1].col = row;
+			data[i + 1].val = data[i].val;
+		}
+	}
+
+	return ptr;
+}
+
+template<typename T>
+static void bench_layout(const char *name, char mat_type, char datatype, char type_size, uint64_t count,
+                         int repeat)
+{
+	uint64_t entry_size = mtb_entry_size(datatype, type_size);
+	uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+	std::vector<Triplet<std::complex<double>>> source(count);
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::ptrdiff_t row = (i * 7919) % 1000003, col = (i * 104729) % 1000003;
+		if (mat_type == kSymmetricSparse && col > row) std::swap(row, col);
+
+		// About a quarter of the entries of symmetric matrices are in the diagonal, in an
+		// irregular pattern (these entries have no mirror)
+		if (mat_type == kSymmetricSparse && (i * 0x9E3779B97F4A7C15ull) >> 62 == 0) col = row;
+
+		double val = (datatype == kPattern) ? 1 : (datatype == kInteger) ? (double) (i % 100) : i * 0.25;
+		source[i] = {row, col, std::complex<double>(val, -val)};
+	}
+
+	std::vector<char> raw(count * entry_size);
+	mtb_encode_entries(source.data(), count, raw.data(), datatype, type_size);
+	std::vector<Triplet<T>> data(count * step_size);
+
+	double generic = mtb_bench_time(repeat, [&]() {
+		generic_decode(raw.data(), data.data(), count, mat_type, datatype, type_size);
+		mtb_bench_keep(data[0]);
+	});
+
+	double kernel = mtb_bench_time(repeat, [&]() {
+		mtb_decode_entries(raw.data(), data.data(), count, mat_type, datatype, type_size);
+		mtb_bench_keep(data[0]);
+	});
+
+	double bytes = (double) raw.size();
+	std::printf("%-26s %12.2f %12.2f %8.2fx\n", name, bytes / generic * 1e-9, bytes / kernel * 1e-9,
+	            generic / kernel);
+}
+
+static void bench_expand(int in_size, uint64_t count, int repeat)
+{
+	static const char *kNames[] = {"scalar", "avx2", "avx512"};
+	std::vector<char> in(count * in_size, 1);
+	std::vector<char> out(count * 24);
+
+	// Reference: copy of records that need no expansion (e.g. 24 -> 24 bytes)
+	if (in_size == 16)
+	{
+		std::vector<char> copy(out.size(), 1);
+
+		double time = mtb_bench_time(repeat, [&]() {
+			std::memcpy(out.data(), copy.data(), copy.size());
+			mtb_bench_keep(out[0]);
+		});
+
+		std::printf("memcpy 24 -> 24 %-10s %12.2f GB/s\n", "", (double) copy.size() / time * 1e-9);
+	}
+
+	for (int level = kScalarSimd; level <= mtb_simd_level(); ++level)
+	{
+		double time = mtb_bench_time(repeat, [&]() {
+			mtb_expand_records(in.data(), out.data(), count, in_size, 0, (MTBSimdLevel) level);
+			mtb_bench_keep(out[0]);
+		});
+
+		std::printf("expand %2d -> 24 %-10s %12.2f GB/s\n", in_size, kNames[level],
+		            (double) in.size() / time * 1e-9);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 22);
+	int repeat = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+	std::printf("%lu entries, best of %d runs\n\n", count, repeat);
+	std::printf("%-26s %12s %12s %9s\n", "layout", "generic GB/s", "kernel GB/s", "speedup");
+
+	bench_layout<int>("pattern -> int", kGeneralSparse, kPattern, 0, count, repeat);
+	bench_layout<double>("pattern -> double", kGeneralSparse, kPattern, 0, count, repeat);
+	bench_layout<int>("int8 -> int", kGeneralSparse, kInteger, 1, count, repeat);
+	bench_layout<int>("int16 -> int", kGeneralSparse, kInteger, 2, count, repeat);
+	bench_layout<int>("int32 -> int", kGeneralSparse, kInteger, 4, count, repeat);
+	bench_layout<int64_t>("int64 -> int64", kGeneralSparse, kInteger, 8, count, repeat);
+	bench_layout<float>("float32 -> float", kGeneralSparse, kReal, 4, count, repeat);
+	bench_layout<double>("float32 -> double", kGeneralSparse, kReal, 4, count, repeat);
+	bench_layout<double>("float64 -> double", kGeneralSparse, kReal, 8, count, repeat);
+	bench_layout<std::complex<float>>("complex64 -> complex", kGeneralSparse, kComplex, 4, count, repeat);
+	bench_layout<std::complex<double>>("complex128 -> complex", kGeneralSparse, kComplex, 8, count, repeat);
+	bench_layout<double>("float64 -> double (sym)", kSymmetricSparse, kReal, 8, count, repeat);
+	bench_layout<int>("pattern -> int (sym)", kSymmetricSparse, kPattern, 0, count, repeat);
+
+	std::printf("\n");
+	bench_expand(16, count, repeat);
+	bench_expand(20, count, repeat);
+
+	return 0;
+}
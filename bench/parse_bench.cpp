@@ -0,0 +1,133 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Parsing throughput of MTX lines in memory (single thread), in millions of lines per
+// second. The strtol/strtod column is the line parser used before mtx_parse.hpp, which
+// requires a null-terminated buffer; the new column is mtx_parse_lines.
+//
+// Usage: parse_bench [number of lines] [repetitions]
+
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtx.hpp"
+#include "bench.hpp"
+
+using namespace mtb;
+
+// Line parser with strtol and strtod
+template<typename T>
+static uint64_t strtod_parse_lines(char *begin, char *end, Triplet<T> *out, bool is_weighted)
+{
+	uint64_t count = 0;
+	char *ptr = begin;
+
+	while (ptr < end)
+	{
+		if (std::isspace((unsigned char) *ptr))
+		{
+			++ptr;
+			continue;
+		}
+
+		char *next;
+		Triplet<T> &triplet = out[count++];
+
+		triplet.row = strtol(ptr, &next, 10) - 1;
+		if (next == ptr) throw std::runtime_error("Error: Wrong MTX format!");
+		triplet.col = strtol(next, &ptr, 10) - 1;
+
+		if (!is_weighted)
+		{
+			triplet.val = 1;
+
+		} else if constexpr (std::is_integral_v<T>)
+		{
+			triplet.val = strtol(ptr, &ptr, 10);
+
+		} else if constexpr (std::is_floating_point_v<T>)
+		{
+			triplet.val = strtod(ptr, &ptr);
+
+		} else
+		{
+			double real = strtod(ptr, &ptr);
+			double imag = strtod(ptr, &ptr);
+
+			triplet.val = T(real, imag);
+		}
+
+		// Move to the next line
+		if (ptr >= end) break;
+		ptr = (char *) std::memchr(ptr, '\n', end - ptr);
+		if (!ptr) break;
+		++ptr;
+	}
+
+	return count;
+}
+
+template<typename T>
+static void bench_lines(const char *name, bool is_weighted, uint64_t count, int repeat)
+{
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> dist(-1000, 1000);
+	std::string text;
+	char line[128];
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		int size = std::snprintf(line, sizeof(line), "%lu %lu", 1 + rng() % 10000000, 1 + rng() % 10000000);
+
+		if (!is_weighted)
+			size += std::snprintf(line + size, sizeof(line) - size, "\n");
+		else if constexpr (std::is_integral_v<T>)
+			size += std::snprintf(line + size, sizeof(line) - size, " %ld\n", (long) (rng() % 2000) - 1000);
+		else if constexpr (std::is_floating_point_v<T>)
+			size += std::snprintf(line + size, sizeof(line) - size, " %.16g\n", dist(rng));
+		else
+			size += std::snprintf(line + size, sizeof(line) - size, " %.16g %.16g\n", dist(rng), dist(rng));
+
+		text.append(line, size);
+	}
+
+	std::vector<Triplet<T>> out(count);
+	char *begin = text.data(), *end = text.data() + text.size();
+
+	double old_time = mtb_bench_time(repeat, [&]() {
+		if (strtod_parse_lines(begin, end, out.data(), is_weighted) != count)
+			throw std::runtime_error("Error: Wrong number of lines!");
+	});
+
+	double new_time = mtb_bench_time(repeat, [&]() {
+		if (mtx_parse_lines(begin, end, out.data(), is_weighted) != count)
+			throw std::runtime_error("Error: Wrong number of lines!");
+	});
+
+	std::printf("%-10s %14.1f %10.1f %8.2fx\n", name, count / old_time * 1e-6, count / new_time * 1e-6,
+	            old_time / new_time);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+	int repeat = (argc > 2) ? std::atoi(argv[2]) : 3;
+
+	std::printf("%lu lines, best of %d runs (M lines/s)\n\n", count, repeat);
+	std::printf("%-10s %14s %10s %9s\n", "data", "strtol/strtod", "new", "speedup");
+
+	bench_lines<double>("real", true, count, repeat);
+	bench_lines<int>("integer", true, count, repeat);
+	bench_lines<std::complex<double>>("complex", true, count, repeat);
+	bench_lines<int>("pattern", false, count, repeat);
+
+	return 0;
+}
@@ -58,7 +58,8 @@ extern "C" {
 	} triplet_int_t;
 
 	//! Reads and parses a MTB file. This routine will allocate the
-	//! nescessary memory space for the `array`.
+	//! nescessary memory space for the `array`. Symmetric matrices are expanded
+	//! to both triangles, without holes.
 	//!
 	//! @param filename[in]		name of MTB file
 	//! @param mat_type[out]	matrix type (@ref MTBMatrixType)
@@ -66,13 +67,16 @@ extern "C" {
 	//! @param type_size[out]	size of the data type (in bytes)
 	//! @param nrows[out]		number of rows
 	//! @param ncols[out]		number of columns
-	//! @param nz[out]			number of nonzero entries
+	//! @param nz[out]			number of entries in `array` (for symmetric matrices, the number
+	//! 						of entries in both triangles, no longer twice the number of
+	//! 						entries in the file; `array` may have space for more entries)
 	//! @param array[out]		triplet array containing the entries of the matrix
 	void read_mtb_int(char filename[64], char *mat_type, char *datatype, char *type_size,
 	                  uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_int_t **array);
 
 	//! Reads and parses a MTB file. This routine will allocate the
-	//! nescessary memory space for the `array`.
+	//! nescessary memory space for the `array`. Symmetric matrices are expanded
+	//! to both triangles, without holes.
 	//!
 	//! @param filename[in]		name of MTB file
 	//! @param mat_type[out]	matrix type (@ref MTBMatrixType)
@@ -80,13 +84,16 @@ extern "C" {
 	//! @param type_size[out]	size of the data type (in bytes)
 	//! @param nrows[out]		number of rows
 	//! @param ncols[out]		number of columns
-	//! @param nz[out]			number of nonzero entries
+	//! @param nz[out]			number of entries in `array` (for symmetric matrices, the number
+	//! 						of entries in both triangles, no longer twice the number of
+	//! 						entries in the file; `array` may have space for more entries)
 	//! @param array[out]		triplet array containing the entries of the matrix
 	void read_mtb_sp(char filename[64], char *mat_type, char *datatype, char *type_size,
 	                 uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_sp_t **array);
 
 	//! Reads and parses a MTB file. This routine will allocate the
-	//! nescessary memory space for the `array`.
+	//! nescessary memory space for the `array`. Symmetric matrices are expanded
+	//! to both triangles, without holes.
 	//!
 	//! @param filename[in]		name of MTB file
 	//! @param mat_type[out]	matrix type (@ref MTBMatrixType)
@@ -94,7 +101,9 @@ extern "C" {
 	//! @param type_size[out]	size of the data type (in bytes)
 	//! @param nrows[out]		number of rows
 	//! @param ncols[out]		number of columns
-	//! @param nz[out]			number of nonzero entries
+	//! @param nz[out]			number of entries in `array` (for symmetric matrices, the number
+	//! 						of entries in both triangles, no longer twice the number of
+	//! 						entries in the file; `array` may have space for more entries)
 	//! @param array[out]		triplet array containing the entries of the matrix
 	void read_mtb_dp(char filename[64], char *mat_type, char *datatype, char *type_size,
 	                 uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_dp_t **array);
@@ -8,11 +8,15 @@
 #ifndef _MTB_HANDLER_HPP_
 #define _MTB_HANDLER_HPP_
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <stdexcept>
 
+#include "mtb_decode.hpp"
 #include "mtb_def.hpp"
+#include "mtb_encoding.hpp"
+#include "mtb_io.hpp"
 
 namespace mtb
 {
@@ -42,9 +46,193 @@ namespace mtb
 	void mtb_write_header(std::ofstream &ofile, char mat_type, char datatype, char type_size,
 	                      uint64_t nrows, uint64_t ncols, uint64_t nz);
 
+	//! Reads and parses the header of a MTB file, including the optional features stored
+	//! in the header (@ref MTBFlags). This routine do not check for format errors.
+	//!
+	//! @param ifile[inout]		input stream to the MTB file
+	//! @param header[out]		matrix properties stored in the header
+	void mtb_read_header(std::ifstream &ifile, MTBHeader &header);
+
+	//! Reads and parses the header of a MTB file with positional reads (`pread`). This
+	//! routine do not check for format errors.
+	//!
+	//! @param file[in]			MTB file
+	//! @param header[out]		matrix properties stored in the header
+	//!
+	//! @exception std::runtime_error if the file is smaller than the header.
+	void mtb_read_header(const File &file, MTBHeader &header);
+
+	//! Writes the header of a MTB file, including the optional features (@ref MTBFlags).
+	//! This routine do not check for format errors.
+	//!
+	//! @param ofile[inout]		output stream to the MTB file
+	//! @param header[in]		matrix properties to be stored in the header
+	void mtb_write_header(std::ofstream &ofile, const MTBHeader &header);
+
+	//! Checks if the header requires the MTB v2 extension, i.e., if the file uses indices with
+	//! less than 64 bits or an encoding other than @ref kPlainEncoding.
+	bool mtb_is_extended(const MTBHeader &header);
+
+	//! Returns the size (in bytes) of the header, which is also the position of the first
+	//! entry in the file.
+	uint64_t mtb_header_size(const MTBHeader &header);
+
+	//! Returns the position (in bytes) of the row index (@ref kRowIndex) in a MTB file. The row
+	//! index follows the entries and the checksum section (@ref kChecksum).
+	uint64_t mtb_row_index_offset(const MTBHeader &header);
+
+	//! Returns the smallest index size (1, 2, 4 or 8 bytes) that can represent all row
+	//! and column indices of a matrix.
+	char mtb_min_index_size(uint64_t nrows, uint64_t ncols);
+
+	//! Parses the header of a MTB file from a memory buffer. This routine do not
+	//! check for format errors.
+	//!
+	//! @param buf[in]			buffer with @ref MTB_HEADER_SIZE bytes, or @ref MTB_MAX_HEADER_SIZE
+	//! 						bytes if the @ref kExtendedHeader flag is set
+	//! @param header[out]		matrix properties stored in the header
+	void mtb_parse_header(const char *buf, MTBHeader &header);
+
+	//! Formats the header of a MTB file into a memory buffer. The MTB v2 extension is
+	//! added if required (see @ref mtb_is_extended).
+	//!
+	//! @param buf[out]			buffer with (at least) @ref MTB_MAX_HEADER_SIZE bytes
+	//! @param header[in]		matrix properties to be stored in the header
+	void mtb_format_header(char *buf, const MTBHeader &header);
+
+	//! Checks if the header describes a matrix that can be handled by this library.
+	//!
+	//! @param header[in]		matrix properties stored in the header
+	//!
+	//! @exception std::runtime_error if the matrix type, datatype, type size, version, index size
+	//! or encoding is not supported.
+	void mtb_check_header(const MTBHeader &header);
+
+	//! Decodes a single nonzero value stored in a MTB file. Complex values are converted
+	//! to their real part if `T` is not a complex type.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param ptr[in]				pointer to the value in the MTB entry
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//!
+	//! @return the decoded value
+	template<typename T>
+	inline T mtb_decode_value(const char *ptr, char datatype, char type_size)
+	{
+		switch (datatype)
+		{
+			case kInteger:
+			{
+				int64_t val;
+
+				switch (type_size)
+				{
+					case 1: { int8_t tmp; std::memcpy(&tmp, ptr, 1); val = tmp; break; }
+					case 2: { int16_t tmp; std::memcpy(&tmp, ptr, 2); val = tmp; break; }
+					case 4: { int32_t tmp; std::memcpy(&tmp, ptr, 4); val = tmp; break; }
+					default: std::memcpy(&val, ptr, sizeof(int64_t)); break;
+				}
+
+				return (T) val;
+			}
+
+			case kReal:
+			case kComplex:
+			{
+				double real, imag = 0;
+
+				if (type_size == 4)
+				{
+					float tmp[2];
+					std::memcpy(tmp, ptr, (datatype == kComplex ? 2 : 1) * sizeof(float));
+					real = tmp[0];
+					if (datatype == kComplex) imag = tmp[1];
+
+				} else
+				{
+					double tmp[2];
+					std::memcpy(tmp, ptr, (datatype == kComplex ? 2 : 1) * sizeof(double));
+					real = tmp[0];
+					if (datatype == kComplex) imag = tmp[1];
+				}
+
+				if constexpr (is_complex<T>()) return T(real, imag);
+				else return (T) real;
+			}
+
+			default:
+				return (T) 1.0;
+		}
+	}
+
+	//! Decodes `count` consecutive entries of a MTB file from a memory buffer. For symmetric
+	//! matrices (@ref kSymmetricSparse), the entry `i` is stored in `data[2 * i]` and, if it
+	//! is not in the diagonal, its mirrored entry is stored in `data[2 * i + 1]`.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param raw[in]				buffer containing the encoded entries
+	//! @param data[out]			triplet array where the decoded entries will be stored
+	//! @param count[in]			number of entries to be decoded
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//!
+	//! @return pointer to the end of the last decoded entry in `raw`
+	template<typename T>
+	const char *mtb_decode_entries(const char *raw, Triplet<T> *data, uint64_t count, char mat_type,
+	                               char datatype, char type_size)
+	{
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+
+		// Fast paths: the entries of general matrices can be copied directly to the output
+		// array if they have the same binary layout as a Triplet.
+		if (mat_type != kSymmetricSparse)
+		{
+			if (mtb_has_triplet_layout<T>(datatype, type_size))
+			{
+				if (entry_size == sizeof(Triplet<T>))
+				{
+					std::memcpy((void *) data, raw, count * entry_size);
+					return raw + count * entry_size;
+
+				} else if (entry_size == 20 && sizeof(Triplet<T>) == 24)
+				{
+					mtb_expand_records(raw, (char *) data, count, entry_size, 0);
+					return raw + count * entry_size;
+				}
+
+			} else if constexpr (std::is_arithmetic_v<T> && sizeof(Triplet<T>) == 24)
+			{
+				if (datatype == kPattern && sizeof(std::ptrdiff_t) == sizeof(uint64_t))
+				{
+					T one = 1;
+					uint64_t fill = 0;
+					std::memcpy(&fill, &one, sizeof(T));
+
+					mtb_expand_records(raw, (char *) data, count, entry_size, fill);
+					return raw + count * entry_size;
+				}
+			}
+		}
+
+		return mtb_decode_dispatch<T>(raw, count, mat_type, datatype, type_size,
+		                              [data](uint64_t i, uint64_t row, uint64_t col, const T &val)
+		                              {
+			                              data[i].row = row;
+			                              data[i].col = col;
+			                              data[i].val = val;
+		                              });
+	}
+
 	//! Reads and parses the matrix entries of a MTB file. The entries are then
 	//! stored in a @ref Triplet array. This routine do not check for errors in the MTB file.
 	//!
+	//! For symmetric matrices (@ref kSymmetricSparse), `nz` must be twice the number of
+	//! entries stored in the file (see @ref mtb_decode_entries for the output layout).
+	//!
 	//! This routine assumes a **little endian** format.
 	//!
 	//! @param ifile[inout]			input file stream to the MTB file
@@ -57,139 +245,315 @@ namespace mtb
 	void mtb_read_data(std::ifstream &ifile, Triplet<T> *data, uint64_t nz, char mat_type,
 	                   char datatype, char type_size)
 	{
-		int batch_size = MTB_BUF_SIZE + (mat_type == kSymmetricSparse) * MTB_BUF_SIZE;
-		int step_size = 1 + (mat_type == kSymmetricSparse);
-		int raw_max_size = MTB_BUF_SIZE * (2 * sizeof(uint64_t) + type_size);
-		std::unique_ptr<char[]> raw(new char[raw_max_size]);
+		uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+		uint64_t count = (nz + step_size - 1) / step_size;
+		std::unique_ptr<char[]> raw(new char[MTB_BUF_SIZE * entry_size]);
 
-		for (uint64_t k = 0; k < nz; k += batch_size)
+		for (uint64_t k = 0; k < count; k += MTB_BUF_SIZE)
 		{
-			char *ptr = raw.get();
+			uint64_t batch_size = std::min<uint64_t>(MTB_BUF_SIZE, count - k);
 
 			// Read a large data block from the file
-			ifile.read(raw.get(), raw_max_size);
+			ifile.read(raw.get(), batch_size * entry_size);
+
+			mtb_decode_entries(raw.get(), data + k * step_size, batch_size, mat_type, datatype,
+			                   type_size);
+		}
+	}
+
+	//! Reads and parses the matrix entries of a MTB file with any index size and encoding
+	//! (MTB v1 or v2). The stream must be positioned at the first entry (e.g., right after
+	//! @ref mtb_read_header).
+	//!
+	//! For symmetric matrices (@ref kSymmetricSparse), `symmetry` selects the output layout. With
+	//! @ref kExpandSymmetry, the layout is the same as in @ref mtb_read_data and `data` must have
+	//! space for `2 * header.nz` entries. With @ref kLowerTriangle, only the `header.nz` entries
+	//! stored in the file are returned (see @ref mtb_expand_symmetric to add the upper triangle).
+	//!
+	//! If the file has checksums (@ref kChecksum), each block of entries is checked before it
+	//! is decoded.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param ifile[inout]			input file stream to the MTB file
+	//! @param data[out]			triplet array containing the entries of the matrix
+	//! @param header[in]			matrix properties stored in the header
+	//! @param symmetry[in]			layout of symmetric matrices
+	//!
+	//! @exception std::runtime_error if the file is truncated or corrupted (a checksum mismatch
+	//! names the affected entries).
+	template<typename T>
+	void mtb_read_data(std::ifstream &ifile, Triplet<T> *data, const MTBHeader &header,
+	                   MTBSymmetry symmetry = kExpandSymmetry)
+	{
+		char mat_type = (symmetry == kLowerTriangle) ? kGeneralSparse : header.mat_type;
+		uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 16, header.nz), 1);
+		std::unique_ptr<char[]> raw(new char[batch_size * entry_size]);
+		EntryReader reader(header);
+
+		for (uint64_t k = 0; k < header.nz; k += batch_size)
+		{
+			uint64_t size = std::min(batch_size, header.nz - k);
+
+			reader.read(ifile, raw.get(), size);
+			mtb_decode_entries(raw.get(), data + k * step_size, size, mat_type, header.datatype,
+			                   header.type_size);
+		}
+	}
+
+	//! Decodes `count` consecutive entries of a MTB file from a memory buffer and stores
+	//! them as a structure of arrays. The output layout is the same as in @ref mtb_decode_entries.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param raw[in]				buffer containing the encoded entries
+	//! @param rows[out]			row index of each entry
+	//! @param cols[out]			column index of each entry
+	//! @param vals[out]			value of each entry
+	//! @param count[in]			number of entries to be decoded
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//!
+	//! @return pointer to the end of the last decoded entry in `raw`
+	template<typename T, typename I>
+	const char *mtb_decode_entries_soa(const char *raw, I *rows, I *cols, T *vals, uint64_t count,
+	                                   char mat_type, char datatype, char type_size)
+	{
+		return mtb_decode_dispatch<T>(raw, count, mat_type, datatype, type_size,
+		                              [=](uint64_t i, uint64_t row, uint64_t col, const T &val)
+		                              {
+			                              rows[i] = row;
+			                              cols[i] = col;
+			                              vals[i] = val;
+		                              });
+	}
 
-			for (int i = 0; i < batch_size && i + k < nz; i += step_size)
+	//! Reads and parses the matrix entries of a MTB file. The entries are then stored
+	//! as a structure of arrays, i.e., the row indices, column indices and values are
+	//! stored in separate arrays. The index type `I` (e.g., `int32_t` or `int64_t`) must
+	//! be able to represent the number of rows and columns of the matrix. This routine do not
+	//! check for errors in the MTB file.
+	//!
+	//! For symmetric matrices (@ref kSymmetricSparse), `nz` must be twice the number of
+	//! entries stored in the file (see @ref mtb_decode_entries for the output layout).
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param ifile[inout]			input file stream to the MTB file
+	//! @param rows[out]			row index of each entry
+	//! @param cols[out]			column index of each entry
+	//! @param vals[out]			value of each entry
+	//! @param nz[in]				number of non-zeros entries
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	template<typename T, typename I>
+	void mtb_read_data_soa(std::ifstream &ifile, I *rows, I *cols, T *vals, uint64_t nz,
+	                       char mat_type, char datatype, char type_size)
+	{
+		uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+		uint64_t count = (nz + step_size - 1) / step_size;
+		std::unique_ptr<char[]> raw(new char[MTB_BUF_SIZE * entry_size]);
+
+		for (uint64_t k = 0; k < count; k += MTB_BUF_SIZE)
+		{
+			uint64_t batch_size = std::min<uint64_t>(MTB_BUF_SIZE, count - k);
+			uint64_t offset = k * step_size;
+
+			// Read a large data block from the file
+			ifile.read(raw.get(), batch_size * entry_size);
+
+			mtb_decode_entries_soa(raw.get(), rows + offset, cols + offset, vals + offset,
+			                       batch_size, mat_type, datatype, type_size);
+		}
+	}
+
+	//! Encodes a single nonzero value in a MTB entry, converting it to the datatype and size
+	//! of the file. If `T` is complex and the file is not, only the real part is stored.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param ptr[out]				pointer to the value in the MTB entry
+	//! @param val[in]				value to be encoded
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//!
+	//! @return pointer to the end of the encoded value
+	template<typename T>
+	inline char *mtb_encode_value(char *ptr, const T &val, char datatype, char type_size)
+	{
+		switch (datatype)
+		{
+			case kInteger:
+			{
+				int64_t integer;
+
+				if constexpr (is_complex<T>()) integer = (int64_t) val.real();
+				else integer = (int64_t) val;
+
+				switch (type_size)
+				{
+					case 1: { int8_t tmp = integer; std::memcpy(ptr, &tmp, 1); break; }
+					case 2: { int16_t tmp = integer; std::memcpy(ptr, &tmp, 2); break; }
+					case 4: { int32_t tmp = integer; std::memcpy(ptr, &tmp, 4); break; }
+					default: std::memcpy(ptr, &integer, sizeof(int64_t)); break;
+				}
+
+				return ptr + type_size;
+			}
+
+			case kReal:
+			case kComplex:
 			{
-				uint64_t row, col;
+				double parts[2];
+				int nparts = (datatype == kComplex) ? 2 : 1;
+
+				if constexpr (is_complex<T>())
+				{
+					parts[0] = val.real();
+					parts[1] = val.imag();
+
+				} else
+				{
+					parts[0] = val;
+					parts[1] = 0;
+				}
+
+				for (int i = 0; i < nparts; ++i)
+				{
+					if (type_size == 4)
+					{
+						float tmp = parts[i];
+						std::memcpy(ptr, &tmp, sizeof(float));
+
+					} else
+					{
+						std::memcpy(ptr, &parts[i], sizeof(double));
+					}
+
+					ptr += type_size;
+				}
 
-				std::memcpy(&row, ptr, sizeof(uint64_t));
-				ptr += sizeof(uint64_t);
+				return ptr;
+			}
 
-				std::memcpy(&col, ptr, sizeof(uint64_t));
-				ptr += sizeof(uint64_t);
+			default:
+				return ptr;
+		}
+	}
 
-				data[k + i].col = col;
-				data[k + i].row = row;
+	//! Returns the smallest size (in bytes) of the data type that stores the values of `count`
+	//! entries without loss: 1, 2, 4 or 8 bytes for integers (@ref kInteger) and 4 bytes
+	//! (`float`) for real and complex values if every part is read back as the same `double`,
+	//! or 8 bytes otherwise. The datatype is not changed. The results of several batches can be
+	//! combined with `std::max`, and `count == 0` returns the smallest size of the datatype.
+	//!
+	//! @param data[in]				triplet array containing the entries of the matrix
+	//! @param count[in]			number of entries
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//!
+	//! @return the value size to be stored in the header (`type_size`)
+	template<typename T>
+	char mtb_min_type_size(const Triplet<T> *data, uint64_t count, char datatype)
+	{
+		switch (datatype)
+		{
+			case kInteger:
+			{
+				int64_t min = 0, max = 0;
 
-				switch (datatype)
+				for (uint64_t i = 0; i < count; ++i)
 				{
-					case kPattern:
-						data[k + i].val = (T) 1.0;
-						break;
-
-					case kInteger:
-
-						// Assuming LITTLE ENDIAN
-						union
-						{
-							int64_t integer;
-							char bytes[sizeof(int64_t)];
-						} val;
-
-						std::memcpy(&val.bytes, ptr, type_size);
-						ptr += type_size;
-
-						data[k + i].val = val.integer;
-
-						break;
-
-					case kReal:
-						if (type_size == 8)
-						{
-							union
-							{
-									double fp;
-									char bytes[sizeof(double)];
-							} val;
-
-							std::memcpy(&val.bytes, ptr, type_size);
-							ptr += type_size;
-
-							data[k + i].val = val.fp;
-
-						} else if (type_size == 4)
-						{
-							union
-							{
-									float fp;
-									char bytes[sizeof(float)];
-							} val;
-
-							std::memcpy(&val.bytes, ptr, type_size);
-							ptr += type_size;
-
-							data[k + i].val = val.fp;
-						}
-
-						break;
-
-					case kComplex:
-						if constexpr (is_complex<T>())
-                        {
-							if (type_size == 8)
-							{
-								union
-								{
-									double fp;
-									char bytes[sizeof(double)];
-								} real, imag;
-
-								std::memcpy(&real.bytes, ptr, type_size);
-								ptr += type_size;
-
-								std::memcpy(&imag.bytes, ptr, type_size);
-								ptr += type_size;
-
-								data[k + i].val.real(real.fp);
-								data[k + i].val.imag(imag.fp);
-
-							} else if (type_size == 4)
-							{
-								union
-								{
-									float fp;
-									char bytes[sizeof(float)];
-								} real, imag;
-
-								std::memcpy(&real.bytes, ptr, type_size);
-								ptr += type_size;
-
-								std::memcpy(&imag.bytes, ptr, type_size);
-								ptr += type_size;
-
-								data[k + i].val.real(real.fp);
-								data[k + i].val.imag(imag.fp);
-							}
-                        }
-
-						break;
-
-					default:
-						throw std::runtime_error("Error: Unsupported MTB type!");
-						break;
+					int64_t integer;
+
+					if constexpr (is_complex<T>()) integer = (int64_t) data[i].val.real();
+					else integer = (int64_t) data[i].val;
+
+					min = std::min(min, integer);
+					max = std::max(max, integer);
 				}
 
-				if (mat_type == kSymmetricSparse && col < row)
+				if (min >= INT8_MIN && max <= INT8_MAX) return 1;
+				if (min >= INT16_MIN && max <= INT16_MAX) return 2;
+				if (min >= INT32_MIN && max <= INT32_MAX) return 4;
+				return 8;
+			}
+
+			case kReal:
+			case kComplex:
+			{
+				for (uint64_t i = 0; i < count; ++i)
 				{
-					std::swap(row, col);
-					data[k + i + 1].col = col;
-					data[k + i + 1].row = row;
-					data[k + i + 1].val = data[k + i].val;
+					double parts[2];
+
+					if constexpr (is_complex<T>())
+					{
+						parts[0] = data[i].val.real();
+						parts[1] = (datatype == kComplex) ? data[i].val.imag() : 0;
+
+					} else
+					{
+						parts[0] = data[i].val;
+						parts[1] = 0;
+					}
+
+					// NaN values are never equal, so they keep the 8-byte size
+					if ((double) (float) parts[0] != parts[0] || (double) (float) parts[1] != parts[1])
+						return sizeof(double);
 				}
+
+				return sizeof(float);
 			}
+
+			default:
+				return 0;
+		}
+	}
+
+	//! Encodes `count` consecutive entries stored as a @ref Triplet array into a memory
+	//! buffer with the MTB entry format.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param data[in]				triplet array containing the entries of the matrix
+	//! @param count[in]			number of entries to be encoded
+	//! @param raw[out]				buffer with space for `count` entries
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//!
+	//! @return pointer to the end of the last encoded entry in `raw`
+	template<typename T>
+	char *mtb_encode_entries(const Triplet<T> *data, uint64_t count, char *raw, char datatype,
+	                         char type_size)
+	{
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+
+		// Fast path: the triplets already have the same binary layout as the MTB entries
+		if (mtb_has_triplet_layout<T>(datatype, type_size) && entry_size == sizeof(Triplet<T>))
+		{
+			std::memcpy(raw, (const void *) data, count * entry_size);
+			return raw + count * entry_size;
+		}
+
+		char *ptr = raw;
+
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			std::memcpy(ptr, &data[i].row, sizeof(uint64_t));
+			ptr += sizeof(uint64_t);
+
+			std::memcpy(ptr, &data[i].col, sizeof(uint64_t));
+			ptr += sizeof(uint64_t);
+
+			ptr = mtb_encode_value(ptr, data[i].val, datatype, type_size);
 		}
 
+		return ptr;
 	}
 
 	//! Writes the matrix entries are stored as a @ref Triplet array in a MTB file.
@@ -205,58 +569,47 @@ namespace mtb
 	void mtb_write_data(std::ofstream &ofile, Triplet<T> *data, uint64_t nz, char mat_type,
 	                    char datatype, char type_size)
 	{
-		int raw_max_size = MTB_BUF_SIZE * (2 * sizeof(uint64_t) + type_size);
-		std::unique_ptr<char[]> raw(new char[raw_max_size]);
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+		std::unique_ptr<char[]> raw(new char[MTB_BUF_SIZE * entry_size]);
 
 		for (uint64_t k = 0; k < nz; k += MTB_BUF_SIZE)
 		{
-			char *ptr = raw.get();
-
-			for (int i = 0; i < MTB_BUF_SIZE && i + k < nz; ++i)
-			{
-				std::memcpy(ptr, &data[k + i].row, sizeof(uint64_t));
-				ptr += sizeof(uint64_t);
-
-				std::memcpy(ptr, &data[k + i].col, sizeof(uint64_t));
-				ptr += sizeof(uint64_t);
-
-				if constexpr (is_complex<T>())
-				{
-					union
-					{
-						typename T::value_type val;
-						char bytes[sizeof(typename T::value_type)];
-					} real, imag;
+			uint64_t batch_size = std::min<uint64_t>(MTB_BUF_SIZE, nz - k);
+			char *end = mtb_encode_entries(data + k, batch_size, raw.get(), datatype, type_size);
 
-					real.val = data[k + i].val.real();
-					imag.val = data[k + i].val.imag();
-
-					std::memcpy(ptr, real.bytes, type_size);
-					ptr += type_size;
+			ofile.write(raw.get(), end - raw.get());
+		}
+	}
 
-					std::memcpy(ptr, imag.bytes, type_size);
-					ptr += type_size;
+	//! Writes `header.nz` matrix entries stored as a @ref Triplet array in a MTB file, using
+	//! the index size and encoding of the header (MTB v1 or v2). The header must be written
+	//! before (see @ref mtb_write_header). The @ref kDeltaEncoding requires the entries to be
+	//! sorted in a row-major order. If the header has the @ref kChecksum flag, the checksum
+	//! section is written after the entries (and before the row index, if any).
+	//!
+	//! @param ofile[inout]			output file stream to the MTB file
+	//! @param data[in]				triplet array containing the entries of the matrix
+	//! @param header[in]			matrix properties stored in the header
+	//!
+	//! @exception std::runtime_error if an index does not fit in the index size or the
+	//! entries are not sorted (@ref kDeltaEncoding).
+	template<typename T>
+	void mtb_write_data(std::ofstream &ofile, const Triplet<T> *data, const MTBHeader &header)
+	{
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 16, header.nz), 1);
+		std::unique_ptr<char[]> raw(new char[batch_size * entry_size]);
+		EntryWriter writer(header);
 
-				} else
-				{
-					if (datatype != kPattern)
-					{
-						union
-						{
-							T val;
-							char bytes[sizeof(T)];
-						} val;
-
-						val.val = data[k + i].val;
-						std::memcpy(ptr, val.bytes, type_size);
-						ptr += type_size;
-					}
-				}
-			}
+		for (uint64_t k = 0; k < header.nz; k += batch_size)
+		{
+			uint64_t size = std::min(batch_size, header.nz - k);
 
-			auto size = ptr - raw.get();
-			ofile.write(raw.get(), size);
+			mtb_encode_entries(data + k, size, raw.get(), header.datatype, header.type_size);
+			writer.write(ofile, raw.get(), size);
 		}
+
+		writer.finish(ofile);
 	}
 
 }   // namespace mtb
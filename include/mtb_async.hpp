@@ -0,0 +1,149 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_ASYNC_HPP_
+#define _MTB_ASYNC_HPP_
+
+#include <memory>
+#include <string>
+
+#include "mtb.hpp"
+#include "mtb_io.hpp"
+
+namespace mtb
+{
+	//! Reads and parses the matrix entries of a MTB file. The file is read by a background
+	//! thread into `nbuffers` rotating buffers, so the I/O of the next block overlaps with
+	//! the decoding of the current one. Any index size is supported with the
+	//! @ref kPlainEncoding, and the checksums (@ref kChecksum) are verified if the file has
+	//! them. The output layout is the same as in @ref mtb_read_data.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param data[out]			triplet array containing the entries of the matrix
+	//! @param nz[in]				number of non-zeros entries (twice the number of entries
+	//! 							stored in the file for @ref kSymmetricSparse)
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//! @param nbuffers[in]			number of buffers
+	//!
+	//! @exception std::runtime_error if the file cannot be read, the header is not supported
+	//! or does not match the arguments, the encoding is not @ref kPlainEncoding or a checksum
+	//! does not match.
+	template<typename T>
+	void mtb_read_data_async(const std::string &filename, Triplet<T> *data, uint64_t nz,
+	                         char mat_type, char datatype, char type_size, int nbuffers = 2)
+	{
+		File file(filename, O_RDONLY);
+		MTBHeader header;
+
+		mtb_read_header(file, header);
+		mtb_check_header(header);
+
+		uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+		uint64_t count = (nz + step_size - 1) / step_size;
+
+		if (header.encoding != kPlainEncoding)
+			throw std::runtime_error("Error: The asynchronous reader requires the plain encoding!");
+		if (header.mat_type != mat_type || header.datatype != datatype || header.type_size != type_size
+		    || count > header.nz)
+			throw std::runtime_error("Error: The MTB header does not match the matrix properties!");
+
+		bool is_narrow = (header.index_size != sizeof(uint64_t));
+		uint64_t entry_size = mtb_entry_size(header);
+		uint64_t raw_size = mtb_entry_size(datatype, type_size);
+		uint64_t value_size = raw_size - 2 * sizeof(uint64_t);
+
+		std::unique_ptr<BlockChecksums> checksums;
+
+		if (header.flags & kChecksum)
+		{
+			checksums.reset(new BlockChecksums(header));
+			checksums->read(file);
+		}
+
+		// With checksums, the entries are read up to the end of the matrix to check the last block
+		uint64_t last_entry = checksums ? header.nz : count;
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 4, last_entry), 1);
+		std::unique_ptr<char[]> raw(is_narrow ? new char[batch_size * raw_size] : nullptr);
+
+		AsyncReader reader(file, mtb_header_size(header), last_entry * entry_size,
+		                   batch_size * entry_size, nbuffers);
+
+		const char *block;
+		uint64_t k = 0;
+
+		while (size_t size = reader.next(block))
+		{
+			uint64_t n = size / entry_size;
+
+			if (is_narrow)
+			{
+				mtb_widen_indices(block, raw.get(), n, header.index_size, value_size);
+				block = raw.get();
+			}
+
+			if (checksums) checksums->verify(block, n);
+			if (k < count)
+				mtb_decode_entries(block, data + k * step_size, std::min(n, count - k), mat_type, datatype,
+				                   type_size);
+			k += n;
+		}
+	}
+
+	//! Writes a MTB file (header and entries). The entries are encoded into `nbuffers` rotating
+	//! buffers and written by a background thread, so the encoding of the next block overlaps
+	//! with the I/O of the current one. The file is written in the MTB v1 layout (64-bit
+	//! indices, plain encoding).
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param data[in]				triplet array containing the entries of the matrix
+	//! @param nrows[in]			number of rows
+	//! @param ncols[in]			number of columns
+	//! @param nz[in]				number of non-zeros entries
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//! @param nbuffers[in]			number of buffers
+	//!
+	//! @exception std::runtime_error if the file cannot be written or the matrix properties
+	//! are not supported.
+	template<typename T>
+	void mtb_write_async(const std::string &filename, const Triplet<T> *data, uint64_t nrows,
+	                     uint64_t ncols, uint64_t nz, char mat_type, char datatype, char type_size,
+	                     int nbuffers = 2)
+	{
+		MTBHeader properties = {mat_type, datatype, type_size, nrows, ncols, nz};
+		mtb_check_header(properties);
+
+		File file(filename, O_WRONLY | O_CREAT | O_TRUNC);
+
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 4, nz), 1);
+
+		char header[MTB_MAX_HEADER_SIZE];
+		mtb_format_header(header, properties);
+		file.write_at(header, mtb_header_size(properties), 0);
+
+		AsyncWriter writer(file, mtb_header_size(properties), batch_size * entry_size, nbuffers);
+
+		for (uint64_t k = 0; k < nz; k += batch_size)
+		{
+			uint64_t n = std::min(batch_size, nz - k);
+			char *block = writer.acquire();
+			char *end = mtb_encode_entries(data + k, n, block, datatype, type_size);
+			writer.submit(end - block);
+		}
+
+		writer.finish();
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_ASYNC_HPP_ */
@@ -0,0 +1,143 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_CHECKSUM_HPP_
+#define _MTB_CHECKSUM_HPP_
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "mtb_def.hpp"
+#include "mtb_io.hpp"
+
+namespace mtb
+{
+	//! Computes the CRC32C (Castagnoli) of a memory buffer. The checksum of a buffer split in
+	//! several parts is obtained by passing the result of each call as `crc` of the next one.
+	//! This routine uses the SSE4.2 CRC instruction if the CPU supports it.
+	//!
+	//! @param crc[in]			checksum of the previous parts (0 for the first part)
+	//! @param buf[in]			data
+	//! @param size[in]			size of the data (in bytes)
+	//!
+	//! @return checksum of the data
+	uint32_t mtb_crc32c(uint32_t crc, const void *buf, uint64_t size);
+
+	//! Kernels of @ref mtb_crc32c
+	enum MTBCrcKernel
+	{
+		kSoftwareCrc = 0,	//!< Portable slicing-by-8 tables
+		kSSE42Crc = 1		//!< SSE4.2 CRC instruction (three interleaved streams)
+	};
+
+	//! Returns the fastest kernel of @ref mtb_crc32c supported by the CPU.
+	MTBCrcKernel mtb_crc_kernel();
+
+	//! Same as @ref mtb_crc32c, with a given kernel, so the kernels can be tested against each
+	//! other on the same CPU.
+	//!
+	//! @exception std::runtime_error if the CPU does not support the kernel.
+	uint32_t mtb_crc32c(uint32_t crc, const void *buf, uint64_t size, MTBCrcKernel kernel);
+
+	//! Returns the number of checksum blocks (@ref MTB_CHECKSUM_BLOCK entries) of a matrix.
+	inline uint64_t mtb_num_checksum_blocks(uint64_t nz)
+	{
+		return (nz + MTB_CHECKSUM_BLOCK - 1) / MTB_CHECKSUM_BLOCK;
+	}
+
+	//! Returns the size (in bytes) of the checksum section (@ref kChecksum) of a MTB file.
+	inline uint64_t mtb_checksum_size(const MTBHeader &header)
+	{
+		return (1 + mtb_num_checksum_blocks(header.nz)) * sizeof(uint32_t);
+	}
+
+	//! The @ref BlockChecksums holds the checksum section of a MTB file (@ref kChecksum): the
+	//! CRC32C of the header and of each block of @ref MTB_CHECKSUM_BLOCK entries. The checksum
+	//! of a block is computed over its entries in the MTB v1 layout, so it does not depend on
+	//! the index size or encoding of the file.
+	class BlockChecksums
+	{
+		public:
+			explicit BlockChecksums(const MTBHeader &header);
+
+			//! Adds the next `count` entries (MTB v1 layout) to the checksums being computed.
+			//! The number of entries in the header is only used by @ref finish, so it may be
+			//! unknown while the entries are added.
+			void update(const char *raw, uint64_t count);
+
+			//! Completes the checksums computed with @ref update: computes the checksum of the
+			//! last block and of the final header (with the number of entries).
+			void finish(const MTBHeader &header);
+
+			//! Computes the checksums of the entries `[first, first + count)` (MTB v1 layout),
+			//! with the same restrictions as in @ref verify_range. Since each block is computed
+			//! independently, this routine can be called concurrently for disjoint blocks.
+			void update_range(const char *raw, uint64_t first, uint64_t count);
+
+			//! Checks the next `count` entries (MTB v1 layout) against the checksums read from
+			//! the file. A block is checked as soon as its last entry is passed.
+			//!
+			//! @exception std::runtime_error if the checksum of a block does not match.
+			void verify(const char *raw, uint64_t count);
+
+			//! Checks the entries `[first, first + count)` (MTB v1 layout) against the checksums
+			//! read from the file. `first` must be the first entry of a block and the range must
+			//! end at the end of a block or of the matrix. Unlike @ref verify, this routine does
+			//! not change the state, so it can be called concurrently.
+			//!
+			//! @exception std::runtime_error if the checksum of a block does not match.
+			void verify_range(const char *raw, uint64_t first, uint64_t count) const;
+
+			//! Moves back to the first entry.
+			void reset();
+
+			//! Reads the checksum section, which is located from the end of the file (it is
+			//! only followed by the row index). The position of the stream is preserved.
+			//!
+			//! @exception std::runtime_error if the file is truncated or the checksum of the
+			//! header does not match.
+			void read(std::istream &in);
+
+			//! Reads the checksum section from a file with a positional read (`pread`).
+			//!
+			//! @exception std::runtime_error if the file is truncated or the checksum of the
+			//! header does not match.
+			void read(const File &file);
+
+			//! Reads the checksum section from a memory buffer with @ref mtb_checksum_size bytes.
+			//!
+			//! @exception std::runtime_error if the checksum of the header does not match.
+			void load(const char *buf);
+
+			//! Writes the checksum section after the last entry. All blocks must have been
+			//! computed before (see @ref finish).
+			void write(std::ostream &out) const;
+
+			//! Checksum of the header followed by those of the blocks (the checksum section)
+			const std::vector<uint32_t> &values() const { return _crcs; }
+
+			//! Returns the position (in bytes) of the checksum section from the end of the file.
+			uint64_t offset_from_end() const;
+
+		private:
+			//! Stores the checksum of a block computed with @ref update
+			void set_block(uint64_t block, uint32_t crc);
+
+			//! Throws the error of a corrupted block
+			[[noreturn]] void mismatch(uint64_t block) const;
+
+			MTBHeader _header;
+			uint64_t _entry_size;
+			std::vector<uint32_t> _crcs;	// Checksum of the header followed by those of the blocks
+			uint32_t _crc;					// Checksum of the current block
+			uint64_t _count;				// Number of entries already processed
+	};
+
+}   // namespace mtb
+
+#endif /* _MTB_CHECKSUM_HPP_ */
@@ -0,0 +1,142 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_CHUNKED_HPP_
+#define _MTB_CHUNKED_HPP_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "mtb.hpp"
+#include "mtb_compress.hpp"
+#include "mtb_io.hpp"
+
+namespace mtb
+{
+	//! The @ref ChunkedFile gives random access to the chunks of a MTB file with the
+	//! @ref kChunkedEncoding. Each chunk is read (`pread`) and decompressed independently,
+	//! so multiple threads can read different chunks of the same file concurrently.
+	class ChunkedFile
+	{
+		public:
+			//! Temporary buffers used to read a chunk. Each thread must have its own buffers.
+			struct Buffers
+			{
+				std::vector<char> compressed;
+				std::vector<char> scratch;
+				std::vector<char> raw;
+			};
+
+			//! Opens a MTB file and reads its header and chunk table.
+			//!
+			//! @param filename[in]		name of MTB file
+			//!
+			//! @exception std::runtime_error if the file cannot be read, the header is not
+			//! supported, the file does not use the @ref kChunkedEncoding, it is truncated or
+			//! the checksum of the header does not match (@ref kChecksum).
+			explicit ChunkedFile(const std::string &filename);
+			virtual ~ChunkedFile() = default;
+
+			const MTBHeader &header() const { return _header; }
+			char mat_type() const { return _header.mat_type; }
+			char datatype() const { return _header.datatype; }
+			char type_size() const { return _header.type_size; }
+			uint64_t nrows() const { return _header.nrows; }
+			uint64_t ncols() const { return _header.ncols; }
+			uint64_t nz() const { return _header.nz; }
+
+			//! Number of entries in each chunk (except the last one)
+			uint64_t chunk_size() const { return _table.chunk_size; }
+
+			//! Number of chunks
+			uint64_t num_chunks() const { return _table.offsets.size() - 1; }
+
+			//! Index of the first entry in the chunk `c`
+			uint64_t chunk_begin(uint64_t c) const { return c * _table.chunk_size; }
+
+			//! Number of entries in the chunk `c`
+			uint64_t chunk_count(uint64_t c) const
+			{
+				return std::min(_table.chunk_size, _header.nz - chunk_begin(c));
+			}
+
+			//! Reads and decompresses the chunk `c`, converting its entries to the MTB v1
+			//! layout (64-bit indices). If the file has checksums (@ref kChecksum), the entries
+			//! are checked right after they are decompressed.
+			//!
+			//! @param c[in]			index of the chunk
+			//! @param out[out]			buffer with space for `chunk_count(c)` entries
+			//! @param buffers[inout]	temporary buffers of the calling thread
+			//!
+			//! @exception std::runtime_error if the chunk is corrupted or a checksum does not match.
+			void read_chunk(uint64_t c, char *out, Buffers &buffers) const;
+
+			//! Reads and decodes the chunk `c`. With @ref kExpandSymmetry, the output layout is
+			//! the same as in @ref mtb_decode_entries, so `data` must have space for
+			//! `2 * chunk_count(c)` entries for @ref kSymmetricSparse.
+			//!
+			//! This routine assumes a **little endian** format.
+			template<typename T>
+			void read_chunk(uint64_t c, Triplet<T> *data, Buffers &buffers,
+			                MTBSymmetry symmetry = kExpandSymmetry) const
+			{
+				char mat_type = (symmetry == kLowerTriangle) ? kGeneralSparse : _header.mat_type;
+				uint64_t count = chunk_count(c);
+
+				buffers.raw.resize(count * mtb_entry_size(_header.datatype, _header.type_size));
+				read_chunk(c, buffers.raw.data(), buffers);
+
+				mtb_decode_entries(buffers.raw.data(), data, count, mat_type, _header.datatype,
+				                   _header.type_size);
+			}
+
+		private:
+			File _file;
+			MTBHeader _header;
+			ChunkTable _table;
+			uint64_t _data_offset;		// Position of the first chunk in the file
+			std::unique_ptr<BlockChecksums> _checksums;		// Only with @ref kChecksum
+	};
+
+	//! Reads and parses the matrix entries of a MTB file with the @ref kChunkedEncoding using
+	//! multiple threads. The chunks are distributed dynamically among the threads, and each
+	//! thread reads and decompresses its chunks directly into the output array. The output
+	//! layout is the same as in @ref mtb_read_data (see `symmetry` in its overload with a
+	//! @ref MTBHeader).
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param data[out]			triplet array containing the entries of the matrix
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//! @param symmetry[in]			layout of symmetric matrices
+	//!
+	//! @exception std::runtime_error if the file cannot be read or is corrupted.
+	template<typename T>
+	void mtb_read_data_chunked(const std::string &filename, Triplet<T> *data, int nthreads = 0,
+	                           MTBSymmetry symmetry = kExpandSymmetry)
+	{
+		ChunkedFile file(filename);
+
+		uint64_t step_size = 1 + (file.mat_type() == kSymmetricSparse && symmetry == kExpandSymmetry);
+		std::atomic<uint64_t> next(0);
+
+		nthreads = (int) std::min<uint64_t>(mtb_num_threads(nthreads), std::max<uint64_t>(file.num_chunks(), 1));
+
+		mtb_parallel_for(nthreads, nthreads, [&](int, uint64_t, uint64_t)
+		{
+			ChunkedFile::Buffers buffers;
+
+			for (uint64_t c = next++; c < file.num_chunks(); c = next++)
+				file.read_chunk(c, data + file.chunk_begin(c) * step_size, buffers, symmetry);
+		});
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_CHUNKED_HPP_ */
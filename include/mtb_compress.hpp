@@ -0,0 +1,85 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_COMPRESS_HPP_
+#define _MTB_COMPRESS_HPP_
+
+#include <vector>
+
+#include "mtb_def.hpp"
+
+namespace mtb
+{
+	//! Compression method of a chunk in the @ref kChunkedEncoding (first byte of the chunk)
+	enum MTBCodec
+	{
+		kStoredCodec = 0x00,	//!< The chunk is stored without compression
+		kLZCodec = 0x01			//!< The chunk is compressed with the built-in LZ codec
+	};
+
+	//! Splits `count` records of `record_size` bytes into byte planes: the byte `b` of the
+	//! record `i` is stored in `out[b * count + i]`. Since the high bytes of the indices and
+	//! values change slowly, the planes compress much better than the records.
+	void mtb_shuffle(const char *in, char *out, uint64_t count, uint64_t record_size);
+
+	//! Inverse of @ref mtb_shuffle.
+	void mtb_unshuffle(const char *in, char *out, uint64_t count, uint64_t record_size);
+
+	//! Returns the maximum size of `size` bytes compressed with @ref mtb_lz_compress.
+	inline uint64_t mtb_lz_bound(uint64_t size) { return size + size / 255 + 16; }
+
+	//! Compresses a memory buffer with the built-in LZ codec (a byte-oriented LZ77 variant
+	//! with a 64 KiB window, similar to the LZ4 block format).
+	//!
+	//! @param in[in]			data to be compressed
+	//! @param size[in]			size of the data (in bytes)
+	//! @param out[out]			buffer with (at least) @ref mtb_lz_bound bytes
+	//!
+	//! @return size of the compressed data (in bytes)
+	uint64_t mtb_lz_compress(const char *in, uint64_t size, char *out);
+
+	//! Decompresses a memory buffer compressed with @ref mtb_lz_compress.
+	//!
+	//! @param in[in]			compressed data
+	//! @param in_size[in]		size of the compressed data (in bytes)
+	//! @param out[out]			buffer for the decompressed data
+	//! @param out_size[in]		size of the decompressed data (in bytes)
+	//!
+	//! @exception std::runtime_error if the compressed data is corrupted.
+	void mtb_lz_decompress(const char *in, uint64_t in_size, char *out, uint64_t out_size);
+
+	//! Compresses a chunk of `count` entries with the plain encoding and the index size of
+	//! `header` (@ref kChunkedEncoding). The chunk is stored without compression if it
+	//! does not become smaller.
+	//!
+	//! @param in[in]			entries with the plain encoding
+	//! @param count[in]		number of entries
+	//! @param header[in]		matrix properties stored in the header
+	//! @param out[out]			output buffer (resized as needed)
+	//! @param scratch[inout]	temporary buffer (resized as needed)
+	//!
+	//! @return size of the compressed chunk (in bytes)
+	uint64_t mtb_compress_chunk(const char *in, uint64_t count, const MTBHeader &header,
+	                            std::vector<char> &out, std::vector<char> &scratch);
+
+	//! Decompresses a chunk created with @ref mtb_compress_chunk and converts its entries to
+	//! the MTB v1 layout (64-bit indices).
+	//!
+	//! @param in[in]			compressed chunk
+	//! @param in_size[in]		size of the compressed chunk (in bytes)
+	//! @param out[out]			buffer with space for `count` entries in the MTB v1 layout
+	//! @param count[in]		number of entries in the chunk
+	//! @param header[in]		matrix properties stored in the header
+	//! @param scratch[inout]	temporary buffer (resized as needed)
+	//!
+	//! @exception std::runtime_error if the chunk is corrupted.
+	void mtb_decompress_chunk(const char *in, uint64_t in_size, char *out, uint64_t count,
+	                          const MTBHeader &header, std::vector<char> &scratch);
+
+}   // namespace mtb
+
+#endif /* _MTB_COMPRESS_HPP_ */
@@ -0,0 +1,410 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_CSR_HPP_
+#define _MTB_CSR_HPP_
+
+#include <limits>
+#include <vector>
+
+#include "mtb.hpp"
+#include "mtb_sort.hpp"
+
+namespace mtb
+{
+	//! Reads the matrix entries of a MTB file directly into a compressed sparse format. If
+	//! `by_col == false`, the matrix is stored in the CSR format (`ptr` indexed by row and
+	//! `idx` containing the column indices). Otherwise, the matrix is stored in the CSC format.
+	//! See @ref mtb_read_csr and @ref mtb_read_csc.
+	template<typename T, typename I>
+	void mtb_read_compressed(std::ifstream &ifile, std::vector<I> &ptr, std::vector<I> &idx,
+	                         std::vector<T> &val, uint64_t nrows, uint64_t ncols, uint64_t nz,
+	                         char mat_type, char datatype, char type_size, bool by_col,
+	                         bool is_sorted)
+	{
+		bool is_symmetric = (mat_type == kSymmetricSparse);
+		uint64_t entry_size = mtb_entry_size(datatype, type_size);
+		uint64_t size = by_col ? ncols : nrows;
+		std::unique_ptr<char[]> raw(new char[std::min<uint64_t>(MTB_BUF_SIZE, nz) * entry_size]);
+
+		// Calls `func(major, minor, ptr_val)` for each entry in the file, where `ptr_val` points
+		// to its value.
+		auto for_each_entry = [&](auto &&func)
+		{
+			for (uint64_t k = 0; k < nz; k += MTB_BUF_SIZE)
+			{
+				uint64_t batch_size = std::min<uint64_t>(MTB_BUF_SIZE, nz - k);
+				const char *entry = raw.get();
+
+				// Read a large data block from the file
+				ifile.read(raw.get(), batch_size * entry_size);
+				if (!ifile) throw std::runtime_error("Error: Truncated MTB file!");
+
+				for (uint64_t i = 0; i < batch_size; ++i, entry += entry_size)
+				{
+					uint64_t coord[2];
+					std::memcpy(coord, entry, 2 * sizeof(uint64_t));
+
+					if (coord[0] >= nrows || coord[1] >= ncols)
+						throw std::runtime_error("Error: Invalid entry in MTB file!");
+
+					func(coord[by_col], coord[!by_col], entry + 2 * sizeof(uint64_t));
+				}
+			}
+		};
+
+		uint64_t max_index = std::numeric_limits<I>::max();
+
+		if (std::max(nrows, ncols) > max_index)
+			throw std::runtime_error("Error: Index type is too small for the matrix!");
+
+		ptr.assign(size + 1, 0);
+
+		if (is_sorted && !is_symmetric)
+		{
+			// The entries are already in the final order, so they can be stored directly.
+			uint64_t k = 0;
+			uint64_t last = 0;
+
+			if (nz > max_index) throw std::runtime_error("Error: Index type is too small for the matrix!");
+
+			idx.resize(nz);
+			val.resize(nz);
+
+			for_each_entry([&](uint64_t major, uint64_t minor, const char *ptr_val)
+			{
+				if (major < last) throw std::runtime_error("Error: MTB file is not sorted!");
+				last = major;
+
+				++ptr[major + 1];
+				idx[k] = minor;
+				val[k] = mtb_decode_value<T>(ptr_val, datatype, type_size);
+				++k;
+			});
+
+			for (uint64_t i = 0; i < size; ++i)
+				ptr[i + 1] += ptr[i];
+
+			return;
+		}
+
+		std::streampos start = ifile.tellg();
+
+		// The counts are kept in 64 bits, since the expanded symmetric matrix may have more
+		// entries than `I` can hold
+		std::vector<uint64_t> pos(size + 1, 0);
+
+		// First pass: count the number of entries in each row (or column)
+		for_each_entry([&](uint64_t major, uint64_t minor, const char *)
+		{
+			++pos[major + 1];
+			if (is_symmetric && major != minor) ++pos[minor + 1];
+		});
+
+		for (uint64_t i = 0; i < size; ++i)
+			pos[i + 1] += pos[i];
+
+		if (pos[size] > max_index) throw std::runtime_error("Error: Index type is too small for the matrix!");
+
+		idx.resize(pos[size]);
+		val.resize(pos[size]);
+
+		// Second pass: place each entry in its row (or column). During this pass, pos[i]
+		// is the position of the next entry in the row `i`.
+		ifile.clear();
+		ifile.seekg(start);
+
+		for_each_entry([&](uint64_t major, uint64_t minor, const char *ptr_val)
+		{
+			T value = mtb_decode_value<T>(ptr_val, datatype, type_size);
+
+			uint64_t k = pos[major]++;
+			idx[k] = minor;
+			val[k] = value;
+
+			if (is_symmetric && major != minor)
+			{
+				k = pos[minor]++;
+				idx[k] = major;
+				val[k] = value;
+			}
+		});
+
+		// Restore the row (or column) pointers
+		for (uint64_t i = 0; i < size; ++i)
+			ptr[i + 1] = pos[i];
+	}
+
+	//! Reads the matrix entries of a MTB file directly into the CSR (Compressed Sparse Row)
+	//! format, without creating an intermediate @ref Triplet array. Within each row, the
+	//! entries are kept in the same order as in the file. Symmetric matrices are expanded
+	//! to include both triangles.
+	//!
+	//! If `is_sorted == true`, the file must be sorted in a row-major order (e.g., created
+	//! with `mtx_to_mtb(..., true)`) and the file is only read once.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param ifile[inout]			input file stream to the MTB file
+	//! @param row_ptr[out]			position of the first entry of each row (`nrows + 1` entries)
+	//! @param col_idx[out]			column index of each entry
+	//! @param val[out]				value of each entry
+	//! @param nrows[in]			number of rows
+	//! @param ncols[in]			number of columns
+	//! @param nz[in]				number of entries stored in the file
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//! @param is_sorted[in]		the file is sorted in a row-major order
+	//!
+	//! @exception std::runtime_error if the file is truncated, contains an index out of
+	//! bounds, is not sorted (when `is_sorted == true`) or if `I` cannot hold the indices.
+	template<typename T, typename I = uint64_t>
+	void mtb_read_csr(std::ifstream &ifile, std::vector<I> &row_ptr, std::vector<I> &col_idx,
+	                  std::vector<T> &val, uint64_t nrows, uint64_t ncols, uint64_t nz,
+	                  char mat_type, char datatype, char type_size, bool is_sorted = false)
+	{
+		mtb_read_compressed(ifile, row_ptr, col_idx, val, nrows, ncols, nz, mat_type, datatype,
+		                    type_size, false, is_sorted);
+	}
+
+	//! Reads the matrix entries of a MTB file directly into the CSC (Compressed Sparse Column)
+	//! format. See @ref mtb_read_csr for more details. Here, `is_sorted == true` means that the
+	//! file is sorted in a column-major order.
+	template<typename T, typename I = uint64_t>
+	void mtb_read_csc(std::ifstream &ifile, std::vector<I> &col_ptr, std::vector<I> &row_idx,
+	                  std::vector<T> &val, uint64_t nrows, uint64_t ncols, uint64_t nz,
+	                  char mat_type, char datatype, char type_size, bool is_sorted = false)
+	{
+		mtb_read_compressed(ifile, col_ptr, row_idx, val, nrows, ncols, nz, mat_type, datatype,
+		                    type_size, true, is_sorted);
+	}
+
+	//! Builds a compressed sparse format from a @ref Triplet array. If `by_col == false`, the
+	//! matrix is stored in the CSR format (`ptr` indexed by row and `idx` containing the column
+	//! indices). Otherwise, the matrix is stored in the CSC format. See @ref mtb_build_csr and
+	//! @ref mtb_build_csc.
+	template<typename T, typename I>
+	void mtb_build_compressed(Triplet<T> *data, uint64_t nz, uint64_t nrows, uint64_t ncols,
+	                          std::vector<I> &ptr, std::vector<I> &idx, std::vector<T> &val,
+	                          bool by_col, int nthreads)
+	{
+		uint64_t max_index = std::numeric_limits<I>::max();
+		uint64_t size = by_col ? ncols : nrows;
+
+		if (std::max(nrows, ncols) > max_index || nz > max_index)
+			throw std::runtime_error("Error: Index type is too small for the matrix!");
+
+		mtb_sort_triplets(data, nz, nrows, ncols, by_col, nthreads);
+
+		ptr.assign(size + 1, 0);
+		idx.resize(nz);
+		val.resize(nz);
+
+		for (uint64_t k = 0; k < nz; ++k)
+			++ptr[(by_col ? data[k].col : data[k].row) + 1];
+
+		for (uint64_t i = 0; i < size; ++i)
+			ptr[i + 1] += ptr[i];
+
+		mtb_parallel_for(nz, mtb_num_threads(nthreads), [&](int, uint64_t begin, uint64_t end)
+		{
+			for (uint64_t k = begin; k < end; ++k)
+			{
+				idx[k] = by_col ? data[k].row : data[k].col;
+				val[k] = data[k].val;
+			}
+		});
+	}
+
+	//! Builds the CSR (Compressed Sparse Row) format from a @ref Triplet array. The triplets
+	//! are sorted in place in a row-major order with @ref mtb_sort_triplets, so the column
+	//! indices of each row are sorted, and entries with the same indices keep their order. The
+	//! triplets are stored as given, so symmetric matrices must be expanded before (e.g., with
+	//! @ref mtb_read_data or @ref mtb_expand_symmetric).
+	//!
+	//! @param data[inout]			triplet array (sorted at exit)
+	//! @param nz[in]				number of entries
+	//! @param nrows[in]			number of rows
+	//! @param ncols[in]			number of columns
+	//! @param row_ptr[out]			position of the first entry of each row (`nrows + 1` entries)
+	//! @param col_idx[out]			column index of each entry
+	//! @param val[out]				value of each entry
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//!
+	//! @exception std::runtime_error if an index is out of bounds or if `I` cannot hold the
+	//! indices.
+	template<typename T, typename I = uint64_t>
+	void mtb_build_csr(Triplet<T> *data, uint64_t nz, uint64_t nrows, uint64_t ncols,
+	                   std::vector<I> &row_ptr, std::vector<I> &col_idx, std::vector<T> &val,
+	                   int nthreads = 0)
+	{
+		mtb_build_compressed(data, nz, nrows, ncols, row_ptr, col_idx, val, false, nthreads);
+	}
+
+	//! Builds the CSC (Compressed Sparse Column) format from a @ref Triplet array, sorted in
+	//! place in a column-major order. See @ref mtb_build_csr for more details.
+	template<typename T, typename I = uint64_t>
+	void mtb_build_csc(Triplet<T> *data, uint64_t nz, uint64_t nrows, uint64_t ncols,
+	                   std::vector<I> &col_ptr, std::vector<I> &row_idx, std::vector<T> &val,
+	                   int nthreads = 0)
+	{
+		mtb_build_compressed(data, nz, nrows, ncols, col_ptr, row_idx, val, true, nthreads);
+	}
+
+	//! Writes a matrix stored in a compressed sparse format in a MTB file (header, entries,
+	//! checksum section and row index), without creating an intermediate @ref Triplet array.
+	//! If `by_col == false`, the matrix is stored in the CSR format. Otherwise, it is stored in
+	//! the CSC format. See @ref mtb_write_csr and @ref mtb_write_csc.
+	template<typename T, typename I>
+	void mtb_write_compressed(std::ofstream &ofile, const I *ptr, const I *idx, const T *val,
+	                          MTBHeader header, bool by_col, bool lower_triangle)
+	{
+		uint64_t size = by_col ? header.ncols : header.nrows;
+		uint64_t minor_size = by_col ? header.nrows : header.ncols;
+
+		// An entry (row, col) is in the lower triangle if row >= col
+		auto is_stored = [=](uint64_t major, uint64_t minor)
+		{
+			return !lower_triangle || (by_col ? minor >= major : minor <= major);
+		};
+
+		// Number of entries written for the row (or column) `i`
+		auto count_entries = [&](uint64_t i)
+		{
+			if (!lower_triangle) return (uint64_t) ptr[i + 1] - (uint64_t) ptr[i];
+
+			uint64_t count = 0;
+			for (uint64_t k = ptr[i]; k < (uint64_t) ptr[i + 1]; ++k)
+				count += is_stored(i, idx[k]);
+
+			return count;
+		};
+
+		header.nz = 0;
+		if (lower_triangle) header.mat_type = kSymmetricSparse;
+
+		// This pass only reads the pointers (and the indices for the lower triangle)
+		for (uint64_t i = 0; i < size; ++i)
+		{
+			if (ptr[i + 1] < ptr[i]) throw std::runtime_error("Error: Invalid compressed matrix!");
+			header.nz += count_entries(i);
+		}
+
+		if (by_col && (header.flags & kRowIndex))
+			throw std::runtime_error("Error: The row index requires the CSR format!");
+
+		mtb_check_header(header);
+		mtb_write_header(ofile, header);
+
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 16, header.nz), 1);
+		std::unique_ptr<char[]> raw(new char[batch_size * entry_size]);
+		bool has_value = (header.datatype != kPattern);
+		bool is_copy = mtb_has_triplet_layout<T>(header.datatype, header.type_size);
+		uint64_t count = 0;
+		EntryWriter writer(header);
+
+		// The entries are encoded directly from the compressed arrays into the output buffer
+		for (uint64_t i = 0; i < size; ++i)
+		{
+			for (uint64_t k = ptr[i]; k < (uint64_t) ptr[i + 1]; ++k)
+			{
+				uint64_t coord[2];
+				coord[by_col] = i;
+				coord[!by_col] = idx[k];
+
+				if (!is_stored(i, coord[!by_col])) continue;
+				if (coord[!by_col] >= minor_size)
+					throw std::runtime_error("Error: Invalid entry in compressed matrix!");
+
+				char *entry = raw.get() + count * entry_size;
+				std::memcpy(entry, coord, 2 * sizeof(uint64_t));
+
+				if (is_copy) std::memcpy(entry + 2 * sizeof(uint64_t), &val[k], sizeof(T));
+				else if (has_value)
+					mtb_encode_value(entry + 2 * sizeof(uint64_t), val[k], header.datatype,
+					                 header.type_size);
+
+				if (++count == batch_size)
+				{
+					writer.write(ofile, raw.get(), count);
+					count = 0;
+				}
+			}
+		}
+
+		writer.write(ofile, raw.get(), count);
+		writer.finish(ofile);
+
+		if (header.flags & kRowIndex)
+		{
+			std::vector<uint64_t> buffer;
+			buffer.reserve(MTB_BUF_SIZE / 8);
+
+			uint64_t pos = 0;
+
+			for (uint64_t row = 0; row <= header.nrows; ++row)
+			{
+				buffer.push_back(pos);
+				if (row < header.nrows) pos += count_entries(row);
+
+				if (buffer.size() == buffer.capacity() || row == header.nrows)
+				{
+					ofile.write((const char *) buffer.data(), buffer.size() * sizeof(uint64_t));
+					buffer.clear();
+				}
+			}
+		}
+
+		if (!ofile) throw std::runtime_error("Error: Cannot write to MTB file!");
+	}
+
+	//! Writes a matrix stored in the CSR (Compressed Sparse Row) format in a MTB file, without
+	//! creating an intermediate @ref Triplet array. The entries are encoded directly from the
+	//! CSR arrays, so no memory proportional to the number of entries is allocated. The entries
+	//! of each row are written in the same order as in `col_idx`.
+	//!
+	//! The number of entries (`header.nz`) is computed from `row_ptr`. With
+	//! `lower_triangle == true`, only the entries at or below the diagonal are written and the
+	//! matrix type is @ref kSymmetricSparse (the upper triangle is assumed to be its mirror).
+	//! Since the entries are sorted by row, the row index (@ref kRowIndex) can be written. The
+	//! @ref kDeltaEncoding requires the column indices of each row to be sorted.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param ofile[inout]			output file stream to the MTB file
+	//! @param row_ptr[in]			position of the first entry of each row (`nrows + 1` entries)
+	//! @param col_idx[in]			column index of each entry
+	//! @param val[in]				value of each entry (not used with @ref kPattern)
+	//! @param header[in]			matrix properties to be stored in the header (`nz` is ignored)
+	//! @param lower_triangle[in]	only write the lower triangle as a symmetric matrix
+	//!
+	//! @exception std::runtime_error if the header is not supported, the file cannot be written,
+	//! a column index is out of bounds, an index does not fit in the index size or the columns
+	//! are not sorted (@ref kDeltaEncoding).
+	template<typename T, typename I>
+	void mtb_write_csr(std::ofstream &ofile, const I *row_ptr, const I *col_idx, const T *val,
+	                   const MTBHeader &header, bool lower_triangle = false)
+	{
+		mtb_write_compressed(ofile, row_ptr, col_idx, val, header, false, lower_triangle);
+	}
+
+	//! Writes a matrix stored in the CSC (Compressed Sparse Column) format in a MTB file. See
+	//! @ref mtb_write_csr for more details. The entries are written in a column-major order, so
+	//! the row index (@ref kRowIndex) and the @ref kDeltaEncoding are not supported (unless
+	//! the matrix has the same order in both formats).
+	template<typename T, typename I>
+	void mtb_write_csc(std::ofstream &ofile, const I *col_ptr, const I *row_idx, const T *val,
+	                   const MTBHeader &header, bool lower_triangle = false)
+	{
+		mtb_write_compressed(ofile, col_ptr, row_idx, val, header, true, lower_triangle);
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_CSR_HPP_ */
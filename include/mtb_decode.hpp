@@ -0,0 +1,171 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_DECODE_HPP_
+#define _MTB_DECODE_HPP_
+
+#include <stdexcept>
+#include <utility>
+
+#include "mtb_def.hpp"
+
+namespace mtb
+{
+	//! Instruction sets of the record expansion kernels (see @ref mtb_expand_records)
+	enum MTBSimdLevel
+	{
+		kScalarSimd = 0,	//!< Portable scalar code
+		kAVX2Simd = 1,		//!< AVX2 permutes (32-byte vectors)
+		kAVX512Simd = 2		//!< AVX-512 permutes (64-byte vectors)
+	};
+
+	//! Returns the widest instruction set of the record expansion kernels supported by the CPU.
+	MTBSimdLevel mtb_simd_level();
+
+	//! Copies `count` records of `in_size` bytes (16 or 20) from `in` to 24-byte records in
+	//! `out`. If `in_size == 16`, the last 8 bytes of each output record are set to `fill`.
+	//! Otherwise, the last 4 bytes of each output record are left undefined (padding).
+	//! This routine selects the widest SIMD instruction set supported by the CPU at runtime.
+	void mtb_expand_records(const char *in, char *out, uint64_t count, int in_size, uint64_t fill);
+
+	//! Same as @ref mtb_expand_records, with the kernel of a given instruction set, so each
+	//! kernel can be tested and benchmarked on the same CPU.
+	//!
+	//! @exception std::runtime_error if the CPU does not support the instruction set.
+	void mtb_expand_records(const char *in, char *out, uint64_t count, int in_size, uint64_t fill,
+	                        MTBSimdLevel level);
+
+	//! Loads a value stored in a MTB entry. The datatype and size are known at compile time.
+	//! Complex values are converted to their real part if `T` is not a complex type.
+	template<char Datatype, int TypeSize, typename T>
+	inline T mtb_load_value(const char *ptr)
+	{
+		if constexpr (Datatype == kPattern)
+		{
+			return (T) 1.0;
+
+		} else if constexpr (Datatype == kInteger)
+		{
+			using Int = std::conditional_t<TypeSize == 1, int8_t,
+			            std::conditional_t<TypeSize == 2, int16_t,
+			            std::conditional_t<TypeSize == 4, int32_t, int64_t>>>;
+			Int val;
+			std::memcpy(&val, ptr, sizeof(Int));
+			return (T) val;
+
+		} else
+		{
+			using Float = std::conditional_t<TypeSize == 4, float, double>;
+			Float val[1 + (Datatype == kComplex)];
+			std::memcpy(val, ptr, sizeof(val));
+
+			if constexpr (Datatype == kComplex && is_complex<T>()) return T(val[0], val[1]);
+			else return (T) val[0];
+		}
+	}
+
+	//! Decodes `count` entries of a MTB file, with the datatype, size and symmetry known
+	//! at compile time. The decoded entry `i` is passed to `out(i, row, col, val)` (see
+	//! @ref mtb_decode_entries for the position of the entries in symmetric matrices).
+	//!
+	//! In symmetric matrices, `out` is called twice for each entry, so it must store the entry
+	//! at the given position. The second call receives the mirrored entry at position `2 * i + 1`
+	//! or, for entries in the diagonal, the same entry at position `2 * i` again.
+	//!
+	//! @return pointer to the end of the last decoded entry in `raw`
+	template<char Datatype, int TypeSize, bool Symmetric, typename T, typename Out>
+	const char *mtb_decode_kernel(const char *raw, uint64_t count, Out &out)
+	{
+		constexpr uint64_t entry_size = 2 * sizeof(uint64_t) + (Datatype == kComplex ? 2 : 1) * TypeSize;
+		constexpr uint64_t step_size = 1 + Symmetric;
+
+		for (uint64_t i = 0; i < count; ++i, raw += entry_size)
+		{
+			uint64_t row, col;
+			std::memcpy(&row, raw, sizeof(uint64_t));
+			std::memcpy(&col, raw + sizeof(uint64_t), sizeof(uint64_t));
+
+			T val = mtb_load_value<Datatype, TypeSize, T>(raw + 2 * sizeof(uint64_t));
+			out(i * step_size, row, col, val);
+
+			// The mirror is stored without a (mispredicted) branch: entries that are not in the
+			// lower triangle are stored again at their own position, with the same indices.
+			if constexpr (Symmetric)
+			{
+				uint64_t is_lower = col < row;
+				uint64_t swap = (row ^ col) & (0 - is_lower);
+				out(i * step_size + is_lower, row ^ swap, col ^ swap, val);
+			}
+		}
+
+		return raw;
+	}
+
+	//! Selects (at runtime) the specialization of @ref mtb_decode_kernel for the given symmetry.
+	template<char Datatype, int TypeSize, typename T, typename Out>
+	const char *mtb_decode_symmetry(const char *raw, uint64_t count, char mat_type, Out &out)
+	{
+		if (mat_type == kSymmetricSparse)
+			return mtb_decode_kernel<Datatype, TypeSize, true, T>(raw, count, out);
+		else
+			return mtb_decode_kernel<Datatype, TypeSize, false, T>(raw, count, out);
+	}
+
+	//! Selects (at runtime) the specialization of @ref mtb_decode_kernel for the given matrix
+	//! type, datatype and type size. The selection is done once per call, not per entry.
+	//!
+	//! @exception std::runtime_error if the datatype or type size is not supported.
+	template<typename T, typename Out>
+	const char *mtb_decode_dispatch(const char *raw, uint64_t count, char mat_type, char datatype,
+	                                char type_size, Out &&out)
+	{
+		switch (datatype | type_size)
+		{
+			case kPattern:
+				return mtb_decode_symmetry<kPattern, 0, T>(raw, count, mat_type, out);
+			case kInteger | 1:
+				return mtb_decode_symmetry<kInteger, 1, T>(raw, count, mat_type, out);
+			case kInteger | 2:
+				return mtb_decode_symmetry<kInteger, 2, T>(raw, count, mat_type, out);
+			case kInteger | 4:
+				return mtb_decode_symmetry<kInteger, 4, T>(raw, count, mat_type, out);
+			case kInteger | 8:
+				return mtb_decode_symmetry<kInteger, 8, T>(raw, count, mat_type, out);
+			case kReal | 4:
+				return mtb_decode_symmetry<kReal, 4, T>(raw, count, mat_type, out);
+			case kReal | 8:
+				return mtb_decode_symmetry<kReal, 8, T>(raw, count, mat_type, out);
+			case kComplex | 4:
+				return mtb_decode_symmetry<kComplex, 4, T>(raw, count, mat_type, out);
+			case kComplex | 8:
+				return mtb_decode_symmetry<kComplex, 8, T>(raw, count, mat_type, out);
+			default:
+				throw std::runtime_error("Error: Unsupported MTB type!");
+		}
+	}
+
+	//! Checks if a MTB entry with the given datatype and type size has exactly the same
+	//! binary representation as a `Triplet<T>`, apart from padding bytes.
+	template<typename T>
+	constexpr bool mtb_has_triplet_layout(char datatype, char type_size)
+	{
+		if constexpr (sizeof(std::ptrdiff_t) != sizeof(uint64_t)) return false;
+		else if constexpr (is_complex<T>())
+			return datatype == kComplex && sizeof(typename T::value_type) == (size_t) type_size
+			       && std::is_floating_point_v<typename T::value_type>
+			       && sizeof(Triplet<T>) == 2 * sizeof(uint64_t) + 2 * sizeof(typename T::value_type);
+		else if constexpr (std::is_floating_point_v<T>)
+			return datatype == kReal && sizeof(T) == (size_t) type_size;
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			return datatype == kInteger && sizeof(T) == (size_t) type_size;
+		else
+			return false;
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_DECODE_HPP_ */
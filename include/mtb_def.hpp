@@ -15,6 +15,13 @@
 #include <type_traits>
 
 #define MTB_BUF_SIZE (1 << 24)
+#define MTB_HEADER_SIZE 26
+#define MTB_EXT_HEADER_SIZE 4
+#define MTB_MAX_HEADER_SIZE (MTB_HEADER_SIZE + MTB_EXT_HEADER_SIZE)
+#define MTB_FLAGS_MASK 0xE0
+#define MTB_VERSION 2
+#define MTB_CHUNK_SIZE (1 << 16)
+#define MTB_CHECKSUM_BLOCK (1 << 16)
 
 namespace mtb
 {
@@ -43,6 +50,58 @@ namespace mtb
 		kComplex = 0x30	  		//!< Complex always uses floating-point datatype for the complex and real parts
 	};
 
+	//! Optional features of a MTB file. The flags are stored in the upper bits of the
+	//! matrix type byte.
+	enum MTBFlags
+	{
+		kRowIndex = 0x80,		//!< The entries are sorted by row and followed by a row index
+		kExtendedHeader = 0x40,	//!< The header is followed by the MTB v2 extension
+		kChecksum = 0x20		//!< The entries are followed by the CRC32C of each data block
+	};
+
+	//! Layout of symmetric matrices (@ref kSymmetricSparse) in memory after reading
+	enum MTBSymmetry
+	{
+		kExpandSymmetry,	//!< The entry `i` is in `data[2 * i]` and its mirror in `data[2 * i + 1]`
+		kLowerTriangle		//!< Only the entries stored in the file (at or below the diagonal)
+	};
+
+	//! Encoding of the matrix entries (MTB v2)
+	enum MTBEncoding
+	{
+		kPlainEncoding = 0x00,	//!< Fixed-size triplets (row, col, value)
+		kDeltaEncoding = 0x01,	//!< Row runs with delta-coded columns (requires row-sorted entries)
+		kChunkedEncoding = 0x02	//!< Independent chunks of byte-shuffled and compressed plain entries
+	};
+
+	//! The @ref MTBHeader contains the matrix properties stored at the beginning of a MTB file.
+	struct MTBHeader
+	{
+		char mat_type;			//!< Matrix type (@ref MTBMatrixType)
+		char datatype;			//!< Datatype (@ref MTBDatatype)
+		char type_size;			//!< Size of the data type (in bytes)
+		uint64_t nrows;			//!< Number of rows
+		uint64_t ncols;			//!< Number of columns
+		uint64_t nz;			//!< Number of nonzero entries stored in the file
+		char flags = 0;							//!< Optional features (@ref MTBFlags)
+		char version = 1;						//!< Version of the file format
+		char index_size = sizeof(uint64_t);		//!< Size of the row and column indices (in bytes)
+		char encoding = kPlainEncoding;			//!< Encoding of the entries (@ref MTBEncoding)
+	};
+
+	//! Returns the size (in bytes) of a single matrix entry in a MTB file.
+	inline uint64_t mtb_entry_size(char datatype, char type_size)
+	{
+		return 2 * sizeof(uint64_t) + (datatype == kComplex ? 2 : 1) * type_size;
+	}
+
+	//! Returns the size (in bytes) of a single matrix entry in a MTB file with the
+	//! plain encoding, taking into account the size of the indices.
+	inline uint64_t mtb_entry_size(const MTBHeader &header)
+	{
+		return 2 * header.index_size + (header.datatype == kComplex ? 2 : 1) * header.type_size;
+	}
+
 	//! The @ref Triplet represents a nonzero entry in a sparse matrix.
 	//! **Template Parameters:**
 	//! - ``T`` - Type of nonzero value.
@@ -0,0 +1,255 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_ENCODING_HPP_
+#define _MTB_ENCODING_HPP_
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "mtb_checksum.hpp"
+#include "mtb_def.hpp"
+
+namespace mtb
+{
+	//! Converts `count` entries with `index_size`-byte indices to entries with 64-bit indices
+	//! (i.e., the MTB v1 layout). Each entry has `value_size` bytes after the indices.
+	//!
+	//! @param in[in]				entries with narrow indices
+	//! @param out[out]				entries with 64-bit indices (must not overlap `in`)
+	//! @param count[in]			number of entries
+	//! @param index_size[in]		size of the indices in `in` (1, 2, 4 or 8 bytes)
+	//! @param value_size[in]		size of the value of each entry (in bytes)
+	void mtb_widen_indices(const char *in, char *out, uint64_t count, int index_size,
+	                       uint64_t value_size);
+
+	//! Converts `count` entries with 64-bit indices to entries with `index_size`-byte indices.
+	//! The conversion can be done in place (`in == out`).
+	//!
+	//! @exception std::runtime_error if an index cannot be represented with `index_size` bytes.
+	void mtb_narrow_indices(const char *in, char *out, uint64_t count, int index_size,
+	                        uint64_t value_size);
+
+	//! The @ref DeltaEncoder converts entries with 64-bit indices (sorted by row, then by
+	//! column) to the @ref kDeltaEncoding format. The entries are grouped in runs with the
+	//! same row:
+	//!
+	//! - varint(row - previous run row), varint(number of entries in the run)
+	//! - for each entry: varint(col - previous col in the run), value
+	//!
+	//! where varint is the LEB128 encoding of an unsigned integer. A run never crosses the
+	//! boundary between two calls of @ref encode, so a row may be split into several runs.
+	class DeltaEncoder
+	{
+		public:
+			explicit DeltaEncoder(uint64_t value_size) : _value_size(value_size), _row(0) {}
+
+			//! Maximum size (in bytes) of `count` encoded entries
+			uint64_t max_size(uint64_t count) const { return count * (30 + _value_size); }
+
+			//! Encodes `count` entries.
+			//!
+			//! @param in[in]		entries with 64-bit indices
+			//! @param count[in]	number of entries
+			//! @param out[out]		buffer with (at least) @ref max_size bytes
+			//!
+			//! @return size of the encoded entries (in bytes)
+			//!
+			//! @exception std::runtime_error if the entries are not sorted.
+			uint64_t encode(const char *in, uint64_t count, char *out);
+
+		private:
+			uint64_t _value_size;
+			uint64_t _row;		// Row of the last run
+	};
+
+	//! The @ref DeltaDecoder converts entries in the @ref kDeltaEncoding format (see
+	//! @ref DeltaEncoder) to entries with 64-bit indices. The encoded data can be split in
+	//! arbitrary blocks: an entry that is not complete in the current block is left for
+	//! the next call.
+	class DeltaDecoder
+	{
+		public:
+			explicit DeltaDecoder(uint64_t value_size) :
+					_value_size(value_size), _row(0), _col(0), _remaining(0) {}
+
+			//! Decodes up to `count` complete entries in `[in, in_end)`.
+			//!
+			//! @param in[inout]	encoded data. At exit, points to the first byte not decoded.
+			//! @param in_end[in]	end of the encoded data
+			//! @param out[out]		buffer with space for `count` entries with 64-bit indices
+			//! @param count[in]	maximum number of entries to decode
+			//!
+			//! @return number of decoded entries
+			//!
+			//! @exception std::runtime_error if the encoded data is corrupted.
+			uint64_t decode(const char *&in, const char *in_end, char *out, uint64_t count);
+
+		private:
+			uint64_t _value_size;
+			uint64_t _row;			// Row of the current run
+			uint64_t _col;			// Column of the previous entry in the run
+			uint64_t _remaining;	// Number of entries left in the current run
+	};
+
+	//! The @ref ChunkTable is stored right after the header of a file with the
+	//! @ref kChunkedEncoding: the number of entries in each chunk (`uint64_t`), followed by
+	//! `nchunks + 1` positions (`uint64_t`), where the element `i` is the position of the
+	//! chunk `i` relative to the end of the table. Every chunk has the same number of entries,
+	//! except the last one, and can be decompressed independently (see @ref mtb_compress_chunk).
+	struct ChunkTable
+	{
+		uint64_t chunk_size = MTB_CHUNK_SIZE;
+		std::vector<uint64_t> offsets;
+
+		//! Number of chunks for a matrix with `nz` entries
+		uint64_t num_chunks(uint64_t nz) const { return nz / chunk_size + (nz % chunk_size != 0); }
+
+		//! Size (in bytes) of the table
+		uint64_t size() const { return (1 + offsets.size()) * sizeof(uint64_t); }
+
+		//! Allocates the positions of the chunks of a matrix with the properties of `header`
+		//! (the chunk size must be set). The number of chunks comes from the file, so it is
+		//! checked before the allocation: the table must fit in the `available` bytes after
+		//! its beginning.
+		//!
+		//! @exception std::runtime_error if the chunk size is zero or the table does not fit.
+		void resize(const MTBHeader &header, uint64_t available);
+
+		//! Reads the table of a matrix with the properties of `header`. If the stream is
+		//! seekable, the table must fit in the rest of the stream.
+		//!
+		//! @exception std::runtime_error if the table is truncated or invalid.
+		void read(std::istream &in, const MTBHeader &header);
+
+		//! Checks if the table is valid for a matrix with the properties of `header`. No chunk
+		//! can be larger than its entries stored without compression (@ref kStoredCodec), so
+		//! a corrupted position is detected before the chunk is read.
+		//!
+		//! @exception std::runtime_error if the table is invalid.
+		void check(const MTBHeader &header) const;
+
+		//! Writes the table.
+		void write(std::ostream &out) const;
+	};
+
+	//! The @ref EntryReader reads the entries of a MTB file with any encoding (@ref MTBHeader)
+	//! and converts them to the MTB v1 layout (64-bit indices, plain encoding), so they can be
+	//! decoded with @ref mtb_decode_entries. The entries must be read sequentially.
+	//!
+	//! With the @ref kDeltaEncoding and @ref kChunkedEncoding, the stream may be read past
+	//! the last entry.
+	class EntryReader
+	{
+		public:
+			explicit EntryReader(const MTBHeader &header);
+
+			//! Reads the next `count` entries of the file.
+			//!
+			//! @param in[inout]	input stream positioned at the next entry (or at the position
+			//! 					left by the previous call)
+			//! @param out[out]		buffer with space for `count` entries in the MTB v1 layout
+			//! @param count[in]	number of entries to read
+			//!
+			//! @exception std::runtime_error if the file is truncated or corrupted. If the file
+			//! has checksums (@ref kChecksum), the error names the entries of the corrupted block.
+			void read(std::istream &in, char *out, uint64_t count);
+
+			//! Moves back to the first entry. The stream must also be moved by the caller.
+			void reset();
+
+		private:
+			void reserve(uint64_t size);
+
+			//! Reads the next entries without checking the checksums
+			void read_entries(std::istream &in, char *out, uint64_t count);
+
+			//! Reads and decompresses the next chunk (@ref kChunkedEncoding)
+			void next_chunk(std::istream &in);
+
+			MTBHeader _header;
+			uint64_t _value_size;
+			DeltaDecoder _decoder;
+
+			std::unique_ptr<char[]> _buf;
+			uint64_t _capacity;		// Capacity of the buffer (in bytes)
+			uint64_t _pos;			// Position of the next byte to decode in the buffer
+			uint64_t _size;			// Number of bytes in the buffer
+
+			ChunkTable _table;
+			uint64_t _chunk;		// Index of the next chunk to read
+			std::vector<char> _scratch;
+
+			std::unique_ptr<BlockChecksums> _checksums;		// Loaded in the first read (@ref kChecksum)
+	};
+
+	//! The @ref EntryWriter converts entries in the MTB v1 layout to the index size and
+	//! encoding of a MTB file (@ref MTBHeader) and writes them. The entries must be written
+	//! sequentially.
+	class EntryWriter
+	{
+		public:
+			//! @param header[in]		matrix properties stored in the header
+			//! @param chunk_size[in]	number of entries in each chunk (@ref kChunkedEncoding). With
+			//! 						@ref kChecksum, it must be a multiple of @ref MTB_CHECKSUM_BLOCK.
+			//!
+			//! @exception std::runtime_error if the chunk size is not valid.
+			explicit EntryWriter(const MTBHeader &header, uint64_t chunk_size = MTB_CHUNK_SIZE);
+
+			//! Writes the next `count` entries of the file.
+			//!
+			//! @param out[inout]	output stream positioned at the next entry
+			//! @param raw[inout]	entries in the MTB v1 layout. The buffer is used as scratch
+			//! 					space, so its content is undefined at exit.
+			//! @param count[in]	number of entries to write
+			//!
+			//! @exception std::runtime_error if an index does not fit in the index size or the
+			//! entries are not sorted (@ref kDeltaEncoding).
+			void write(std::ostream &out, char *raw, uint64_t count);
+
+			//! Writes the pending data after the last entry. For the @ref kChunkedEncoding,
+			//! the last chunk is compressed and the chunk table is updated. The checksum section
+			//! (@ref kChecksum) is also written here, so the row index must be written after.
+			//!
+			//! @exception std::runtime_error if the number of entries differs from the header
+			//! (@ref kChunkedEncoding and @ref kChecksum).
+			void finish(std::ostream &out);
+
+			//! Sets the number of entries of a file whose size was not known when the writer
+			//! was created (see @ref Writer). It must be called before @ref finish and is not
+			//! supported with the @ref kChunkedEncoding.
+			void set_nz(uint64_t nz) { _header.nz = nz; }
+
+		private:
+			//! Compresses and writes the pending chunk (@ref kChunkedEncoding)
+			void write_chunk(std::ostream &out);
+
+			//! Writes the last chunk and the chunk table (@ref kChunkedEncoding)
+			void finish_chunks(std::ostream &out);
+
+			MTBHeader _header;
+			uint64_t _value_size;
+			DeltaEncoder _encoder;
+
+			std::unique_ptr<char[]> _buf;
+			uint64_t _capacity;		// Capacity of the buffer (in bytes)
+
+			ChunkTable _table;
+			std::streampos _table_pos;	// Position of the chunk table in the stream
+			uint64_t _pending;			// Number of entries in the buffer (not yet compressed)
+			uint64_t _written;			// Number of entries written
+			std::vector<char> _chunk;
+			std::vector<char> _scratch;
+
+			std::unique_ptr<BlockChecksums> _checksums;		// Only with @ref kChecksum
+	};
+
+}   // namespace mtb
+
+#endif /* _MTB_ENCODING_HPP_ */
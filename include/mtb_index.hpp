@@ -0,0 +1,160 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_INDEX_HPP_
+#define _MTB_INDEX_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mtb.hpp"
+#include "mtb_io.hpp"
+
+namespace mtb
+{
+	//! Writes the row index of a MTB file (@ref kRowIndex). The row index contains `nrows + 1`
+	//! 64-bit integers, where the element `i` is the position of the first entry of the row `i`
+	//! in the file (similar to the row pointer in the CSR format). It must be written right
+	//! after the matrix entries.
+	//!
+	//! @param ofile[inout]			output file stream to the MTB file
+	//! @param data[in]				triplet array sorted in a row-major order
+	//! @param nz[in]				number of non-zeros entries
+	//! @param nrows[in]			number of rows
+	//!
+	//! @exception std::runtime_error if the entries are not sorted by row or a row index is out
+	//! of bounds.
+	template<typename T>
+	void mtb_write_row_index(std::ofstream &ofile, const Triplet<T> *data, uint64_t nz,
+	                         uint64_t nrows)
+	{
+		std::vector<uint64_t> buffer;
+		buffer.reserve(MTB_BUF_SIZE / 8);
+
+		uint64_t k = 0;
+
+		for (uint64_t row = 0; row <= nrows; ++row)
+		{
+			// Position of the first entry with a row index greater or equal to `row`
+			while (k < nz && (uint64_t) data[k].row < row)
+			{
+				if (k > 0 && data[k].row < data[k - 1].row)
+					throw std::runtime_error("Error: MTB entries are not sorted!");
+				++k;
+			}
+
+			// The remaining entries have a row index out of bounds
+			if (row == nrows && k < nz) throw std::runtime_error("Error: Entry out of bounds!");
+
+			buffer.push_back(row == nrows ? nz : k);
+
+			if (buffer.size() == buffer.capacity() || row == nrows)
+			{
+				ofile.write((const char *) buffer.data(), buffer.size() * sizeof(uint64_t));
+				buffer.clear();
+			}
+		}
+	}
+
+	//! Reads the entries of the rows `[row_begin, row_end)` of a MTB file with a row index
+	//! (@ref kRowIndex). Only the bytes of these rows are read from the file. For symmetric
+	//! matrices (@ref kSymmetricSparse), only the entries stored in the file are returned
+	//! (i.e., the entries of these rows at or below the diagonal). If the file has checksums
+	//! (@ref kChecksum), the whole blocks of @ref MTB_CHECKSUM_BLOCK entries that contain the
+	//! rows are read and verified.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param row_begin[in]		first row
+	//! @param row_end[in]			row after the last one
+	//! @param data[out]			triplet array containing the entries of the rows
+	//!
+	//! @exception std::runtime_error if the file cannot be read, has no row index, the rows
+	//! are out of bounds or a checksum does not match.
+	template<typename T>
+	void mtb_read_rows(const std::string &filename, uint64_t row_begin, uint64_t row_end,
+	                   std::vector<Triplet<T>> &data)
+	{
+		File file(filename, O_RDONLY);
+		MTBHeader header;
+
+		mtb_read_header(file, header);
+		mtb_check_header(header);
+
+		if (!(header.flags & kRowIndex)) throw std::runtime_error("Error: MTB file has no row index!");
+		if (row_begin > row_end || row_end > header.nrows)
+			throw std::runtime_error("Error: Rows out of bounds!");
+
+		// Position of the first entry of `row_begin` and `row_end`
+		uint64_t bounds[2];
+		uint64_t index_offset = mtb_row_index_offset(header);
+		file.read_at(&bounds[0], sizeof(uint64_t), index_offset + row_begin * sizeof(uint64_t));
+		file.read_at(&bounds[1], sizeof(uint64_t), index_offset + row_end * sizeof(uint64_t));
+
+		if (bounds[0] > bounds[1] || bounds[1] > header.nz)
+			throw std::runtime_error("Error: Invalid MTB row index!");
+
+		// The row index is only allowed with the plain encoding, but the indices may be narrow
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t file_entry_size = mtb_entry_size(header);
+		uint64_t value_size = entry_size - 2 * sizeof(uint64_t);
+		bool is_narrow = (header.index_size != sizeof(uint64_t));
+
+		// With checksums, the whole blocks that contain the rows are read and verified
+		uint64_t begin = bounds[0];
+		uint64_t end = bounds[1];
+		std::unique_ptr<BlockChecksums> checksums;
+
+		if ((header.flags & kChecksum) && begin < end)
+		{
+			checksums.reset(new BlockChecksums(header));
+			checksums->read(file);
+
+			begin = begin / MTB_CHECKSUM_BLOCK * MTB_CHECKSUM_BLOCK;
+			end = std::min<uint64_t>((end + MTB_CHECKSUM_BLOCK - 1) / MTB_CHECKSUM_BLOCK * MTB_CHECKSUM_BLOCK,
+			                         header.nz);
+		}
+
+		uint64_t batch_size = checksums ? MTB_CHECKSUM_BLOCK
+		                                : std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE, end - begin), 1);
+		std::unique_ptr<char[]> raw(new char[batch_size * entry_size]);
+		std::unique_ptr<char[]> narrow(is_narrow ? new char[batch_size * file_entry_size] : nullptr);
+
+		data.resize(bounds[1] - bounds[0]);
+
+		for (uint64_t k = begin; k < end; k += batch_size)
+		{
+			uint64_t size = std::min(batch_size, end - k);
+			uint64_t offset = mtb_header_size(header) + k * file_entry_size;
+
+			if (is_narrow)
+			{
+				file.read_at(narrow.get(), size * file_entry_size, offset);
+				mtb_widen_indices(narrow.get(), raw.get(), size, header.index_size, value_size);
+
+			} else
+			{
+				file.read_at(raw.get(), size * entry_size, offset);
+			}
+
+			if (checksums) checksums->verify_range(raw.get(), k, size);
+
+			// Entries of the rows in the batch
+			uint64_t first = std::max(k, bounds[0]);
+			uint64_t last = std::min(k + size, bounds[1]);
+
+			if (first < last)
+				mtb_decode_entries(raw.get() + (first - k) * entry_size, data.data() + (first - bounds[0]),
+				                   last - first, kGeneralSparse, header.datatype, header.type_size);
+		}
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_INDEX_HPP_ */
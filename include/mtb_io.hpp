@@ -0,0 +1,252 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_IO_HPP_
+#define _MTB_IO_HPP_
+
+#include <fcntl.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mtb
+{
+	//! Returns the number of threads to be used by the parallel routines. If `nthreads <= 0`,
+	//! returns the number of hardware threads available.
+	int mtb_num_threads(int nthreads);
+
+	//! Calls `func(t, begin, end)` in `nthreads` threads, where `[begin, end)` is the
+	//! slice of `[0, count)` assigned to the thread `t`. The first exception thrown by a
+	//! thread is rethrown after all threads finish.
+	template<typename Func>
+	void mtb_parallel_for(uint64_t count, int nthreads, Func &&func)
+	{
+		std::vector<std::thread> threads;
+		std::vector<std::exception_ptr> errors(nthreads);
+
+		for (int t = 0; t < nthreads; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				try
+				{
+					func(t, count * t / nthreads, count * (t + 1) / nthreads);
+
+				} catch (...)
+				{
+					errors[t] = std::current_exception();
+				}
+			});
+		}
+
+		for (auto &thread : threads)
+			thread.join();
+
+		for (auto &error : errors)
+			if (error) std::rethrow_exception(error);
+	}
+
+	//! The @ref File is a thin wrapper around a POSIX file descriptor for positional
+	//! reads and writes (`pread`/`pwrite`). Both operations are thread-safe, so multiple
+	//! threads can access disjoint regions of the same file concurrently.
+	class File
+	{
+		public:
+			//! Opens a file.
+			//!
+			//! @param filename[in]		name of the file
+			//! @param flags[in]		flags passed to `open` (e.g., `O_RDONLY`)
+			//! @param mode[in]			permissions of the file, if it is created
+			//!
+			//! @exception std::runtime_error if the file cannot be opened.
+			File(const std::string &filename, int flags, int mode = 0644);
+			virtual ~File();
+
+			File(const File &) = delete;
+			File &operator=(const File &) = delete;
+
+			int fd() const { return _fd; }
+
+			//! Size of the file (in bytes)
+			uint64_t size() const;
+
+			//! Reads exactly `size` bytes starting at `offset`.
+			//!
+			//! @exception std::runtime_error if the read fails or reaches the end of the file.
+			void read_at(void *buf, size_t size, uint64_t offset) const;
+
+			//! Writes exactly `size` bytes starting at `offset`.
+			//!
+			//! @exception std::runtime_error if the write fails.
+			void write_at(const void *buf, size_t size, uint64_t offset) const;
+
+			//! Reserves the disk space of the first `size` bytes of the file (`posix_fallocate`),
+			//! so concurrent writes do not fragment it. If the file system does not support it,
+			//! the file is only resized.
+			//!
+			//! @exception std::runtime_error if there is not enough space.
+			void allocate(uint64_t size) const;
+
+		private:
+			int _fd;
+	};
+
+	//! Alignment (in bytes) of the offsets, sizes and buffers used with `O_DIRECT`
+	#define MTB_DIRECT_ALIGN 4096
+
+	//! The @ref RangeWriter writes a contiguous region of a file through a private buffer.
+	//! If a second descriptor opened with `O_DIRECT` is given, the pages completely inside the
+	//! region bypass the page cache, while the partial pages at its ends (which may be shared
+	//! with other regions) are written with the regular descriptor.
+	class RangeWriter
+	{
+		public:
+			//! @param file[in]			file to be written (must outlive this object)
+			//! @param direct[in]		same file opened with `O_DIRECT`, or `nullptr`
+			//! @param offset[in]		position of the first byte of the region
+			//! @param capacity[in]		size of the buffer (in bytes)
+			RangeWriter(const File &file, const File *direct, uint64_t offset, size_t capacity);
+			virtual ~RangeWriter() = default;
+
+			RangeWriter(const RangeWriter &) = delete;
+			RangeWriter &operator=(const RangeWriter &) = delete;
+
+			//! Returns a pointer to `size` free bytes after the data in the buffer. The buffer
+			//! is written to the file first if there is not enough space.
+			//!
+			//! @exception std::runtime_error if `size` is larger than the capacity or the write fails.
+			char *reserve(size_t size);
+
+			//! Appends the first `size` bytes of the last reserved space to the region.
+			void commit(size_t size) { _end += size; }
+
+			//! Writes the remaining data in the buffer.
+			//!
+			//! @exception std::runtime_error if the write fails.
+			void finish() { flush(true); }
+
+		private:
+			//! Writes the data in the buffer. Unless `last == true`, the last partial page is
+			//! kept in the buffer.
+			void flush(bool last);
+
+			const File &_file;
+			const File *_direct;
+			std::unique_ptr<char[], void (*)(void *)> _buf;
+			size_t _capacity;
+			uint64_t _base;		// Position in the file of the first byte of the buffer (aligned)
+			size_t _begin;		// Position of the first byte of the region in the buffer
+			size_t _end;		// Position after the last byte of data in the buffer
+	};
+
+	//! The @ref AsyncReader reads consecutive blocks of a file in a background thread into
+	//! a set of rotating buffers. While the caller processes one block, the next ones are
+	//! already being read from the disk.
+	class AsyncReader
+	{
+		public:
+			//! Starts reading the region `[offset, offset + size)` of a file.
+			//!
+			//! @param file[in]			file to be read (must outlive this object)
+			//! @param offset[in]		position of the first byte
+			//! @param size[in]			number of bytes to be read
+			//! @param block_size[in]	size of each block (in bytes)
+			//! @param nbuffers[in]		number of rotating buffers (at least 2)
+			AsyncReader(const File &file, uint64_t offset, uint64_t size, size_t block_size,
+			            int nbuffers = 2);
+			virtual ~AsyncReader();
+
+			AsyncReader(const AsyncReader &) = delete;
+			AsyncReader &operator=(const AsyncReader &) = delete;
+
+			//! Waits for the next block. The previous block returned by this routine is released
+			//! and must no longer be used.
+			//!
+			//! @param block[out]		pointer to the block
+			//!
+			//! @return size of the block (in bytes), or 0 if all blocks have been read.
+			//!
+			//! @exception std::runtime_error if the background read failed.
+			size_t next(const char *&block);
+
+		private:
+			void run();
+
+			const File &_file;
+			uint64_t _offset;
+			uint64_t _size;
+			size_t _block_size;
+			uint64_t _nblocks;
+
+			std::vector<std::unique_ptr<char[]>> _buffers;
+			std::mutex _mutex;
+			std::condition_variable _cond;
+			uint64_t _produced;		// Number of blocks read from the file
+			uint64_t _consumed;		// Number of blocks returned to the caller
+			bool _stop;
+			std::exception_ptr _error;
+			std::thread _thread;
+	};
+
+	//! The @ref AsyncWriter writes consecutive blocks to a file in a background thread. The caller
+	//! fills one buffer while the previous ones are being written to the disk.
+	class AsyncWriter
+	{
+		public:
+			//! Starts writing to a file at position `offset`.
+			//!
+			//! @param file[in]			file to be written (must outlive this object)
+			//! @param offset[in]		position of the first byte
+			//! @param block_size[in]	maximum size of each block (in bytes)
+			//! @param nbuffers[in]		number of rotating buffers (at least 2)
+			AsyncWriter(const File &file, uint64_t offset, size_t block_size, int nbuffers = 2);
+			virtual ~AsyncWriter();
+
+			AsyncWriter(const AsyncWriter &) = delete;
+			AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+			//! Waits for a free buffer with `block_size` bytes.
+			//!
+			//! @exception std::runtime_error if a background write failed.
+			char *acquire();
+
+			//! Writes the first `size` bytes of the last acquired buffer after the previous block.
+			void submit(size_t size);
+
+			//! Waits until all blocks are written.
+			//!
+			//! @exception std::runtime_error if a background write failed.
+			void finish();
+
+		private:
+			void run();
+
+			const File &_file;
+			uint64_t _offset;
+			size_t _block_size;
+
+			std::vector<std::unique_ptr<char[]>> _buffers;
+			std::vector<size_t> _sizes;
+			std::mutex _mutex;
+			std::condition_variable _cond;
+			uint64_t _submitted;	// Number of blocks submitted by the caller
+			uint64_t _written;		// Number of blocks written to the file
+			bool _stop;
+			std::exception_ptr _error;
+			std::thread _thread;
+	};
+
+}   // namespace mtb
+
+#endif /* _MTB_IO_HPP_ */
@@ -0,0 +1,122 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_MAPPED_HPP_
+#define _MTB_MAPPED_HPP_
+
+#include <string>
+
+#include "mtb.hpp"
+
+namespace mtb
+{
+	//! The @ref MappedMatrix is a read-only view of a MTB file mapped in memory. The entries
+	//! are decoded directly from the mapping on each access, so the file is never copied to
+	//! the heap and multiple processes reading the same file share the same physical pages.
+	//!
+	//! For symmetric matrices (@ref kSymmetricSparse), only the entries stored in the file
+	//! (i.e., at or below the diagonal) are accessible. Files with narrow indices (MTB v2)
+	//! are supported, but not the @ref kDeltaEncoding.
+	class MappedMatrix
+	{
+		public:
+			//! Access pattern hints (see `madvise`)
+			enum Access
+			{
+				kNormal,		//!< No special treatment
+				kSequential,	//!< The entries will be accessed in sequential order
+				kRandom,		//!< The entries will be accessed in random order
+				kWillNeed		//!< The entries will be accessed in the near future
+			};
+
+			//! Maps a MTB file in memory and checks its header.
+			//!
+			//! @param filename[in]		name of MTB file
+			//! @param access[in]		expected access pattern for the entries
+			//!
+			//! @exception std::runtime_error if the file cannot be mapped, the header or encoding
+			//! is not supported or the file is truncated.
+			explicit MappedMatrix(const std::string &filename, Access access = kNormal);
+			virtual ~MappedMatrix();
+
+			MappedMatrix(const MappedMatrix &) = delete;
+			MappedMatrix &operator=(const MappedMatrix &) = delete;
+
+			MappedMatrix(MappedMatrix &&other) noexcept;
+			MappedMatrix &operator=(MappedMatrix &&other) noexcept;
+
+			//! Gives a hint to the kernel about how the entries in `[begin, end)`
+			//! will be accessed.
+			//!
+			//! @param access[in]		expected access pattern
+			//! @param begin[in]		index of the first entry
+			//! @param end[in]			index after the last entry (clamped to `nz()`)
+			void advise(Access access, uint64_t begin = 0, uint64_t end = UINT64_MAX);
+
+			const MTBHeader &header() const { return _header; }
+			char mat_type() const { return _header.mat_type; }
+			char datatype() const { return _header.datatype; }
+			char type_size() const { return _header.type_size; }
+			uint64_t nrows() const { return _header.nrows; }
+			uint64_t ncols() const { return _header.ncols; }
+			uint64_t nz() const { return _header.nz; }
+
+			//! Size (in bytes) of each entry in the file
+			uint64_t entry_size() const { return _entry_size; }
+
+			//! Pointer to the first entry in the mapping
+			const char *data() const { return _data; }
+
+			//! Row index of the entry `i`
+			uint64_t row(uint64_t i) const
+			{
+				// Assuming LITTLE ENDIAN
+				uint64_t row = 0;
+				std::memcpy(&row, _data + i * _entry_size, _header.index_size);
+				return row;
+			}
+
+			//! Column index of the entry `i`
+			uint64_t col(uint64_t i) const
+			{
+				uint64_t col = 0;
+				std::memcpy(&col, _data + i * _entry_size + _header.index_size, _header.index_size);
+				return col;
+			}
+
+			//! Value of the entry `i`
+			template<typename T>
+			T value(uint64_t i) const
+			{
+				return mtb_decode_value<T>(_data + i * _entry_size + 2 * _header.index_size,
+				                           _header.datatype, _header.type_size);
+			}
+
+			//! Entry `i` as a @ref Triplet
+			template<typename T>
+			Triplet<T> entry(uint64_t i) const
+			{
+				Triplet<T> triplet;
+				triplet.row = row(i);
+				triplet.col = col(i);
+				triplet.val = value<T>(i);
+				return triplet;
+			}
+
+		private:
+			void unmap();
+
+			char *_map;
+			size_t _map_size;
+			const char *_data;
+			uint64_t _entry_size;
+			MTBHeader _header;
+	};
+
+}   // namespace mtb
+
+#endif /* _MTB_MAPPED_HPP_ */
@@ -0,0 +1,258 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_PARALLEL_HPP_
+#define _MTB_PARALLEL_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mtb.hpp"
+#include "mtb_io.hpp"
+
+namespace mtb
+{
+	//! Reads and parses the matrix entries of a MTB file using multiple threads. Since
+	//! every entry has the same size with the @ref kPlainEncoding, the entries are split
+	//! evenly among the threads and each thread reads (`pread`) and decodes its own slice of
+	//! the file. Any index size is supported, and the checksums (@ref kChecksum) of the blocks
+	//! are verified if the file has them. The output layout is the same as in
+	//! @ref mtb_read_data.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param data[out]			triplet array containing the entries of the matrix
+	//! @param nz[in]				number of non-zeros entries (twice the number of entries
+	//! 							stored in the file for @ref kSymmetricSparse)
+	//! @param mat_type[in]			matrix type (@ref MTBMatrixType)
+	//! @param datatype[in]			datatype (@ref MTBDatatype)
+	//! @param type_size[in]		size of the data type (in bytes)
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//!
+	//! @exception std::runtime_error if the file cannot be read, the header is not supported
+	//! or does not match the arguments, the encoding is not @ref kPlainEncoding or a checksum
+	//! does not match.
+	template<typename T>
+	void mtb_read_data_parallel(const std::string &filename, Triplet<T> *data, uint64_t nz,
+	                            char mat_type, char datatype, char type_size, int nthreads = 0)
+	{
+		File file(filename, O_RDONLY);
+		MTBHeader header;
+
+		mtb_read_header(file, header);
+		mtb_check_header(header);
+
+		uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+		uint64_t count = (nz + step_size - 1) / step_size;
+
+		if (header.encoding != kPlainEncoding)
+			throw std::runtime_error("Error: The parallel reader requires the plain encoding!");
+		if (header.mat_type != mat_type || header.datatype != datatype || header.type_size != type_size
+		    || count > header.nz)
+			throw std::runtime_error("Error: The MTB header does not match the matrix properties!");
+
+		bool is_narrow = (header.index_size != sizeof(uint64_t));
+		uint64_t header_size = mtb_header_size(header);
+		uint64_t entry_size = mtb_entry_size(header);
+		uint64_t raw_size = mtb_entry_size(datatype, type_size);
+		uint64_t value_size = raw_size - 2 * sizeof(uint64_t);
+
+		std::unique_ptr<BlockChecksums> checksums;
+
+		if (header.flags & kChecksum)
+		{
+			checksums.reset(new BlockChecksums(header));
+			checksums->read(file);
+		}
+
+		// The slices of the threads contain whole checksum blocks. With checksums, the last
+		// block is read up to the end of the matrix, even if only part of it is decoded.
+		uint64_t last_entry = checksums ? header.nz : count;
+		uint64_t nblocks = mtb_num_checksum_blocks(count);
+
+		mtb_parallel_for(nblocks, mtb_num_threads(nthreads), [&](int, uint64_t first, uint64_t last)
+		{
+			if (first >= last) return;
+
+			std::unique_ptr<char[]> raw(new char[MTB_CHECKSUM_BLOCK * raw_size]);
+			std::unique_ptr<char[]> narrow(is_narrow ? new char[MTB_CHECKSUM_BLOCK * entry_size] : nullptr);
+
+			for (uint64_t b = first; b < last; ++b)
+			{
+				uint64_t k = b * MTB_CHECKSUM_BLOCK;
+				uint64_t size = std::min<uint64_t>(MTB_CHECKSUM_BLOCK, last_entry - k);
+				uint64_t offset = header_size + k * entry_size;
+
+				if (is_narrow)
+				{
+					file.read_at(narrow.get(), size * entry_size, offset);
+					mtb_widen_indices(narrow.get(), raw.get(), size, header.index_size, value_size);
+
+				} else
+				{
+					file.read_at(raw.get(), size * entry_size, offset);
+				}
+
+				if (checksums) checksums->verify_range(raw.get(), k, size);
+				mtb_decode_entries(raw.get(), data + k * step_size, std::min(size, count - k), mat_type,
+				                   datatype, type_size);
+			}
+		});
+	}
+
+	//! Writes the part of the row index (@ref kRowIndex) that depends on the entries
+	//! `[begin, end)`, i.e., the position of the rows after the row of the entry `begin - 1`,
+	//! up to the row of the entry `end - 1` (or up to `nrows` for the last entry).
+	template<typename T>
+	void mtb_write_row_index_range(const File &file, uint64_t index_offset, const Triplet<T> *data,
+	                               uint64_t begin, uint64_t end, uint64_t nz, uint64_t nrows)
+	{
+		std::vector<uint64_t> buffer;
+		buffer.reserve(MTB_BUF_SIZE / 256);
+
+		uint64_t row = (begin == 0) ? 0 : data[begin - 1].row + 1;
+
+		auto push = [&](uint64_t pos)
+		{
+			buffer.push_back(pos);
+
+			if (buffer.size() == buffer.capacity())
+			{
+				file.write_at(buffer.data(), buffer.size() * sizeof(uint64_t),
+				              index_offset + (row + 1 - buffer.size()) * sizeof(uint64_t));
+				buffer.clear();
+			}
+		};
+
+		for (uint64_t k = begin; k < end; ++k)
+		{
+			if ((uint64_t) data[k].row >= nrows) throw std::runtime_error("Error: Row index out of bounds!");
+			if (k > 0 && data[k].row < data[k - 1].row)
+				throw std::runtime_error("Error: MTB entries are not sorted!");
+
+			for (; row <= (uint64_t) data[k].row; ++row)
+				push(k);
+		}
+
+		if (end == nz)
+			for (; row <= nrows; ++row)
+				push(nz);
+
+		file.write_at(buffer.data(), buffer.size() * sizeof(uint64_t),
+		              index_offset + (row - buffer.size()) * sizeof(uint64_t));
+	}
+
+	//! Writes a MTB file (header and entries) using multiple threads. Since every entry has
+	//! the same size with the @ref kPlainEncoding, the position of each entry in the file is
+	//! known in advance: the file is preallocated (`fallocate`) and each thread encodes its own
+	//! slice of the entries into a private buffer and writes it (`pwrite`) at its position.
+	//! The checksum section (@ref kChecksum) and the row index (@ref kRowIndex) are also
+	//! computed and written in parallel, if the header has these flags.
+	//!
+	//! With `direct_io == true`, the entries are written with `O_DIRECT`, bypassing the page
+	//! cache (useful for outputs much larger than the memory). The few bytes at the boundaries
+	//! between the threads are still written through the page cache. If the file system does
+	//! not support `O_DIRECT`, the regular writes are used.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param data[in]				triplet array containing the `header.nz` entries of the matrix
+	//! 							(sorted in a row-major order with @ref kRowIndex)
+	//! @param header[in]			matrix properties to be stored in the header
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//! @param direct_io[in]		write the entries with `O_DIRECT`
+	//!
+	//! @exception std::runtime_error if the file cannot be written, the encoding is not
+	//! @ref kPlainEncoding, an index does not fit in the index size or the entries are not
+	//! sorted (@ref kRowIndex).
+	template<typename T>
+	void mtb_write_data_parallel(const std::string &filename, const Triplet<T> *data,
+	                             const MTBHeader &header, int nthreads = 0, bool direct_io = false)
+	{
+		if (header.encoding != kPlainEncoding)
+			throw std::runtime_error("Error: The parallel writer requires the plain encoding!");
+
+		File file(filename, O_WRONLY | O_CREAT | O_TRUNC);
+		std::unique_ptr<File> direct;
+
+		if (direct_io)
+		{
+			try
+			{
+				direct.reset(new File(filename, O_WRONLY | O_DIRECT));
+
+			} catch (const std::runtime_error &)
+			{
+				// O_DIRECT is not supported by the file system
+			}
+		}
+
+		bool is_narrow = (header.index_size != sizeof(uint64_t));
+		uint64_t header_size = mtb_header_size(header);
+		uint64_t entry_size = mtb_entry_size(header);
+		uint64_t raw_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t value_size = raw_size - 2 * sizeof(uint64_t);
+		uint64_t index_offset = mtb_row_index_offset(header);
+		uint64_t file_size = index_offset;
+		if (header.flags & kRowIndex) file_size += (header.nrows + 1) * sizeof(uint64_t);
+
+		char buf[MTB_MAX_HEADER_SIZE];
+		mtb_format_header(buf, header);
+
+		file.allocate(file_size);
+		file.write_at(buf, header_size, 0);
+
+		// The slices of the threads contain whole checksum blocks
+		BlockChecksums checksums(header);
+		uint64_t nblocks = mtb_num_checksum_blocks(header.nz);
+
+		mtb_parallel_for(nblocks, mtb_num_threads(nthreads), [&](int, uint64_t first, uint64_t last)
+		{
+			uint64_t begin = first * MTB_CHECKSUM_BLOCK;
+			uint64_t end = std::min<uint64_t>(last * MTB_CHECKSUM_BLOCK, header.nz);
+			if (begin >= end) return;
+
+			std::unique_ptr<char[]> raw(is_narrow ? new char[MTB_CHECKSUM_BLOCK * raw_size] : nullptr);
+			RangeWriter writer(file, direct.get(), header_size + begin * entry_size,
+			                   4 * MTB_CHECKSUM_BLOCK * entry_size);
+
+			for (uint64_t k = begin; k < end; k += MTB_CHECKSUM_BLOCK)
+			{
+				uint64_t size = std::min<uint64_t>(MTB_CHECKSUM_BLOCK, end - k);
+				char *out = writer.reserve(size * entry_size);
+				char *entries = is_narrow ? raw.get() : out;
+
+				mtb_encode_entries(data + k, size, entries, header.datatype, header.type_size);
+				if (header.flags & kChecksum) checksums.update_range(entries, k, size);
+				if (is_narrow) mtb_narrow_indices(entries, out, size, header.index_size, value_size);
+
+				writer.commit(size * entry_size);
+			}
+
+			writer.finish();
+
+			if (header.flags & kRowIndex)
+				mtb_write_row_index_range(file, index_offset, data, begin, end, header.nz, header.nrows);
+		});
+
+		if (header.flags & kChecksum)
+			file.write_at(checksums.values().data(), mtb_checksum_size(header),
+			              header_size + header.nz * entry_size);
+
+		if ((header.flags & kRowIndex) && header.nz == 0)
+		{
+			std::vector<uint64_t> index(header.nrows + 1, 0);
+			file.write_at(index.data(), index.size() * sizeof(uint64_t), index_offset);
+		}
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_PARALLEL_HPP_ */
@@ -0,0 +1,155 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_PARTITION_HPP_
+#define _MTB_PARTITION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "mtb.hpp"
+#include "mtb_index.hpp"
+
+namespace mtb
+{
+	//! The @ref RowPartition is the range of rows assigned to one of the cooperating
+	//! readers (e.g., MPI ranks) of a MTB file.
+	struct RowPartition
+	{
+		uint64_t row_begin;		//!< First row
+		uint64_t row_end;		//!< Row after the last one
+		uint64_t nz;			//!< Number of entries stored in the file for these rows
+		bool is_indexed;		//!< The file has a row index, so only these rows need to be read
+	};
+
+	//! Splits the rows of a MTB file into `nranks` contiguous ranges with (approximately) the
+	//! same number of entries and returns the range of `rank`. Each rank computes its range
+	//! independently, without communication, and all ranks obtain a consistent partition.
+	//!
+	//! If the file has a row index (@ref kRowIndex), the range is found with a binary search
+	//! on the index (`O(log nrows)` small reads). Otherwise, the entries of each row are
+	//! counted with @ref mtb_count_rows, which reads the whole file and allocates `nrows + 1`
+	//! counters in every rank. For many ranks, count the rows once and share the counts (e.g.,
+	//! with `MPI_Bcast`) instead (see the overload with a row pointer), or write the file with
+	//! a row index. For symmetric matrices (@ref kSymmetricSparse), the entries stored in the
+	//! file are balanced.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param rank[in]				index of the reader (`0 <= rank < nranks`)
+	//! @param nranks[in]			number of readers
+	//!
+	//! @exception std::runtime_error if the file cannot be read or the rank is invalid.
+	RowPartition mtb_partition_rows(const std::string &filename, int rank, int nranks);
+
+	//! Same as @ref mtb_partition_rows, with the number of entries of each row already known
+	//! (see @ref mtb_count_rows), so the file is not read. Since the counts do not tell how the
+	//! file is stored, `is_indexed` is always false (@ref mtb_read_partition checks the file).
+	//!
+	//! @param row_ptr[in]			position of the first entry of each row (`nrows + 1` elements)
+	//! @param rank[in]				index of the reader (`0 <= rank < nranks`)
+	//! @param nranks[in]			number of readers
+	//!
+	//! @exception std::runtime_error if the row pointer is empty or the rank is invalid.
+	RowPartition mtb_partition_rows(const std::vector<uint64_t> &row_ptr, int rank, int nranks);
+
+	//! Returns the position of the first entry of each row of a MTB file (`nrows + 1` elements,
+	//! similar to the row pointer in the CSR format). If the file has a row index
+	//! (@ref kRowIndex), the index is returned. Otherwise, the entries of each row are counted
+	//! in a pass over the file.
+	//!
+	//! @param filename[in]			name of MTB file
+	//!
+	//! @exception std::runtime_error if the file cannot be read or a row is out of bounds.
+	std::vector<uint64_t> mtb_count_rows(const std::string &filename);
+
+	//! Reads the entries of the rows of a partition (see @ref mtb_partition_rows). If the file
+	//! has a row index, only these rows are read from the file (see @ref mtb_read_rows).
+	//! Otherwise, the whole file is read once and the other entries are discarded. For
+	//! symmetric matrices (@ref kSymmetricSparse), only the entries stored in the file are
+	//! returned.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param part[in]				range of rows to read
+	//! @param data[out]			triplet array containing the entries of the rows
+	//!
+	//! @exception std::runtime_error if the file cannot be read or the range is invalid.
+	template<typename T>
+	void mtb_read_partition(const std::string &filename, const RowPartition &part,
+	                        std::vector<Triplet<T>> &data)
+	{
+		std::ifstream ifile(filename, std::fstream::binary);
+		MTBHeader header;
+
+		if (!ifile) throw std::runtime_error("Error: Cannot read from MTB file!");
+
+		mtb_read_header(ifile, header);
+		if (!ifile) throw std::runtime_error("Error: Invalid MTB header!");
+
+		mtb_check_header(header);
+
+		if (part.row_begin > part.row_end || part.row_end > header.nrows)
+			throw std::runtime_error("Error: Rows out of bounds!");
+
+		if (header.flags & kRowIndex)
+		{
+			mtb_read_rows(filename, part.row_begin, part.row_end, data);
+			return;
+		}
+
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 16, header.nz), 1);
+		std::unique_ptr<char[]> raw(new char[batch_size * entry_size]);
+		EntryReader reader(header);
+
+		data.clear();
+		data.reserve(part.nz);
+
+		for (uint64_t k = 0; k < header.nz; k += batch_size)
+		{
+			uint64_t size = std::min(batch_size, header.nz - k);
+
+			reader.read(ifile, raw.get(), size);
+			mtb_decode_dispatch<T>(raw.get(), size, kGeneralSparse, header.datatype, header.type_size,
+			                       [&](uint64_t, uint64_t row, uint64_t col, const T &val)
+			                       {
+				                       if (row >= part.row_begin && row < part.row_end)
+					                       data.push_back(Triplet<T>{(std::ptrdiff_t) row, (std::ptrdiff_t) col, val});
+			                       });
+		}
+	}
+
+	//! Reads the entries of the rows assigned to `rank` (see @ref mtb_partition_rows and the
+	//! overload with a @ref RowPartition). Without a row index, the file is read twice in
+	//! every rank: once to count the entries of each row and once to read the entries. To
+	//! read it only once, share the counts of @ref mtb_count_rows among the ranks and call
+	//! the overload with a @ref RowPartition.
+	//!
+	//! This routine assumes a **little endian** format.
+	//!
+	//! @param filename[in]			name of MTB file
+	//! @param rank[in]				index of the reader (`0 <= rank < nranks`)
+	//! @param nranks[in]			number of readers
+	//! @param data[out]			triplet array containing the entries of the rows
+	//!
+	//! @return the range of rows assigned to `rank`
+	//!
+	//! @exception std::runtime_error if the file cannot be read or the rank is invalid.
+	template<typename T>
+	RowPartition mtb_read_partition(const std::string &filename, int rank, int nranks,
+	                                std::vector<Triplet<T>> &data)
+	{
+		RowPartition part = mtb_partition_rows(filename, rank, nranks);
+
+		mtb_read_partition(filename, part, data);
+		return part;
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_PARTITION_HPP_ */
@@ -0,0 +1,144 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_READER_HPP_
+#define _MTB_READER_HPP_
+
+#include <string>
+
+#include "mtb.hpp"
+
+namespace mtb
+{
+	//! The @ref Reader reads the entries of a MTB file in batches of a size chosen by the
+	//! caller, using a constant amount of memory. It can be used to process matrices that
+	//! do not fit in memory.
+	//!
+	//! For symmetric matrices (@ref kSymmetricSparse), each entry outside the diagonal is
+	//! immediately followed by its mirrored entry, even if they are returned in different
+	//! batches. The batches never contain holes. All index sizes and encodings are supported
+	//! (see @ref EntryReader).
+	class Reader
+	{
+		public:
+			//! Opens a MTB file and reads its header.
+			//!
+			//! @param filename[in]		name of MTB file
+			//! @param buffer_size[in]	number of entries read from the file at once
+			//!
+			//! @exception std::runtime_error if the file cannot be read or the header
+			//! is not supported.
+			explicit Reader(const std::string &filename, uint64_t buffer_size = MTB_BUF_SIZE / 16);
+			virtual ~Reader() = default;
+
+			const MTBHeader &header() const { return _header; }
+			char mat_type() const { return _header.mat_type; }
+			char datatype() const { return _header.datatype; }
+			char type_size() const { return _header.type_size; }
+			uint64_t nrows() const { return _header.nrows; }
+			uint64_t ncols() const { return _header.ncols; }
+			uint64_t nz() const { return _header.nz; }
+
+			//! Returns true if all entries have been returned.
+			bool eof() const { return _read == _header.nz && _raw_pos == _raw_count && !_pending; }
+
+			//! Moves back to the first entry in the file.
+			void rewind();
+
+			//! Reads and decodes the next entries in the file.
+			//!
+			//! This routine assumes a **little endian** format.
+			//!
+			//! @param batch[out]		triplet array where the entries will be stored
+			//! @param capacity[in]		maximum number of entries to store in `batch`
+			//!
+			//! @return the number of entries stored in `batch`. Returns 0 only if all entries
+			//! have been read or `capacity == 0`.
+			//!
+			//! @exception std::runtime_error if the file is truncated.
+			template<typename T>
+			uint64_t next_batch(Triplet<T> *batch, uint64_t capacity)
+			{
+				uint64_t size = 0;
+
+				// Emit the mirror of the last entry of the previous batch
+				if (_pending && capacity > 0)
+				{
+					const char *entry = _raw.get() + (_raw_pos - 1) * _entry_size;
+
+					mtb_decode_dispatch<T>(entry, 1, kGeneralSparse, _header.datatype, _header.type_size,
+					                       [&](uint64_t, uint64_t row, uint64_t col, const T &val)
+					                       {
+						                       batch[size++] = Triplet<T>{(std::ptrdiff_t) col, (std::ptrdiff_t) row, val};
+					                       });
+
+					_pending = false;
+				}
+
+				while (size < capacity && fill())
+				{
+					uint64_t available = _raw_count - _raw_pos;
+					const char *entry = _raw.get() + _raw_pos * _entry_size;
+
+					if (_header.mat_type != kSymmetricSparse)
+					{
+						uint64_t count = std::min(available, capacity - size);
+						mtb_decode_entries(entry, batch + size, count, _header.mat_type,
+						                   _header.datatype, _header.type_size);
+
+						size += count;
+						_raw_pos += count;
+
+					} else
+					{
+						// Each entry produces at most 2 triplets. If the mirror of the last entry
+						// do not fit in the batch, it is kept for the next one.
+						uint64_t count = std::min(available, std::max<uint64_t>((capacity - size) / 2, 1));
+
+						mtb_decode_dispatch<T>(entry, count, kGeneralSparse, _header.datatype,
+						                       _header.type_size,
+						                       [&](uint64_t, uint64_t row, uint64_t col, const T &val)
+						                       {
+							                       batch[size++] = Triplet<T>{(std::ptrdiff_t) row, (std::ptrdiff_t) col, val};
+
+							                       if (col < row)
+							                       {
+								                       if (size < capacity)
+									                       batch[size++] = Triplet<T>{(std::ptrdiff_t) col, (std::ptrdiff_t) row, val};
+								                       else
+									                       _pending = true;
+							                       }
+						                       });
+
+						_raw_pos += count;
+					}
+				}
+
+				return size;
+			}
+
+		private:
+			//! Reads the next block of entries if the buffer is empty. Returns false if there are no
+			//! more entries in the file.
+			bool fill();
+
+			std::ifstream _ifile;
+			MTBHeader _header;
+			uint64_t _entry_size;			// Size of the decoded entries (MTB v1 layout)
+			std::unique_ptr<EntryReader> _entries;
+
+			std::unique_ptr<char[]> _raw;
+			uint64_t _raw_capacity;		// Capacity of the buffer (in entries)
+			uint64_t _raw_count;		// Number of entries in the buffer
+			uint64_t _raw_pos;			// Position of the next entry in the buffer
+			uint64_t _read;				// Number of entries read from the file
+			bool _pending;				// The mirror of the last decoded entry was not returned
+	};
+
+}   // namespace mtb
+
+#endif /* _MTB_READER_HPP_ */
@@ -0,0 +1,241 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_SORT_HPP_
+#define _MTB_SORT_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "mtb_def.hpp"
+#include "mtb_io.hpp"
+
+#define MTB_RADIX_BITS 11
+#define MTB_RADIX_MIN_SIZE (1 << 12)
+
+namespace mtb
+{
+	//! Digit of a radix sort pass: `bits` bits of the row (or column) index starting at `shift`
+	struct RadixDigit
+	{
+		bool is_row;
+		int shift;
+		int bits;
+	};
+
+	//! Returns the number of bits required to represent the indices `[0, size)`.
+	inline int mtb_index_bits(uint64_t size)
+	{
+		return (size > 1) ? 64 - __builtin_clzll(size - 1) : 0;
+	}
+
+	//! Returns the bucket of a triplet in a radix sort pass.
+	template<typename T>
+	inline uint64_t mtb_radix_bucket(const Triplet<T> &entry, const RadixDigit &digit)
+	{
+		uint64_t index = digit.is_row ? entry.row : entry.col;
+		return (index >> digit.shift) & ((uint64_t(1) << digit.bits) - 1);
+	}
+
+	//! Sorts `count` triplets by the digits `[0, ndigits)` (least significant first) with a
+	//! serial LSD radix sort. The passes alternate between `in` and `out`, and the passes whose
+	//! digit is equal in all entries are skipped.
+	//!
+	//! @param in[inout]			triplet array to be sorted
+	//! @param out[out]				scratch array with space for `count` entries
+	//! @param count[in]			number of entries
+	//! @param digits[in]			digits of the sort key
+	//! @param ndigits[in]			number of digits
+	//! @param histogram[out]		scratch array with space for 2^@ref MTB_RADIX_BITS entries
+	//!
+	//! @return the array that contains the sorted triplets (`in` or `out`)
+	template<typename T>
+	Triplet<T> *mtb_radix_sort_serial(Triplet<T> *in, Triplet<T> *out, uint64_t count,
+	                                  const RadixDigit *digits, int ndigits, uint64_t *histogram)
+	{
+		for (int d = 0; d < ndigits; ++d)
+		{
+			uint64_t nbuckets = uint64_t(1) << digits[d].bits;
+			std::fill(histogram, histogram + nbuckets, 0);
+
+			for (uint64_t i = 0; i < count; ++i)
+				++histogram[mtb_radix_bucket(in[i], digits[d])];
+
+			// Position of the first entry of each bucket
+			uint64_t pos = 0;
+			bool is_trivial = false;
+
+			for (uint64_t b = 0; b < nbuckets; ++b)
+			{
+				uint64_t size = histogram[b];
+				is_trivial |= (size == count);
+				histogram[b] = pos;
+				pos += size;
+			}
+
+			if (is_trivial) continue;
+
+			for (uint64_t i = 0; i < count; ++i)
+				out[histogram[mtb_radix_bucket(in[i], digits[d])]++] = in[i];
+
+			std::swap(in, out);
+		}
+
+		return in;
+	}
+
+	//! Sorts `count` triplets in a row-major order (first by row index, then by column index)
+	//! or, if `by_col == true`, in a column-major order, with a parallel radix sort. Each index
+	//! only contributes the bits required for `nrows` or `ncols`, split in digits of up to
+	//! @ref MTB_RADIX_BITS bits. The values are moved with the indices. The sort is stable, so
+	//! entries with the same indices keep their order.
+	//!
+	//! The first pass distributes the entries by the most significant digit (MSD) with all
+	//! threads. Then, the threads take the resulting buckets, which are usually small enough to
+	//! fit in the cache, and sort each one by the remaining digits (LSD).
+	//!
+	//! @param data[inout]			triplet array to be sorted
+	//! @param tmp[out]				scratch array with space for `count` entries
+	//! @param count[in]			number of entries
+	//! @param nrows[in]			number of rows
+	//! @param ncols[in]			number of columns
+	//! @param by_col[in]			sort in a column-major order
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//!
+	//! @exception std::runtime_error if an index is out of bounds.
+	template<typename T>
+	void mtb_radix_sort(Triplet<T> *data, Triplet<T> *tmp, uint64_t count, uint64_t nrows,
+	                    uint64_t ncols, bool by_col = false, int nthreads = 0)
+	{
+		nthreads = std::max<int>(std::min<uint64_t>(mtb_num_threads(nthreads),
+		                                            count / MTB_RADIX_MIN_SIZE), 1);
+
+		// The digits of the minor index are the least significant ones
+		std::vector<RadixDigit> digits;
+
+		for (bool is_row : {by_col, !by_col})
+		{
+			int bits = mtb_index_bits(is_row ? nrows : ncols);
+			int ndigits = (bits + MTB_RADIX_BITS - 1) / MTB_RADIX_BITS;
+
+			for (int d = 0, shift = 0; d < ndigits; ++d)
+			{
+				int digit_bits = (bits - shift + (ndigits - d) - 1) / (ndigits - d);
+				digits.push_back({is_row, shift, digit_bits});
+				shift += digit_bits;
+			}
+		}
+
+		if (digits.empty()) return;
+
+		// Histogram of each thread for the most significant digit
+		const RadixDigit &top = digits.back();
+		uint64_t nbuckets = uint64_t(1) << top.bits;
+		std::vector<std::vector<uint64_t>> histograms(nthreads, std::vector<uint64_t>(nbuckets, 0));
+
+		mtb_parallel_for(count, nthreads, [&](int t, uint64_t begin, uint64_t end)
+		{
+			std::vector<uint64_t> &histogram = histograms[t];
+
+			for (uint64_t i = begin; i < end; ++i)
+			{
+				if ((uint64_t) data[i].row >= nrows || (uint64_t) data[i].col >= ncols)
+					throw std::runtime_error("Error: Entry out of bounds!");
+
+				++histogram[mtb_radix_bucket(data[i], top)];
+			}
+		});
+
+		// Position of the first entry of each (bucket, thread) pair, in this order
+		std::vector<uint64_t> bounds(nbuckets + 1);
+		uint64_t pos = 0;
+
+		for (uint64_t b = 0; b < nbuckets; ++b)
+		{
+			bounds[b] = pos;
+
+			for (int t = 0; t < nthreads; ++t)
+			{
+				uint64_t size = histograms[t][b];
+				histograms[t][b] = pos;
+				pos += size;
+			}
+		}
+
+		bounds[nbuckets] = count;
+
+		mtb_parallel_for(count, nthreads, [&](int t, uint64_t begin, uint64_t end)
+		{
+			std::vector<uint64_t> &offsets = histograms[t];
+
+			for (uint64_t i = begin; i < end; ++i)
+				tmp[offsets[mtb_radix_bucket(data[i], top)]++] = data[i];
+		});
+
+		// Each bucket is sorted by the remaining digits and copied back to `data`
+		std::atomic<uint64_t> next_bucket(0);
+
+		mtb_parallel_for(nthreads, nthreads, [&](int, uint64_t, uint64_t)
+		{
+			std::vector<uint64_t> histogram(uint64_t(1) << MTB_RADIX_BITS);
+			uint64_t b;
+
+			while ((b = next_bucket++) < nbuckets)
+			{
+				uint64_t begin = bounds[b];
+				uint64_t size = bounds[b + 1] - begin;
+
+				Triplet<T> *sorted = mtb_radix_sort_serial(tmp + begin, data + begin, size,
+				                                           digits.data(), digits.size() - 1,
+				                                           histogram.data());
+
+				if (sorted != data + begin) std::copy(sorted, sorted + size, data + begin);
+			}
+		});
+	}
+
+	//! Sorts `count` triplets in a row-major order (or column-major, if `by_col == true`). Small
+	//! arrays are sorted with `std::stable_sort`, so the order of entries with the same indices
+	//! does not depend on the size of the array. Otherwise, a scratch array with the same size is
+	//! allocated and the triplets are sorted with @ref mtb_radix_sort.
+	//!
+	//! @param data[inout]			triplet array to be sorted
+	//! @param count[in]			number of entries
+	//! @param nrows[in]			number of rows
+	//! @param ncols[in]			number of columns
+	//! @param by_col[in]			sort in a column-major order
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//!
+	//! @exception std::runtime_error if an index is out of bounds.
+	template<typename T>
+	void mtb_sort_triplets(Triplet<T> *data, uint64_t count, uint64_t nrows, uint64_t ncols,
+	                       bool by_col = false, int nthreads = 0)
+	{
+		if (count < MTB_RADIX_MIN_SIZE)
+		{
+			for (uint64_t i = 0; i < count; ++i)
+				if ((uint64_t) data[i].row >= nrows || (uint64_t) data[i].col >= ncols)
+					throw std::runtime_error("Error: Entry out of bounds!");
+
+			std::stable_sort(data, data + count, [by_col](const Triplet<T> &a, const Triplet<T> &b)
+			{
+				if (by_col) return (a.col == b.col) ? (a.row < b.row) : (a.col < b.col);
+				else return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+			});
+			return;
+		}
+
+		std::unique_ptr<Triplet<T>[]> tmp(new Triplet<T>[count]);
+		mtb_radix_sort(data, tmp.get(), count, nrows, ncols, by_col, nthreads);
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_SORT_HPP_ */
@@ -0,0 +1,98 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_SYMMETRIC_HPP_
+#define _MTB_SYMMETRIC_HPP_
+
+#include <vector>
+
+#include "mtb_def.hpp"
+#include "mtb_io.hpp"
+
+namespace mtb
+{
+	//! Returns the number of entries of a symmetric matrix with both triangles, given the
+	//! `nz` entries of its lower triangle (see @ref kLowerTriangle).
+	//!
+	//! @param lower[in]			entries at or below the diagonal
+	//! @param nz[in]				number of entries in `lower`
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	template<typename T>
+	uint64_t mtb_expanded_size(const Triplet<T> *lower, uint64_t nz, int nthreads = 0)
+	{
+		nthreads = std::min<uint64_t>(mtb_num_threads(nthreads), nz / (1 << 16) + 1);
+		std::vector<uint64_t> counts(nthreads, 0);
+
+		mtb_parallel_for(nz, nthreads, [&](int t, uint64_t begin, uint64_t end)
+		{
+			uint64_t count = 0;
+
+			for (uint64_t i = begin; i < end; ++i)
+				count += (lower[i].row != lower[i].col);
+
+			counts[t] = count;
+		});
+
+		uint64_t size = nz;
+		for (uint64_t count : counts)
+			size += count;
+
+		return size;
+	}
+
+	//! Expands the lower triangle of a symmetric matrix (see @ref kLowerTriangle) into both
+	//! triangles using multiple threads. Each entry outside the diagonal is immediately
+	//! followed by its mirrored entry. Unlike @ref kExpandSymmetry, the output has no holes.
+	//!
+	//! @param lower[in]			entries at or below the diagonal
+	//! @param nz[in]				number of entries in `lower`
+	//! @param data[out]			triplet array with space for @ref mtb_expanded_size entries
+	//! 							(must not overlap `lower`)
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	//!
+	//! @return number of entries stored in `data`
+	template<typename T>
+	uint64_t mtb_expand_symmetric(const Triplet<T> *lower, uint64_t nz, Triplet<T> *data,
+	                              int nthreads = 0)
+	{
+		nthreads = std::min<uint64_t>(mtb_num_threads(nthreads), nz / (1 << 16) + 1);
+		std::vector<uint64_t> offsets(nthreads + 1, 0);
+
+		// First pass: number of entries produced by each thread
+		mtb_parallel_for(nz, nthreads, [&](int t, uint64_t begin, uint64_t end)
+		{
+			uint64_t count = end - begin;
+
+			for (uint64_t i = begin; i < end; ++i)
+				count += (lower[i].row != lower[i].col);
+
+			offsets[t + 1] = count;
+		});
+
+		for (int t = 0; t < nthreads; ++t)
+			offsets[t + 1] += offsets[t];
+
+		// Second pass: each thread writes its entries starting at its offset
+		mtb_parallel_for(nz, nthreads, [&](int t, uint64_t begin, uint64_t end)
+		{
+			Triplet<T> *out = data + offsets[t];
+
+			for (uint64_t i = begin; i < end; ++i)
+			{
+				*out++ = lower[i];
+
+				if (lower[i].row != lower[i].col)
+					*out++ = Triplet<T>{lower[i].col, lower[i].row, lower[i].val};
+			}
+		});
+
+		return offsets[nthreads];
+	}
+
+}   // namespace mtb
+
+#endif /* _MTB_SYMMETRIC_HPP_ */
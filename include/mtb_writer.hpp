@@ -0,0 +1,127 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_WRITER_HPP_
+#define _MTB_WRITER_HPP_
+
+#include <string>
+
+#include "mtb.hpp"
+
+namespace mtb
+{
+	//! The @ref Writer writes the entries of a MTB file one at a time or in batches, using a
+	//! constant amount of memory. The number of entries does not need to be known in advance:
+	//! it is written in the header when the file is closed. It can be used to write matrices
+	//! that are produced incrementally and never stored in memory at once.
+	//!
+	//! The entries are buffered and then converted to the index size and encoding of the
+	//! header (see @ref EntryWriter). The @ref kPlainEncoding and the @ref kDeltaEncoding (with
+	//! entries sorted in a row-major order) are supported, as well as the checksums
+	//! (@ref kChecksum). The @ref kChunkedEncoding and the row index (@ref kRowIndex) require
+	//! the number of entries in advance, so they are not supported.
+	class Writer
+	{
+		public:
+			//! Creates a MTB file and writes its header. The number of entries in the header
+			//! (`header.nz`) is ignored.
+			//!
+			//! @param filename[in]		name of MTB file
+			//! @param header[in]		matrix properties to be stored in the header
+			//! @param buffer_size[in]	number of entries written to the file at once
+			//!
+			//! @exception std::runtime_error if the file cannot be created or the header
+			//! is not supported.
+			Writer(const std::string &filename, const MTBHeader &header,
+			       uint64_t buffer_size = MTB_BUF_SIZE / 16);
+
+			//! Closes the file if @ref close was not called. Errors are ignored, so @ref close
+			//! should be called explicitly.
+			virtual ~Writer();
+
+			const MTBHeader &header() const { return _header; }
+			char mat_type() const { return _header.mat_type; }
+			char datatype() const { return _header.datatype; }
+			char type_size() const { return _header.type_size; }
+			uint64_t nrows() const { return _header.nrows; }
+			uint64_t ncols() const { return _header.ncols; }
+
+			//! Number of entries written so far
+			uint64_t nz() const { return _header.nz + _raw_count; }
+
+			//! Writes a single entry. For symmetric matrices (@ref kSymmetricSparse), only the
+			//! entries at or below the diagonal must be written.
+			//!
+			//! This routine assumes a **little endian** format.
+			//!
+			//! @exception std::runtime_error if the file is closed or cannot be written.
+			template<typename T>
+			void write(uint64_t row, uint64_t col, const T &val)
+			{
+				if (_raw_count == _raw_capacity) flush();
+
+				char *entry = _raw.get() + _raw_count * _entry_size;
+				std::memcpy(entry, &row, sizeof(uint64_t));
+				std::memcpy(entry + sizeof(uint64_t), &col, sizeof(uint64_t));
+				mtb_encode_value(entry + 2 * sizeof(uint64_t), val, _header.datatype, _header.type_size);
+
+				++_raw_count;
+			}
+
+			//! Writes a single entry stored as a @ref Triplet.
+			template<typename T>
+			void write(const Triplet<T> &entry)
+			{
+				write((uint64_t) entry.row, (uint64_t) entry.col, entry.val);
+			}
+
+			//! Writes `count` consecutive entries stored as a @ref Triplet array.
+			//!
+			//! This routine assumes a **little endian** format.
+			//!
+			//! @exception std::runtime_error if the file is closed or cannot be written.
+			template<typename T>
+			void write(const Triplet<T> *batch, uint64_t count)
+			{
+				while (count > 0)
+				{
+					if (_raw_count == _raw_capacity) flush();
+
+					uint64_t size = std::min(count, _raw_capacity - _raw_count);
+					mtb_encode_entries(batch, size, _raw.get() + _raw_count * _entry_size,
+					                   _header.datatype, _header.type_size);
+
+					_raw_count += size;
+					batch += size;
+					count -= size;
+				}
+			}
+
+			//! Writes the buffered entries, the data after the last entry (e.g., the checksums)
+			//! and the final number of entries in the header.
+			//!
+			//! @exception std::runtime_error if the file cannot be written, an index does not fit
+			//! in the index size or the entries are not sorted (@ref kDeltaEncoding).
+			void close();
+
+		private:
+			//! Encodes and writes the buffered entries.
+			void flush();
+
+			std::ofstream _ofile;
+			MTBHeader _header;				// The number of entries is the number already flushed
+			uint64_t _entry_size;			// Size of the buffered entries (MTB v1 layout)
+			std::unique_ptr<EntryWriter> _entries;
+
+			std::unique_ptr<char[]> _raw;
+			uint64_t _raw_capacity;		// Capacity of the buffer (in entries)
+			uint64_t _raw_count;		// Number of entries in the buffer
+	};
+
+}   // namespace mtb
+
+#endif /* _MTB_WRITER_HPP_ */
@@ -8,14 +8,29 @@
 #ifndef _MTX_HPP_
 #define _MTX_HPP_
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <memory>
 
 #include "mtb_def.hpp"
+#include "mtb_io.hpp"
+#include "mtx_parse.hpp"
 #include "progress_bar.hpp"
 
+#define MTX_CHUNK_SIZE (1 << 21)
+#define MTX_MIN_RUN_SIZE (1 << 16)
+#define MTX_MIN_MERGE_SIZE (1 << 12)
+#define MTX_FORMAT_SIZE (1 << 16)
+#define MTX_MAX_LINE_SIZE 128
+
 namespace mtb
 {
 
@@ -32,94 +47,509 @@ namespace mtb
 	void mtx_read_header(std::ifstream &ifile, std::vector<std::string> &properties,
 	                     uint64_t &nrows, uint64_t &ncols, uint64_t &nz);
 
-	//! Reads and parses the matrix entries of a MTX file. The entries are then
-	//! stored in a @ref Triplet array.
+	//! Parses the entries of a MTX file stored in `[begin, end)`, which must contain whole
+	//! lines with one entry per line. The fields may be separated by any number of spaces or
+	//! tabs, and the lines may end with CRLF. Blank lines are ignored, so the number of entries
+	//! is at most the number of lines. The numbers are parsed with the routines in
+	//! `mtx_parse.hpp`, which never read past `end`.
 	//!
-	//! @param ifile[inout]			input file stream to the MTX file
-	//! @param array[out]			triplet array containing the entries of the matrix
-	//! @param size[out]			the size of the triplet array
-	//! @param nz[in]				number of non-zeros entries
+	//! @param begin[in]			first character of the first line
+	//! @param end[in]				end of the last line
+	//! @param out[out]				triplet array where the entries are stored (zero-based indices)
 	//! @param is_weighted[in]		non-zero entries have a value or not
-	//! @param is_symmetric[in]		the matrix is symmetric or not
+	//!
+	//! @return number of parsed entries
+	//!
+	//! @exception std::runtime_error if a line does not contain the expected numbers.
 	template<typename T>
-	void mtx_read_data(std::ifstream &ifile, Triplet<T> *array, uint64_t *size, uint64_t nz,
-	                   bool is_weighted, bool is_symmetric)
+	uint64_t mtx_parse_lines(const char *begin, const char *end, Triplet<T> *out, bool is_weighted)
 	{
-		// Read buffer
-		std::unique_ptr<char[]> input(new char[MTB_BUF_SIZE + 1]);
+		uint64_t count = 0;
+		const char *ptr = begin;
 
-		ProgressBar bar(60);
-		bar.init("Importing data from MTX...");
+		while (ptr < end)
+		{
+			if (mtx_is_blank(*ptr) || *ptr == '\n')
+			{
+				++ptr;
+				continue;
+			}
+
+			uint64_t coord[2];
+			Triplet<T> &triplet = out[count++];
+
+			ptr = mtx_parse_uint(ptr, end, coord[0]);
+			ptr = mtx_parse_uint(mtx_skip_blanks(ptr, end), end, coord[1]);
+
+			triplet.row = coord[0] - 1;
+			triplet.col = coord[1] - 1;
+
+			if (!is_weighted)
+			{
+				triplet.val = 1;
+
+			} else if constexpr (std::is_integral_v<T>)
+			{
+				int64_t val;
+				ptr = mtx_parse_int(mtx_skip_blanks(ptr, end), end, val);
+				triplet.val = val;
+
+			} else if constexpr (std::is_floating_point_v<T>)
+			{
+				double val;
+				ptr = mtx_parse_real(mtx_skip_blanks(ptr, end), end, val);
+				triplet.val = val;
+
+			} else
+			{
+				double real, imag;
+				ptr = mtx_parse_real(mtx_skip_blanks(ptr, end), end, real);
+				ptr = mtx_parse_real(mtx_skip_blanks(ptr, end), end, imag);
+
+				triplet.val.real(real);
+				triplet.val.imag(imag);
+			}
+
+			// Move to the next line
+			ptr = (const char *) std::memchr(ptr, '\n', end - ptr);
+			if (!ptr) break;
+			++ptr;
+		}
+
+		return count;
+	}
+
+	//! The @ref MTXMappedFile maps a MTX file in memory (read-only, with `MADV_SEQUENTIAL`), so
+	//! the entries can be parsed in place from the mapping, without copying the text to a buffer.
+	//! Any byte range of the file can be addressed directly, e.g., by concurrent parsers.
+	class MTXMappedFile
+	{
+		public:
+			//! Maps a MTX file in memory.
+			//!
+			//! @param filename[in]		name of MTX file
+			//! @param offset[in]		position of the first entry (e.g., after @ref mtx_read_header)
+			//!
+			//! @exception std::runtime_error if the file cannot be mapped.
+			MTXMappedFile(const std::string &filename, uint64_t offset = 0);
+			virtual ~MTXMappedFile();
+
+			MTXMappedFile(const MTXMappedFile &) = delete;
+			MTXMappedFile &operator=(const MTXMappedFile &) = delete;
+
+			//! First character after `offset`
+			const char *begin() const { return _map + _offset; }
+
+			//! End of the file
+			const char *end() const { return _map + _size; }
+
+		private:
+			char *_map;
+			uint64_t _size;		// Size of the file (in bytes)
+			uint64_t _offset;
+	};
+
+	//! Block of a MTX file in the pipeline of @ref mtx_parse_parallel
+	template<typename T>
+	struct MTXBlock
+	{
+		std::unique_ptr<char[]> text;		// Copy of the lines (only for file streams)
+		const char *begin;					// First line of the block
+		uint64_t size;						// Size of the lines (in bytes)
+		uint64_t line;						// Number of lines before the block (after the header)
+		uint64_t nlines;					// Number of lines in the block
+		std::vector<Triplet<T>> buffer;		// Entries, if they are not parsed into the array
+		Triplet<T> *entries;				// Parsed entries
+		uint64_t count;						// Number of parsed entries
+		bool is_parsed;
+	};
+
+	//! Parses the blocks of a MTX file with a pipeline of threads (see @ref mtx_parse_parallel).
+	//! The blocks are provided by `next(block)`, which is called by the reader thread and sets
+	//! `block.begin` and `block.size` to the next whole lines of the file. It returns `true` for
+	//! the last block.
+	template<typename T, typename N, typename F>
+	void mtx_parse_blocks(N &&next, uint64_t nz, bool is_weighted, Triplet<T> *array, int nthreads,
+	                      F &&func)
+	{
+		nthreads = mtb_num_threads(nthreads);
+
+		std::vector<MTXBlock<T>> blocks(2 * nthreads + 2);
+
+		std::mutex mutex;
+		std::condition_variable cond;
+		uint64_t nread = 0;			// Number of blocks read from the file
+		uint64_t nclaimed = 0;		// Number of blocks taken by the parser threads
+		uint64_t nconsumed = 0;		// Number of blocks passed to `func`
+		bool is_eof = false;
+		bool stop = false;
+		std::exception_ptr error;
 
-		while (ifile)
+		// Stops all stages after the first error
+		auto fail = [&]()
 		{
-			char *ptr = input.get();
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) error = std::current_exception();
+			stop = true;
+			cond.notify_all();
+		};
 
-			// Read a large data block from the file
-			ifile.read(ptr, MTB_BUF_SIZE);
+		std::thread reader([&]()
+		{
+			try
+			{
+				uint64_t line = 0;
+
+				for (uint64_t k = 0; ; ++k)
+				{
+					{
+						// The block k is free once the block k - blocks.size() is consumed
+						std::unique_lock<std::mutex> lock(mutex);
+						cond.wait(lock, [&]() { return stop || k < nconsumed + blocks.size(); });
+						if (stop) return;
+					}
+
+					MTXBlock<T> &block = blocks[k % blocks.size()];
+					bool is_last = next(block);
+					uint64_t size = block.size;
+
+					block.line = line;
+					block.nlines = std::count(block.begin, block.begin + size, '\n');
+					if (size > 0 && block.begin[size - 1] != '\n') ++block.nlines;
+					block.is_parsed = false;
+					line += block.nlines;
+
+					std::lock_guard<std::mutex> lock(mutex);
+					if (size > 0) ++nread;
+					is_eof = is_last;
+					cond.notify_all();
+
+					if (is_last) return;
+				}
 
-			if (ifile.gcount() > 0)
+			} catch (...)
 			{
-				char *input_end = ptr + ifile.gcount();
-				*input_end = '\0';
+				fail();
+			}
+		});
 
-				// Find the end of the last complete line
-				char *last = std::strrchr(ptr, '\n');
+		std::vector<std::thread> parsers;
 
-				if (last)
+		for (int t = 0; t < nthreads; ++t)
+		{
+			parsers.emplace_back([&]()
+			{
+				try
 				{
-					// If the last line is truncated, rewind file pointer
-					// to the beggining of this line, so it can be read again
-					// in the next block.
-					ifile.seekg(last - input_end, ifile.cur);
-					std::fill(last + 1, input_end, '\0');
-
-					// Parse each line into triplets and then place them in the write buffer.
-					// TODO: Replace strtol and strtod with std::from_char for better performance
-					while (ptr < last)
+					while (true)
 					{
-						Triplet<T> triplet;
-						triplet.row = strtol(ptr, &ptr, 10) - 1;
-						triplet.col = strtol(++ptr, &ptr, 10) - 1;
+						uint64_t k;
 
-						if (!is_weighted)
 						{
-							triplet.val = 1;
+							std::unique_lock<std::mutex> lock(mutex);
+							cond.wait(lock, [&]() { return stop || is_eof || nclaimed < nread; });
+							if (stop || nclaimed == nread) return;
 
-						} else
-						{
-							if constexpr (std::is_integral_v<T>) triplet.val = strtol(++ptr, &ptr, 10);
-							else if constexpr (std::is_floating_point_v<T>) triplet.val = strtod(++ptr, &ptr);
-							else
-							{
-								typename T::value_type imag, real;
-
-								real = strtod(++ptr, &ptr);
-								imag = strtod(++ptr, &ptr);
-								triplet.val.real(real);
-								triplet.val.imag(imag);
-							}
+							k = nclaimed++;
 						}
 
-						array[(*size)++] = triplet;
+						// The entries are parsed directly into `array`, unless it may be too
+						// small (e.g., due to blank lines)
+						MTXBlock<T> &block = blocks[k % blocks.size()];
 
-						if (is_symmetric && triplet.col < triplet.row)
+						if (array && block.line + block.nlines <= nz)
 						{
-							std::swap(triplet.row, triplet.col);
-							array[(*size)++] = triplet;
+							block.entries = array + block.line;
+
+						} else
+						{
+							if (block.buffer.size() < block.nlines) block.buffer.resize(block.nlines);
+							block.entries = block.buffer.data();
 						}
 
-						++ptr;
+						block.count = mtx_parse_lines(block.begin, block.begin + block.size, block.entries,
+						                              is_weighted);
+
+						std::lock_guard<std::mutex> lock(mutex);
+						block.is_parsed = true;
+						cond.notify_all();
 					}
 
-					bar.set((float) *size / nz);
+				} catch (...)
+				{
+					fail();
+				}
+			});
+		}
+
+		ProgressBar bar(60);
+		bar.init("Importing data from MTX...");
+
+		try
+		{
+			uint64_t first = 0;
+
+			while (true)
+			{
+				MTXBlock<T> *block;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [&]()
+					{
+						return stop || (is_eof && nconsumed == nread)
+						       || (nconsumed < nread && blocks[nconsumed % blocks.size()].is_parsed);
+					});
+
+					if (stop) break;
+					if (nconsumed == nread) break;
+
+					block = &blocks[nconsumed % blocks.size()];
 				}
+
+				// The blank lines of the previous blocks leave a gap before the entries
+				Triplet<T> *entries = block->entries;
+				uint64_t count = block->count;
+
+				if (array)
+				{
+					if (first + count > nz)
+						throw std::runtime_error("Error: MTX file has more entries than expected!");
+
+					if (entries != array + first)
+						std::memmove((void *) (array + first), (const void *) entries,
+						             count * sizeof(Triplet<T>));
+					entries = array + first;
+				}
+
+				func((const Triplet<T> *) entries, first, count);
+				first += count;
+
+				if (nz > 0) bar.set(std::min<float>((float) first / nz, 1));
+
+				std::lock_guard<std::mutex> lock(mutex);
+				++nconsumed;
+				cond.notify_all();
 			}
+
+		} catch (...)
+		{
+			fail();
 		}
 
+		reader.join();
+		for (auto &parser : parsers)
+			parser.join();
+
+		if (error) std::rethrow_exception(error);
+
 		bar.finish();
 	}
 
+
+	//! Reads and parses the matrix entries of a MTX file with a pipeline of threads:
+	//!  - a reader thread reads the file in blocks of @ref MTX_CHUNK_SIZE bytes and counts
+	//!    their lines. The partial line at the end of a block is carried over in memory to the
+	//!    beginning of the next one;
+	//!  - `nthreads` parser threads take the blocks and parse them concurrently. Since every
+	//!    line contains one entry, each block is parsed directly into its final position in
+	//!    `array`, if it is not null, or into a buffer of the block otherwise;
+	//!  - the calling thread takes the parsed blocks in file order, closes the gaps left by
+	//!    blank lines and calls `func(entries, first, count)`, where `entries` points to the
+	//!    `count` entries of the block and `first` is the position of its first entry in the
+	//!    file. For example, `func` can encode and write the entries while the next blocks are
+	//!    read and parsed.
+	//!
+	//! A fixed number of blocks (2 per parser thread, plus 2) rotates between the stages, so a
+	//! stage waits if the following one is slower. Then, the throughput is the one of the
+	//! slowest stage.
+	//!
+	//! @param ifile[inout]			input file stream positioned at the first entry
+	//! @param nz[in]				number of non-zeros entries (capacity of `array`)
+	//! @param is_weighted[in]		non-zero entries have a value or not
+	//! @param array[out]			triplet array containing the entries of the matrix (or null)
+	//! @param nthreads[in]			number of parser threads (`<= 0` uses all hardware threads)
+	//! @param func[in]				function called for each block
+	//!
+	//! @exception std::runtime_error if the format is wrong or `array` is too small.
+	template<typename T, typename F>
+	void mtx_parse_parallel(std::ifstream &ifile, uint64_t nz, bool is_weighted, Triplet<T> *array,
+	                        int nthreads, F &&func)
+	{
+		std::unique_ptr<char[]> carry(new char[MTX_CHUNK_SIZE]);
+		uint64_t carry_size = 0;
+
+		mtx_parse_blocks<T>([&](MTXBlock<T> &block) -> bool
+		{
+			if (!block.text) block.text.reset(new char[MTX_CHUNK_SIZE]);
+			char *buf = block.text.get();
+
+			// The partial line of the previous block goes first
+			std::memcpy(buf, carry.get(), carry_size);
+			ifile.read(buf + carry_size, MTX_CHUNK_SIZE - carry_size);
+			uint64_t size = carry_size + ifile.gcount();
+			bool is_last = (size < MTX_CHUNK_SIZE);
+
+			if (!is_last)
+			{
+				char *last = (char *) memrchr(buf, '\n', size);
+				if (!last) throw std::runtime_error("Error: Wrong MTX format!");
+
+				carry_size = buf + size - (last + 1);
+				std::memcpy(carry.get(), last + 1, carry_size);
+				size = last + 1 - buf;
+
+			} else
+			{
+				// End of file: the last line may not end with a newline
+				while (size > 0 && (mtx_is_blank(buf[size - 1]) || buf[size - 1] == '\n'))
+					--size;
+			}
+
+			block.begin = buf;
+			block.size = size;
+			return is_last;
+
+		}, nz, is_weighted, array, nthreads, func);
+	}
+
+	//! Parses the matrix entries of a MTX file mapped in memory with a pipeline of threads (see
+	//! the overload above). The blocks are parsed in place from the mapping, so the reader
+	//! thread only finds the line boundaries and counts the lines (which also faults in the
+	//! pages before the parsers need them).
+	//!
+	//! @param file[in]				MTX file mapped from the first entry
+	//!
+	//! @exception std::runtime_error if the format is wrong or `array` is too small.
+	template<typename T, typename F>
+	void mtx_parse_parallel(const MTXMappedFile &file, uint64_t nz, bool is_weighted,
+	                        Triplet<T> *array, int nthreads, F &&func)
+	{
+		const char *ptr = file.begin();
+		const char *end = file.end();
+
+		mtx_parse_blocks<T>([&](MTXBlock<T> &block) -> bool
+		{
+			// Blocks end at a line boundary, so a line is never split
+			const char *last = end;
+
+			if ((uint64_t) (end - ptr) > MTX_CHUNK_SIZE)
+			{
+				last = (const char *) std::memchr(ptr + MTX_CHUNK_SIZE - 1, '\n',
+				                                  end - (ptr + MTX_CHUNK_SIZE - 1));
+				last = last ? last + 1 : end;
+			}
+
+			bool is_last = (last == end);
+
+			// End of file: the last line may not end with a newline
+			if (is_last)
+				while (last > ptr && (mtx_is_blank(last[-1]) || last[-1] == '\n'))
+					--last;
+
+			block.begin = ptr;
+			block.size = last - ptr;
+			ptr = last;
+			return is_last;
+
+		}, nz, is_weighted, array, nthreads, func);
+	}
+
+	//! Reads and parses the matrix entries of a MTX file. For each entry, `func(triplet)` is
+	//! called with the entry converted to a @ref Triplet (with zero-based indices), in file
+	//! order. The entries are parsed with multiple threads (see @ref mtx_parse_parallel), but
+	//! `func` is only called by the calling thread.
+	//!
+	//! @param input[inout]			input file stream to the MTX file or @ref MTXMappedFile
+	//! @param nz[in]				number of non-zeros entries
+	//! @param is_weighted[in]		non-zero entries have a value or not
+	//! @param func[in]				function called for each entry
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	template<typename T, typename Input, typename F>
+	void mtx_parse_data(Input &input, uint64_t nz, bool is_weighted, F &&func,
+	                    int nthreads = 0)
+	{
+		mtx_parse_parallel<T>(input, nz, is_weighted, nullptr, nthreads,
+		                      [&](const Triplet<T> *entries, uint64_t, uint64_t count)
+		                      {
+			                      for (uint64_t i = 0; i < count; ++i)
+				                      func(entries[i]);
+		                      });
+	}
+
+	//! Reads and parses the matrix entries of a MTX file. The entries are then
+	//! stored in a @ref Triplet array. The entries are parsed with multiple threads and,
+	//! for non-symmetric matrices, stored directly in their final positions (see
+	//! @ref mtx_parse_parallel).
+	//!
+	//! @param input[inout]			input file stream to the MTX file or @ref MTXMappedFile
+	//! @param array[out]			triplet array containing the entries of the matrix
+	//! @param size[out]			the size of the triplet array
+	//! @param nz[in]				number of non-zeros entries
+	//! @param is_weighted[in]		non-zero entries have a value or not
+	//! @param is_symmetric[in]		the matrix is symmetric or not
+	//! @param nthreads[in]			number of threads (`<= 0` uses all hardware threads)
+	template<typename T, typename Input>
+	void mtx_read_data(Input &input, Triplet<T> *array, uint64_t *size, uint64_t nz,
+	                   bool is_weighted, bool is_symmetric, int nthreads = 0)
+	{
+		if (!is_symmetric)
+		{
+			uint64_t start = *size;
+
+			mtx_parse_parallel<T>(input, nz - std::min(start, nz), is_weighted, array + start,
+			                      nthreads, [&](const Triplet<T> *, uint64_t first, uint64_t count)
+			                      {
+				                      *size = start + first + count;
+			                      });
+			return;
+		}
+
+		mtx_parse_data<T>(input, nz, is_weighted, [&](Triplet<T> triplet)
+		{
+			array[(*size)++] = triplet;
+
+			if (triplet.col < triplet.row)
+			{
+				std::swap(triplet.row, triplet.col);
+				array[(*size)++] = triplet;
+			}
+		}, nthreads);
+	}
+
+	//! Reads and parses the matrix entries of a MTX file. The entries are then stored
+	//! as a structure of arrays, i.e., the row indices, column indices and values are
+	//! stored in separate arrays. The index type `I` (e.g., `int32_t` or `int64_t`) must
+	//! be able to represent the number of rows and columns of the matrix.
+	//!
+	//! @param input[inout]			input file stream to the MTX file or @ref MTXMappedFile
+	//! @param rows[out]			row index of each entry
+	//! @param cols[out]			column index of each entry
+	//! @param vals[out]			value of each entry
+	//! @param size[out]			the number of entries stored in the arrays
+	//! @param nz[in]				number of non-zeros entries
+	//! @param is_weighted[in]		non-zero entries have a value or not
+	//! @param is_symmetric[in]		the matrix is symmetric or not
+	//! @param nthreads[in]			number of threads used to parse the file
+	template<typename T, typename I, typename Input>
+	void mtx_read_data_soa(Input &input, I *rows, I *cols, T *vals, uint64_t *size,
+	                       uint64_t nz, bool is_weighted, bool is_symmetric, int nthreads = 0)
+	{
+		mtx_parse_data<T>(input, nz, is_weighted, [&](const Triplet<T> &triplet)
+		{
+			rows[*size] = triplet.row;
+			cols[*size] = triplet.col;
+			vals[(*size)++] = triplet.val;
+
+			if (is_symmetric && triplet.col < triplet.row)
+			{
+				rows[*size] = triplet.col;
+				cols[*size] = triplet.row;
+				vals[(*size)++] = triplet.val;
+			}
+		}, nthreads);
+	}
+
 	//! Converts a MTX file to a MTB file. If `sort_data == true`, sort the data
 	//! in a row-major format (first by row index, then by column index) before
 	//! writing the data to the MTB file. This sorting requires that the entire
@@ -133,6 +563,73 @@ namespace mtb
 	//! @exception std::runtime_error if this routine encounters some error (e.g.,
 	//! wrong MTX format, unsupported matrix types, etc.).
 	void mtx_to_mtb(std::string mtx_file, std::string mtb_file, bool sort_data);
+
+	//! Options for the MTX to MTB conversion (see @ref mtx_to_mtb).
+	struct MTXConvertOptions
+	{
+		bool sort_data = true;					//!< Sort the data in a row-major format
+		char index_size = sizeof(uint64_t);		//!< Size of the indices (0 selects the smallest size)
+		bool delta_encoding = false;			//!< Use the @ref kDeltaEncoding (requires `sort_data`)
+		bool compression = false;				//!< Use the @ref kChunkedEncoding
+		bool checksum = false;					//!< Store the CRC32C of each data block (@ref kChecksum)
+		int nthreads = 0;						//!< Number of threads used to parse the MTX file (0 for all)
+		uint64_t memory_budget = 0;				//!< Memory for sorting (in bytes, 0 for no limit)
+		bool detect_symmetry = false;			//!< Store symmetric "general" matrices as @ref kSymmetricSparse
+		bool narrow_values = false;				//!< Store the values with the smallest lossless size
+		bool row_index = false;					//!< Store the @ref kRowIndex (requires `sort_data` and the plain encoding)
+	};
+
+	//! Converts a MTX file to a MTB file with the given options. If the index size is
+	//! smaller than 8 bytes or another encoding is selected, the MTB file uses the v2 format.
+	//! The row index (@ref kRowIndex) is only written if `options.row_index == true`, so the
+	//! default options (and @ref mtx_to_mtb with `sort_data`) still create MTB v1 files.
+	//!
+	//! If the data is sorted and the entries do not fit in `options.memory_budget`, an external
+	//! sort is used: the entries are split in sorted runs that fit in the budget, which are
+	//! stored in temporary files next to the MTB file (`<mtb_file>.run<k>`) and then merged
+	//! into the MTB file. The parse buffers (see @ref mtx_parse_parallel) are not included in
+	//! the budget.
+	//!
+	//! If `options.detect_symmetry == true`, a square matrix labeled as "general" is checked for
+	//! symmetry (same indices and values, bitwise, in both triangles). If it is symmetric, only
+	//! the lower triangle is stored, as a @ref kSymmetricSparse matrix. When the entries are
+	//! sorted in memory, each mirror is looked up in the sorted data. Otherwise, the entries and
+	//! the transposed entries are compared with an order-independent 128-bit hash, and the
+	//! unsorted data is parsed twice. A matrix with repeated indices is never stored as
+	//! symmetric: they are found in the sorted data or while the runs of the external sort are
+	//! merged (which restarts the merge as a general matrix), and the unsorted data keeps the
+	//! indices of the entries (8 bytes per entry) during the first parse.
+	//!
+	//! If `options.narrow_values == true`, the values are stored with the smallest size that
+	//! keeps them exactly (see @ref mtb_min_type_size), e.g., `float` for real values that are
+	//! small integers. The unsorted data is also parsed twice in this case.
+	//!
+	//! @param mtx_file[in]		MTX file name
+	//! @param mtb_file[in]		MTB file name
+	//! @param options[in]		conversion options
+	//!
+	//! @exception std::runtime_error if this routine encounters some error (e.g.,
+	//! wrong MTX format, unsupported matrix types, invalid options, etc.).
+	void mtx_to_mtb(std::string mtx_file, std::string mtb_file, const MTXConvertOptions &options);
+
+	//! Converts a MTB file (any index size, encoding or value size) to a MTX file. The entries
+	//! are written in the same order as in the MTB file and the entries of symmetric matrices
+	//! are kept in the lower triangle. The header and each entry have the format accepted by
+	//! @ref mtx_read_header and @ref mtx_parse_lines, so the MTX file can be converted back.
+	//!
+	//! The entries are read in batches (@ref MTX_FORMAT_SIZE entries per thread) by a
+	//! background thread, while the previous batch is formatted. Each thread formats a chunk
+	//! of the batch with `std::to_chars`, which gives the shortest representation of the
+	//! values that is read back to the same number (as a `double`, also for 4-byte values, so
+	//! @ref mtx_to_mtb can narrow them back). Then, the chunks are written in order.
+	//!
+	//! @param mtb_file[in]		MTB file name
+	//! @param mtx_file[in]		MTX file name
+	//! @param nthreads[in]		number of threads (`<= 0` uses all hardware threads)
+	//!
+	//! @exception std::runtime_error if the MTB file cannot be read or is not supported, or the
+	//! MTX file cannot be written.
+	void mtb_to_mtx(std::string mtb_file, std::string mtx_file, int nthreads = 0);
 }   // namespace mtb
 
 #endif /* _MTX_HPP_ */
@@ -0,0 +1,153 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTX_PARSE_HPP_
+#define _MTX_PARSE_HPP_
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace mtb
+{
+	//! Checks if a character separates the fields of a MTX line (space, tab or the carriage
+	//! return of a CRLF line ending).
+	inline bool mtx_is_blank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	//! Returns the first character in `[ptr, end)` that does not separate two fields.
+	inline const char *mtx_skip_blanks(const char *ptr, const char *end)
+	{
+		while (ptr < end && mtx_is_blank(*ptr))
+			++ptr;
+
+		return ptr;
+	}
+
+	//! Returns the number of leading decimal digits (up to 8) in 8 characters loaded as a
+	//! little endian integer.
+	inline int mtx_count_digits(uint64_t chunk)
+	{
+		// A byte is a digit if its upper nibble is 3 before and after adding 6. A carry
+		// may only change the bytes after the first non-digit.
+		uint64_t lower = chunk & 0xF0F0F0F0F0F0F0F0;
+		uint64_t upper = (chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0;
+		uint64_t mask = (lower ^ 0x3030303030303030) | (upper ^ 0x3030303030303030);
+
+		return mask ? __builtin_ctzll(mask) / 8 : 8;
+	}
+
+	//! Converts the first `ndigits` (1 to 8) decimal digits in 8 characters loaded as a little
+	//! endian integer, with 3 multiplications (SWAR).
+	inline uint64_t mtx_convert_digits(uint64_t chunk, int ndigits)
+	{
+		// Move the digits to the end, so the discarded characters become leading zeros
+		chunk = (chunk & 0x0F0F0F0F0F0F0F0F) << (8 * (8 - ndigits));
+
+		chunk = (chunk * 2561) >> 8;
+		chunk = ((chunk & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+		return ((chunk & 0x0000FFFF0000FFFF) * 42949672960001) >> 32;
+	}
+
+	//! Parses an unsigned decimal integer starting at `ptr`. The digits are converted 8 at a
+	//! time while at least 8 characters are available before `end`.
+	//!
+	//! @param ptr[in]		first character of the integer
+	//! @param end[in]		end of the buffer
+	//! @param val[out]		parsed integer
+	//!
+	//! @return pointer to the first character after the integer
+	//!
+	//! @exception std::runtime_error if there are no digits or more than 19 digits.
+	inline const char *mtx_parse_uint(const char *ptr, const char *end, uint64_t &val)
+	{
+		static constexpr uint64_t kPow10[9] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+		                                       10000000, 100000000};
+		const char *begin = ptr;
+		val = 0;
+
+		while (end - ptr >= 8)
+		{
+			uint64_t chunk;
+			std::memcpy(&chunk, ptr, sizeof(uint64_t));
+
+			int ndigits = mtx_count_digits(chunk);
+			if (ndigits == 0) break;
+
+			val = val * kPow10[ndigits] + mtx_convert_digits(chunk, ndigits);
+			ptr += ndigits;
+
+			if (ndigits < 8) break;
+		}
+
+		// Last characters of the buffer
+		if (end - ptr < 8)
+		{
+			for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr)
+				val = val * 10 + (*ptr - '0');
+		}
+
+		if (ptr == begin || ptr - begin > 19) throw std::runtime_error("Error: Wrong MTX format!");
+
+		return ptr;
+	}
+
+	//! Parses a signed decimal integer (with an optional sign) starting at `ptr`. See
+	//! @ref mtx_parse_uint.
+	inline const char *mtx_parse_int(const char *ptr, const char *end, int64_t &val)
+	{
+		bool is_negative = (ptr < end && *ptr == '-');
+		if (ptr < end && (*ptr == '-' || *ptr == '+')) ++ptr;
+
+		uint64_t abs_val;
+		ptr = mtx_parse_uint(ptr, end, abs_val);
+
+		val = is_negative ? -(int64_t) abs_val : (int64_t) abs_val;
+		return ptr;
+	}
+
+	//! Parses a floating-point number (fixed or scientific notation, with an optional sign)
+	//! starting at `ptr`, with the correct rounding (`std::from_chars`). Unlike `strtod`, this
+	//! routine does not depend on the locale and does not require a null-terminated buffer.
+	//! Numbers out of the range of `double` are converted to zero or infinity.
+	//!
+	//! @param ptr[in]		first character of the number
+	//! @param end[in]		end of the buffer
+	//! @param val[out]		parsed number
+	//!
+	//! @return pointer to the first character after the number
+	//!
+	//! @exception std::runtime_error if there is no number at `ptr`.
+	inline const char *mtx_parse_real(const char *ptr, const char *end, double &val)
+	{
+		// std::from_chars does not accept a leading plus sign
+		if (ptr < end && *ptr == '+' && end - ptr > 1 && ptr[1] != '-') ++ptr;
+
+		auto result = std::from_chars(ptr, end, val);
+
+		if (result.ec == std::errc::result_out_of_range)
+		{
+			// Keep the behavior of strtod (underflow to zero, overflow to infinity)
+			std::string number(ptr, result.ptr);
+			val = std::strtod(number.c_str(), nullptr);
+
+		} else if (result.ec != std::errc())
+		{
+			throw std::runtime_error("Error: Wrong MTX format!");
+		}
+
+		return result.ptr;
+	}
+
+}   // namespace mtb
+
+#endif /* _MTX_PARSE_HPP_ */
@@ -8,38 +8,68 @@
 #include "../include/compatibility.h"
 #include "../include/mtb.hpp"
 
-void read_mtb_int(char filename[64], char *mat_type, char *datatype, char *type_size,
-                  uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_int_t **array)
+// Reads a MTB file into a new array of `Triplet<T>`, which has the same layout as the
+// C triplet `C`. Symmetric matrices are read as their lower triangle into the second half
+// of an array with space for `2 * nz` entries, and then expanded in place (from the first
+// entry) to both triangles without holes. The entry `i` is written at most at position
+// `2 * i + 1`, so it never overwrites the entries that were not expanded yet.
+template<typename T, typename C>
+static void read_mtb(char filename[64], char *mat_type, char *datatype, char *type_size,
+                     uint64_t *nrows, uint64_t *ncols, uint64_t *nz, C **array)
 {
+	static_assert(sizeof(C) == sizeof(mtb::Triplet<T>), "Incompatible triplet layout");
+
 	std::ifstream ifile(filename, std::fstream::binary);
-	mtb::mtb_read_header(ifile, *mat_type, *datatype, *type_size, *nrows, *ncols, *nz);
+	mtb::MTBHeader header;
+	mtb::mtb_read_header(ifile, header);
+
+	*mat_type = header.mat_type;
+	*datatype = header.datatype;
+	*type_size = header.type_size;
+	*nrows = header.nrows;
+	*ncols = header.ncols;
+	*nz = header.nz;
+
+	if (*mat_type == kSymmetricSparse)
+	{
+		*array = new C[2 * header.nz];
+		mtb::Triplet<T> *data = (mtb::Triplet<T> *) *array;
+		mtb::mtb_read_data(ifile, data + header.nz, header, mtb::kLowerTriangle);
 
-	if (*mat_type == kSymmetricSparse) *nz *= 2;
-	*array = new triplet_int_t[*nz];
+		uint64_t size = 0;
 
-	mtb::mtb_read_data(ifile, (mtb::Triplet<int> *) *array, *nz, *mat_type, *datatype, *type_size);
+		for (uint64_t i = header.nz; i < 2 * header.nz; ++i)
+		{
+			mtb::Triplet<T> entry = data[i];
+			data[size++] = entry;
+
+			if (entry.row != entry.col)
+				data[size++] = mtb::Triplet<T>{entry.col, entry.row, entry.val};
+		}
+
+		*nz = size;
+
+	} else
+	{
+		*array = new C[*nz];
+		mtb::mtb_read_data(ifile, (mtb::Triplet<T> *) *array, header);
+	}
+}
+
+void read_mtb_int(char filename[64], char *mat_type, char *datatype, char *type_size,
+                  uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_int_t **array)
+{
+	read_mtb<int>(filename, mat_type, datatype, type_size, nrows, ncols, nz, array);
 }
 
 void read_mtb_sp(char filename[64], char *mat_type, char *datatype, char *type_size,
                  uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_sp_t **array)
 {
-	std::ifstream ifile(filename, std::fstream::binary);
-	mtb::mtb_read_header(ifile, *mat_type, *datatype, *type_size, *nrows, *ncols, *nz);
-
-	if (*mat_type == kSymmetricSparse) *nz *= 2;
-	*array = new triplet_sp_t[*nz];
-
-	mtb::mtb_read_data(ifile, (mtb::Triplet<float> *) *array, *nz, *mat_type, *datatype, *type_size);
+	read_mtb<float>(filename, mat_type, datatype, type_size, nrows, ncols, nz, array);
 }
 
 void read_mtb_dp(char filename[64], char *mat_type, char *datatype, char *type_size,
                  uint64_t *nrows, uint64_t *ncols, uint64_t *nz, triplet_dp_t **array)
 {
-	std::ifstream ifile(filename, std::fstream::binary);
-	mtb::mtb_read_header(ifile, *mat_type, *datatype, *type_size, *nrows, *ncols, *nz);
-
-	if (*mat_type == kSymmetricSparse) *nz *= 2;
-	*array = new triplet_dp_t[*nz];
-
-	mtb::mtb_read_data(ifile, (mtb::Triplet<double> *) *array, *nz, *mat_type, *datatype, *type_size);
+	read_mtb<double>(filename, mat_type, datatype, type_size, nrows, ncols, nz, array);
 }
@@ -4,25 +4,72 @@
  terms contained in the LICENSE file.
  **************************************************************************/
 
+#include <unistd.h>
+
 #include <cstdio>
 
 #include "../include/mtb.hpp"
 #include "../include/mtx.hpp"
 
+static void usage(const char *name)
+{
+	std::fprintf(stderr, "Usage: %s [-i <index size>] [-d] [-z] [-c] [-r] [-s] [-n] [-t <threads>] [-m <MiB>] <mtx file> <mtb file> <sort data>.\n"
+	                     "       %s -x [-t <threads>] <mtb file> <mtx file>.\n"
+	                     "  -i <index size>  size of the indices in bytes (1, 2, 4, 8 or 0 for the smallest)\n"
+	                     "  -d               delta-encode the indices (requires sorted data)\n"
+	                     "  -z               compress the entries in independent chunks\n"
+	                     "  -c               store a checksum of each data block\n"
+	                     "  -r               store the row index (requires sorted data)\n"
+	                     "  -s               store symmetric general matrices as their lower triangle\n"
+	                     "  -n               store the values with the smallest lossless size\n"
+	                     "  -t <threads>     number of threads used to parse the MTX file (0 for all)\n"
+	                     "  -m <MiB>         memory budget for sorting (uses temporary files if exceeded)\n"
+	                     "  -x               export a MTB file to MTX\n", name, name);
+	std::fflush(stderr);
+	exit(-1);
+}
+
 int main(int argc, char **argv)
 {
-	if (argc != 4)
-    {
-	    std::fprintf(stderr, "Usage: ./%s <mtx file> <mtb file> <sort data>.\n", argv[0]);
-	    std::fflush(stderr);
-	    exit(-1);
-    }
-
-	std::string input = argv[1];
-	std::string output = argv[2];
-	bool sort_data = atoi(argv[3]);
-
-	mtb::mtx_to_mtb(input, output, sort_data);
+	mtb::MTXConvertOptions options;
+	bool is_export = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:dzcrsnt:m:x")) != -1)
+	{
+		switch (opt)
+		{
+			case 'i': options.index_size = atoi(optarg); break;
+			case 'd': options.delta_encoding = true; break;
+			case 'z': options.compression = true; break;
+			case 'c': options.checksum = true; break;
+			case 'r': options.row_index = true; break;
+			case 's': options.detect_symmetry = true; break;
+			case 'n': options.narrow_values = true; break;
+			case 't': options.nthreads = atoi(optarg); break;
+			case 'm': options.memory_budget = strtoull(optarg, nullptr, 10) << 20; break;
+			case 'x': is_export = true; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	if (argc - optind != (is_export ? 2 : 3)) usage(argv[0]);
+
+	std::string input = argv[optind];
+	std::string output = argv[optind + 1];
+	if (!is_export) options.sort_data = atoi(argv[optind + 2]);
+
+	// Catch the errors, so the temporary files of the external sort are removed
+	try
+	{
+		if (is_export) mtb::mtb_to_mtx(input, output, options.nthreads);
+		else mtb::mtx_to_mtb(input, output, options);
+
+	} catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "\n%s\n", e.what());
+		return -1;
+	}
 
 	return 0;
 }
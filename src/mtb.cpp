@@ -16,28 +16,168 @@ namespace mtb
 	void mtb_read_header(std::ifstream &ifile, char &mat_type, char &datatype, char &type_size,
 	                     uint64_t &nrows, uint64_t &ncols, uint64_t &nz)
 	{
-		char tmp;
+		MTBHeader header;
+		mtb_read_header(ifile, header);
 
-		ifile.read((char *) &mat_type, 1);
-		ifile.read((char *) &tmp, 1);
-		ifile.read((char *) &ncols, sizeof(uint64_t));
-		ifile.read((char *) &nrows, sizeof(uint64_t));
-		ifile.read((char *) &nz, sizeof(uint64_t));
-
-		datatype = (tmp & 0xF0);
-		type_size = (tmp & 0x0F);
+		mat_type = header.mat_type;
+		datatype = header.datatype;
+		type_size = header.type_size;
+		nrows = header.nrows;
+		ncols = header.ncols;
+		nz = header.nz;
 	}
 
 	void mtb_write_header(std::ofstream &ofile, char mat_type, char datatype, char type_size,
 	                      uint64_t nrows, uint64_t ncols, uint64_t nz)
 	{
-		char tmp = datatype | type_size;
+		MTBHeader header = {mat_type, datatype, type_size, nrows, ncols, nz};
+		mtb_write_header(ofile, header);
+	}
+
+	void mtb_read_header(std::ifstream &ifile, MTBHeader &header)
+	{
+		char buf[MTB_MAX_HEADER_SIZE];
+
+		ifile.read(buf, MTB_HEADER_SIZE);
+		if (buf[0] & kExtendedHeader) ifile.read(buf + MTB_HEADER_SIZE, MTB_EXT_HEADER_SIZE);
+
+		mtb_parse_header(buf, header);
+	}
+
+	void mtb_read_header(const File &file, MTBHeader &header)
+	{
+		char buf[MTB_MAX_HEADER_SIZE];
+
+		if (file.size() < MTB_HEADER_SIZE) throw std::runtime_error("Error: Invalid MTB header!");
+
+		file.read_at(buf, MTB_HEADER_SIZE, 0);
+		if (buf[0] & kExtendedHeader) file.read_at(buf + MTB_HEADER_SIZE, MTB_EXT_HEADER_SIZE, MTB_HEADER_SIZE);
+
+		mtb_parse_header(buf, header);
+	}
+
+	void mtb_write_header(std::ofstream &ofile, const MTBHeader &header)
+	{
+		char buf[MTB_MAX_HEADER_SIZE];
+
+		mtb_format_header(buf, header);
+		ofile.write(buf, mtb_header_size(header));
+	}
+
+	bool mtb_is_extended(const MTBHeader &header)
+	{
+		return (header.flags & kExtendedHeader) || header.index_size != sizeof(uint64_t)
+		       || header.encoding != kPlainEncoding;
+	}
+
+	uint64_t mtb_header_size(const MTBHeader &header)
+	{
+		return MTB_HEADER_SIZE + mtb_is_extended(header) * MTB_EXT_HEADER_SIZE;
+	}
+
+	uint64_t mtb_row_index_offset(const MTBHeader &header)
+	{
+		uint64_t offset = mtb_header_size(header) + header.nz * mtb_entry_size(header);
+		if (header.flags & kChecksum) offset += mtb_checksum_size(header);
+
+		return offset;
+	}
+
+	void mtb_parse_header(const char *buf, MTBHeader &header)
+	{
+		header.mat_type = (buf[0] & ~MTB_FLAGS_MASK);
+		header.flags = (buf[0] & MTB_FLAGS_MASK);
+		header.datatype = (buf[1] & 0xF0);
+		header.type_size = (buf[1] & 0x0F);
+
+		std::memcpy(&header.ncols, buf + 2, sizeof(uint64_t));
+		std::memcpy(&header.nrows, buf + 2 + sizeof(uint64_t), sizeof(uint64_t));
+		std::memcpy(&header.nz, buf + 2 + 2 * sizeof(uint64_t), sizeof(uint64_t));
+
+		if (header.flags & kExtendedHeader)
+		{
+			header.version = buf[MTB_HEADER_SIZE];
+			header.index_size = buf[MTB_HEADER_SIZE + 1];
+			header.encoding = buf[MTB_HEADER_SIZE + 2];
+
+		} else
+		{
+			header.version = 1;
+			header.index_size = sizeof(uint64_t);
+			header.encoding = kPlainEncoding;
+		}
+	}
+
+	void mtb_format_header(char *buf, const MTBHeader &header)
+	{
+		bool is_extended = mtb_is_extended(header);
+
+		buf[0] = header.mat_type | header.flags | (is_extended ? kExtendedHeader : 0);
+		buf[1] = header.datatype | header.type_size;
+
+		std::memcpy(buf + 2, &header.ncols, sizeof(uint64_t));
+		std::memcpy(buf + 2 + sizeof(uint64_t), &header.nrows, sizeof(uint64_t));
+		std::memcpy(buf + 2 + 2 * sizeof(uint64_t), &header.nz, sizeof(uint64_t));
+
+		if (is_extended)
+		{
+			buf[MTB_HEADER_SIZE] = MTB_VERSION;
+			buf[MTB_HEADER_SIZE + 1] = header.index_size;
+			buf[MTB_HEADER_SIZE + 2] = header.encoding;
+			buf[MTB_HEADER_SIZE + 3] = 0;
+		}
+	}
+
+	char mtb_min_index_size(uint64_t nrows, uint64_t ncols)
+	{
+		uint64_t max_index = std::max(nrows, ncols);
+
+		if (max_index <= (1ULL << 8)) return 1;
+		if (max_index <= (1ULL << 16)) return 2;
+		if (max_index <= (1ULL << 32)) return 4;
+		return 8;
+	}
+
+	void mtb_check_header(const MTBHeader &header)
+	{
+		if (header.mat_type != kGeneralSparse && header.mat_type != kSymmetricSparse)
+			throw std::runtime_error("Error: Unsupported MTB matrix type!");
+
+		switch (header.datatype)
+		{
+			case kPattern:
+				if (header.type_size != 0) throw std::runtime_error("Error: Invalid MTB type size!");
+				break;
+
+			case kInteger:
+				if (header.type_size != 1 && header.type_size != 2 && header.type_size != 4
+				    && header.type_size != 8)
+					throw std::runtime_error("Error: Invalid MTB type size!");
+				break;
+
+			case kReal:
+			case kComplex:
+				if (header.type_size != 4 && header.type_size != 8)
+					throw std::runtime_error("Error: Invalid MTB type size!");
+				break;
+
+			default:
+				throw std::runtime_error("Error: Unsupported MTB type!");
+		}
+
+		if (header.version < 1 || header.version > MTB_VERSION)
+			throw std::runtime_error("Error: Unsupported MTB version!");
+
+		if (header.index_size != 1 && header.index_size != 2 && header.index_size != 4
+		    && header.index_size != 8)
+			throw std::runtime_error("Error: Invalid MTB index size!");
+
+		if (header.encoding != kPlainEncoding && header.encoding != kDeltaEncoding
+		    && header.encoding != kChunkedEncoding)
+			throw std::runtime_error("Error: Unsupported MTB encoding!");
 
-		ofile.write((char *) &mat_type, 1);
-		ofile.write((char *) &tmp, 1);
-		ofile.write((char *) &ncols, sizeof(uint64_t));
-		ofile.write((char *) &nrows, sizeof(uint64_t));
-		ofile.write((char *) &nz, sizeof(uint64_t));
+		if (header.encoding != kPlainEncoding && (header.flags & kRowIndex))
+			throw std::runtime_error("Error: The MTB row index requires the plain encoding!");
 	}
 }   // namespace mtb
 
@@ -0,0 +1,387 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_checksum.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define MTB_HAS_X86_CRC
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "../include/mtb.hpp"
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 CRC32C
+	 *********************************************************************************************/
+
+	// Reflected CRC32C (Castagnoli) polynomial
+	static const uint32_t kPolynomial = 0x82F63B78;
+
+	// Sizes of the three streams computed in parallel by the hardware kernel (in bytes)
+	static const uint64_t kLongStream = 8192;
+	static const uint64_t kShortStream = 256;
+
+	struct CRCTables
+	{
+		uint32_t slice[8][256];		// Slicing-by-8 tables of the software kernel
+		uint32_t long_shift[4][256];	// Appends `kLongStream` zero bytes to a CRC
+		uint32_t short_shift[4][256];	// Appends `kShortStream` zero bytes to a CRC
+
+		CRCTables();
+	};
+
+	// Multiplies a 32x32 matrix by a vector over GF(2)
+	static uint32_t gf2_times(const uint32_t *mat, uint32_t vec)
+	{
+		uint32_t sum = 0;
+
+		for (; vec; vec >>= 1, ++mat)
+			if (vec & 1) sum ^= *mat;
+
+		return sum;
+	}
+
+	static void gf2_square(uint32_t *square, const uint32_t *mat)
+	{
+		for (int n = 0; n < 32; ++n)
+			square[n] = gf2_times(mat, mat[n]);
+	}
+
+	// Builds the tables that append `size` zero bytes (a power of two) to a CRC, so the CRCs
+	// of consecutive streams can be combined: crc(a + b) = shift(crc(a)) ^ crc(b).
+	static void zeros_tables(uint32_t tables[4][256], uint64_t size)
+	{
+		uint32_t odd[32], even[32];
+
+		// Operator for a single zero bit, then squared to 2, 4 and 8 bits (one byte)
+		odd[0] = kPolynomial;
+		for (int n = 1; n < 32; ++n)
+			odd[n] = 1U << (n - 1);
+
+		gf2_square(even, odd);
+		gf2_square(odd, even);
+		gf2_square(even, odd);
+
+		for (; size > 1; size >>= 1)
+		{
+			gf2_square(odd, even);
+			std::copy(odd, odd + 32, even);
+		}
+
+		for (uint32_t n = 0; n < 256; ++n)
+			for (int k = 0; k < 4; ++k)
+				tables[k][n] = gf2_times(even, n << (8 * k));
+	}
+
+	CRCTables::CRCTables()
+	{
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t crc = n;
+			for (int k = 0; k < 8; ++k)
+				crc = (crc & 1) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+			slice[0][n] = crc;
+		}
+
+		for (uint32_t n = 0; n < 256; ++n)
+			for (int k = 1; k < 8; ++k)
+				slice[k][n] = slice[0][slice[k - 1][n] & 0xFF] ^ (slice[k - 1][n] >> 8);
+
+		zeros_tables(long_shift, kLongStream);
+		zeros_tables(short_shift, kShortStream);
+	}
+
+	static const CRCTables kTables;
+
+	static uint32_t crc32c_software(uint32_t crc, const char *buf, uint64_t size)
+	{
+		crc = ~crc;
+
+		for (; size >= 8; size -= 8, buf += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, buf, sizeof(uint64_t));
+			word ^= crc;
+
+			crc = kTables.slice[7][word & 0xFF] ^ kTables.slice[6][(word >> 8) & 0xFF]
+			      ^ kTables.slice[5][(word >> 16) & 0xFF] ^ kTables.slice[4][(word >> 24) & 0xFF]
+			      ^ kTables.slice[3][(word >> 32) & 0xFF] ^ kTables.slice[2][(word >> 40) & 0xFF]
+			      ^ kTables.slice[1][(word >> 48) & 0xFF] ^ kTables.slice[0][word >> 56];
+		}
+
+		for (; size > 0; --size, ++buf)
+			crc = kTables.slice[0][(crc ^ (uint8_t) *buf) & 0xFF] ^ (crc >> 8);
+
+		return ~crc;
+	}
+
+#ifdef MTB_HAS_X86_CRC
+	static inline uint32_t shift_crc(const uint32_t tables[4][256], uint32_t crc)
+	{
+		return tables[0][crc & 0xFF] ^ tables[1][(crc >> 8) & 0xFF] ^ tables[2][(crc >> 16) & 0xFF]
+		       ^ tables[3][crc >> 24];
+	}
+
+	// Computes the CRC of three consecutive streams of `stream` bytes at once. The CRC
+	// instruction has a latency of 3 cycles but a throughput of 1 per cycle, so the three
+	// independent dependency chains keep it busy.
+	__attribute__((target("sse4.2")))
+	static inline uint64_t crc32c_streams(uint64_t crc, const char *&buf, uint64_t &size,
+	                                      uint64_t stream, const uint32_t tables[4][256])
+	{
+		for (; size >= 3 * stream; size -= 3 * stream, buf += 3 * stream)
+		{
+			uint64_t crc1 = 0, crc2 = 0;
+
+			for (const char *ptr = buf; ptr < buf + stream; ptr += 8)
+			{
+				uint64_t words[3];
+				std::memcpy(&words[0], ptr, sizeof(uint64_t));
+				std::memcpy(&words[1], ptr + stream, sizeof(uint64_t));
+				std::memcpy(&words[2], ptr + 2 * stream, sizeof(uint64_t));
+
+				crc = _mm_crc32_u64(crc, words[0]);
+				crc1 = _mm_crc32_u64(crc1, words[1]);
+				crc2 = _mm_crc32_u64(crc2, words[2]);
+			}
+
+			crc = shift_crc(tables, crc) ^ crc1;
+			crc = shift_crc(tables, crc) ^ crc2;
+		}
+
+		return crc;
+	}
+
+	__attribute__((target("sse4.2")))
+	static uint32_t crc32c_sse42(uint32_t crc, const char *buf, uint64_t size)
+	{
+		uint64_t crc0 = ~crc;
+
+		crc0 = crc32c_streams(crc0, buf, size, kLongStream, kTables.long_shift);
+		crc0 = crc32c_streams(crc0, buf, size, kShortStream, kTables.short_shift);
+
+		for (; size >= 8; size -= 8, buf += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, buf, sizeof(uint64_t));
+			crc0 = _mm_crc32_u64(crc0, word);
+		}
+
+		for (; size > 0; --size, ++buf)
+			crc0 = _mm_crc32_u8(crc0, *buf);
+
+		return ~crc0;
+	}
+#endif
+
+	using crc_func = uint32_t (*)(uint32_t, const char *, uint64_t);
+
+	MTBCrcKernel mtb_crc_kernel()
+	{
+#ifdef MTB_HAS_X86_CRC
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse4.2")) return kSSE42Crc;
+#endif
+		return kSoftwareCrc;
+	}
+
+	static crc_func select_crc_kernel(MTBCrcKernel kernel)
+	{
+#ifdef MTB_HAS_X86_CRC
+		if (kernel == kSSE42Crc) return crc32c_sse42;
+#endif
+		return crc32c_software;
+	}
+
+	uint32_t mtb_crc32c(uint32_t crc, const void *buf, uint64_t size)
+	{
+		static const crc_func kernel = select_crc_kernel(mtb_crc_kernel());
+		return kernel(crc, (const char *) buf, size);
+	}
+
+	uint32_t mtb_crc32c(uint32_t crc, const void *buf, uint64_t size, MTBCrcKernel kernel)
+	{
+		if (kernel > mtb_crc_kernel()) throw std::runtime_error("Error: Unsupported instruction set!");
+
+		return select_crc_kernel(kernel)(crc, (const char *) buf, size);
+	}
+
+	/*********************************************************************************************
+	 Block Checksums
+	 *********************************************************************************************/
+
+	static uint32_t header_checksum(const MTBHeader &header)
+	{
+		char buf[MTB_MAX_HEADER_SIZE];
+
+		mtb_format_header(buf, header);
+		return mtb_crc32c(0, buf, mtb_header_size(header));
+	}
+
+	BlockChecksums::BlockChecksums(const MTBHeader &header) :
+			_header(header), _entry_size(mtb_entry_size(header.datatype, header.type_size)),
+			_crcs(1 + mtb_num_checksum_blocks(header.nz)), _crc(0), _count(0)
+	{
+		_crcs[0] = header_checksum(header);
+	}
+
+	void BlockChecksums::update(const char *raw, uint64_t count)
+	{
+		// The number of entries may not be known yet (see finish())
+		while (count > 0)
+		{
+			uint64_t size = std::min<uint64_t>(count, MTB_CHECKSUM_BLOCK - _count % MTB_CHECKSUM_BLOCK);
+
+			_crc = mtb_crc32c(_crc, raw, size * _entry_size);
+			raw += size * _entry_size;
+			count -= size;
+			_count += size;
+
+			if (_count % MTB_CHECKSUM_BLOCK == 0)
+			{
+				set_block(_count / MTB_CHECKSUM_BLOCK - 1, _crc);
+				_crc = 0;
+			}
+		}
+	}
+
+	void BlockChecksums::set_block(uint64_t block, uint32_t crc)
+	{
+		if (block + 1 >= _crcs.size()) _crcs.resize(block + 2);
+		_crcs[block + 1] = crc;
+	}
+
+	void BlockChecksums::finish(const MTBHeader &header)
+	{
+		if (_count % MTB_CHECKSUM_BLOCK != 0) set_block(_count / MTB_CHECKSUM_BLOCK, _crc);
+
+		_header = header;
+		_crcs.resize(1 + mtb_num_checksum_blocks(header.nz));
+		_crcs[0] = header_checksum(header);
+		_crc = 0;
+	}
+
+	void BlockChecksums::update_range(const char *raw, uint64_t first, uint64_t count)
+	{
+		for (uint64_t k = 0; k < count; k += MTB_CHECKSUM_BLOCK)
+		{
+			uint64_t size = std::min<uint64_t>(MTB_CHECKSUM_BLOCK, count - k);
+			_crcs[(first + k) / MTB_CHECKSUM_BLOCK + 1] = mtb_crc32c(0, raw + k * _entry_size,
+			                                                         size * _entry_size);
+		}
+	}
+
+	void BlockChecksums::verify(const char *raw, uint64_t count)
+	{
+		while (count > 0)
+		{
+			if (_count >= _header.nz) throw std::runtime_error("Error: Wrong number of MTB entries!");
+
+			uint64_t block = _count / MTB_CHECKSUM_BLOCK;
+			uint64_t end = std::min<uint64_t>((block + 1) * MTB_CHECKSUM_BLOCK, _header.nz);
+			uint64_t size = std::min(count, end - _count);
+
+			_crc = mtb_crc32c(_crc, raw, size * _entry_size);
+			raw += size * _entry_size;
+			count -= size;
+			_count += size;
+
+			if (_count == end)
+			{
+				if (_crc != _crcs[block + 1]) mismatch(block);
+				_crc = 0;
+			}
+		}
+	}
+
+	void BlockChecksums::verify_range(const char *raw, uint64_t first, uint64_t count) const
+	{
+		for (uint64_t k = 0; k < count; k += MTB_CHECKSUM_BLOCK)
+		{
+			uint64_t block = (first + k) / MTB_CHECKSUM_BLOCK;
+			uint64_t size = std::min<uint64_t>(MTB_CHECKSUM_BLOCK, count - k);
+
+			if (mtb_crc32c(0, raw + k * _entry_size, size * _entry_size) != _crcs[block + 1])
+				mismatch(block);
+		}
+	}
+
+	void BlockChecksums::mismatch(uint64_t block) const
+	{
+		uint64_t begin = block * MTB_CHECKSUM_BLOCK;
+		uint64_t end = std::min<uint64_t>(begin + MTB_CHECKSUM_BLOCK, _header.nz);
+
+		throw std::runtime_error("Error: MTB checksum mismatch in entries [" + std::to_string(begin)
+		                         + ", " + std::to_string(end) + ")!");
+	}
+
+	void BlockChecksums::reset()
+	{
+		_crc = 0;
+		_count = 0;
+	}
+
+	uint64_t BlockChecksums::offset_from_end() const
+	{
+		uint64_t offset = mtb_checksum_size(_header);
+		if (_header.flags & kRowIndex) offset += (_header.nrows + 1) * sizeof(uint64_t);
+
+		return offset;
+	}
+
+	void BlockChecksums::read(std::istream &in)
+	{
+		std::streampos pos = in.tellg();
+		std::vector<char> buf(mtb_checksum_size(_header));
+
+		in.seekg(0, std::ios::end);
+		uint64_t file_size = in.tellg();
+
+		if (file_size < mtb_header_size(_header) + offset_from_end())
+			throw std::runtime_error("Error: Truncated MTB file!");
+
+		in.seekg(file_size - offset_from_end());
+		in.read(buf.data(), buf.size());
+		if (!in) throw std::runtime_error("Error: Truncated MTB file!");
+
+		in.seekg(pos);
+		load(buf.data());
+	}
+
+	void BlockChecksums::read(const File &file)
+	{
+		std::vector<char> buf(mtb_checksum_size(_header));
+		uint64_t file_size = file.size();
+
+		if (file_size < mtb_header_size(_header) + offset_from_end())
+			throw std::runtime_error("Error: Truncated MTB file!");
+
+		file.read_at(buf.data(), buf.size(), file_size - offset_from_end());
+		load(buf.data());
+	}
+
+	void BlockChecksums::load(const char *buf)
+	{
+		uint32_t expected = header_checksum(_header);
+
+		std::memcpy(_crcs.data(), buf, _crcs.size() * sizeof(uint32_t));
+
+		if (_crcs[0] != expected) throw std::runtime_error("Error: MTB checksum mismatch in the header!");
+	}
+
+	void BlockChecksums::write(std::ostream &out) const
+	{
+		out.write((const char *) _crcs.data(), _crcs.size() * sizeof(uint32_t));
+	}
+
+}   // namespace mtb
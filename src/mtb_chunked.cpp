@@ -0,0 +1,80 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_chunked.hpp"
+
+#include <fcntl.h>
+
+#include <stdexcept>
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 Chunked MTB File
+	 *********************************************************************************************/
+
+	ChunkedFile::ChunkedFile(const std::string &filename) : _file(filename, O_RDONLY), _header()
+	{
+		char buf[MTB_MAX_HEADER_SIZE];
+
+		if (_file.size() < MTB_HEADER_SIZE) throw std::runtime_error("Error: Invalid MTB header!");
+
+		_file.read_at(buf, MTB_HEADER_SIZE, 0);
+		if (buf[0] & kExtendedHeader) _file.read_at(buf + MTB_HEADER_SIZE, MTB_EXT_HEADER_SIZE, MTB_HEADER_SIZE);
+
+		mtb_parse_header(buf, _header);
+		mtb_check_header(_header);
+
+		if (_header.encoding != kChunkedEncoding)
+			throw std::runtime_error("Error: MTB file is not chunked!");
+
+		uint64_t offset = mtb_header_size(_header);
+		if (offset + sizeof(uint64_t) > _file.size()) throw std::runtime_error("Error: Truncated MTB file!");
+
+		_file.read_at(&_table.chunk_size, sizeof(uint64_t), offset);
+		_table.resize(_header, _file.size() - offset);
+		_file.read_at(_table.offsets.data(), _table.offsets.size() * sizeof(uint64_t),
+		              offset + sizeof(uint64_t));
+		_table.check(_header);
+
+		_data_offset = offset + _table.size();
+
+		if (_data_offset > _file.size() || _table.offsets.back() > _file.size() - _data_offset)
+			throw std::runtime_error("Error: Truncated MTB file!");
+
+		if (_header.flags & kChecksum)
+		{
+			// Each chunk must contain whole checksum blocks, so they can be checked independently
+			if (_table.chunk_size % MTB_CHECKSUM_BLOCK != 0)
+				throw std::runtime_error("Error: Invalid MTB chunk table!");
+
+			_checksums.reset(new BlockChecksums(_header));
+			std::vector<char> buf(mtb_checksum_size(_header));
+
+			if (_data_offset + _table.offsets.back() + _checksums->offset_from_end() > _file.size())
+				throw std::runtime_error("Error: Truncated MTB file!");
+
+			_file.read_at(buf.data(), buf.size(), _file.size() - _checksums->offset_from_end());
+			_checksums->load(buf.data());
+		}
+	}
+
+	void ChunkedFile::read_chunk(uint64_t c, char *out, Buffers &buffers) const
+	{
+		if (c >= num_chunks()) throw std::runtime_error("Error: Chunk out of bounds!");
+
+		uint64_t size = _table.offsets[c + 1] - _table.offsets[c];
+		buffers.compressed.resize(size);
+
+		_file.read_at(buffers.compressed.data(), size, _data_offset + _table.offsets[c]);
+		mtb_decompress_chunk(buffers.compressed.data(), size, out, chunk_count(c), _header,
+		                     buffers.scratch);
+
+		if (_checksums) _checksums->verify_range(out, chunk_begin(c), chunk_count(c));
+	}
+
+}   // namespace mtb
@@ -0,0 +1,356 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_compress.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "../include/mtb_encoding.hpp"
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 Byte Shuffle
+	 *********************************************************************************************/
+
+	// Transposes a 8x8 byte matrix: the byte `j` of the row `k` of the input (`in + k * in_stride`)
+	// is stored in the byte `k` of the row `j` of the output (`out + j * out_stride`).
+	static inline void transpose8(const char *in, uint64_t in_stride, char *out, uint64_t out_stride)
+	{
+#ifdef __SSE2__
+		__m128i x[8];
+		for (int k = 0; k < 8; ++k)
+			x[k] = _mm_loadl_epi64((const __m128i *) (in + k * in_stride));
+
+		__m128i a = _mm_unpacklo_epi8(x[0], x[1]);
+		__m128i b = _mm_unpacklo_epi8(x[2], x[3]);
+		__m128i c = _mm_unpacklo_epi8(x[4], x[5]);
+		__m128i d = _mm_unpacklo_epi8(x[6], x[7]);
+
+		__m128i ab_lo = _mm_unpacklo_epi16(a, b);
+		__m128i ab_hi = _mm_unpackhi_epi16(a, b);
+		__m128i cd_lo = _mm_unpacklo_epi16(c, d);
+		__m128i cd_hi = _mm_unpackhi_epi16(c, d);
+
+		__m128i r[4] = {_mm_unpacklo_epi32(ab_lo, cd_lo), _mm_unpackhi_epi32(ab_lo, cd_lo),
+		                _mm_unpacklo_epi32(ab_hi, cd_hi), _mm_unpackhi_epi32(ab_hi, cd_hi)};
+
+		for (int j = 0; j < 4; ++j)
+		{
+			_mm_storel_epi64((__m128i *) (out + 2 * j * out_stride), r[j]);
+			_mm_storel_epi64((__m128i *) (out + (2 * j + 1) * out_stride), _mm_unpackhi_epi64(r[j], r[j]));
+		}
+#else
+		for (int k = 0; k < 8; ++k)
+			for (int j = 0; j < 8; ++j)
+				out[j * out_stride + k] = in[k * in_stride + j];
+#endif
+	}
+
+	// The records are processed in small blocks, so the records of a block stay in the L1 cache
+	// while the byte planes are accessed sequentially. Inside a block, groups of 8 records and
+	// 8 planes are transposed at once.
+	static const uint64_t kShuffleBlock = 256;
+
+	void mtb_shuffle(const char *in, char *out, uint64_t count, uint64_t record_size)
+	{
+		for (uint64_t first = 0; first < count; first += kShuffleBlock)
+		{
+			uint64_t size = std::min(kShuffleBlock, count - first);
+			const char *block = in + first * record_size;
+			uint64_t b = 0;
+
+			for (; b + 8 <= record_size; b += 8)
+			{
+				char *plane = out + b * count + first;
+				uint64_t i = 0;
+
+				for (; i + 8 <= size; i += 8)
+					transpose8(block + i * record_size + b, record_size, plane + i, count);
+
+				for (; i < size; ++i)
+					for (uint64_t k = 0; k < 8; ++k)
+						plane[k * count + i] = block[i * record_size + b + k];
+			}
+
+			for (; b < record_size; ++b)
+				for (uint64_t i = 0; i < size; ++i)
+					out[b * count + first + i] = block[i * record_size + b];
+		}
+	}
+
+	void mtb_unshuffle(const char *in, char *out, uint64_t count, uint64_t record_size)
+	{
+		for (uint64_t first = 0; first < count; first += kShuffleBlock)
+		{
+			uint64_t size = std::min(kShuffleBlock, count - first);
+			char *block = out + first * record_size;
+			uint64_t b = 0;
+
+			for (; b + 8 <= record_size; b += 8)
+			{
+				const char *plane = in + b * count + first;
+				uint64_t i = 0;
+
+				for (; i + 8 <= size; i += 8)
+					transpose8(plane + i, count, block + i * record_size + b, record_size);
+
+				for (; i < size; ++i)
+					for (uint64_t k = 0; k < 8; ++k)
+						block[i * record_size + b + k] = plane[k * count + i];
+			}
+
+			for (; b < record_size; ++b)
+				for (uint64_t i = 0; i < size; ++i)
+					block[i * record_size + b] = in[b * count + first + i];
+		}
+	}
+
+	/*********************************************************************************************
+	 LZ Codec
+	 *********************************************************************************************/
+
+	// Each sequence is composed by a token (4 bits for the number of literals and 4 bits for
+	// the match length minus kMinMatch), the literals, a 16-bit offset and the match length.
+	// Lengths that do not fit in the token are followed by bytes of 255 until the remainder.
+	// The last sequence only contains literals.
+	static const uint64_t kMinMatch = 4;
+	static const uint64_t kMaxOffset = 65535;
+	static const int kHashBits = 14;
+
+	static inline uint32_t hash4(const char *ptr)
+	{
+		uint32_t val;
+		std::memcpy(&val, ptr, sizeof(uint32_t));
+		return (val * 2654435761U) >> (32 - kHashBits);
+	}
+
+	static inline char *put_length(char *out, uint64_t len)
+	{
+		for (; len >= 255; len -= 255)
+			*out++ = (char) 255;
+
+		*out++ = (char) len;
+		return out;
+	}
+
+	// Writes the token and the literals of a sequence
+	static inline char *put_literals(char *out, const char *literals, uint64_t lit_len,
+	                                 uint64_t match_len)
+	{
+		*out++ = (char) ((std::min<uint64_t>(lit_len, 15) << 4) | std::min<uint64_t>(match_len, 15));
+		if (lit_len >= 15) out = put_length(out, lit_len - 15);
+
+		std::memcpy(out, literals, lit_len);
+		return out + lit_len;
+	}
+
+	// Number of equal bytes in [a, end) and [b, ...)
+	static inline uint64_t match_length(const char *a, const char *b, const char *end)
+	{
+		const char *start = a;
+
+		while (a + sizeof(uint64_t) <= end)
+		{
+			uint64_t x, y;
+			std::memcpy(&x, a, sizeof(uint64_t));
+			std::memcpy(&y, b, sizeof(uint64_t));
+
+			// Assuming LITTLE ENDIAN
+			if (x != y) return a - start + (__builtin_ctzll(x ^ y) >> 3);
+
+			a += sizeof(uint64_t);
+			b += sizeof(uint64_t);
+		}
+
+		while (a < end && *a == *b)
+		{
+			++a;
+			++b;
+		}
+
+		return a - start;
+	}
+
+	uint64_t mtb_lz_compress(const char *in, uint64_t size, char *out)
+	{
+		// Position + 1 of the last occurrence of each hash (0 if none)
+		std::unique_ptr<uint64_t[]> table(new uint64_t[1 << kHashBits]());
+
+		const char *ip = in;
+		const char *anchor = in;
+		const char *end = in + size;
+		char *op = out;
+
+		while (ip + kMinMatch <= end)
+		{
+			uint32_t hash = hash4(ip);
+			uint64_t ref = table[hash];
+			table[hash] = ip - in + 1;
+
+			if (ref == 0 || (uint64_t) (ip - in) - (ref - 1) > kMaxOffset
+			    || std::memcmp(ip, in + ref - 1, kMinMatch) != 0)
+			{
+				++ip;
+				continue;
+			}
+
+			const char *match = in + ref - 1;
+
+			uint64_t len = kMinMatch + match_length(ip + kMinMatch, match + kMinMatch, end);
+			uint16_t offset = ip - match;
+
+			op = put_literals(op, anchor, ip - anchor, len - kMinMatch);
+			std::memcpy(op, &offset, sizeof(uint16_t));
+			op += sizeof(uint16_t);
+
+			if (len - kMinMatch >= 15) op = put_length(op, len - kMinMatch - 15);
+
+			ip += len;
+			anchor = ip;
+		}
+
+		// Last literals
+		return put_literals(op, anchor, end - anchor, 0) - out;
+	}
+
+	static inline uint64_t get_length(const uint8_t *&ip, const uint8_t *end, uint64_t len)
+	{
+		if (len < 15) return len;
+
+		for (;;)
+		{
+			if (ip == end) throw std::runtime_error("Error: Corrupted MTB chunk!");
+
+			uint8_t byte = *ip++;
+			len += byte;
+			if (byte != 255) return len;
+		}
+	}
+
+	void mtb_lz_decompress(const char *in, uint64_t in_size, char *out, uint64_t out_size)
+	{
+		const uint8_t *ip = (const uint8_t *) in;
+		const uint8_t *ip_end = ip + in_size;
+		char *op = out;
+		char *op_end = out + out_size;
+
+		for (;;)
+		{
+			if (ip == ip_end) throw std::runtime_error("Error: Corrupted MTB chunk!");
+
+			uint8_t token = *ip++;
+			uint64_t lit_len = get_length(ip, ip_end, token >> 4);
+
+			if (lit_len > (uint64_t) (ip_end - ip) || lit_len > (uint64_t) (op_end - op))
+				throw std::runtime_error("Error: Corrupted MTB chunk!");
+
+			std::memcpy(op, ip, lit_len);
+			op += lit_len;
+			ip += lit_len;
+
+			// The last sequence has no match
+			if (ip == ip_end) break;
+
+			if (ip_end - ip < (std::ptrdiff_t) sizeof(uint16_t))
+				throw std::runtime_error("Error: Corrupted MTB chunk!");
+
+			uint16_t offset;
+			std::memcpy(&offset, ip, sizeof(uint16_t));
+			ip += sizeof(uint16_t);
+
+			uint64_t len = get_length(ip, ip_end, token & 15) + kMinMatch;
+
+			if (offset == 0 || offset > op - out || len > (uint64_t) (op_end - op))
+				throw std::runtime_error("Error: Corrupted MTB chunk!");
+
+			const char *match = op - offset;
+
+			if (offset == 1)
+			{
+				std::memset(op, *match, len);
+
+			} else
+			{
+				// The match may overlap the output, so it is copied in pieces of `offset` bytes
+				for (uint64_t done = 0; done < len; done += offset)
+					std::memcpy(op + done, match + done, std::min<uint64_t>(offset, len - done));
+			}
+
+			op += len;
+		}
+
+		if (op != op_end) throw std::runtime_error("Error: Corrupted MTB chunk!");
+	}
+
+	/*********************************************************************************************
+	 Chunks
+	 *********************************************************************************************/
+
+	uint64_t mtb_compress_chunk(const char *in, uint64_t count, const MTBHeader &header,
+	                            std::vector<char> &out, std::vector<char> &scratch)
+	{
+		uint64_t entry_size = mtb_entry_size(header);
+		uint64_t size = count * entry_size;
+
+		scratch.resize(size);
+		out.resize(1 + mtb_lz_bound(size));
+
+		mtb_shuffle(in, scratch.data(), count, entry_size);
+		uint64_t compressed_size = mtb_lz_compress(scratch.data(), size, out.data() + 1);
+
+		if (compressed_size < size)
+		{
+			out[0] = kLZCodec;
+			return 1 + compressed_size;
+		}
+
+		out[0] = kStoredCodec;
+		std::memcpy(out.data() + 1, scratch.data(), size);
+		return 1 + size;
+	}
+
+	void mtb_decompress_chunk(const char *in, uint64_t in_size, char *out, uint64_t count,
+	                          const MTBHeader &header, std::vector<char> &scratch)
+	{
+		uint64_t entry_size = mtb_entry_size(header);
+		uint64_t value_size = mtb_entry_size(header.datatype, header.type_size) - 2 * sizeof(uint64_t);
+		uint64_t size = count * entry_size;
+		bool is_narrow = (header.index_size != sizeof(uint64_t));
+
+		if (in_size == 0) throw std::runtime_error("Error: Corrupted MTB chunk!");
+
+		scratch.resize(size * (1 + is_narrow));
+		const char *shuffled = scratch.data();
+		char *plain = is_narrow ? scratch.data() + size : out;
+
+		switch (in[0])
+		{
+			case kStoredCodec:
+				if (in_size - 1 != size) throw std::runtime_error("Error: Corrupted MTB chunk!");
+				shuffled = in + 1;
+				break;
+
+			case kLZCodec:
+				mtb_lz_decompress(in + 1, in_size - 1, scratch.data(), size);
+				break;
+
+			default:
+				throw std::runtime_error("Error: Unsupported MTB codec!");
+		}
+
+		mtb_unshuffle(shuffled, plain, count, entry_size);
+		if (is_narrow) mtb_widen_indices(plain, out, count, header.index_size, value_size);
+	}
+
+}   // namespace mtb
@@ -0,0 +1,280 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_decode.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MTB_HAS_X86_SIMD
+#endif
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 Record Expansion Kernels
+	 *********************************************************************************************/
+
+	// All kernels handle the records in [first, count) and return the index of the first record
+	// that was not processed. The SIMD kernels store more bytes than the size of an output
+	// record, so the last few records are always handled by the scalar kernel.
+	static uint64_t expand_scalar(const char *in, char *out, uint64_t first, uint64_t count,
+	                              int in_size, uint64_t fill)
+	{
+		for (uint64_t i = first; i < count; ++i)
+		{
+			std::memcpy(out + i * 24, in + i * in_size, in_size);
+			if (in_size == 16) std::memcpy(out + i * 24 + 16, &fill, sizeof(uint64_t));
+		}
+
+		return count;
+	}
+
+#ifdef MTB_HAS_X86_SIMD
+	// Outputs of at least this size (in bytes) do not fit in the cache, so they are written with
+	// non-temporal stores. These stores skip the read of each cache line before it is written.
+	static constexpr uint64_t kStreamSize = 1 << 20;
+
+	// Expands the first records with the scalar kernel, until the output is aligned to `align`
+	// bytes. Returns the index of the first aligned record.
+	static uint64_t expand_head(const char *in, char *out, uint64_t count, int in_size, uint64_t fill,
+	                            uint64_t align)
+	{
+		uint64_t i = 0;
+		while (i < count && (uintptr_t) (out + i * 24) % align != 0) ++i;
+
+		return expand_scalar(in, out, 0, i, in_size, fill);
+	}
+
+	// Four records per iteration: the 96 output bytes are assembled from three overlapping input
+	// loads and written with aligned non-temporal stores. The loads never pass the last record.
+	__attribute__((target("avx2")))
+	static uint64_t expand_avx2_stream(const char *in, char *out, uint64_t count, int in_size,
+	                                   uint64_t fill)
+	{
+		uint64_t i = expand_head(in, out, count, in_size, fill, 32);
+
+		if (in_size == 20)
+		{
+			const __m256i idx0 = _mm256_setr_epi32(0, 1, 2, 3, 4, 4, 5, 6);
+			const __m256i idx1 = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 6);
+			const __m256i idx2 = _mm256_setr_epi32(2, 2, 3, 4, 5, 6, 7, 7);
+
+			for (; i + 4 <= count; i += 4)
+			{
+				const char *src = in + i * 20;
+				__m256i *dst = (__m256i *) (out + i * 24);
+
+				__m256i a = _mm256_loadu_si256((const __m256i *) src);
+				__m256i b = _mm256_loadu_si256((const __m256i *) (src + 28));
+				__m256i c = _mm256_loadu_si256((const __m256i *) (src + 48));
+
+				_mm256_stream_si256(dst, _mm256_permutevar8x32_epi32(a, idx0));
+				_mm256_stream_si256(dst + 1, _mm256_permutevar8x32_epi32(b, idx1));
+				_mm256_stream_si256(dst + 2, _mm256_permutevar8x32_epi32(c, idx2));
+			}
+
+		} else
+		{
+			const __m256i val = _mm256_set1_epi64x(fill);
+
+			for (; i + 4 <= count; i += 4)
+			{
+				const char *src = in + i * 16;
+				__m256i *dst = (__m256i *) (out + i * 24);
+
+				__m256i a = _mm256_loadu_si256((const __m256i *) src);
+				__m256i b = _mm256_loadu_si256((const __m256i *) (src + 24));
+				__m256i c = _mm256_loadu_si256((const __m256i *) (src + 32));
+
+				a = _mm256_permute4x64_epi64(a, _MM_SHUFFLE(2, 0, 1, 0));
+				b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 0));
+				c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(0, 3, 2, 0));
+
+				_mm256_stream_si256(dst, _mm256_blend_epi32(a, val, 0x30));
+				_mm256_stream_si256(dst + 1, _mm256_blend_epi32(b, val, 0x0C));
+				_mm256_stream_si256(dst + 2, _mm256_blend_epi32(c, val, 0xC3));
+			}
+		}
+
+		_mm_sfence();
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	static uint64_t expand_avx2(const char *in, char *out, uint64_t count, int in_size,
+	                            uint64_t fill)
+	{
+		if (count * 24 >= kStreamSize && (uintptr_t) out % 8 == 0)
+			return expand_avx2_stream(in, out, count, in_size, fill);
+
+		uint64_t i = 0;
+
+		if (in_size == 20)
+		{
+			// Each 32-byte load contains one input record (5 dwords) and the beginning of the next
+			// one. The permutation inserts the padding dword in the output record.
+			const __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 4, 5, 6);
+
+			for (; i + 2 <= count; ++i)
+			{
+				__m256i v = _mm256_loadu_si256((const __m256i *) (in + i * 20));
+				_mm256_storeu_si256((__m256i *) (out + i * 24), _mm256_permutevar8x32_epi32(v, idx));
+			}
+
+		} else
+		{
+			const __m256i val = _mm256_set1_epi64x(fill);
+
+			for (; i + 2 <= count; ++i)
+			{
+				__m256i v = _mm256_zextsi128_si256(_mm_loadu_si128((const __m128i *) (in + i * 16)));
+				_mm256_storeu_si256((__m256i *) (out + i * 24), _mm256_blend_epi32(v, val, 0x30));
+			}
+		}
+
+		return i;
+	}
+
+	// Eight records per iteration, as in expand_avx2_stream. The last load is masked, so it
+	// never passes the last record.
+	__attribute__((target("avx512f")))
+	static uint64_t expand_avx512_stream(const char *in, char *out, uint64_t count, int in_size,
+	                                     uint64_t fill)
+	{
+		uint64_t i = expand_head(in, out, count, in_size, fill, 64);
+
+		if (in_size == 20)
+		{
+			// The padding dword of each output record is a copy of the previous dword
+			const __m512i idx0 = _mm512_setr_epi32(0, 1, 2, 3, 4, 4, 5, 6, 7, 8, 9, 9, 10, 11, 12, 13);
+			const __m512i idx1 = _mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 5, 6, 7, 8, 9, 10, 10, 11, 12);
+			const __m512i idx2 = _mm512_setr_epi32(0, 1, 2, 2, 3, 4, 5, 6, 7, 7, 8, 9, 10, 11, 12, 12);
+
+			for (; i + 8 <= count; i += 8)
+			{
+				const char *src = in + i * 20;
+				char *dst = out + i * 24;
+
+				__m512i a = _mm512_loadu_si512(src);
+				__m512i b = _mm512_loadu_si512(src + 56);
+				__m512i c = _mm512_maskz_loadu_epi32(0x1FFF, src + 108);
+
+				_mm512_stream_si512((__m512i *) dst, _mm512_maskz_permutexvar_epi32(0xFFFF, idx0, a));
+				_mm512_stream_si512((__m512i *) (dst + 64), _mm512_maskz_permutexvar_epi32(0xFFFF, idx1, b));
+				_mm512_stream_si512((__m512i *) (dst + 128), _mm512_maskz_permutexvar_epi32(0xFFFF, idx2, c));
+			}
+
+		} else
+		{
+			// The masked-out qwords of each output vector receive the value
+			const __m512i idx0 = _mm512_setr_epi64(0, 1, 0, 2, 3, 0, 4, 5);
+			const __m512i idx1 = _mm512_setr_epi64(0, 0, 1, 0, 2, 3, 0, 4);
+			const __m512i idx2 = _mm512_setr_epi64(0, 0, 1, 2, 0, 3, 4, 0);
+			const __m512i val = _mm512_set1_epi64(fill);
+
+			for (; i + 8 <= count; i += 8)
+			{
+				const char *src = in + i * 16;
+				char *dst = out + i * 24;
+
+				__m512i a = _mm512_loadu_si512(src);
+				__m512i b = _mm512_loadu_si512(src + 48);
+				__m512i c = _mm512_maskz_loadu_epi64(0x1F, src + 88);
+
+				_mm512_stream_si512((__m512i *) dst, _mm512_mask_permutexvar_epi64(val, 0xDB, idx0, a));
+				_mm512_stream_si512((__m512i *) (dst + 64), _mm512_mask_permutexvar_epi64(val, 0xB6, idx1, b));
+				_mm512_stream_si512((__m512i *) (dst + 128), _mm512_mask_permutexvar_epi64(val, 0x6D, idx2, c));
+			}
+		}
+
+		_mm_sfence();
+		return i;
+	}
+
+	__attribute__((target("avx512f")))
+	static uint64_t expand_avx512(const char *in, char *out, uint64_t count, int in_size,
+	                              uint64_t fill)
+	{
+		if (count * 24 >= kStreamSize && (uintptr_t) out % 8 == 0)
+			return expand_avx512_stream(in, out, count, in_size, fill);
+
+		uint64_t i = 0;
+
+		if (in_size == 20)
+		{
+			// Two records per iteration: dwords 0-4 and 5-9 of the input are placed in dwords 0-4 and
+			// 6-10 of the output. The last 4 dwords are overwritten in the next iteration.
+			const __m512i idx = _mm512_setr_epi32(0, 1, 2, 3, 4, 4, 5, 6, 7, 8, 9, 9, 10, 11, 12, 13);
+
+			for (; i + 4 <= count; i += 2)
+			{
+				__m512i v = _mm512_loadu_si512(in + i * 20);
+				_mm512_storeu_si512(out + i * 24, _mm512_maskz_permutexvar_epi32(0xFFFF, idx, v));
+			}
+
+		} else
+		{
+			// Two records per iteration: the dwords 4-5 and 10-11 of the output receive the value.
+			const __m512i idx = _mm512_setr_epi32(0, 1, 2, 3, 0, 0, 4, 5, 6, 7, 0, 0, 8, 9, 10, 11);
+			const __m512i val = _mm512_set1_epi64(fill);
+			const __mmask16 mask = 0xF3CF;
+
+			for (; i + 3 <= count; i += 2)
+			{
+				__m512i v = _mm512_maskz_loadu_epi32(0x00FF, in + i * 16);
+				_mm512_storeu_si512(out + i * 24, _mm512_mask_permutexvar_epi32(val, mask, idx, v));
+			}
+		}
+
+		return i;
+	}
+#endif
+
+	using expand_func = uint64_t (*)(const char *, char *, uint64_t, int, uint64_t);
+
+	MTBSimdLevel mtb_simd_level()
+	{
+#ifdef MTB_HAS_X86_SIMD
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return kAVX512Simd;
+		if (__builtin_cpu_supports("avx2")) return kAVX2Simd;
+#endif
+		return kScalarSimd;
+	}
+
+	static expand_func select_expand_kernel(MTBSimdLevel level)
+	{
+		switch (level)
+		{
+#ifdef MTB_HAS_X86_SIMD
+			case kAVX512Simd: return expand_avx512;
+			case kAVX2Simd: return expand_avx2;
+#endif
+			default: return nullptr;
+		}
+	}
+
+	void mtb_expand_records(const char *in, char *out, uint64_t count, int in_size, uint64_t fill)
+	{
+		static const expand_func kernel = select_expand_kernel(mtb_simd_level());
+
+		uint64_t first = kernel ? kernel(in, out, count, in_size, fill) : 0;
+		expand_scalar(in, out, first, count, in_size, fill);
+	}
+
+	void mtb_expand_records(const char *in, char *out, uint64_t count, int in_size, uint64_t fill,
+	                        MTBSimdLevel level)
+	{
+		if (level > mtb_simd_level()) throw std::runtime_error("Error: Unsupported instruction set!");
+
+		expand_func kernel = select_expand_kernel(level);
+
+		uint64_t first = kernel ? kernel(in, out, count, in_size, fill) : 0;
+		expand_scalar(in, out, first, count, in_size, fill);
+	}
+
+}   // namespace mtb
@@ -0,0 +1,518 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_encoding.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/mtb_compress.hpp"
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 Narrow Indices
+	 *********************************************************************************************/
+
+	void mtb_widen_indices(const char *in, char *out, uint64_t count, int index_size,
+	                       uint64_t value_size)
+	{
+		uint64_t in_size = 2 * index_size + value_size;
+		uint64_t out_size = 2 * sizeof(uint64_t) + value_size;
+
+		for (uint64_t i = 0; i < count; ++i, in += in_size, out += out_size)
+		{
+			// Assuming LITTLE ENDIAN
+			uint64_t coord[2] = {0, 0};
+			std::memcpy(&coord[0], in, index_size);
+			std::memcpy(&coord[1], in + index_size, index_size);
+
+			std::memcpy(out, coord, 2 * sizeof(uint64_t));
+			std::memcpy(out + 2 * sizeof(uint64_t), in + 2 * index_size, value_size);
+		}
+	}
+
+	void mtb_narrow_indices(const char *in, char *out, uint64_t count, int index_size,
+	                        uint64_t value_size)
+	{
+		uint64_t in_size = 2 * sizeof(uint64_t) + value_size;
+		uint64_t out_size = 2 * index_size + value_size;
+		uint64_t max_index = (index_size == 8) ? UINT64_MAX : (1ULL << (8 * index_size)) - 1;
+
+		for (uint64_t i = 0; i < count; ++i, in += in_size, out += out_size)
+		{
+			uint64_t coord[2];
+			std::memcpy(coord, in, 2 * sizeof(uint64_t));
+
+			if (coord[0] > max_index || coord[1] > max_index)
+				throw std::runtime_error("Error: Index does not fit in the MTB index size!");
+
+			// Assuming LITTLE ENDIAN. The input and output may overlap.
+			std::memmove(out, &coord[0], index_size);
+			std::memmove(out + index_size, &coord[1], index_size);
+			std::memmove(out + 2 * index_size, in + 2 * sizeof(uint64_t), value_size);
+		}
+	}
+
+	/*********************************************************************************************
+	 Delta Encoding
+	 *********************************************************************************************/
+
+	static char *put_varint(char *out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			*out++ = (char) (value | 0x80);
+			value >>= 7;
+		}
+
+		*out++ = (char) value;
+		return out;
+	}
+
+	// Returns false if the varint is not complete in [ptr, end)
+	static bool get_varint(const char *&ptr, const char *end, uint64_t &value)
+	{
+		value = 0;
+
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (ptr == end) return false;
+
+			uint8_t byte = *ptr++;
+			value |= (uint64_t) (byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+
+		throw std::runtime_error("Error: Corrupted MTB file!");
+	}
+
+	uint64_t DeltaEncoder::encode(const char *in, uint64_t count, char *out)
+	{
+		uint64_t in_size = 2 * sizeof(uint64_t) + _value_size;
+		char *ptr = out;
+
+		for (uint64_t i = 0; i < count;)
+		{
+			uint64_t row;
+			std::memcpy(&row, in + i * in_size, sizeof(uint64_t));
+
+			if (row < _row) throw std::runtime_error("Error: MTB entries are not sorted!");
+
+			// Find the end of the run
+			uint64_t end = i + 1;
+			while (end < count)
+			{
+				uint64_t next;
+				std::memcpy(&next, in + end * in_size, sizeof(uint64_t));
+				if (next != row) break;
+				++end;
+			}
+
+			ptr = put_varint(ptr, row - _row);
+			ptr = put_varint(ptr, end - i);
+			_row = row;
+
+			uint64_t prev_col = 0;
+
+			for (; i < end; ++i)
+			{
+				uint64_t col;
+				std::memcpy(&col, in + i * in_size + sizeof(uint64_t), sizeof(uint64_t));
+
+				if (col < prev_col) throw std::runtime_error("Error: MTB entries are not sorted!");
+
+				ptr = put_varint(ptr, col - prev_col);
+				prev_col = col;
+
+				std::memcpy(ptr, in + i * in_size + 2 * sizeof(uint64_t), _value_size);
+				ptr += _value_size;
+			}
+		}
+
+		return ptr - out;
+	}
+
+	uint64_t DeltaDecoder::decode(const char *&in, const char *in_end, char *out, uint64_t count)
+	{
+		uint64_t out_size = 2 * sizeof(uint64_t) + _value_size;
+		uint64_t n = 0;
+
+		while (n < count)
+		{
+			const char *ptr = in;
+			uint64_t row = _row, col = _col, remaining = _remaining;
+			uint64_t delta;
+
+			if (remaining == 0)
+			{
+				// Start of a new run
+				if (!get_varint(ptr, in_end, delta)) break;
+				row += delta;
+
+				if (!get_varint(ptr, in_end, remaining)) break;
+				if (remaining == 0) throw std::runtime_error("Error: Corrupted MTB file!");
+
+				col = 0;
+			}
+
+			if (!get_varint(ptr, in_end, delta)) break;
+			if ((uint64_t) (in_end - ptr) < _value_size) break;
+
+			col += delta;
+
+			// The entry is complete, so the decoder state can be updated
+			uint64_t coord[2] = {row, col};
+			std::memcpy(out + n * out_size, coord, 2 * sizeof(uint64_t));
+			std::memcpy(out + n * out_size + 2 * sizeof(uint64_t), ptr, _value_size);
+
+			in = ptr + _value_size;
+			_row = row;
+			_col = col;
+			_remaining = remaining - 1;
+			++n;
+		}
+
+		return n;
+	}
+
+	/*********************************************************************************************
+	 Chunk Table
+	 *********************************************************************************************/
+
+	void ChunkTable::resize(const MTBHeader &header, uint64_t available)
+	{
+		if (chunk_size == 0) throw std::runtime_error("Error: Invalid MTB chunk table!");
+
+		// Chunk size and `nchunks + 1` positions, without overflowing `nchunks + 2`
+		uint64_t max_entries = available / sizeof(uint64_t);
+		uint64_t nchunks = num_chunks(header.nz);
+
+		if (max_entries < 2 || nchunks > max_entries - 2)
+			throw std::runtime_error("Error: Truncated MTB file!");
+
+		offsets.resize(nchunks + 1);
+	}
+
+	void ChunkTable::read(std::istream &in, const MTBHeader &header)
+	{
+		// Bytes left in the stream (unknown if it is not seekable)
+		uint64_t available = std::numeric_limits<uint64_t>::max();
+		std::streampos begin = in.tellg();
+
+		if (begin != std::streampos(-1))
+		{
+			in.seekg(0, std::ios::end);
+			std::streampos end = in.tellg();
+			in.seekg(begin);
+
+			if (!in) throw std::runtime_error("Error: Cannot read from MTB file!");
+			if (end >= begin) available = end - begin;
+		}
+
+		in.read((char *) &chunk_size, sizeof(uint64_t));
+		if (!in) throw std::runtime_error("Error: Truncated MTB file!");
+
+		resize(header, available);
+		in.read((char *) offsets.data(), offsets.size() * sizeof(uint64_t));
+		if (!in) throw std::runtime_error("Error: Truncated MTB file!");
+
+		check(header);
+
+		// The chunks must also fit in the stream
+		if (offsets.back() > available - size()) throw std::runtime_error("Error: Truncated MTB file!");
+	}
+
+	void ChunkTable::write(std::ostream &out) const
+	{
+		out.write((const char *) &chunk_size, sizeof(uint64_t));
+		out.write((const char *) offsets.data(), offsets.size() * sizeof(uint64_t));
+	}
+
+	void ChunkTable::check(const MTBHeader &header) const
+	{
+		uint64_t nz = header.nz;
+		uint64_t entry_size = mtb_entry_size(header);
+
+		if (chunk_size == 0 || offsets.empty() || offsets.size() - 1 != num_chunks(nz) || offsets[0] != 0)
+			throw std::runtime_error("Error: Invalid MTB chunk table!");
+
+		for (uint64_t i = 1; i < offsets.size(); ++i)
+		{
+			// Codec and the entries stored without compression (the largest possible chunk)
+			uint64_t count = std::min(chunk_size, nz - (i - 1) * chunk_size);
+			uint64_t max_size = 1 + count * entry_size;
+
+			if (offsets[i] <= offsets[i - 1] || offsets[i] - offsets[i - 1] > max_size)
+				throw std::runtime_error("Error: Invalid MTB chunk table!");
+		}
+	}
+
+	/*********************************************************************************************
+	 Entry Reader and Writer
+	 *********************************************************************************************/
+
+	// Size of the buffer used to read delta-coded entries (in bytes)
+	static const uint64_t kDeltaBufferSize = 1 << 20;
+
+	static uint64_t value_size(const MTBHeader &header)
+	{
+		return mtb_entry_size(header.datatype, header.type_size) - 2 * sizeof(uint64_t);
+	}
+
+	EntryReader::EntryReader(const MTBHeader &header) :
+			_header(header), _value_size(value_size(header)), _decoder(_value_size),
+			_capacity(0), _pos(0), _size(0), _chunk(0)
+	{
+	}
+
+	void EntryReader::reserve(uint64_t size)
+	{
+		if (size <= _capacity) return;
+
+		_buf.reset(new char[size]);
+		_capacity = size;
+	}
+
+	void EntryReader::reset()
+	{
+		_decoder = DeltaDecoder(_value_size);
+		_pos = 0;
+		_size = 0;
+		_table.offsets.clear();
+		_chunk = 0;
+
+		if (_checksums) _checksums->reset();
+	}
+
+	void EntryReader::next_chunk(std::istream &in)
+	{
+		if (_table.offsets.empty()) _table.read(in, _header);
+		if (_chunk + 1 >= _table.offsets.size()) throw std::runtime_error("Error: Truncated MTB file!");
+
+		uint64_t out_size = 2 * sizeof(uint64_t) + _value_size;
+		uint64_t count = std::min(_table.chunk_size, _header.nz - _chunk * _table.chunk_size);
+		uint64_t size = _table.offsets[_chunk + 1] - _table.offsets[_chunk];
+		std::vector<char> compressed(size);
+
+		in.read(compressed.data(), size);
+		if (!in) throw std::runtime_error("Error: Truncated MTB file!");
+
+		// The decompressed entries are kept in the buffer until they are read
+		reserve(count * out_size);
+		mtb_decompress_chunk(compressed.data(), size, _buf.get(), count, _header, _scratch);
+
+		_pos = 0;
+		_size = count;
+		++_chunk;
+	}
+
+	void EntryReader::read(std::istream &in, char *out, uint64_t count)
+	{
+		if (!(_header.flags & kChecksum)) return read_entries(in, out, count);
+
+		if (!_checksums)
+		{
+			_checksums.reset(new BlockChecksums(_header));
+			_checksums->read(in);
+		}
+
+		// The entries are checked in small pieces, while they are still in the cache
+		uint64_t out_size = 2 * sizeof(uint64_t) + _value_size;
+		uint64_t piece_size = std::max<uint64_t>(MTB_CHECKSUM_BLOCK / 4, 1);
+
+		for (uint64_t k = 0; k < count; k += piece_size)
+		{
+			uint64_t size = std::min(piece_size, count - k);
+
+			read_entries(in, out + k * out_size, size);
+			_checksums->verify(out + k * out_size, size);
+		}
+	}
+
+	void EntryReader::read_entries(std::istream &in, char *out, uint64_t count)
+	{
+		uint64_t in_size = mtb_entry_size(_header);
+		uint64_t out_size = 2 * sizeof(uint64_t) + _value_size;
+
+		if (_header.encoding == kPlainEncoding)
+		{
+			if (_header.index_size == sizeof(uint64_t))
+			{
+				in.read(out, count * in_size);
+				if (!in) throw std::runtime_error("Error: Truncated MTB file!");
+				return;
+			}
+
+			reserve(count * in_size);
+
+			in.read(_buf.get(), count * in_size);
+			if (!in) throw std::runtime_error("Error: Truncated MTB file!");
+
+			mtb_widen_indices(_buf.get(), out, count, _header.index_size, _value_size);
+			return;
+		}
+
+		if (_header.encoding == kChunkedEncoding)
+		{
+			// Here, the position and size of the buffer are in entries
+			for (uint64_t done = 0; done < count;)
+			{
+				if (_pos == _size) next_chunk(in);
+
+				uint64_t size = std::min(count - done, _size - _pos);
+				std::memcpy(out + done * out_size, _buf.get() + _pos * out_size, size * out_size);
+
+				_pos += size;
+				done += size;
+			}
+
+			return;
+		}
+
+		reserve(kDeltaBufferSize);
+
+		for (uint64_t done = 0;;)
+		{
+			const char *ptr = _buf.get() + _pos;
+			done += _decoder.decode(ptr, _buf.get() + _size, out + done * out_size, count - done);
+			_pos = ptr - _buf.get();
+
+			if (done == count) break;
+
+			// Move the incomplete entry to the beginning of the buffer and read the next block
+			uint64_t left = _size - _pos;
+			std::memmove(_buf.get(), _buf.get() + _pos, left);
+
+			in.read(_buf.get() + left, _capacity - left);
+			if (in.gcount() == 0) throw std::runtime_error("Error: Truncated MTB file!");
+
+			_pos = 0;
+			_size = left + in.gcount();
+		}
+	}
+
+	EntryWriter::EntryWriter(const MTBHeader &header, uint64_t chunk_size) :
+			_header(header), _value_size(value_size(header)), _encoder(_value_size), _capacity(0),
+			_pending(0), _written(0)
+	{
+		_table.chunk_size = chunk_size;
+
+		if (header.flags & kChecksum)
+		{
+			if (header.encoding == kChunkedEncoding && (chunk_size == 0 || chunk_size % MTB_CHECKSUM_BLOCK != 0))
+				throw std::runtime_error("Error: The MTB chunk size must be a multiple of the checksum block!");
+
+			_checksums.reset(new BlockChecksums(header));
+		}
+	}
+
+	void EntryWriter::write_chunk(std::ostream &out)
+	{
+		if (_pending == 0) return;
+
+		uint64_t size = mtb_compress_chunk(_buf.get(), _pending, _header, _chunk, _scratch);
+		out.write(_chunk.data(), size);
+
+		_table.offsets.push_back(_table.offsets.back() + size);
+		_pending = 0;
+	}
+
+	void EntryWriter::write(std::ostream &out, char *raw, uint64_t count)
+	{
+		_written += count;
+
+		// The checksums are computed before the entries are converted in place
+		if (_checksums) _checksums->update(raw, count);
+
+		if (_header.encoding == kChunkedEncoding)
+		{
+			uint64_t entry_size = mtb_entry_size(_header);
+
+			if (_table.offsets.empty())
+			{
+				// Reserve space for the chunk table, which is written in finish()
+				_table.offsets.assign(_table.num_chunks(_header.nz) + 1, 0);
+				_table_pos = out.tellp();
+				_table.write(out);
+
+				_table.offsets.assign(1, 0);
+				_capacity = _table.chunk_size * entry_size;
+				_buf.reset(new char[_capacity]);
+			}
+
+			if (_header.index_size != sizeof(uint64_t))
+				mtb_narrow_indices(raw, raw, count, _header.index_size, _value_size);
+
+			for (uint64_t done = 0; done < count;)
+			{
+				uint64_t size = std::min(count - done, _table.chunk_size - _pending);
+				std::memcpy(_buf.get() + _pending * entry_size, raw + done * entry_size, size * entry_size);
+
+				_pending += size;
+				done += size;
+
+				if (_pending == _table.chunk_size) write_chunk(out);
+			}
+
+			return;
+		}
+
+		if (_header.encoding == kPlainEncoding)
+		{
+			if (_header.index_size != sizeof(uint64_t))
+				mtb_narrow_indices(raw, raw, count, _header.index_size, _value_size);
+
+			out.write(raw, count * mtb_entry_size(_header));
+			return;
+		}
+
+		uint64_t size = _encoder.max_size(count);
+
+		if (size > _capacity)
+		{
+			_buf.reset(new char[size]);
+			_capacity = size;
+		}
+
+		out.write(_buf.get(), _encoder.encode(raw, count, _buf.get()));
+	}
+
+	void EntryWriter::finish(std::ostream &out)
+	{
+		if ((_header.encoding == kChunkedEncoding || _checksums) && _written != _header.nz)
+			throw std::runtime_error("Error: Wrong number of MTB entries!");
+
+		if (_header.encoding == kChunkedEncoding) finish_chunks(out);
+
+		if (_checksums)
+		{
+			_checksums->finish(_header);
+			_checksums->write(out);
+		}
+	}
+
+	void EntryWriter::finish_chunks(std::ostream &out)
+	{
+		// Matrix without entries
+		if (_table.offsets.empty())
+		{
+			_table.offsets.assign(1, 0);
+			_table.write(out);
+			return;
+		}
+
+		write_chunk(out);
+
+		std::streampos end = out.tellp();
+		out.seekp(_table_pos);
+		_table.write(out);
+		out.seekp(end);
+	}
+
+}   // namespace mtb
@@ -0,0 +1,326 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_io.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace mtb
+{
+	int mtb_num_threads(int nthreads)
+	{
+		if (nthreads > 0) return nthreads;
+
+		int hw_threads = std::thread::hardware_concurrency();
+		return (hw_threads > 0) ? hw_threads : 1;
+	}
+
+	/*********************************************************************************************
+	 POSIX File
+	 *********************************************************************************************/
+
+	File::File(const std::string &filename, int flags, int mode)
+	{
+		_fd = open(filename.c_str(), flags, mode);
+		if (_fd < 0) throw std::runtime_error("Error: Cannot open file " + filename + "!");
+	}
+
+	File::~File()
+	{
+		if (_fd >= 0) close(_fd);
+	}
+
+	uint64_t File::size() const
+	{
+		struct stat st;
+		if (fstat(_fd, &st) != 0) throw std::runtime_error("Error: Cannot read the file size!");
+		return st.st_size;
+	}
+
+	void File::read_at(void *buf, size_t size, uint64_t offset) const
+	{
+		char *ptr = (char *) buf;
+
+		while (size > 0)
+		{
+			ssize_t n = pread(_fd, ptr, size, offset);
+
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) throw std::runtime_error("Error: Cannot read from file!");
+
+			ptr += n;
+			size -= n;
+			offset += n;
+		}
+	}
+
+	void File::write_at(const void *buf, size_t size, uint64_t offset) const
+	{
+		const char *ptr = (const char *) buf;
+
+		while (size > 0)
+		{
+			ssize_t n = pwrite(_fd, ptr, size, offset);
+
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) throw std::runtime_error("Error: Cannot write to file!");
+
+			ptr += n;
+			size -= n;
+			offset += n;
+		}
+	}
+
+	void File::allocate(uint64_t size) const
+	{
+		int error = posix_fallocate(_fd, 0, size);
+
+		if (error == EINVAL || error == EOPNOTSUPP) error = ftruncate(_fd, size) ? errno : 0;
+		if (error != 0) throw std::runtime_error("Error: Cannot allocate the file!");
+	}
+
+	/*********************************************************************************************
+	 Range Writer
+	 *********************************************************************************************/
+
+	static void *aligned_buffer(size_t size)
+	{
+		void *ptr;
+		if (posix_memalign(&ptr, MTB_DIRECT_ALIGN, size) != 0) throw std::bad_alloc();
+		return ptr;
+	}
+
+	RangeWriter::RangeWriter(const File &file, const File *direct, uint64_t offset, size_t capacity) :
+			_file(file), _direct(direct), _buf(nullptr, std::free),
+			_capacity(std::max<size_t>(capacity, 2 * MTB_DIRECT_ALIGN)),
+			_base(offset - offset % MTB_DIRECT_ALIGN), _begin(offset % MTB_DIRECT_ALIGN),
+			_end(offset % MTB_DIRECT_ALIGN)
+	{
+		// The buffer has the same alignment as the file, so the pages can be written directly
+		_capacity += MTB_DIRECT_ALIGN - _capacity % MTB_DIRECT_ALIGN;
+		_buf.reset((char *) aligned_buffer(_capacity));
+	}
+
+	char *RangeWriter::reserve(size_t size)
+	{
+		if (_end + size > _capacity) flush(false);
+		if (_end + size > _capacity) throw std::runtime_error("Error: Buffer is too small!");
+
+		return _buf.get() + _end;
+	}
+
+	void RangeWriter::flush(bool last)
+	{
+		size_t end = last ? _end : _end - _end % MTB_DIRECT_ALIGN;
+		if (end <= _begin) return;
+
+		// Pages completely inside the data: [first, end_page)
+		size_t first = std::min(end, _begin + (MTB_DIRECT_ALIGN - _begin % MTB_DIRECT_ALIGN) % MTB_DIRECT_ALIGN);
+		size_t end_page = std::max(first, end - end % MTB_DIRECT_ALIGN);
+		const File &direct = _direct ? *_direct : _file;
+
+		if (_begin < first) _file.write_at(_buf.get() + _begin, first - _begin, _base + _begin);
+		if (first < end_page) direct.write_at(_buf.get() + first, end_page - first, _base + first);
+		if (end_page < end) _file.write_at(_buf.get() + end_page, end - end_page, _base + end_page);
+
+		// Keep the last partial page at the beginning of the buffer
+		std::memmove(_buf.get(), _buf.get() + end, _end - end);
+		_base += end;
+		_begin = 0;
+		_end -= end;
+	}
+
+	/*********************************************************************************************
+	 Asynchronous Reader
+	 *********************************************************************************************/
+
+	AsyncReader::AsyncReader(const File &file, uint64_t offset, uint64_t size, size_t block_size,
+	                         int nbuffers) :
+			_file(file), _offset(offset), _size(size), _block_size(block_size),
+			_nblocks((size + block_size - 1) / block_size), _produced(0), _consumed(0),
+			_stop(false)
+	{
+		nbuffers = std::max(nbuffers, 2);
+		for (int i = 0; i < nbuffers; ++i)
+			_buffers.emplace_back(new char[block_size]);
+
+		_thread = std::thread(&AsyncReader::run, this);
+	}
+
+	AsyncReader::~AsyncReader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+
+		_cond.notify_all();
+		_thread.join();
+	}
+
+	void AsyncReader::run()
+	{
+		for (uint64_t k = 0; k < _nblocks; ++k)
+		{
+			{
+				// The buffer of block k is free once the block k - nbuffers is released, i.e., when
+				// the caller asks for the block k - nbuffers + 1.
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cond.wait(lock, [&]()
+				{
+					return _stop || k < _buffers.size() || k + 2 <= _consumed + _buffers.size();
+				});
+				if (_stop) return;
+			}
+
+			uint64_t begin = k * _block_size;
+			size_t size = std::min<uint64_t>(_block_size, _size - begin);
+
+			try
+			{
+				_file.read_at(_buffers[k % _buffers.size()].get(), size, _offset + begin);
+
+			} catch (...)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_error = std::current_exception();
+				_cond.notify_all();
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				++_produced;
+			}
+
+			_cond.notify_all();
+		}
+	}
+
+	size_t AsyncReader::next(const char *&block)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		if (_consumed == _nblocks)
+		{
+			block = nullptr;
+			return 0;
+		}
+
+		// Release the previous block and wait for the next one
+		uint64_t k = _consumed++;
+		_cond.notify_all();
+		_cond.wait(lock, [&]() { return _error || _produced > k; });
+
+		if (_produced <= k) std::rethrow_exception(_error);
+
+		block = _buffers[k % _buffers.size()].get();
+		return std::min<uint64_t>(_block_size, _size - k * _block_size);
+	}
+
+	/*********************************************************************************************
+	 Asynchronous Writer
+	 *********************************************************************************************/
+
+	AsyncWriter::AsyncWriter(const File &file, uint64_t offset, size_t block_size, int nbuffers) :
+			_file(file), _offset(offset), _block_size(block_size), _submitted(0), _written(0),
+			_stop(false)
+	{
+		nbuffers = std::max(nbuffers, 2);
+		for (int i = 0; i < nbuffers; ++i)
+			_buffers.emplace_back(new char[block_size]);
+		_sizes.resize(nbuffers);
+
+		_thread = std::thread(&AsyncWriter::run, this);
+	}
+
+	AsyncWriter::~AsyncWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+
+		_cond.notify_all();
+		_thread.join();
+	}
+
+	void AsyncWriter::run()
+	{
+		while (true)
+		{
+			uint64_t k;
+			size_t size;
+
+			{
+				// Wait for the next block, or for the end of the writing
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cond.wait(lock, [&]() { return _stop || _submitted > _written; });
+				if (_submitted == _written) return;
+
+				k = _written;
+				size = _sizes[k % _buffers.size()];
+			}
+
+			try
+			{
+				_file.write_at(_buffers[k % _buffers.size()].get(), size, _offset);
+				_offset += size;
+
+			} catch (...)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_error = std::current_exception();
+				_cond.notify_all();
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				++_written;
+			}
+
+			_cond.notify_all();
+		}
+	}
+
+	char *AsyncWriter::acquire()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cond.wait(lock, [&]() { return _error || _submitted < _written + _buffers.size(); });
+
+		if (_error) std::rethrow_exception(_error);
+		return _buffers[_submitted % _buffers.size()].get();
+	}
+
+	void AsyncWriter::submit(size_t size)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_sizes[_submitted % _buffers.size()] = size;
+			++_submitted;
+		}
+
+		_cond.notify_all();
+	}
+
+	void AsyncWriter::finish()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cond.wait(lock, [&]() { return _error || _written == _submitted; });
+
+		if (_error) std::rethrow_exception(_error);
+	}
+
+}   // namespace mtb
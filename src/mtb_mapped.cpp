@@ -0,0 +1,141 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_mapped.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 Memory-mapped MTB File
+	 *********************************************************************************************/
+
+	static int to_madvise(MappedMatrix::Access access)
+	{
+		switch (access)
+		{
+			case MappedMatrix::kSequential: return MADV_SEQUENTIAL;
+			case MappedMatrix::kRandom: return MADV_RANDOM;
+			case MappedMatrix::kWillNeed: return MADV_WILLNEED;
+			default: return MADV_NORMAL;
+		}
+	}
+
+	MappedMatrix::MappedMatrix(const std::string &filename, Access access) :
+			_map(nullptr), _map_size(0), _data(nullptr), _entry_size(0), _header()
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("Error: Cannot read from MTB file!");
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw std::runtime_error("Error: Cannot read from MTB file!");
+		}
+
+		if ((uint64_t) st.st_size < MTB_HEADER_SIZE)
+		{
+			close(fd);
+			throw std::runtime_error("Error: Invalid MTB header!");
+		}
+
+		_map_size = st.st_size;
+		void *map = mmap(nullptr, _map_size, PROT_READ, MAP_SHARED, fd, 0);
+
+		// The mapping keeps its own reference to the file
+		close(fd);
+
+		if (map == MAP_FAILED) throw std::runtime_error("Error: Cannot map the MTB file!");
+		_map = (char *) map;
+
+		try
+		{
+			if ((_map[0] & kExtendedHeader) && _map_size < MTB_MAX_HEADER_SIZE)
+				throw std::runtime_error("Error: Invalid MTB header!");
+
+			mtb_parse_header(_map, _header);
+			mtb_check_header(_header);
+
+			// The entries can only be accessed directly if they have a fixed size
+			if (_header.encoding != kPlainEncoding)
+				throw std::runtime_error("Error: Unsupported MTB encoding for memory mapping!");
+
+			uint64_t header_size = mtb_header_size(_header);
+			_entry_size = mtb_entry_size(_header);
+			_data = _map + header_size;
+
+			if (_header.nz > (_map_size - header_size) / _entry_size)
+				throw std::runtime_error("Error: Truncated MTB file!");
+
+		} catch (...)
+		{
+			unmap();
+			throw;
+		}
+
+		if (access != kNormal) advise(access);
+	}
+
+	MappedMatrix::~MappedMatrix()
+	{
+		unmap();
+	}
+
+	MappedMatrix::MappedMatrix(MappedMatrix &&other) noexcept :
+			_map(std::exchange(other._map, nullptr)), _map_size(std::exchange(other._map_size, 0)),
+			_data(std::exchange(other._data, nullptr)), _entry_size(other._entry_size),
+			_header(other._header)
+	{
+	}
+
+	MappedMatrix &MappedMatrix::operator=(MappedMatrix &&other) noexcept
+	{
+		if (this != &other)
+		{
+			unmap();
+			_map = std::exchange(other._map, nullptr);
+			_map_size = std::exchange(other._map_size, 0);
+			_data = std::exchange(other._data, nullptr);
+			_entry_size = other._entry_size;
+			_header = other._header;
+		}
+
+		return *this;
+	}
+
+	void MappedMatrix::advise(Access access, uint64_t begin, uint64_t end)
+	{
+		end = std::min(end, _header.nz);
+		if (!_map || begin >= end) return;
+
+		// madvise requires the address to be aligned with the page boundary
+		uint64_t page_size = sysconf(_SC_PAGESIZE);
+		uint64_t first = (_data - _map) + begin * _entry_size;
+		uint64_t last = (_data - _map) + end * _entry_size;
+		first -= first % page_size;
+
+		madvise(_map + first, last - first, to_madvise(access));
+	}
+
+	void MappedMatrix::unmap()
+	{
+		if (_map) munmap(_map, _map_size);
+		_map = nullptr;
+		_data = nullptr;
+		_map_size = 0;
+	}
+
+}   // namespace mtb
@@ -0,0 +1,157 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_partition.hpp"
+
+#include <fcntl.h>
+
+#include <stdexcept>
+
+#include "../include/mtb_io.hpp"
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 Row Partition
+	 *********************************************************************************************/
+
+	// Returns the first row `r` such that pos(r) >= target, where pos(r) is the number of
+	// entries before the row `r` (non-decreasing, pos(nrows) == nz).
+	template<typename Func>
+	static uint64_t lower_bound_row(uint64_t nrows, uint64_t target, Func &&pos)
+	{
+		uint64_t first = 0;
+		uint64_t last = nrows;
+
+		while (first < last)
+		{
+			uint64_t mid = first + (last - first) / 2;
+
+			if (pos(mid) < target) first = mid + 1;
+			else last = mid;
+		}
+
+		return first;
+	}
+
+	// Returns the range of rows of `rank`, where pos(r) is the number of entries before the row
+	// `r`. The boundaries are the first rows with at least `k * nz / nranks` entries before them.
+	template<typename Func>
+	static RowPartition partition_rows(uint64_t nrows, uint64_t nz, int rank, int nranks, bool is_indexed,
+	                                   Func &&pos)
+	{
+		if (nranks <= 0 || rank < 0 || rank >= nranks)
+			throw std::runtime_error("Error: Invalid rank!");
+
+		uint64_t targets[2] = {nz * rank / nranks, nz * (rank + 1) / nranks};
+		uint64_t bounds[2];
+
+		for (int i = 0; i < 2; ++i)
+			bounds[i] = lower_bound_row(nrows, targets[i], pos);
+
+		// The last rank always ends at the last row
+		if (rank == nranks - 1) bounds[1] = nrows;
+
+		return RowPartition{bounds[0], bounds[1], pos(bounds[1]) - pos(bounds[0]), is_indexed};
+	}
+
+	static void open_file(const std::string &filename, std::ifstream &ifile, MTBHeader &header)
+	{
+		ifile.open(filename, std::fstream::binary);
+		if (!ifile) throw std::runtime_error("Error: Cannot read from MTB file!");
+
+		mtb_read_header(ifile, header);
+		if (!ifile) throw std::runtime_error("Error: Invalid MTB header!");
+
+		mtb_check_header(header);
+	}
+
+	RowPartition mtb_partition_rows(const std::string &filename, int rank, int nranks)
+	{
+		if (nranks <= 0 || rank < 0 || rank >= nranks)
+			throw std::runtime_error("Error: Invalid rank!");
+
+		std::ifstream ifile;
+		MTBHeader header;
+
+		open_file(filename, ifile, header);
+
+		if (!(header.flags & kRowIndex))
+		{
+			ifile.close();
+			return mtb_partition_rows(mtb_count_rows(filename), rank, nranks);
+		}
+
+		File file(filename, O_RDONLY);
+		uint64_t index_offset = mtb_row_index_offset(header);
+
+		auto pos = [&](uint64_t row)
+		{
+			uint64_t val;
+			file.read_at(&val, sizeof(uint64_t), index_offset + row * sizeof(uint64_t));
+			return val;
+		};
+
+		return partition_rows(header.nrows, header.nz, rank, nranks, true, pos);
+	}
+
+	RowPartition mtb_partition_rows(const std::vector<uint64_t> &row_ptr, int rank, int nranks)
+	{
+		if (row_ptr.empty()) throw std::runtime_error("Error: Invalid row pointer!");
+
+		auto pos = [&](uint64_t row) { return row_ptr[row]; };
+
+		return partition_rows(row_ptr.size() - 1, row_ptr.back(), rank, nranks, false, pos);
+	}
+
+	std::vector<uint64_t> mtb_count_rows(const std::string &filename)
+	{
+		std::ifstream ifile;
+		MTBHeader header;
+
+		open_file(filename, ifile, header);
+
+		std::vector<uint64_t> row_ptr(header.nrows + 1, 0);
+
+		if (header.flags & kRowIndex)
+		{
+			File file(filename, O_RDONLY);
+			file.read_at(row_ptr.data(), row_ptr.size() * sizeof(uint64_t), mtb_row_index_offset(header));
+
+			return row_ptr;
+		}
+
+		// Count the number of entries of each row
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>(MTB_BUF_SIZE / 16, header.nz), 1);
+		std::unique_ptr<char[]> raw(new char[batch_size * entry_size]);
+		EntryReader reader(header);
+
+		for (uint64_t k = 0; k < header.nz; k += batch_size)
+		{
+			uint64_t size = std::min(batch_size, header.nz - k);
+			const char *entry = raw.get();
+
+			reader.read(ifile, raw.get(), size);
+
+			for (uint64_t i = 0; i < size; ++i, entry += entry_size)
+			{
+				uint64_t row;
+				std::memcpy(&row, entry, sizeof(uint64_t));
+
+				if (row >= header.nrows) throw std::runtime_error("Error: Invalid entry in MTB file!");
+				++row_ptr[row + 1];
+			}
+		}
+
+		for (uint64_t i = 0; i < header.nrows; ++i)
+			row_ptr[i + 1] += row_ptr[i];
+
+		return row_ptr;
+	}
+
+}   // namespace mtb
@@ -0,0 +1,61 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_reader.hpp"
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 MTB Streaming Reader
+	 *********************************************************************************************/
+
+	Reader::Reader(const std::string &filename, uint64_t buffer_size) :
+			_ifile(filename, std::fstream::binary), _raw_count(0), _raw_pos(0), _read(0),
+			_pending(false)
+	{
+		if (!_ifile) throw std::runtime_error("Error: Cannot read from MTB file!");
+
+		mtb_read_header(_ifile, _header);
+		if (!_ifile) throw std::runtime_error("Error: Invalid MTB header!");
+
+		mtb_check_header(_header);
+
+		_entries.reset(new EntryReader(_header));
+		_entry_size = mtb_entry_size(_header.datatype, _header.type_size);
+		_raw_capacity = std::max<uint64_t>(std::min(buffer_size, _header.nz), 1);
+		_raw.reset(new char[_raw_capacity * _entry_size]);
+	}
+
+	void Reader::rewind()
+	{
+		_ifile.clear();
+		_ifile.seekg(mtb_header_size(_header));
+		_entries->reset();
+
+		_raw_count = 0;
+		_raw_pos = 0;
+		_read = 0;
+		_pending = false;
+	}
+
+	bool Reader::fill()
+	{
+		if (_raw_pos < _raw_count) return true;
+		if (_read == _header.nz) return false;
+
+		uint64_t count = std::min(_raw_capacity, _header.nz - _read);
+
+		_entries->read(_ifile, _raw.get(), count);
+
+		_raw_count = count;
+		_raw_pos = 0;
+		_read += count;
+
+		return true;
+	}
+
+}   // namespace mtb
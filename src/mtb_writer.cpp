@@ -0,0 +1,88 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#include "../include/mtb_writer.hpp"
+
+namespace mtb
+{
+	/*********************************************************************************************
+	 MTB Streaming Writer
+	 *********************************************************************************************/
+
+	Writer::Writer(const std::string &filename, const MTBHeader &header, uint64_t buffer_size) :
+			_ofile(filename, std::fstream::binary), _header(header), _raw_count(0)
+	{
+		if (!_ofile) throw std::runtime_error("Error: Cannot write to MTB file!");
+
+		_header.nz = 0;
+		mtb_check_header(_header);
+
+		if (_header.encoding == kChunkedEncoding)
+			throw std::runtime_error("Error: The MTB writer does not support the chunked encoding!");
+		if (_header.flags & kRowIndex)
+			throw std::runtime_error("Error: The MTB writer does not support the row index!");
+
+		// The header is written again when the file is closed
+		mtb_write_header(_ofile, _header);
+
+		_entries.reset(new EntryWriter(_header));
+		_entry_size = mtb_entry_size(_header.datatype, _header.type_size);
+		_raw_capacity = std::max<uint64_t>(buffer_size, 1);
+		_raw.reset(new char[_raw_capacity * _entry_size]);
+	}
+
+	Writer::~Writer()
+	{
+		try
+		{
+			if (_entries) close();
+
+		} catch (...)
+		{
+		}
+	}
+
+	void Writer::flush()
+	{
+		if (!_entries) throw std::runtime_error("Error: MTB file is closed!");
+
+		try
+		{
+			_entries->write(_ofile, _raw.get(), _raw_count);
+			if (!_ofile) throw std::runtime_error("Error: Cannot write to MTB file!");
+
+		} catch (...)
+		{
+			// The buffer may have been partially converted, so the file cannot be completed
+			_entries.reset();
+			throw;
+		}
+
+		_header.nz += _raw_count;
+		_raw_count = 0;
+	}
+
+	void Writer::close()
+	{
+		flush();
+
+		// Any further write fails, since the buffer is always full
+		std::unique_ptr<EntryWriter> entries = std::move(_entries);
+		_raw.reset();
+		_raw_capacity = 0;
+
+		entries->set_nz(_header.nz);
+		entries->finish(_ofile);
+
+		_ofile.seekp(0);
+		mtb_write_header(_ofile, _header);
+		_ofile.close();
+
+		if (!_ofile) throw std::runtime_error("Error: Cannot write to MTB file!");
+	}
+
+}   // namespace mtb
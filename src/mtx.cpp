@@ -7,14 +7,24 @@
 
 #include "../include/mtx.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <charconv>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 #include <stdexcept>
 
 #include "../include/mtb.hpp"
+#include "../include/mtb_index.hpp"
+#include "../include/mtb_sort.hpp"
 
 
 namespace mtb
@@ -34,9 +44,10 @@ namespace mtb
 		// Read and parse the file header
 		std::getline(ifile, line);
 
+		// Tokens may be separated by several spaces or tabs, and the line may end with CRLF
 		std::stringstream ss(line);
 		properties.reserve(5);
-		while (std::getline(ss, token, ' '))
+		while (ss >> token)
 			properties.push_back(token);
 
 		if (properties.size() != 5)
@@ -55,30 +66,632 @@ namespace mtb
 		if (err != 3) throw std::runtime_error("Error: Wrong MTX format!");
 	}
 
+	/*********************************************************************************************
+	 Memory-Mapped MTX File
+	 *********************************************************************************************/
+
+	MTXMappedFile::MTXMappedFile(const std::string &filename, uint64_t offset) :
+			_map(nullptr), _size(0), _offset(0)
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("Error: Cannot read from MTX file!");
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw std::runtime_error("Error: Cannot read from MTX file!");
+		}
+
+		_size = st.st_size;
+		_offset = std::min<uint64_t>(offset, _size);
+
+		// An empty region cannot be mapped
+		if (_size == 0)
+		{
+			close(fd);
+			return;
+		}
+
+		void *map = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+
+		// The mapping keeps its own reference to the file
+		close(fd);
+
+		if (map == MAP_FAILED) throw std::runtime_error("Error: Cannot map the MTX file!");
+		_map = (char *) map;
+
+		madvise(_map, _size, MADV_SEQUENTIAL);
+	}
+
+	MTXMappedFile::~MTXMappedFile()
+	{
+		if (_map) munmap(_map, _size);
+	}
+
+	/*********************************************************************************************
+	 MTX to MTB Conversion
+	 *********************************************************************************************/
+
+	// Order of the entries in a sorted MTB file (row-major)
+	template<typename T>
+	static bool mtx_row_major(const Triplet<T> &a, const Triplet<T> &b)
+	{
+		return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+	}
+
+	// Removes the temporary files of the external sort when it finishes (or fails)
+	struct MTXTemporaryFiles
+	{
+		std::vector<std::string> names;
+
+		~MTXTemporaryFiles()
+		{
+			for (auto &name : names)
+				std::remove(name.c_str());
+		}
+	};
+
+	// Mixes the bits of a 64-bit word (finalizer of SplitMix64)
+	static inline uint64_t mtx_mix(uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+		return x ^ (x >> 31);
+	}
+
+	// Hash of an entry, which depends on the order of the indices and on the bits of the value
+	template<typename T>
+	static inline uint64_t mtx_entry_hash(uint64_t row, uint64_t col, const T &val, uint64_t seed)
+	{
+		uint64_t words[(sizeof(T) + 7) / 8] = {};
+		std::memcpy(words, &val, sizeof(T));
+
+		uint64_t hash = mtx_mix(mtx_mix(seed ^ row) ^ col);
+		for (uint64_t word : words)
+			hash = mtx_mix(hash ^ word);
+
+		return hash;
+	}
+
+	// Order-independent fingerprint of the entries and of the transposed entries (the sums of
+	// their hashes with two seeds). The matrix is symmetric if both sets of entries are equal,
+	// i.e., if the fingerprints match (except for a probability of about 2^-128). A repeated
+	// entry with a repeated mirror has matching fingerprints, so the repeated indices must be
+	// checked separately.
+	struct MTXSymmetryHash
+	{
+		static constexpr uint64_t kSeeds[2] = {0x243F6A8885A308D3, 0x13198A2E03707344};
+
+		uint64_t entries[2] = {0, 0};
+		uint64_t transposed[2] = {0, 0};
+		uint64_t nlower = 0;		// Number of entries at or below the diagonal
+
+		template<typename T>
+		void add(const Triplet<T> *data, uint64_t count)
+		{
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				for (int s = 0; s < 2; ++s)
+				{
+					entries[s] += mtx_entry_hash(data[i].row, data[i].col, data[i].val, kSeeds[s]);
+					transposed[s] += mtx_entry_hash(data[i].col, data[i].row, data[i].val, kSeeds[s]);
+				}
+
+				nlower += (data[i].col <= data[i].row);
+			}
+		}
+
+		bool is_symmetric() const
+		{
+			return entries[0] == transposed[0] && entries[1] == transposed[1];
+		}
+	};
+
+	// Checks if the entries sorted in a row-major order are symmetric: each entry above the
+	// diagonal must have a mirror below the diagonal with the same value (bitwise), and the
+	// indices cannot be repeated.
+	template<typename T>
+	static bool mtx_is_symmetric(const Triplet<T> *data, uint64_t count, uint64_t nrows,
+	                             int nthreads)
+	{
+		// Position of the first entry of each row
+		std::vector<uint64_t> row_ptr(nrows + 1, 0);
+		for (uint64_t i = 0; i < count; ++i)
+			++row_ptr[data[i].row + 1];
+		for (uint64_t r = 0; r < nrows; ++r)
+			row_ptr[r + 1] += row_ptr[r];
+
+		nthreads = std::max<int>(std::min<uint64_t>(mtb_num_threads(nthreads), count), 1);
+		std::vector<int64_t> balance(nthreads, 0);
+		std::vector<char> is_symmetric(nthreads, true);
+
+		mtb_parallel_for(count, nthreads, [&](int t, uint64_t begin, uint64_t end)
+		{
+			for (uint64_t i = begin; i < end && is_symmetric[t]; ++i)
+			{
+				const Triplet<T> &entry = data[i];
+
+				if (i > 0 && entry.row == data[i - 1].row && entry.col == data[i - 1].col)
+				{
+					is_symmetric[t] = false;
+
+				} else if (entry.col < entry.row)
+				{
+					++balance[t];
+
+				} else if (entry.col > entry.row)
+				{
+					--balance[t];
+
+					// Look for the mirror in the row of the column index
+					const Triplet<T> *first = data + row_ptr[entry.col];
+					const Triplet<T> *last = data + row_ptr[entry.col + 1];
+					const Triplet<T> *mirror = std::lower_bound(first, last, entry.row,
+					                                            [](const Triplet<T> &a, std::ptrdiff_t col)
+					                                            {
+						                                            return a.col < col;
+					                                            });
+
+					is_symmetric[t] = (mirror != last && mirror->col == entry.row
+					                   && std::memcmp(&mirror->val, &entry.val, sizeof(T)) == 0);
+				}
+			}
+		});
+
+		// Every entry above the diagonal has a distinct mirror, so the matrix is symmetric if
+		// there are no other entries below the diagonal
+		int64_t total = 0;
+		for (int t = 0; t < nthreads; ++t)
+		{
+			if (!is_symmetric[t]) return false;
+			total += balance[t];
+		}
+
+		return total == 0;
+	}
+
+	// Key of the indices of an entry: exact if the indices fit (`nrows * ncols < 2^64`), and
+	// otherwise a hash, whose collisions only store a symmetric matrix as general
+	static inline uint64_t mtx_index_key(uint64_t row, uint64_t col, uint64_t ncols)
+	{
+		return (ncols >> 32) ? mtx_mix(mtx_mix(row) ^ col) : row * ncols + col;
+	}
+
+	// Checks if the keys of the indices (see @ref mtx_index_key) have repeated values. The keys
+	// are sorted in place.
+	static bool mtx_has_repeated_indices(std::vector<uint64_t> &keys)
+	{
+		std::sort(keys.begin(), keys.end());
+		return std::adjacent_find(keys.begin(), keys.end()) != keys.end();
+	}
+
+	// Changes a general matrix to a symmetric matrix with `nz` entries (the lower triangle) and
+	// writes the header again. The stream must be positioned after the header.
+	static void mtx_set_symmetric(std::ofstream &ofile, MTBHeader &header, uint64_t nz)
+	{
+		header.mat_type = kSymmetricSparse;
+		header.nz = nz;
+
+		ofile.seekp(0);
+		mtb_write_header(ofile, header);
+
+		std::cerr << "Storing the symmetric matrix as its lower triangle" << std::endl;
+	}
+
+	// Changes the value size to the smallest lossless size of the entries and writes the header
+	// again. The stream must be positioned after the header.
+	static void mtx_set_type_size(std::ofstream &ofile, MTBHeader &header, char type_size)
+	{
+		if (type_size == header.type_size) return;
+
+		header.type_size = type_size;
+
+		ofile.seekp(0);
+		mtb_write_header(ofile, header);
+
+		std::cerr << "Storing the values with " << (int) type_size << " bytes" << std::endl;
+	}
+
+	// Checks if symmetry detection applies to the matrix
+	static bool mtx_detect_symmetry(const MTBHeader &header, const MTXConvertOptions &options)
+	{
+		return options.detect_symmetry && header.mat_type == kGeneralSparse
+		       && header.nrows == header.ncols;
+	}
+
 	template<typename T>
-	void mtx_sorted_data(std::string mtx_file, std::ifstream &ifile, std::ofstream &ofile,
-	                     uint64_t nz, char &mat_type, char &datatype, char &type_size)
+	void mtx_external_sorted_data(std::string mtb_file, const MTXMappedFile &input,
+	                              std::ofstream &ofile, MTBHeader &header,
+	                              const MTXConvertOptions &options)
 	{
+		// The radix sort requires a scratch array with the same size as the run
+		uint64_t run_capacity = std::max<uint64_t>(options.memory_budget / (2 * sizeof(Triplet<T>)),
+		                                           MTX_MIN_RUN_SIZE);
+		std::vector<Triplet<T>> run;
+		std::vector<uint64_t> run_sizes;
+		MTXTemporaryFiles runs;
+
+		bool is_weighted = (header.datatype != kPattern);
+
+		// Sorts the entries in memory and writes them to a new temporary file
+		auto spill = [&]()
+		{
+			mtb_sort_triplets(run.data(), run.size(), header.nrows, header.ncols, false,
+			                  options.nthreads);
+
+			runs.names.push_back(mtb_file + ".run" + std::to_string(runs.names.size()));
+			std::ofstream out(runs.names.back(), std::fstream::binary);
+
+			out.write((const char *) run.data(), run.size() * sizeof(Triplet<T>));
+			if (!out) throw std::runtime_error("Error: Cannot write temporary file!");
+
+			run_sizes.push_back(run.size());
+			run.clear();
+		};
+
+		// First pass: split the entries in sorted runs that fit in the memory budget
+		bool detect_symmetry = mtx_detect_symmetry(header, options);
+		MTXSymmetryHash symmetry;
+		char type_size = mtb_min_type_size<T>(nullptr, 0, header.datatype);
+
+		run.reserve(std::min(run_capacity, header.nz));
+
+		mtx_parse_parallel<T>(input, header.nz, is_weighted, nullptr, options.nthreads,
+		                      [&](const Triplet<T> *entries, uint64_t, uint64_t count)
+		                      {
+			                      if (detect_symmetry) symmetry.add(entries, count);
+			                      if (options.narrow_values)
+				                      type_size = std::max(type_size, mtb_min_type_size(entries, count,
+				                                                                        header.datatype));
+
+			                      while (count > 0)
+			                      {
+				                      uint64_t size = std::min(count, run_capacity - run.size());
+
+				                      run.insert(run.end(), entries, entries + size);
+				                      if (run.size() == run_capacity) spill();
+
+				                      entries += size;
+				                      count -= size;
+			                      }
+		                      });
+
+		if (!run.empty()) spill();
+		run.clear();
+		run.shrink_to_fit();
+
+		uint64_t nz = 0;
+		for (uint64_t size : run_sizes)
+			nz += size;
+
+		if (nz != header.nz) throw std::runtime_error("Error: Wrong number of entries in MTX file!");
+
+		uint64_t general_nz = nz;		// Number of entries of the general matrix
+
+		// Only the lower triangle of a symmetric matrix is merged
+		bool is_symmetric = detect_symmetry && symmetry.is_symmetric();
+		if (is_symmetric) mtx_set_symmetric(ofile, header, nz = symmetry.nlower);
+		if (options.narrow_values) mtx_set_type_size(ofile, header, type_size);
+
+		// Second pass: k-way merge of the runs. The memory budget is split evenly between
+		// the input buffers of the runs and the output buffer.
+		uint64_t nruns = runs.names.size();
+		uint64_t buffer_size = std::max<uint64_t>(run_capacity / (nruns + 1), MTX_MIN_MERGE_SIZE);
+
+		std::cerr << "Merging " << nruns << " sorted runs... ";
+
+		struct RunReader
+		{
+			std::ifstream in;
+			std::vector<Triplet<T>> buffer;
+			uint64_t pos, size, remaining;
+		};
+
+		// Merges the runs into the MTB file (the stream must be positioned after the header).
+		// Returns false if a symmetric matrix has repeated indices, which the fingerprints do
+		// not detect, as soon as they are merged.
+		auto merge = [&]()
+		{
+			std::vector<RunReader> readers(nruns);
+
+			// Loads the next entries of a run and returns false if it is exhausted
+			auto refill = [&](RunReader &reader)
+			{
+				reader.size = std::min<uint64_t>(reader.buffer.size(), reader.remaining);
+				reader.pos = 0;
+
+				reader.in.read((char *) reader.buffer.data(), reader.size * sizeof(Triplet<T>));
+				if (!reader.in) throw std::runtime_error("Error: Cannot read temporary file!");
+
+				reader.remaining -= reader.size;
+				return reader.size > 0;
+			};
+
+			// Min-heap with the run of the next entry of each run
+			auto greater = [&](uint64_t a, uint64_t b)
+			{
+				return mtx_row_major(readers[b].buffer[readers[b].pos], readers[a].buffer[readers[a].pos]);
+			};
+			std::vector<uint64_t> heap;
+
+			for (uint64_t r = 0; r < nruns; ++r)
+			{
+				readers[r].in.open(runs.names[r], std::fstream::binary);
+				readers[r].buffer.resize(std::min(buffer_size, run_sizes[r]));
+				readers[r].remaining = run_sizes[r];
+
+				if (refill(readers[r])) heap.push_back(r);
+			}
+
+			std::make_heap(heap.begin(), heap.end(), greater);
+
+			// The row index is written directly at its position, while the entries are merged
+			bool has_index = (header.flags & kRowIndex);
+			std::unique_ptr<File> index_file(has_index ? new File(mtb_file, O_WRONLY) : nullptr);
+			uint64_t index_offset = mtb_row_index_offset(header);
+			std::vector<uint64_t> index;
+			uint64_t index_row = 0;
+
+			auto push_index = [&](uint64_t pos)
+			{
+				index.push_back(pos);
+
+				if (index.size() == MTB_BUF_SIZE / 64 || index_row + index.size() == header.nrows + 1)
+				{
+					index_file->write_at(index.data(), index.size() * sizeof(uint64_t),
+					                     index_offset + index_row * sizeof(uint64_t));
+					index_row += index.size();
+					index.clear();
+				}
+			};
+
+			uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+			std::vector<Triplet<T>> output;
+			std::unique_ptr<char[]> raw(new char[buffer_size * entry_size]);
+			EntryWriter writer(header);
+			uint64_t written = 0;
+
+			output.reserve(buffer_size);
+
+			auto flush = [&]()
+			{
+				mtb_encode_entries(output.data(), output.size(), raw.get(), header.datatype,
+				                   header.type_size);
+				writer.write(ofile, raw.get(), output.size());
+
+				written += output.size();
+				output.clear();
+			};
+
+			// Indices of the previous entry (the repeated indices are adjacent in the merge)
+			std::ptrdiff_t prev_row = -1, prev_col = -1;
+
+			while (!heap.empty())
+			{
+				std::pop_heap(heap.begin(), heap.end(), greater);
+				RunReader &reader = readers[heap.back()];
+				const Triplet<T> &entry = reader.buffer[reader.pos];
+
+				if (is_symmetric && entry.row == prev_row && entry.col == prev_col) return false;
+				prev_row = entry.row;
+				prev_col = entry.col;
+
+				if (!is_symmetric || entry.col <= entry.row)
+				{
+					if (has_index)
+						for (uint64_t row = index_row + index.size(); row <= (uint64_t) entry.row; ++row)
+							push_index(written + output.size());
+
+					output.push_back(entry);
+					if (output.size() == buffer_size) flush();
+				}
+
+				if (++reader.pos < reader.size || refill(reader))
+					std::push_heap(heap.begin(), heap.end(), greater);
+				else
+					heap.pop_back();
+			}
+
+			flush();
+			writer.finish(ofile);
+
+			if (has_index)
+				while (index_row + index.size() <= header.nrows)
+					push_index(nz);
+
+			return true;
+		};
+
+		if (!merge())
+		{
+			// Store the general matrix instead: the file is truncated after the header, since
+			// the entries may be compressed to fewer bytes than the ones already written
+			is_symmetric = false;
+			header.mat_type = kGeneralSparse;
+			header.nz = nz = general_nz;
+
+			ofile.seekp(0);
+			mtb_write_header(ofile, header);
+			ofile.flush();
+
+			if (!ofile || truncate(mtb_file.c_str(), ofile.tellp()) != 0)
+				throw std::runtime_error("Error: Cannot write MTB file!");
+
+			std::cerr << "Repeated indices, storing the general matrix... ";
+			merge();
+		}
+
+		std::cerr << "Done" << std::endl;
+	}
+
+	template<typename T>
+	void mtx_sorted_data(std::string mtb_file, const MTXMappedFile &input, std::ofstream &ofile,
+	                     MTBHeader &header, const MTXConvertOptions &options)
+	{
+		// Use an external sort if the entries (and the scratch array of the radix sort) do not
+		// fit in the memory budget
+		if (options.memory_budget > 0 && 2 * header.nz * sizeof(Triplet<T>) > options.memory_budget)
+		{
+			mtx_external_sorted_data<T>(mtb_file, input, ofile, header, options);
+			return;
+		}
+
+		uint64_t nz = header.nz;
 		auto tmp_array = std::make_unique<Triplet<T>[]>(nz);
 		uint64_t size = 0;
 
-		bool is_weighted = (datatype != kPattern);
+		bool is_weighted = (header.datatype != kPattern);
+
+		mtx_read_data(input, tmp_array.get(), &size, nz, is_weighted, false, options.nthreads);
 
-		mtx_read_data(ifile, tmp_array.get(), &size, nz, is_weighted, false);
+		if (size != nz) throw std::runtime_error("Error: Wrong number of entries in MTX file!");
 
 		std::cerr << "Sorting Data... ";
-		std::sort(tmp_array.get(), tmp_array.get() + size, [](auto a, auto b){
-			return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
-		});
+		mtb_sort_triplets(tmp_array.get(), size, header.nrows, header.ncols, false, options.nthreads);
 		std::cerr << "Done" << std::endl;
 
+		if (mtx_detect_symmetry(header, options)
+		    && mtx_is_symmetric(tmp_array.get(), size, header.nrows, options.nthreads))
+		{
+			// Keep the lower triangle (still sorted)
+			Triplet<T> *end = std::remove_if(tmp_array.get(), tmp_array.get() + size,
+			                                 [](const Triplet<T> &entry) { return entry.col > entry.row; });
+			mtx_set_symmetric(ofile, header, nz = end - tmp_array.get());
+		}
+
+		if (options.narrow_values)
+		{
+			int nthreads = mtb_num_threads(options.nthreads);
+			std::vector<char> type_sizes(nthreads);
+
+			mtb_parallel_for(nz, nthreads, [&](int t, uint64_t begin, uint64_t end)
+			{
+				type_sizes[t] = mtb_min_type_size(tmp_array.get() + begin, end - begin, header.datatype);
+			});
+
+			mtx_set_type_size(ofile, header, *std::max_element(type_sizes.begin(), type_sizes.end()));
+		}
+
 		std::cerr << "Writing data to MTB... ";
-		mtb_write_data(ofile, tmp_array.get(), nz, mat_type, datatype, type_size);
+		mtb_write_data(ofile, tmp_array.get(), header);
 		std::cerr << "Done" << std::endl;
+
+		if (header.flags & kRowIndex)
+		{
+			std::cerr << "Writing row index to MTB... ";
+			mtb_write_row_index(ofile, tmp_array.get(), nz, header.nrows);
+			std::cerr << "Done" << std::endl;
+		}
+	}
+
+	template<typename T>
+	void mtx_unsorted_data(const MTXMappedFile &input, std::ofstream &ofile, MTBHeader &header,
+	                       const MTXConvertOptions &options)
+	{
+		bool is_weighted = (header.datatype != kPattern);
+		bool is_symmetric = false;
+		uint64_t nz = header.nz;		// Number of entries in the MTX file
+
+		// The entries are parsed twice: first to check the symmetry and the value size, and then
+		// to write them. The keys of the indices are kept to find repeated indices.
+		bool detect_symmetry = mtx_detect_symmetry(header, options);
+
+		if (detect_symmetry || options.narrow_values)
+		{
+			MTXSymmetryHash symmetry;
+			std::vector<uint64_t> keys;
+			char type_size = mtb_min_type_size<T>(nullptr, 0, header.datatype);
+
+			if (detect_symmetry) keys.reserve(nz);
+
+			mtx_parse_parallel<T>(input, nz, is_weighted, nullptr, options.nthreads,
+			                      [&](const Triplet<T> *entries, uint64_t, uint64_t count)
+			                      {
+				                      if (detect_symmetry)
+				                      {
+					                      symmetry.add(entries, count);
+
+					                      for (uint64_t i = 0; i < count; ++i)
+						                      keys.push_back(mtx_index_key(entries[i].row, entries[i].col, header.ncols));
+				                      }
+
+				                      if (options.narrow_values)
+					                      type_size = std::max(type_size, mtb_min_type_size(entries, count,
+					                                                                        header.datatype));
+			                      });
+
+			is_symmetric = detect_symmetry && symmetry.is_symmetric() && !mtx_has_repeated_indices(keys);
+			if (is_symmetric) mtx_set_symmetric(ofile, header, symmetry.nlower);
+			if (options.narrow_values) mtx_set_type_size(ofile, header, type_size);
+		}
+
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = MTB_BUF_SIZE / 16;
+		std::unique_ptr<char[]> output(new char[batch_size * entry_size]);
+		std::vector<Triplet<T>> lower;
+		EntryWriter writer(header);
+		uint64_t nread = 0;
+
+		// The entries of each block are encoded and written in file order while the next
+		// blocks are read and parsed
+		mtx_parse_parallel<T>(input, nz, is_weighted, nullptr, options.nthreads,
+		                      [&](const Triplet<T> *entries, uint64_t first, uint64_t count)
+		                      {
+			                      nread = first + count;
+			                      if (nread > nz) throw std::runtime_error("Error: Wrong number of entries in MTX file!");
+
+			                      if (is_symmetric)
+			                      {
+				                      lower.clear();
+				                      std::copy_if(entries, entries + count, std::back_inserter(lower),
+				                                   [](const Triplet<T> &entry) { return entry.col <= entry.row; });
+
+				                      entries = lower.data();
+				                      count = lower.size();
+			                      }
+
+			                      for (uint64_t k = 0; k < count; k += batch_size)
+			                      {
+				                      uint64_t size = std::min(batch_size, count - k);
+
+				                      mtb_encode_entries(entries + k, size, output.get(),
+				                                         header.datatype, header.type_size);
+				                      writer.write(ofile, output.get(), size);
+			                      }
+		                      });
+
+		if (nread != nz)
+			throw std::runtime_error("Error: Wrong number of entries in MTX file!");
+
+		writer.finish(ofile);
 	}
 
 	void mtx_to_mtb(std::string mtx_file, std::string mtb_file, bool sort_data = true)
 	{
+		MTXConvertOptions options;
+		options.sort_data = sort_data;
+
+		mtx_to_mtb(mtx_file, mtb_file, options);
+	}
+
+	void mtx_to_mtb(std::string mtx_file, std::string mtb_file, const MTXConvertOptions &options)
+	{
+		bool sort_data = options.sort_data;
+
+		if (options.delta_encoding && !sort_data)
+			throw std::runtime_error("Error: The delta encoding requires sorted data!");
+
+		if (options.delta_encoding && options.compression)
+			throw std::runtime_error("Error: The delta encoding cannot be compressed!");
+
+		if (options.row_index && (!sort_data || options.delta_encoding || options.compression))
+			throw std::runtime_error("Error: The row index requires sorted data with the plain encoding!");
+
+		if (options.index_size != 0 && options.index_size != 1 && options.index_size != 2
+		    && options.index_size != 4 && options.index_size != 8)
+			throw std::runtime_error("Error: Invalid MTB index size!");
+
 		std::ifstream ifile(mtx_file, std::fstream::in);
 		std::ofstream ofile(mtb_file, std::fstream::binary);
 		std::vector<std::string> properties;
@@ -91,6 +704,10 @@ namespace mtb
 			mtx_read_header(ifile, properties, nrows, ncols, nonzeros);
 			std::cerr << "Done" << std::endl;
 
+			// The entries are parsed in place from a mapping of the file
+			MTXMappedFile input(mtx_file, ifile.tellg());
+			ifile.close();
+
 			// Verify the properties of the matrix
 			char mat_type, datatype, type_size;
 
@@ -111,7 +728,13 @@ namespace mtb
 			if (ofile) // Check if the file is open
 			{
 				std::cerr << "Writing MTB header... ";
-				mtb_write_header(ofile, mat_type, datatype, type_size, nrows, ncols, nonzeros);
+				MTBHeader header = {mat_type, datatype, type_size, nrows, ncols, nonzeros};
+				header.index_size = options.index_size ? options.index_size : mtb_min_index_size(nrows, ncols);
+				header.encoding = options.delta_encoding ? kDeltaEncoding : kPlainEncoding;
+				if (options.compression) header.encoding = kChunkedEncoding;
+				if (options.row_index) header.flags = kRowIndex;
+				if (options.checksum) header.flags |= kChecksum;
+				mtb_write_header(ofile, header);
 				std::cerr << "Done" << std::endl;
 
 				if (sort_data)
@@ -119,104 +742,42 @@ namespace mtb
 					switch (datatype)
                     {
 	                    case kPattern:
-	                    	mtx_sorted_data<int>(mtx_file, ifile, ofile, nonzeros, mat_type, datatype, type_size);
+	                    	mtx_sorted_data<int>(mtb_file, input, ofile, header, options);
 	                    break;
 
 	                    case kInteger:
-	                    	mtx_sorted_data<int>(mtx_file, ifile, ofile, nonzeros, mat_type, datatype, type_size);
+	                    	mtx_sorted_data<int>(mtb_file, input, ofile, header, options);
 	                    break;
 
 	                    case kReal:
-	                    	mtx_sorted_data<double>(mtx_file, ifile, ofile, nonzeros, mat_type, datatype, type_size);
+	                    	mtx_sorted_data<double>(mtb_file, input, ofile, header, options);
 	                    break;
 
 	                    case kComplex:
-	                    	mtx_sorted_data<std::complex<double>>(mtx_file, ifile, ofile, nonzeros, mat_type, datatype, type_size);
+	                    	mtx_sorted_data<std::complex<double>>(mtb_file, input, ofile, header, options);
 	                    break;
                     }
 
                 } else // Do not sort the data.
                 {
-    				// Read buffer
-    				std::unique_ptr<char[]> input(new char[MTB_BUF_SIZE + 1]);
-
-                	// Write Buffer
-    				int triplet_size = 2 * sizeof(uint64_t) + type_size;
-    				std::unique_ptr<char[]> output(new char[MTB_BUF_SIZE * triplet_size]);
-
-    				// Progress bar
-    				ProgressBar bar(60);
-    				bar.init("Converting MTX to MTB...");
-
-    				while (ifile)
-    				{
-    					uint64_t output_size = 0;
-    					char *ptr = input.get();
-
-    					// Read a large data block from the file
-    					ifile.read(ptr, MTB_BUF_SIZE);
-
-    					if (ifile.gcount() > 0)
-    					{
-    						char *input_end = ptr + ifile.gcount();
-    						*input_end = '\0';
-
-    						// Find the end of the last complete line
-    						char *last = std::strrchr(ptr, '\n');
-
-    						if (last)
-    						{
-    							// If the last line is truncated, rewind file pointer
-    							// to the beggining of this line, so it can be read again
-    							// in the next block.
-    							ifile.seekg(last - input_end, ifile.cur);
-    							std::fill(last + 1, input_end, '\0');
-
-    							// Parse each line into triplets and then place them in the write buffer.
-    							// TODO: Replace strtol and strtod with std::from_char for better performance
-    							while (ptr < last)
-    							{
-    								uint64_t coord[2];
-    								coord[0] = strtol(ptr, &ptr, 10) - 1;
-    								coord[1] = strtol(++ptr, &ptr, 10) - 1;
-
-    								std::memcpy(output.get() + output_size, &coord, 2 * sizeof(uint64_t));
-    								output_size += 2 * sizeof(uint64_t);
-
-    								if (datatype == kReal)
-    								{
-    									double val = strtod(++ptr, &ptr);
-    									std::memcpy(output.get() + output_size, &val, type_size);
-    									output_size += type_size;
-
-    								} else if (datatype == kComplex)
-    								{
-    									double real = strtod(++ptr, &ptr);
-    									std::memcpy(output.get() + output_size, &real, type_size);
-    									output_size += type_size;
-
-    									double imag = strtod(++ptr, &ptr);
-    									std::memcpy(output.get() + output_size, &imag, type_size);
-    									output_size += type_size;
-
-    								} else if (datatype == kInteger)
-    								{
-    									int val = strtol(++ptr, &ptr, 10);
-    									std::memcpy(output.get() + output_size, &val, type_size);
-    									output_size += type_size;
-    								}
-
-    								++ptr;
-    							}
-
-    							// Write the content of the buffer to the MTB file
-    							if (output_size > 0) ofile.write(output.get(), output_size);
-    							bar.update(output_size, nonzeros * triplet_size);
-    						}
-    					}
-    				}
-
-    				bar.finish();
+					switch (datatype)
+                    {
+	                    case kPattern:
+	                    	mtx_unsorted_data<int>(input, ofile, header, options);
+	                    break;
+
+	                    case kInteger:
+	                    	mtx_unsorted_data<int>(input, ofile, header, options);
+	                    break;
+
+	                    case kReal:
+	                    	mtx_unsorted_data<double>(input, ofile, header, options);
+	                    break;
+
+	                    case kComplex:
+	                    	mtx_unsorted_data<std::complex<double>>(input, ofile, header, options);
+	                    break;
+                    }
                 }
 			} else
 			{
@@ -229,5 +790,170 @@ namespace mtb
 		}
 	}
 
+	/*********************************************************************************************
+	 MTB to MTX Conversion
+	 *********************************************************************************************/
+
+	// Formats a real number with the shortest representation that is read back to the same number
+	static char *mtx_format_real(char *out, const char *ptr, char type_size)
+	{
+		if (type_size == sizeof(float))
+		{
+			// The MTX parser reads doubles, so a float is formatted as the same double (the
+			// shortest float representation, e.g., 0.1, is not read back to the same value)
+			float val;
+			std::memcpy(&val, ptr, sizeof(float));
+			return std::to_chars(out, out + MTX_MAX_LINE_SIZE, (double) val).ptr;
+		}
+
+		double val;
+		std::memcpy(&val, ptr, sizeof(double));
+		return std::to_chars(out, out + MTX_MAX_LINE_SIZE, val).ptr;
+	}
+
+	// Formats `count` entries (MTB v1 layout) as MTX lines with one-based indices. Each line has
+	// at most MTX_MAX_LINE_SIZE characters. Returns the end of the text.
+	static char *mtx_format_entries(const char *raw, uint64_t count, const MTBHeader &header,
+	                                char *out)
+	{
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+
+		for (uint64_t i = 0; i < count; ++i, raw += entry_size)
+		{
+			uint64_t row, col;
+			std::memcpy(&row, raw, sizeof(uint64_t));
+			std::memcpy(&col, raw + sizeof(uint64_t), sizeof(uint64_t));
+			const char *val = raw + 2 * sizeof(uint64_t);
+
+			out = std::to_chars(out, out + MTX_MAX_LINE_SIZE, row + 1).ptr;
+			*out++ = ' ';
+			out = std::to_chars(out, out + MTX_MAX_LINE_SIZE, col + 1).ptr;
+
+			switch (header.datatype)
+			{
+				case kInteger:
+					*out++ = ' ';
+					out = std::to_chars(out, out + MTX_MAX_LINE_SIZE,
+					                    mtb_decode_value<int64_t>(val, kInteger, header.type_size)).ptr;
+				break;
+
+				case kReal:
+					*out++ = ' ';
+					out = mtx_format_real(out, val, header.type_size);
+				break;
+
+				case kComplex:
+					*out++ = ' ';
+					out = mtx_format_real(out, val, header.type_size);
+					*out++ = ' ';
+					out = mtx_format_real(out, val + header.type_size, header.type_size);
+				break;
+			}
+
+			*out++ = '\n';
+		}
+
+		return out;
+	}
+
+	void mtb_to_mtx(std::string mtb_file, std::string mtx_file, int nthreads)
+	{
+		std::ifstream ifile(mtb_file, std::fstream::binary);
+		if (!ifile) throw std::runtime_error("Error: Cannot read from MTB file!");
+
+		MTBHeader header;
+		mtb_read_header(ifile, header);
+		if (!ifile) throw std::runtime_error("Error: Invalid MTB header!");
+		mtb_check_header(header);
+
+		std::ofstream ofile(mtx_file, std::fstream::binary);
+		if (!ofile) throw std::runtime_error("Error: Cannot write to MTX file!");
+
+		const char *datatype = "pattern";
+		if (header.datatype == kInteger) datatype = "integer";
+		else if (header.datatype == kReal) datatype = "real";
+		else if (header.datatype == kComplex) datatype = "complex";
+
+		ofile << "%%MatrixMarket matrix coordinate " << datatype << " "
+		      << (header.mat_type == kSymmetricSparse ? "symmetric" : "general") << "\n";
+		ofile << header.nrows << " " << header.ncols << " " << header.nz << "\n";
+
+		nthreads = mtb_num_threads(nthreads);
+
+		uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+		uint64_t batch_size = std::max<uint64_t>(std::min<uint64_t>((uint64_t) nthreads * MTX_FORMAT_SIZE,
+		                                                            header.nz), 1);
+		std::unique_ptr<char[]> raw[2] = {std::unique_ptr<char[]>(new char[batch_size * entry_size]),
+		                                  std::unique_ptr<char[]>(new char[batch_size * entry_size])};
+
+		// Text of the chunk formatted by each thread
+		uint64_t chunk_size = batch_size / nthreads + 1;
+		std::vector<std::unique_ptr<char[]>> text(nthreads);
+		std::vector<uint64_t> text_sizes(nthreads);
+
+		for (auto &buf : text)
+			buf.reset(new char[chunk_size * MTX_MAX_LINE_SIZE]);
+
+		EntryReader reader(header);
+
+		ProgressBar bar(60);
+		bar.init("Exporting data to MTX...");
+
+		uint64_t size = std::min(batch_size, header.nz);
+		reader.read(ifile, raw[0].get(), size);
+
+		for (uint64_t k = 0, current = 0; size > 0; current = !current)
+		{
+			// Read the next batch in the background
+			uint64_t next_size = std::min(batch_size, header.nz - k - size);
+			std::exception_ptr error;
+			std::thread background([&]()
+			{
+				try
+				{
+					if (next_size > 0) reader.read(ifile, raw[!current].get(), next_size);
+
+				} catch (...)
+				{
+					error = std::current_exception();
+				}
+			});
+
+			try
+			{
+				const char *batch = raw[current].get();
+
+				mtb_parallel_for(size, nthreads, [&](int t, uint64_t begin, uint64_t end)
+				{
+					char *out = text[t].get();
+					text_sizes[t] = mtx_format_entries(batch + begin * entry_size, end - begin,
+					                                   header, out) - out;
+				});
+
+				for (int t = 0; t < nthreads; ++t)
+					ofile.write(text[t].get(), text_sizes[t]);
+
+				if (!ofile) throw std::runtime_error("Error: Cannot write to MTX file!");
+
+			} catch (...)
+			{
+				background.join();
+				throw;
+			}
+
+			background.join();
+			if (error) std::rethrow_exception(error);
+
+			k += size;
+			size = next_size;
+			bar.set((float) k / header.nz);
+		}
+
+		bar.finish();
+
+		ofile.close();
+		if (!ofile) throw std::runtime_error("Error: Cannot write to MTX file!");
+	}
+
 }   // namespace mtb
 
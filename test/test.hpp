@@ -0,0 +1,50 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+#ifndef _MTB_TEST_HPP_
+#define _MTB_TEST_HPP_
+
+#include <cstdio>
+#include <stdexcept>
+
+//! Number of failed checks of the test program
+inline int mtb_test_failures = 0;
+
+//! Reports a failed check, without stopping the test program.
+#define MTB_CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++mtb_test_failures; \
+		} \
+	} while (0)
+
+//! Reports a failed check if `expr` does not throw a `std::runtime_error`.
+#define MTB_CHECK_THROWS(expr) \
+	do \
+	{ \
+		bool is_thrown = false; \
+		try { expr; } catch (const std::runtime_error &) { is_thrown = true; } \
+		if (!is_thrown) \
+		{ \
+			std::fprintf(stderr, "%s:%d: no exception thrown: %s\n", __FILE__, __LINE__, #expr); \
+			++mtb_test_failures; \
+		} \
+	} while (0)
+
+//! Prints the result of the test program and returns its exit code.
+inline int mtb_test_result(const char *name)
+{
+	if (mtb_test_failures == 0) std::printf("%s: passed\n", name);
+	else std::printf("%s: %d checks failed\n", name, mtb_test_failures);
+
+	return mtb_test_failures != 0;
+}
+
+#endif /* _MTB_TEST_HPP_ */
@@ -0,0 +1,277 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Asynchronous I/O: the rotating buffers of AsyncReader and AsyncWriter (block sizes, number of
+// buffers, a slow consumer and failed background operations), and mtb_read_data_async and
+// mtb_write_async against the serial reader and writer.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_async.hpp"
+#include "../include/mtb_io.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+static void check_async_reader(std::mt19937_64 &rng)
+{
+	std::string filename = "test_async.bin";
+	std::vector<char> bytes(50000);
+
+	for (char &c : bytes)
+		c = (char) rng();
+
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		ofile.write(bytes.data(), bytes.size());
+	}
+
+	File file(filename, O_RDONLY);
+
+	for (uint64_t block_size : {1, 7, 4096})
+	{
+		for (int nbuffers : {2, 3, 8})
+		{
+			for (uint64_t size : {uint64_t(0), uint64_t(1), block_size - 1, block_size, 5 * block_size + 3})
+			{
+				if (size == 0 && block_size == 1) continue;
+
+				uint64_t offset = 13;
+				AsyncReader reader(file, offset, size, block_size, nbuffers);
+				std::vector<char> out;
+				const char *block;
+				bool is_valid = true;
+
+				while (size_t n = reader.next(block))
+				{
+					// Only the last block is smaller
+					is_valid &= (n == std::min<uint64_t>(block_size, size - out.size()));
+
+					// The block is not overwritten while it is used, even if the consumer is slow
+					std::vector<char> copy(block, block + n);
+					if (out.size() < 3 * block_size) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					is_valid &= std::equal(copy.begin(), copy.end(), block);
+
+					out.insert(out.end(), block, block + n);
+				}
+
+				MTB_CHECK(is_valid);
+				MTB_CHECK(std::equal(out.begin(), out.end(), bytes.begin() + offset, bytes.begin() + offset + size));
+				MTB_CHECK(reader.next(block) == 0 && block == nullptr);
+			}
+		}
+	}
+
+	// The region ends after the end of the file
+	{
+		AsyncReader reader(file, 0, bytes.size() + 10, 4096);
+		const char *block;
+		MTB_CHECK_THROWS(while (reader.next(block) > 0) {});
+	}
+
+	// Destroyed before every block is read
+	{
+		AsyncReader reader(file, 0, bytes.size(), 16, 2);
+		const char *block;
+		reader.next(block);
+	}
+
+	std::remove(filename.c_str());
+}
+
+static void check_async_writer(std::mt19937_64 &rng)
+{
+	std::string filename = "test_async.bin";
+
+	for (size_t block_size : {1, 5, 4096})
+	{
+		for (int nbuffers : {2, 4})
+		{
+			std::vector<char> expected;
+
+			{
+				File file(filename, O_WRONLY | O_CREAT | O_TRUNC);
+				AsyncWriter writer(file, 3, block_size, nbuffers);
+				expected.assign(3, 0);
+
+				// Blocks of any size up to the block size, including empty blocks
+				for (int k = 0; k < 200; ++k)
+				{
+					size_t size = rng() % (block_size + 1);
+					char *block = writer.acquire();
+
+					for (size_t i = 0; i < size; ++i)
+						expected.push_back(block[i] = (char) rng());
+
+					writer.submit(size);
+				}
+
+				writer.finish();
+			}
+
+			MTB_CHECK(read_file(filename) == expected);
+		}
+	}
+
+	// The background write fails on a file opened for reading
+	{
+		File file(filename, O_RDONLY);
+		AsyncWriter writer(file, 0, 16);
+
+		auto write = [&]()
+		{
+			for (int k = 0; k < 10; ++k)
+			{
+				writer.acquire();
+				writer.submit(16);
+			}
+
+			writer.finish();
+		};
+
+		MTB_CHECK_THROWS(write());
+	}
+
+	std::remove(filename.c_str());
+}
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+static void check_matrices(std::mt19937_64 &rng)
+{
+	std::string filename = "test_async.mtb", reference = "test_async_ref.mtb";
+	uint64_t nrows = 3000;
+
+	for (uint64_t nz : {0, 1, 3 * MTB_CHECKSUM_BLOCK + 5})
+	{
+		for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+		{
+			std::vector<Triplet<double>> data(nz);
+
+			for (Triplet<double> &entry : data)
+			{
+				entry.row = rng() % nrows;
+				entry.col = rng() % (mat_type == kSymmetricSparse ? entry.row + 1 : nrows);
+				entry.val = std::uniform_real_distribution<double>(-1, 1)(rng);
+			}
+
+			// The asynchronous writer creates the same file as the serial writer
+			for (int nbuffers : {2, 3})
+			{
+				mtb_write_async(filename, data.data(), nrows, nrows, nz, mat_type, kReal, 8, nbuffers);
+
+				{
+					std::ofstream ofile(reference, std::ios::binary);
+					mtb_write_header(ofile, mat_type, kReal, 8, nrows, nrows, nz);
+					mtb_write_data(ofile, data.data(), nz, mat_type, kReal, 8);
+				}
+
+				MTB_CHECK(read_file(filename) == read_file(reference));
+			}
+
+			// The asynchronous reader, with narrow indices and checksums
+			uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+
+			for (char index_size : {2, 8})
+			{
+				for (bool checksum : {false, true})
+				{
+					MTBHeader header{mat_type, kReal, 8, nrows, nrows, nz};
+					header.index_size = index_size;
+					if (checksum) header.flags = kChecksum;
+
+					{
+						std::ofstream ofile(filename, std::ios::binary);
+						mtb_write_header(ofile, header);
+						mtb_write_data(ofile, data.data(), header);
+					}
+
+					std::vector<Triplet<double>> expected(step_size * nz, Triplet<double>{-1, -1, -1.0});
+					{
+						std::ifstream ifile(filename, std::ios::binary);
+						mtb_read_header(ifile, header);
+						mtb_read_data(ifile, expected.data(), header);
+					}
+
+					for (int nbuffers : {2, 4})
+					{
+						std::vector<Triplet<double>> out(step_size * nz, Triplet<double>{-1, -1, -1.0});
+						mtb_read_data_async(filename, out.data(), step_size * nz, mat_type, kReal, 8, nbuffers);
+						MTB_CHECK(same_entries(out, expected));
+					}
+
+					// Only the first entries
+					if (nz > 1)
+					{
+						uint64_t count = nz / 2;
+						std::vector<Triplet<double>> out(step_size * nz, Triplet<double>{-1, -1, -1.0});
+						mtb_read_data_async(filename, out.data(), step_size * count, mat_type, kReal, 8);
+
+						std::vector<Triplet<double>> partial = expected;
+						std::fill(partial.begin() + step_size * count, partial.end(), Triplet<double>{-1, -1, -1.0});
+						MTB_CHECK(same_entries(out, partial));
+					}
+				}
+			}
+		}
+	}
+
+	// Properties that do not match the header and the chunked encoding
+	std::vector<Triplet<double>> data = {{0, 0, 1.0}, {1, 0, 2.0}}, out(4);
+	MTBHeader header{kGeneralSparse, kReal, 8, 2, 2, 2};
+	mtb_write_async(filename, data.data(), 2, 2, 2, kGeneralSparse, kReal, 8);
+
+	MTB_CHECK_THROWS(mtb_read_data_async(filename, out.data(), 4, kSymmetricSparse, kReal, 8));
+	MTB_CHECK_THROWS(mtb_read_data_async(filename, out.data(), 3, kGeneralSparse, kReal, 8));
+	MTB_CHECK_THROWS(mtb_write_async(filename, data.data(), 2, 2, 2, kGeneralSparse, kReal, 3));
+
+	header.encoding = kChunkedEncoding;
+	header.version = 2;
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+	MTB_CHECK_THROWS(mtb_read_data_async(filename, out.data(), 2, kGeneralSparse, kReal, 8));
+
+	std::remove(filename.c_str());
+	std::remove(reference.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_async_reader(rng);
+	check_async_writer(rng);
+	check_matrices(rng);
+
+	return mtb_test_result("test_async");
+}
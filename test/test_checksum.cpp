@@ -0,0 +1,227 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// CRC32C kernels against each other, and detection of a corrupted entry (kChecksum) by every
+// reader, which must name the range of entries of the corrupted block.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_checksum.hpp"
+#include "../include/mtb_chunked.hpp"
+#include "../include/mtb_index.hpp"
+#include "../include/mtb_parallel.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static void check_crc32c(std::mt19937_64 &rng)
+{
+	// Reference value of the CRC32C (RFC 3720)
+	MTB_CHECK(mtb_crc32c(0, "123456789", 9) == 0xE3069283);
+	MTB_CHECK(mtb_crc32c(0, "123456789", 9, kSoftwareCrc) == 0xE3069283);
+
+	if (mtb_crc_kernel() < kSSE42Crc)
+	{
+		std::printf("test_checksum: the SSE4.2 kernel is not supported by this CPU\n");
+		MTB_CHECK_THROWS(mtb_crc32c(0, "", 0, kSSE42Crc));
+		return;
+	}
+
+	// Sizes around the streams of the SSE4.2 kernel (3 x 256 and 3 x 8192 bytes)
+	std::vector<uint64_t> sizes;
+
+	for (uint64_t size = 0; size <= 64; ++size)
+		sizes.push_back(size);
+
+	for (uint64_t base : {3 * 256, 3 * 8192, 2 * 3 * 8192 + 3 * 256})
+		for (uint64_t delta = 0; delta <= 9; ++delta)
+			sizes.insert(sizes.end(), {base - delta, base + delta});
+
+	std::vector<char> buf(2 * 3 * 8192 + 3 * 256 + 32);
+
+	for (char &c : buf)
+		c = (char) rng();
+
+	bool is_same = true;
+
+	for (uint64_t size : sizes)
+	{
+		// Unaligned buffers, and the same data split in two parts
+		for (uint64_t offset = 0; offset < 8; ++offset)
+		{
+			const char *ptr = buf.data() + offset;
+			uint32_t crc = mtb_crc32c(0, ptr, size, kSoftwareCrc);
+			uint64_t half = std::min(size, size / 2 + offset);
+
+			is_same &= (mtb_crc32c(0, ptr, size, kSSE42Crc) == crc);
+			is_same &= (mtb_crc32c(mtb_crc32c(0, ptr, half, kSSE42Crc), ptr + half, size - half, kSSE42Crc) == crc);
+		}
+	}
+
+	MTB_CHECK(is_same);
+}
+
+// Checks that `func` throws the checksum error of the entries [begin, end).
+template<typename Func>
+static void check_mismatch(const char *reader, Func func, uint64_t begin, uint64_t end)
+{
+	std::string expected = "Error: MTB checksum mismatch in entries [" + std::to_string(begin) + ", "
+	                       + std::to_string(end) + ")!";
+	std::string error;
+
+	try
+	{
+		func();
+
+	} catch (const std::runtime_error &e)
+	{
+		error = e.what();
+	}
+
+	if (error != expected) std::fprintf(stderr, "%s: \"%s\" instead of \"%s\"\n", reader, error.c_str(),
+	                                    expected.c_str());
+	MTB_CHECK(error == expected);
+}
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &filename, const std::vector<char> &bytes)
+{
+	std::ofstream ofile(filename, std::ios::binary);
+	ofile.write(bytes.data(), bytes.size());
+}
+
+// Writes the entries with the given header, with the plain (parallel writer) or chunked encoding.
+static void write_matrix(const std::string &filename, const std::vector<Triplet<double>> &data,
+                         const MTBHeader &header)
+{
+	if (header.encoding == kPlainEncoding)
+	{
+		mtb_write_data_parallel(filename, data.data(), header, 2);
+
+	} else
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+}
+
+// Corrupts the entry `k` of each file, in a block that is not the first one, the last one
+// (which is not full) and the first one, and reads it with every reader.
+static void check_corruption(std::mt19937_64 &rng)
+{
+	std::string filename = "test_checksum.mtb", modified = "test_checksum_2.mtb";
+	uint64_t nz = 3 * MTB_CHECKSUM_BLOCK + 123, nrows = 1000;
+	std::vector<Triplet<double>> data(nz), out(nz);
+
+	// Sorted entries (for the row index) with random values
+	for (uint64_t i = 0; i < nz; ++i)
+		data[i] = {(std::ptrdiff_t) (i * nrows / nz), (std::ptrdiff_t) (rng() % nrows),
+		           std::uniform_real_distribution<double>(-1, 1)(rng)};
+
+	for (char encoding : {kPlainEncoding, kChunkedEncoding})
+	{
+		MTBHeader header{kGeneralSparse, kReal, 8, nrows, nrows, nz};
+		header.encoding = encoding;
+		header.flags = kChecksum | (encoding == kPlainEncoding ? kRowIndex : 0);
+		if (encoding != kPlainEncoding) header.version = 2;
+
+		write_matrix(filename, data, header);
+		std::vector<char> original = read_file(filename);
+
+		// Without corruption, every reader succeeds
+		{
+			std::ifstream ifile(filename, std::ios::binary);
+			MTBHeader file_header;
+			mtb_read_header(ifile, file_header);
+			mtb_read_data(ifile, out.data(), file_header);
+			MTB_CHECK(std::equal(out.begin(), out.end(), data.begin(), [](const auto &a, const auto &b)
+			                     { return a.row == b.row && a.col == b.col && a.val == b.val; }));
+		}
+
+		for (uint64_t k : {uint64_t(2 * MTB_CHECKSUM_BLOCK + 5), nz - 1, uint64_t(0)})
+		{
+			// The byte of the entry `k` that differs in a copy where the last bit of this value
+			// is flipped. The low bytes of the values are random, so they are stored as literals
+			// in the compressed chunks. The checksums of the copy are not used.
+			std::vector<Triplet<double>> other = data;
+			uint64_t bits;
+			std::memcpy(&bits, &other[k].val, sizeof(double));
+			bits ^= 1;
+			std::memcpy(&other[k].val, &bits, sizeof(double));
+			write_matrix(modified, other, header);
+
+			std::vector<char> corrupted = original, changed = read_file(modified);
+			uint64_t pos = std::mismatch(original.begin(), original.end(), changed.begin()).first - original.begin();
+			MTB_CHECK(pos < original.size() - mtb_checksum_size(header));
+			corrupted[pos] = changed[pos];
+			write_file(filename, corrupted);
+
+			uint64_t begin = k / MTB_CHECKSUM_BLOCK * MTB_CHECKSUM_BLOCK;
+			uint64_t end = std::min(begin + MTB_CHECKSUM_BLOCK, nz);
+
+			check_mismatch("mtb_read_data", [&]()
+			{
+				std::ifstream ifile(filename, std::ios::binary);
+				MTBHeader file_header;
+				mtb_read_header(ifile, file_header);
+				mtb_read_data(ifile, out.data(), file_header);
+			}, begin, end);
+
+			if (encoding == kPlainEncoding)
+			{
+				check_mismatch("mtb_read_data_parallel", [&]()
+				{
+					mtb_read_data_parallel(filename, out.data(), nz, kGeneralSparse, kReal, 8, 3);
+				}, begin, end);
+
+				// Only the rows in the corrupted block are affected
+				std::vector<Triplet<double>> rows;
+				uint64_t row = data[k].row;
+				check_mismatch("mtb_read_rows", [&]() { mtb_read_rows(filename, row, row + 1, rows); },
+				               begin, end);
+
+				uint64_t clean_row = (k < MTB_CHECKSUM_BLOCK) ? nrows - 1 : 0;
+				mtb_read_rows(filename, clean_row, clean_row + 1, rows);
+				MTB_CHECK(!rows.empty() && (uint64_t) rows[0].row == clean_row);
+
+			} else
+			{
+				check_mismatch("mtb_read_data_chunked", [&]()
+				{
+					mtb_read_data_chunked(filename, out.data(), 2);
+				}, begin, end);
+			}
+		}
+	}
+
+	std::remove(filename.c_str());
+	std::remove(modified.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_crc32c(rng);
+	check_corruption(rng);
+
+	return mtb_test_result("test_checksum");
+}
@@ -0,0 +1,345 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Round trip of the byte shuffle, the LZ codec and the chunks of the kChunkedEncoding, and
+// rejection of corrupted chunks and chunk tables.
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb_chunked.hpp"
+#include "../include/mtb_compress.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static void check_shuffle(std::mt19937_64 &rng)
+{
+	for (uint64_t record_size : {1, 3, 7, 8, 9, 16, 17, 20, 24, 40})
+	{
+		for (uint64_t count : {0, 1, 7, 8, 9, 255, 256, 257, 1000})
+		{
+			std::vector<char> in(count * record_size), shuffled(in.size()), out(in.size());
+
+			for (char &c : in)
+				c = (char) rng();
+
+			mtb_shuffle(in.data(), shuffled.data(), count, record_size);
+			mtb_unshuffle(shuffled.data(), out.data(), count, record_size);
+
+			bool is_same = (out == in);
+
+			// The byte `b` of the record `i` is stored in the plane `b`
+			for (uint64_t i = 0; i < count; ++i)
+				for (uint64_t b = 0; b < record_size; ++b)
+					is_same &= (shuffled[b * count + i] == in[i * record_size + b]);
+
+			if (!is_same) std::fprintf(stderr, "record_size=%lu count=%lu\n", record_size, count);
+			MTB_CHECK(is_same);
+		}
+	}
+}
+
+// Data with different amounts of redundancy: random bytes, long runs, short periods (matches
+// that overlap their output) and long literals and matches (lengths above 15 + 255)
+static std::vector<std::vector<char>> lz_inputs(std::mt19937_64 &rng)
+{
+	std::vector<std::vector<char>> inputs;
+
+	for (uint64_t size : {0, 1, 4, 5, 12, 13, 100, 5000, 100000})
+	{
+		std::vector<char> random(size), zeros(size, 0), periodic(size), mixed(size);
+
+		for (uint64_t i = 0; i < size; ++i)
+		{
+			random[i] = (char) rng();
+			periodic[i] = (char) ("abcdefg"[i % (1 + size % 7)]);
+			mixed[i] = ((i / 1000) % 2) ? (char) rng() : (char) (i % 3);
+		}
+
+		inputs.insert(inputs.end(), {random, zeros, periodic, mixed});
+	}
+
+	return inputs;
+}
+
+static void check_lz(std::mt19937_64 &rng)
+{
+	for (const std::vector<char> &in : lz_inputs(rng))
+	{
+		std::vector<char> compressed(mtb_lz_bound(in.size())), out(in.size());
+
+		uint64_t size = mtb_lz_compress(in.data(), in.size(), compressed.data());
+		MTB_CHECK(size <= mtb_lz_bound(in.size()));
+
+		mtb_lz_decompress(compressed.data(), size, out.data(), out.size());
+		MTB_CHECK(out == in);
+
+		// Truncated data and wrong output sizes
+		for (uint64_t cut = 0; cut < size; cut += 1 + cut / 8)
+			MTB_CHECK_THROWS(mtb_lz_decompress(compressed.data(), cut, out.data(), out.size()));
+
+		std::vector<char> larger(in.size() + 1);
+		MTB_CHECK_THROWS(mtb_lz_decompress(compressed.data(), size, larger.data(), larger.size()));
+		if (!in.empty()) MTB_CHECK_THROWS(mtb_lz_decompress(compressed.data(), size, out.data(), out.size() - 1));
+	}
+
+	// Handcrafted sequences: token (literals << 4 | match length - 4), literals, 16-bit offset
+	std::vector<char> out(64);
+	auto decompress = [&](std::vector<unsigned char> in, uint64_t out_size) {
+		mtb_lz_decompress((const char *) in.data(), in.size(), out.data(), out_size);
+	};
+
+	decompress({0x20, 'a', 'b'}, 2);
+	decompress({0x10, 'a', 0x01, 0x00, 0x00}, 5);
+	MTB_CHECK(std::string(out.data(), 5) == "aaaaa");
+
+	// Match offset out of range (before the beginning of the output) or zero
+	MTB_CHECK_THROWS(decompress({0x10, 'a', 0x02, 0x00, 0x00}, 5));
+	MTB_CHECK_THROWS(decompress({0x10, 'a', 0xFF, 0xFF, 0x00}, 5));
+	MTB_CHECK_THROWS(decompress({0x10, 'a', 0x00, 0x00, 0x00}, 5));
+
+	// Match or literals past the end of the output, literals past the end of the input
+	MTB_CHECK_THROWS(decompress({0x1F, 'a', 0x01, 0x00, 0xFF, 0x10, 0x00}, 64));
+	MTB_CHECK_THROWS(decompress({0x50, 'a', 'b', 'c'}, 5));
+	MTB_CHECK_THROWS(decompress({0x30, 'a', 'b', 'c'}, 2));
+	MTB_CHECK_THROWS(decompress({0xF0, 0xFF}, 64));
+
+	// Offset or match length cut
+	MTB_CHECK_THROWS(decompress({0x10, 'a', 0x01}, 5));
+	MTB_CHECK_THROWS(decompress({0x1F, 'a', 0x01, 0x00}, 64));
+	MTB_CHECK_THROWS(decompress({}, 0));
+}
+
+// Entries of a matrix with slowly changing rows and small integer values (MTB v1 layout)
+static std::vector<char> random_entries(const MTBHeader &header, uint64_t count, std::mt19937_64 &rng)
+{
+	uint64_t entry_size = mtb_entry_size(header.datatype, header.type_size);
+	std::vector<char> raw(count * entry_size);
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t row = i / 8, col = rng() % header.ncols;
+		double val = (double) (rng() % 16);
+
+		std::memcpy(raw.data() + i * entry_size, &row, sizeof(uint64_t));
+		std::memcpy(raw.data() + i * entry_size + 8, &col, sizeof(uint64_t));
+		std::memcpy(raw.data() + i * entry_size + 16, &val, sizeof(double));
+	}
+
+	return raw;
+}
+
+static MTBHeader chunked_header(uint64_t nz, char index_size)
+{
+	MTBHeader header{kGeneralSparse, kReal, 8, 1000, 1000, nz};
+	header.version = 2;
+	header.index_size = index_size;
+	header.encoding = kChunkedEncoding;
+
+	return header;
+}
+
+static void check_chunks(std::mt19937_64 &rng)
+{
+	for (char index_size : {2, 4, 8})
+	{
+		for (uint64_t count : {0, 1, 9, 1000})
+		{
+			MTBHeader header = chunked_header(count, index_size);
+			uint64_t entry_size = mtb_entry_size(header);
+			uint64_t value_size = mtb_entry_size(header.datatype, header.type_size) - 2 * sizeof(uint64_t);
+			std::vector<char> raw = random_entries(header, count, rng);
+
+			// Entries with the index size of the header, and random entries (stored chunk)
+			std::vector<char> plain(count * entry_size), noise(count * entry_size);
+			mtb_narrow_indices(raw.data(), plain.data(), count, index_size, value_size);
+
+			for (char &c : noise)
+				c = (char) rng();
+
+			for (const std::vector<char> *in : {&plain, &noise})
+			{
+				std::vector<char> chunk, scratch, out(raw.size());
+				uint64_t size = mtb_compress_chunk(in->data(), count, header, chunk, scratch);
+				MTB_CHECK(size <= 1 + in->size());
+
+				// The noise is stored, except for a few entries with narrow indices
+				if (in == &plain && count >= 1000) MTB_CHECK(chunk[0] == kLZCodec && size < raw.size() / 2);
+				if (in == &noise && count >= 1000) MTB_CHECK(chunk[0] == kStoredCodec);
+
+				mtb_decompress_chunk(chunk.data(), size, out.data(), count, header, scratch);
+
+				std::vector<char> expected(raw.size());
+				mtb_widen_indices(in->data(), expected.data(), count, index_size, value_size);
+				MTB_CHECK(out == expected);
+
+				// Truncated chunks, a chunk with extra bytes and unknown codecs
+				for (uint64_t cut = 0; cut < size; cut += 1 + cut / 8)
+					MTB_CHECK_THROWS(mtb_decompress_chunk(chunk.data(), cut, out.data(), count, header, scratch));
+
+				chunk.resize(size + 1);
+				MTB_CHECK_THROWS(mtb_decompress_chunk(chunk.data(), size + 1, out.data(), count, header, scratch));
+
+				chunk[0] = 0x7F;
+				MTB_CHECK_THROWS(mtb_decompress_chunk(chunk.data(), size, out.data(), count, header, scratch));
+			}
+		}
+	}
+}
+
+template<typename T>
+static void read_file(const std::string &filename, std::vector<Triplet<T>> &data)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	MTBHeader header;
+
+	mtb_read_header(ifile, header);
+	data.resize(header.nz);
+	mtb_read_data(ifile, data.data(), header);
+}
+
+template<typename T>
+static void read_chunked(const std::string &filename, std::vector<Triplet<T>> &data)
+{
+	ChunkedFile file(filename);
+	ChunkedFile::Buffers buffers;
+
+	data.resize(file.nz());
+	for (uint64_t c = 0; c < file.num_chunks(); ++c)
+		file.read_chunk(c, data.data() + file.chunk_begin(c), buffers);
+}
+
+static void check_chunk_table(std::mt19937_64 &rng)
+{
+	const uint64_t nz = 1000, chunk_size = 300;
+	std::string filename = "test_compress.mtb";
+	MTBHeader header = chunked_header(nz, 4);
+	std::vector<char> raw = random_entries(header, nz, rng);
+
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+
+		EntryWriter writer(header, chunk_size);
+		std::vector<char> copy = raw;
+		writer.write(ofile, copy.data(), nz);
+		writer.finish(ofile);
+	}
+
+	std::ifstream ifile(filename, std::ios::binary);
+	std::vector<char> file((std::istreambuf_iterator<char>(ifile)), std::istreambuf_iterator<char>());
+	ifile.close();
+
+	// Both readers return the original entries
+	std::vector<Triplet<double>> data, chunked;
+	read_file(filename, data);
+	read_chunked(filename, chunked);
+
+	bool is_same = (data.size() == nz && chunked.size() == nz);
+	for (uint64_t i = 0; is_same && i < nz; ++i)
+	{
+		uint64_t row, col;
+		double val;
+		std::memcpy(&row, raw.data() + i * 24, sizeof(uint64_t));
+		std::memcpy(&col, raw.data() + i * 24 + 8, sizeof(uint64_t));
+		std::memcpy(&val, raw.data() + i * 24 + 16, sizeof(double));
+
+		is_same &= (uint64_t) data[i].row == row && (uint64_t) data[i].col == col && data[i].val == val;
+		is_same &= (uint64_t) chunked[i].row == row && (uint64_t) chunked[i].col == col && chunked[i].val == val;
+	}
+	MTB_CHECK(is_same);
+
+	// Chunk table: chunk size, then the position of each chunk and the end of the last one
+	uint64_t table = mtb_header_size(header);
+	uint64_t nchunks = (nz + chunk_size - 1) / chunk_size;
+	auto get = [&](uint64_t i) { uint64_t val; std::memcpy(&val, file.data() + table + 8 * i, 8); return val; };
+	uint64_t end = get(1 + nchunks);
+
+	struct { uint64_t entry; uint64_t value; } corruptions[] = {
+		{0, 0},							// Chunk size of zero
+		{0, chunk_size + 1},			// Chunk size that changes the number of chunks
+		{0, chunk_size - 1},
+		{0, ~(uint64_t) 0},				// Single chunk (wraps around in (nz + chunk_size - 1))
+		{1, 1},							// First chunk not at the beginning
+		{2, get(3)},					// Positions not increasing
+		{3, get(2) - 1},
+		{2, get(2) + 1},				// Chunk boundaries moved
+		{3, get(3) - 1},
+		{1 + nchunks, end + 1},			// End past the end of the file
+		{1 + nchunks, end - 1},
+		{1 + nchunks, ~(uint64_t) 0}
+	};
+
+	for (auto &corruption : corruptions)
+	{
+		std::vector<char> bad = file;
+		std::memcpy(bad.data() + table + 8 * corruption.entry, &corruption.value, sizeof(uint64_t));
+
+		std::ofstream ofile(filename, std::ios::binary);
+		ofile.write(bad.data(), bad.size());
+		ofile.close();
+
+		MTB_CHECK_THROWS(read_file(filename, data));
+		MTB_CHECK_THROWS(read_chunked(filename, chunked));
+	}
+
+	std::remove(filename.c_str());
+}
+
+// Reads the first entry with the stream reader, without allocating space for the whole matrix
+static void read_first_entry(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	MTBHeader header;
+	char raw[64];
+
+	mtb_read_header(ifile, header);
+	EntryReader reader(header);
+	reader.read(ifile, raw, 1);
+}
+
+// Files with only a header and a chunk size, whose number of entries implies a huge table
+static void check_huge_table()
+{
+	std::string filename = "test_compress.mtb";
+
+	for (uint64_t nz : {~(uint64_t) 0, uint64_t(1) << 40, uint64_t(1) << 62})
+	{
+		for (uint64_t chunk_size : {uint64_t(1), uint64_t(3), uint64_t(MTB_CHUNK_SIZE)})
+		{
+			MTBHeader header = chunked_header(nz, 8);
+
+			{
+				std::ofstream ofile(filename, std::ios::binary);
+				mtb_write_header(ofile, header);
+				ofile.write((const char *) &chunk_size, sizeof(uint64_t));
+			}
+
+			MTB_CHECK_THROWS(read_first_entry(filename));
+			MTB_CHECK_THROWS(ChunkedFile file(filename));
+		}
+	}
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_shuffle(rng);
+	check_lz(rng);
+	check_chunks(rng);
+	check_chunk_table(rng);
+	check_huge_table();
+
+	return mtb_test_result("test_compress");
+}
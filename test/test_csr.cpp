@@ -0,0 +1,358 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Direct reads into the CSR and CSC formats (mtb_read_csr and mtb_read_csc) with the sorted
+// path (one pass) and the unsorted path (counting pass and placement pass), for general and
+// symmetric matrices, compared with the compressed format built from the entries in file order.
+// Direct writes from the CSR and CSC formats (mtb_write_csr and mtb_write_csc), with and
+// without the lower triangle, compared with the serial writer.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_csr.hpp"
+#include "../include/mtb_index.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+// Compressed format in which each row (or column) keeps the entries in file order, with the
+// mirrors of symmetric matrices placed when their entry is found
+template<typename T>
+struct Compressed
+{
+	std::vector<uint64_t> ptr;
+	std::vector<uint64_t> idx;
+	std::vector<T> val;
+};
+
+template<typename T>
+static Compressed<T> expected_compressed(const std::vector<Triplet<T>> &data, uint64_t size,
+                                         bool is_symmetric, bool by_col)
+{
+	std::vector<std::vector<std::pair<uint64_t, T>>> lines(size);
+
+	for (const Triplet<T> &entry : data)
+	{
+		uint64_t major = by_col ? entry.col : entry.row, minor = by_col ? entry.row : entry.col;
+
+		lines[major].push_back({minor, entry.val});
+		if (is_symmetric && major != minor) lines[minor].push_back({major, entry.val});
+	}
+
+	Compressed<T> out;
+	out.ptr.push_back(0);
+
+	for (const auto &line : lines)
+	{
+		for (const auto &[minor, val] : line)
+		{
+			out.idx.push_back(minor);
+			out.val.push_back(val);
+		}
+
+		out.ptr.push_back(out.idx.size());
+	}
+
+	return out;
+}
+
+template<typename T, typename I>
+static bool same_compressed(const Compressed<T> &expected, const std::vector<I> &ptr,
+                            const std::vector<I> &idx, const std::vector<T> &val)
+{
+	return std::equal(ptr.begin(), ptr.end(), expected.ptr.begin(), expected.ptr.end())
+	       && std::equal(idx.begin(), idx.end(), expected.idx.begin(), expected.idx.end())
+	       && val == expected.val;
+}
+
+template<typename T>
+static void write_matrix(const std::string &filename, const std::vector<Triplet<T>> &data,
+                         const MTBHeader &header)
+{
+	std::ofstream ofile(filename, std::ios::binary);
+	mtb_write_header(ofile, header);
+	mtb_write_data(ofile, data.data(), header);
+}
+
+// Reads the file with both formats and both paths (the sorted path only if the file has the
+// order of the format) and compares them with the expected formats
+template<typename T, typename I>
+static void check_read(const std::string &filename, const std::vector<Triplet<T>> &data,
+                       const MTBHeader &header, bool is_row_major, bool is_col_major)
+{
+	bool is_symmetric = (header.mat_type == kSymmetricSparse);
+
+	for (bool by_col : {false, true})
+	{
+		Compressed<T> expected = expected_compressed(data, by_col ? header.ncols : header.nrows,
+		                                             is_symmetric, by_col);
+		bool is_ordered = by_col ? is_col_major : is_row_major;
+
+		for (bool is_sorted : {false, true})
+		{
+			if (is_sorted && !is_ordered) continue;
+
+			std::ifstream ifile(filename, std::ios::binary);
+			MTBHeader file_header;
+			mtb_read_header(ifile, file_header);
+
+			std::vector<I> ptr, idx;
+			std::vector<T> val;
+
+			if (by_col)
+				mtb_read_csc(ifile, ptr, idx, val, header.nrows, header.ncols, header.nz, header.mat_type,
+				             header.datatype, header.type_size, is_sorted);
+			else
+				mtb_read_csr(ifile, ptr, idx, val, header.nrows, header.ncols, header.nz, header.mat_type,
+				             header.datatype, header.type_size, is_sorted);
+
+			MTB_CHECK(same_compressed(expected, ptr, idx, val));
+		}
+	}
+}
+
+static void check_matrices(std::mt19937_64 &rng)
+{
+	std::string filename = "test_csr.mtb";
+	uint64_t nrows = 700, ncols = 500, nz = 20000;
+
+	// Rectangular matrix with empty rows and columns (the last ones included), and repeated
+	// indices, which keep their order
+	std::vector<Triplet<double>> data(nz);
+
+	for (Triplet<double> &entry : data)
+	{
+		entry.row = rng() % (nrows - 50);
+		entry.col = rng() % (ncols - 20);
+		if (entry.row % 7 == 3) entry.row = 0;
+		entry.val = (double) (rng() % 1000) - 500;
+	}
+
+	MTBHeader header{kGeneralSparse, kReal, 8, nrows, ncols, nz};
+
+	write_matrix(filename, data, header);
+	check_read<double, uint64_t>(filename, data, header, false, false);
+
+	// Sorted in a row-major and in a column-major order (stable, so the repeated indices keep
+	// their order)
+	std::vector<Triplet<double>> row_major = data, col_major = data;
+	std::stable_sort(row_major.begin(), row_major.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+	});
+	std::stable_sort(col_major.begin(), col_major.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return (a.col == b.col) ? (a.row < b.row) : (a.col < b.col);
+	});
+
+	write_matrix(filename, row_major, header);
+	check_read<double, uint64_t>(filename, row_major, header, true, false);
+	check_read<double, uint32_t>(filename, row_major, header, true, false);
+
+	write_matrix(filename, col_major, header);
+	check_read<double, int>(filename, col_major, header, false, true);
+
+	// Symmetric matrix (the sorted path places the mirrors like the unsorted path)
+	std::vector<Triplet<double>> lower;
+	for (const Triplet<double> &entry : row_major)
+		if (entry.row < (std::ptrdiff_t) ncols && entry.col <= entry.row) lower.push_back(entry);
+
+	MTBHeader symmetric{kSymmetricSparse, kReal, 8, ncols, ncols, lower.size()};
+	write_matrix(filename, lower, symmetric);
+	check_read<double, uint64_t>(filename, lower, symmetric, true, false);
+
+	// Integers with a narrow value size
+	std::vector<Triplet<int>> integers(nz);
+	for (uint64_t i = 0; i < nz; ++i)
+		integers[i] = {data[i].row, data[i].col, (int) data[i].val};
+
+	MTBHeader integer_header{kGeneralSparse, kInteger, 2, nrows, ncols, nz};
+	write_matrix(filename, integers, integer_header);
+	check_read<int, uint64_t>(filename, integers, integer_header, false, false);
+
+	std::remove(filename.c_str());
+}
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+// Writes the compressed matrix (with indices of type I) and compares it with the file of the
+// serial writer with its entries in the order of the format (only the entries at or below
+// the diagonal with the lower triangle)
+template<typename T, typename I>
+static void check_write(const Compressed<T> &matrix, MTBHeader header, bool by_col, bool lower_triangle)
+{
+	std::string filename = "test_csr.mtb", reference = "test_csr_ref.mtb";
+	std::vector<I> ptr(matrix.ptr.begin(), matrix.ptr.end()), idx(matrix.idx.begin(), matrix.idx.end());
+	std::vector<Triplet<T>> data;
+
+	for (uint64_t i = 0; i + 1 < ptr.size(); ++i)
+	{
+		for (uint64_t k = ptr[i]; k < (uint64_t) ptr[i + 1]; ++k)
+		{
+			std::ptrdiff_t row = by_col ? idx[k] : i, col = by_col ? i : idx[k];
+			if (!lower_triangle || col <= row) data.push_back({row, col, matrix.val[k]});
+		}
+	}
+
+	{
+		MTBHeader expected = header;
+		expected.nz = data.size();
+		if (lower_triangle) expected.mat_type = kSymmetricSparse;
+
+		std::ofstream ofile(reference, std::ios::binary);
+		mtb_write_header(ofile, expected);
+		mtb_write_data(ofile, data.data(), expected);
+		if (header.flags & kRowIndex) mtb_write_row_index(ofile, data.data(), data.size(), header.nrows);
+	}
+
+	// The number of entries of the header is ignored
+	header.nz = 12345;
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		if (by_col) mtb_write_csc(ofile, ptr.data(), idx.data(), matrix.val.data(), header, lower_triangle);
+		else mtb_write_csr(ofile, ptr.data(), idx.data(), matrix.val.data(), header, lower_triangle);
+	}
+
+	MTB_CHECK(read_file(filename) == read_file(reference));
+
+	std::remove(filename.c_str());
+	std::remove(reference.c_str());
+}
+
+static void check_writes(std::mt19937_64 &rng)
+{
+	uint64_t nrows = 600, nz = 30000;
+
+	// Square matrix with entries above, on and below the diagonal, empty rows and columns, and
+	// repeated indices
+	std::vector<Triplet<double>> data(nz);
+
+	for (Triplet<double> &entry : data)
+	{
+		entry.row = rng() % (nrows - 30);
+		entry.col = rng() % nrows;
+		if (entry.col % 11 == 5) entry.col = entry.row;
+		entry.val = std::uniform_real_distribution<double>(-1, 1)(rng);
+	}
+
+	// The CSR format has the columns of each row sorted (for the delta encoding and the row
+	// index), the CSC format has the rows in file order
+	std::vector<Triplet<double>> row_major = data;
+	std::stable_sort(row_major.begin(), row_major.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+	});
+
+	Compressed<double> csr = expected_compressed(row_major, nrows, false, false);
+	Compressed<double> csc = expected_compressed(data, nrows, false, true);
+
+	for (bool lower_triangle : {false, true})
+	{
+		for (char index_size : {2, 8})
+		{
+			for (int flags : {0, (int) kChecksum, (int) kRowIndex, kChecksum | kRowIndex})
+			{
+				MTBHeader header{kGeneralSparse, kReal, 8, nrows, nrows, 0};
+				header.index_size = index_size;
+				header.flags = flags;
+				check_write<double, uint64_t>(csr, header, false, lower_triangle);
+				check_write<double, int>(csr, header, false, lower_triangle);
+
+				header.flags &= ~kRowIndex;
+				check_write<double, uint32_t>(csc, header, true, lower_triangle);
+			}
+
+			MTBHeader header{kGeneralSparse, kReal, 8, nrows, nrows, 0};
+			header.index_size = index_size;
+			header.encoding = kDeltaEncoding;
+			header.version = 2;
+			check_write<double, uint64_t>(csr, header, false, lower_triangle);
+		}
+
+		// Narrow values
+		MTBHeader header{kGeneralSparse, kReal, 4, nrows, nrows, 0};
+		check_write<double, uint64_t>(csr, header, false, lower_triangle);
+		check_write<double, uint64_t>(csc, header, true, lower_triangle);
+	}
+}
+
+static void check_errors()
+{
+	std::string filename = "test_csr.mtb";
+	std::vector<Triplet<double>> data = {{2, 1, 1.0}, {0, 3, 2.0}, {299, 0, 3.0}};
+	MTBHeader header{kGeneralSparse, kReal, 8, 300, 4, 3};
+	write_matrix(filename, data, header);
+
+	auto read = [&](uint64_t nrows, uint64_t ncols, uint64_t nz, bool is_sorted, auto index)
+	{
+		using I = decltype(index);
+		std::ifstream ifile(filename, std::ios::binary);
+		MTBHeader file_header;
+		mtb_read_header(ifile, file_header);
+
+		std::vector<I> row_ptr, col_idx;
+		std::vector<double> val;
+		mtb_read_csr(ifile, row_ptr, col_idx, val, nrows, ncols, nz, kGeneralSparse, kReal, 8, is_sorted);
+	};
+
+	read(300, 4, 3, false, uint64_t());
+
+	// Not sorted by row, indices out of bounds, truncated file and indices that do not fit
+	MTB_CHECK_THROWS(read(300, 4, 3, true, uint64_t()));
+	MTB_CHECK_THROWS(read(299, 4, 3, false, uint64_t()));
+	MTB_CHECK_THROWS(read(300, 3, 3, false, uint64_t()));
+	MTB_CHECK_THROWS(read(300, 4, 4, false, uint64_t()));
+	MTB_CHECK_THROWS(read(300, 4, 3, false, uint8_t()));
+
+	// Pointers that decrease, indices out of bounds and a row index with the CSC format
+	std::vector<uint64_t> ptr = {0, 2, 1, 3}, idx = {0, 1, 2};
+	std::vector<double> val = {1.0, 2.0, 3.0};
+	MTBHeader square{kGeneralSparse, kReal, 8, 3, 3, 3};
+
+	auto write = [&](const MTBHeader &header, bool by_col)
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		if (by_col) mtb_write_csc(ofile, ptr.data(), idx.data(), val.data(), header);
+		else mtb_write_csr(ofile, ptr.data(), idx.data(), val.data(), header);
+	};
+
+	MTB_CHECK_THROWS(write(square, false));
+
+	ptr = {0, 1, 2, 3};
+	idx = {0, 3, 1};
+	MTB_CHECK_THROWS(write(square, false));
+	MTB_CHECK_THROWS(write(square, true));
+
+	idx = {0, 1, 2};
+	square.flags = kRowIndex;
+	write(square, false);
+	MTB_CHECK_THROWS(write(square, true));
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_matrices(rng);
+	check_writes(rng);
+	check_errors();
+
+	return mtb_test_result("test_csr");
+}
@@ -0,0 +1,230 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Round trip of every specialization of mtb_decode_dispatch (datatype, type size and
+// symmetry), of the memcpy and record expansion fast paths of mtb_decode_entries, and of
+// each kernel of mtb_expand_records.
+
+#include <complex>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+// Layouts of the MTB entries (datatype and type size)
+static const std::pair<char, char> kLayouts[] = {
+	{kPattern, 0}, {kInteger, 1}, {kInteger, 2}, {kInteger, 4}, {kInteger, 8},
+	{kReal, 4}, {kReal, 8}, {kComplex, 4}, {kComplex, 8}
+};
+
+// Number of entries of each block (covers the tails of the SIMD kernels)
+static const uint64_t kCounts[] = {0, 1, 2, 3, 4, 5, 7, 8, 17, 33, 1000};
+
+// Random value that is stored exactly with the given layout. Integers are limited to
+// `[-max_int, max_int]`, so they can also be represented by the decoded type.
+static std::complex<double> random_value(std::mt19937_64 &rng, char datatype, char type_size,
+                                         int64_t max_int)
+{
+	if (datatype == kPattern) return 1;
+
+	if (datatype == kInteger)
+	{
+		int64_t max = (type_size == 8) ? (int64_t(1) << 52) : (int64_t(1) << (8 * type_size - 1)) - 1;
+		max = std::min(max, max_int);
+		return (double) (int64_t) (rng() % (2 * max + 1) - max);
+	}
+
+	// Multiples of 2^-8 below 2^12 are exactly representable as float
+	auto part = [&]() { return ((int64_t) (rng() % (1 << 21)) - (1 << 20)) / 256.0; };
+	return std::complex<double>(part(), (datatype == kComplex) ? part() : 0);
+}
+
+// Value of `T` expected after decoding a stored value
+template<typename T>
+static T expected_value(const std::complex<double> &val)
+{
+	if constexpr (is_complex<T>()) return T(val.real(), val.imag());
+	else return (T) val.real();
+}
+
+template<typename T>
+static bool same_triplet(const Triplet<T> &entry, uint64_t row, uint64_t col, const T &val)
+{
+	return (uint64_t) entry.row == row && (uint64_t) entry.col == col && entry.val == val;
+}
+
+template<typename T>
+static void check_layout(char mat_type, char datatype, char type_size, uint64_t count,
+                         std::mt19937_64 &rng)
+{
+	bool is_symmetric = (mat_type == kSymmetricSparse);
+	int64_t max_int = int64_t(1) << 52;
+	if constexpr (std::is_integral_v<T>) max_int = std::min<int64_t>(max_int, std::numeric_limits<T>::max());
+	uint64_t entry_size = mtb_entry_size(datatype, type_size);
+	std::vector<Triplet<std::complex<double>>> source(count);
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t row = rng() % 1000000;
+		uint64_t col = (i % 3 == 0) ? row : rng() % 1000000;
+		if (is_symmetric && col > row) std::swap(row, col);
+
+		source[i] = {(std::ptrdiff_t) row, (std::ptrdiff_t) col,
+		             random_value(rng, datatype, type_size, max_int)};
+	}
+
+	std::vector<char> raw(count * entry_size + 1);
+	char *end = mtb_encode_entries(source.data(), count, raw.data(), datatype, type_size);
+	MTB_CHECK(end == raw.data() + count * entry_size);
+
+	uint64_t step_size = 1 + is_symmetric;
+	std::vector<Triplet<T>> data(count * step_size + 1);
+	std::vector<int64_t> rows(count * step_size), cols(count * step_size);
+	std::vector<T> vals(count * step_size);
+
+	const char *next = mtb_decode_entries(raw.data(), data.data(), count, mat_type, datatype, type_size);
+	MTB_CHECK(next == raw.data() + count * entry_size);
+
+	next = mtb_decode_entries_soa(raw.data(), rows.data(), cols.data(), vals.data(), count, mat_type,
+	                              datatype, type_size);
+	MTB_CHECK(next == raw.data() + count * entry_size);
+
+	bool is_same = true;
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t row = source[i].row, col = source[i].col;
+		T val = expected_value<T>(source[i].val);
+		uint64_t k = i * step_size;
+
+		is_same &= same_triplet(data[k], row, col, val);
+		is_same &= (uint64_t) rows[k] == row && (uint64_t) cols[k] == col && vals[k] == val;
+		is_same &= mtb_decode_value<T>(raw.data() + i * entry_size + 2 * sizeof(uint64_t), datatype,
+		                               type_size) == val;
+
+		if (is_symmetric && col < row)
+		{
+			is_same &= same_triplet(data[k + 1], col, row, val);
+			is_same &= (uint64_t) rows[k + 1] == col && (uint64_t) cols[k + 1] == row && vals[k + 1] == val;
+
+		} else if (is_symmetric)
+		{
+			// The hole after a diagonal entry must not be written
+			is_same &= same_triplet(data[k + 1], 0, 0, T());
+			is_same &= rows[k + 1] == 0 && cols[k + 1] == 0 && vals[k + 1] == T();
+		}
+	}
+
+	if (!is_same)
+		std::fprintf(stderr, "mat_type=%d datatype=0x%x type_size=%d count=%lu sizeof(T)=%zu\n",
+		             mat_type, (unsigned char) datatype, type_size, count, sizeof(T));
+	MTB_CHECK(is_same);
+}
+
+template<typename T>
+static void check_type(std::mt19937_64 &rng)
+{
+	for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+		for (auto layout : kLayouts)
+			for (uint64_t count : kCounts)
+				check_layout<T>(mat_type, layout.first, layout.second, count, rng);
+}
+
+// Checks the expansion of `count` records from `in` to `out`, and that the `guard` bytes after
+// the last output record are not written.
+static bool same_records(const char *in, const char *out, uint64_t count, int in_size, uint64_t fill,
+                         uint64_t guard)
+{
+	bool is_same = true;
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		is_same &= std::memcmp(out + i * 24, in + i * in_size, in_size) == 0;
+		if (in_size == 16) is_same &= std::memcmp(out + i * 24 + 16, &fill, 8) == 0;
+	}
+
+	for (uint64_t i = count * 24; i < count * 24 + guard; ++i)
+		is_same &= (out[i] == 0x5A);
+
+	return is_same;
+}
+
+static void check_expand_records(std::mt19937_64 &rng)
+{
+	const uint64_t guard = 128;
+
+	for (int level = kScalarSimd; level <= kAVX512Simd; ++level)
+	{
+		if (level > mtb_simd_level())
+		{
+			std::printf("test_decode: kernel %d is not supported by this CPU\n", level);
+			MTB_CHECK_THROWS(mtb_expand_records(nullptr, nullptr, 0, 16, 0, (MTBSimdLevel) level));
+			continue;
+		}
+
+		for (int in_size : {16, 20})
+		{
+			for (uint64_t count = 0; count <= 70; count += (count < 40) ? 1 : 10)
+			{
+				std::vector<char> in(count * in_size);
+				std::vector<char> out(count * 24 + guard, 0x5A);
+				uint64_t fill = rng();
+
+				for (char &c : in)
+					c = (char) rng();
+
+				mtb_expand_records(in.data(), out.data(), count, in_size, fill, (MTBSimdLevel) level);
+
+				bool is_same = same_records(in.data(), out.data(), count, in_size, fill, guard);
+				if (!is_same) std::fprintf(stderr, "level=%d in_size=%d count=%lu\n", level, in_size, count);
+				MTB_CHECK(is_same);
+			}
+
+			// Large outputs are written with aligned non-temporal stores, after a few records that
+			// align the output. The input ends at the end of its buffer, to detect reads past it.
+			for (uint64_t offset : {0, 3, 8, 16, 24, 40, 56})
+			{
+				uint64_t count = (1 << 16) + offset;
+				std::unique_ptr<char[]> in(new char[count * in_size + offset]);
+				std::unique_ptr<char[]> out(new char[count * 24 + guard + 128]);
+				char *dst = out.get() + (64 - (uintptr_t) out.get() % 64) + offset % 64;
+				uint64_t fill = rng();
+
+				for (uint64_t i = 0; i < count * in_size + offset; ++i)
+					in[i] = (char) rng();
+
+				std::memset(dst, 0x5A, count * 24 + guard);
+				mtb_expand_records(in.get() + offset, dst, count, in_size, fill, (MTBSimdLevel) level);
+
+				bool is_same = same_records(in.get() + offset, dst, count, in_size, fill, guard);
+				if (!is_same) std::fprintf(stderr, "level=%d in_size=%d offset=%lu\n", level, in_size, offset);
+				MTB_CHECK(is_same);
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_type<double>(rng);
+	check_type<float>(rng);
+	check_type<int>(rng);
+	check_type<int64_t>(rng);
+	check_type<std::complex<double>>(rng);
+	check_type<std::complex<float>>(rng);
+
+	check_expand_records(rng);
+
+	return mtb_test_result("test_decode");
+}
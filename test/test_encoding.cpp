@@ -0,0 +1,288 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Round trip of MTB v2 files (index sizes and delta encoding), rows split across calls of the
+// delta encoder, rejection of unsorted entries, and compatibility with MTB v1 files.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_encoding.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Random entries sorted by row and column, with indices up to `max_index` (fewer than `nz`
+// entries if the indices do not fit). Some rows are long, so they are split across the
+// batches of the writer.
+static std::vector<Triplet<double>> sorted_entries(uint64_t nz, uint64_t max_index, std::mt19937_64 &rng)
+{
+	std::vector<Triplet<double>> data;
+
+	for (uint64_t row = rng() % 3; row <= max_index && data.size() < nz; )
+	{
+		uint64_t count = (rng() % 4 == 0) ? 1 + rng() % 300 : 1 + rng() % 5;
+		uint64_t col = rng() % 4;
+
+		for (uint64_t k = 0; k < count && col <= max_index && data.size() < nz; ++k, col += 1 + rng() % 3)
+			data.push_back({(std::ptrdiff_t) row, (std::ptrdiff_t) col, (double) (rng() % 1000) * 0.5});
+
+		// Large gaps between the rows need several bytes in the delta encoding
+		uint64_t gap = (rng() % 8 == 0) ? 1 + rng() % (max_index / 64 + 1) : 1 + rng() % 2;
+		if (gap > max_index - row) break;
+		row += gap;
+	}
+
+	return data;
+}
+
+static void check_round_trip(std::mt19937_64 &rng)
+{
+	std::string filename = "test_encoding.mtb";
+
+	for (char index_size : {1, 2, 4, 8})
+	{
+		uint64_t max_index = (index_size == 8) ? (uint64_t(1) << 40) : (uint64_t(1) << (8 * index_size)) - 1;
+
+		for (char encoding : {kPlainEncoding, kDeltaEncoding})
+		{
+			for (uint64_t size : {0, 1, 1000, 5000})
+			{
+				std::vector<Triplet<double>> data = sorted_entries(size, max_index, rng);
+				uint64_t nz = data.size();
+				MTBHeader header{kGeneralSparse, kReal, 8, max_index + 1, max_index + 1, nz};
+				header.index_size = index_size;
+				header.encoding = encoding;
+
+				{
+					std::ofstream ofile(filename, std::ios::binary);
+					mtb_write_header(ofile, header);
+					mtb_write_data(ofile, data.data(), header);
+				}
+
+				std::ifstream ifile(filename, std::ios::binary);
+				MTBHeader file_header;
+				mtb_read_header(ifile, file_header);
+				mtb_check_header(file_header);
+
+				MTB_CHECK(file_header.index_size == index_size && file_header.encoding == encoding);
+				MTB_CHECK(file_header.version == (mtb_is_extended(header) ? 2 : 1));
+				MTB_CHECK(file_header.nz == nz && file_header.nrows == max_index + 1);
+
+				std::vector<Triplet<double>> out(nz);
+				mtb_read_data(ifile, out.data(), file_header);
+				MTB_CHECK(same_entries(out, data));
+
+				// An index that does not fit in the index size (the delta encoding has no fixed size)
+				if (index_size < 8 && encoding == kPlainEncoding && nz > 0)
+				{
+					data.back().col = max_index + 1;
+					std::ofstream ofile(filename, std::ios::binary);
+					mtb_write_header(ofile, header);
+					MTB_CHECK_THROWS(mtb_write_data(ofile, data.data(), header));
+				}
+			}
+		}
+	}
+
+	std::remove(filename.c_str());
+}
+
+// Encodes the entries with the given split points between the calls of the encoder, and
+// decodes them in blocks of `block` bytes.
+static std::vector<Triplet<double>> delta_round_trip(const std::vector<Triplet<double>> &data,
+                                                     const std::vector<uint64_t> &splits, uint64_t block)
+{
+	std::vector<char> raw(data.size() * 24), encoded;
+	mtb_encode_entries(data.data(), data.size(), raw.data(), kReal, 8);
+
+	DeltaEncoder encoder(8);
+	uint64_t begin = 0;
+
+	for (uint64_t k = 0; k <= splits.size(); ++k)
+	{
+		uint64_t end = (k < splits.size()) ? splits[k] : data.size();
+		uint64_t size = encoded.size();
+
+		encoded.resize(size + encoder.max_size(end - begin));
+		encoded.resize(size + encoder.encode(raw.data() + begin * 24, end - begin, encoded.data() + size));
+		begin = end;
+	}
+
+	DeltaDecoder decoder(8);
+	std::vector<char> decoded(data.size() * 24);
+	const char *in = encoded.data();
+	uint64_t count = 0;
+
+	for (uint64_t pos = 0; pos < encoded.size(); )
+	{
+		pos = std::min<uint64_t>(pos + block, encoded.size());
+		count += decoder.decode(in, encoded.data() + pos, decoded.data() + count * 24, data.size() - count);
+	}
+
+	std::vector<Triplet<double>> out(count);
+	mtb_decode_entries(decoded.data(), out.data(), count, kGeneralSparse, kReal, 8);
+
+	return out;
+}
+
+static void check_delta_splits(std::mt19937_64 &rng)
+{
+	// Row 5 has entries in both calls of the encoder (split at 2, 3 and 4)
+	std::vector<Triplet<double>> data = {{1, 2, 1.0}, {5, 0, 2.0}, {5, 3, 3.0}, {5, 300, 4.0},
+	                                     {5, 301, 5.0}, {700, 1, 6.0}};
+
+	for (uint64_t split : {1, 2, 3, 4, 5})
+		for (uint64_t block : {1, 2, 7, 1000})
+			MTB_CHECK(same_entries(delta_round_trip(data, {split}, block), data));
+
+	// Many random splits, also with empty calls
+	std::vector<Triplet<double>> many = sorted_entries(3000, uint64_t(1) << 40, rng);
+	std::vector<uint64_t> splits;
+
+	for (uint64_t pos = 0; pos < many.size(); pos += rng() % 50)
+		splits.push_back(pos);
+
+	MTB_CHECK(same_entries(delta_round_trip(many, splits, 13), many));
+
+	// The writer splits the rows across its batches in the same way
+	std::string filename = "test_encoding.mtb";
+	MTBHeader header{kGeneralSparse, kReal, 8, uint64_t(1) << 41, uint64_t(1) << 41, many.size()};
+	header.encoding = kDeltaEncoding;
+
+	{
+		std::vector<char> raw(many.size() * 24);
+		mtb_encode_entries(many.data(), many.size(), raw.data(), kReal, 8);
+
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		EntryWriter writer(header);
+
+		for (uint64_t k = 0; k < many.size(); k += 7)
+			writer.write(ofile, raw.data() + k * 24, std::min<uint64_t>(7, many.size() - k));
+
+		writer.finish(ofile);
+	}
+
+	std::ifstream ifile(filename, std::ios::binary);
+	mtb_read_header(ifile, header);
+	std::vector<Triplet<double>> out(header.nz);
+	mtb_read_data(ifile, out.data(), header);
+	MTB_CHECK(same_entries(out, many));
+
+	std::remove(filename.c_str());
+}
+
+static void check_unsorted()
+{
+	std::vector<Triplet<double>> columns = {{1, 2, 1.0}, {1, 1, 2.0}};
+	std::vector<Triplet<double>> rows = {{2, 0, 1.0}, {1, 5, 2.0}};
+	std::vector<char> raw(2 * 24), encoded(1000);
+
+	for (const auto *data : {&columns, &rows})
+	{
+		mtb_encode_entries(data->data(), 2, raw.data(), kReal, 8);
+
+		DeltaEncoder encoder(8);
+		MTB_CHECK_THROWS(encoder.encode(raw.data(), 2, encoded.data()));
+
+		// The same entries in two calls: only the rows are compared across calls, since a
+		// row split across calls starts a new run
+		DeltaEncoder split(8);
+		split.encode(raw.data(), 1, encoded.data());
+		if (data == &rows) MTB_CHECK_THROWS(split.encode(raw.data() + 24, 1, encoded.data()));
+	}
+
+	// The file writer rejects them too
+	MTBHeader header{kGeneralSparse, kReal, 8, 10, 10, 2};
+	header.encoding = kDeltaEncoding;
+	std::ofstream ofile("test_encoding.mtb", std::ios::binary);
+	mtb_write_header(ofile, header);
+	MTB_CHECK_THROWS(mtb_write_data(ofile, rows.data(), header));
+	ofile.close();
+
+	std::remove("test_encoding.mtb");
+}
+
+static void check_v1(std::mt19937_64 &rng)
+{
+	std::string filename = "test_encoding.mtb", legacy = "test_encoding_v1.mtb";
+	std::vector<Triplet<double>> data = sorted_entries(1000, 5000, rng);
+	uint64_t nz = data.size();
+
+	// Writer of MTB v1 files
+	{
+		std::ofstream ofile(legacy, std::ios::binary);
+		mtb_write_header(ofile, kGeneralSparse, kReal, 8, 5001, 5001, nz);
+		mtb_write_data(ofile, data.data(), nz, kGeneralSparse, kReal, 8);
+	}
+
+	// The default header creates the same file
+	{
+		MTBHeader header{kGeneralSparse, kReal, 8, 5001, 5001, nz};
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+
+	std::ifstream a(filename, std::ios::binary), b(legacy, std::ios::binary);
+	std::vector<char> bytes(std::istreambuf_iterator<char>(a), {}), legacy_bytes(std::istreambuf_iterator<char>(b), {});
+	MTB_CHECK(bytes == legacy_bytes && bytes.size() == MTB_HEADER_SIZE + nz * 24);
+
+	// Legacy readers
+	std::ifstream ifile(legacy, std::ios::binary);
+	char mat_type, datatype, type_size;
+	uint64_t nrows, ncols, file_nz;
+
+	mtb_read_header(ifile, mat_type, datatype, type_size, nrows, ncols, file_nz);
+	MTB_CHECK(mat_type == kGeneralSparse && datatype == kReal && type_size == 8);
+	MTB_CHECK(nrows == 5001 && ncols == 5001 && file_nz == nz);
+
+	std::vector<Triplet<double>> out(nz);
+	mtb_read_data(ifile, out.data(), nz, mat_type, datatype, type_size);
+	MTB_CHECK(same_entries(out, data));
+
+	// Reader of MTB v2 files
+	ifile.seekg(0);
+	MTBHeader header;
+	mtb_read_header(ifile, header);
+	MTB_CHECK(header.version == 1 && header.index_size == 8 && header.encoding == kPlainEncoding);
+
+	mtb_read_data(ifile, out.data(), header);
+	MTB_CHECK(same_entries(out, data));
+
+	std::remove(filename.c_str());
+	std::remove(legacy.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_round_trip(rng);
+	check_delta_splits(rng);
+	check_unsorted();
+	check_v1(rng);
+
+	return mtb_test_result("test_encoding");
+}
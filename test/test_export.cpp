@@ -0,0 +1,193 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// MTB to MTX exporter (mtb_to_mtx): a MTB file exported to MTX and converted back with the
+// matching options (mtx_to_mtb) must be the same file, for every datatype and value size,
+// symmetric matrices, the encodings and extreme values, with batches formatted by any number
+// of threads.
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+// Entries sorted in a row-major order without repeated indices (at or below the diagonal if
+// `is_lower`), with the given values
+template<typename T, typename F>
+static std::vector<Triplet<T>> make_entries(uint64_t nz, uint64_t nrows, bool is_lower,
+                                            std::mt19937_64 &rng, F &&value)
+{
+	std::vector<Triplet<T>> data;
+
+	for (uint64_t row = 0; row < nrows && data.size() < nz; ++row)
+		for (uint64_t col = rng() % 3; col < (is_lower ? row + 1 : nrows) && data.size() < nz; col += 1 + rng() % 3)
+			data.push_back({(std::ptrdiff_t) row, (std::ptrdiff_t) col, value(data.size())});
+
+	return data;
+}
+
+// Exports the MTB file, checks the header of the MTX file and converts it back
+template<typename T>
+static void check_round_trip(const std::vector<Triplet<T>> &data, const MTBHeader &header,
+                             const MTXConvertOptions &options, const std::string &banner)
+{
+	std::string mtb_file = "test_export.mtb", mtx_file = "test_export.mtx";
+	std::string converted = "test_export_back.mtb";
+
+	{
+		std::ofstream ofile(mtb_file, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+
+	std::vector<char> expected = read_file(mtb_file);
+
+	for (int nthreads : {1, 2, 3})
+	{
+		mtb_to_mtx(mtb_file, mtx_file, nthreads);
+
+		std::ifstream ifile(mtx_file);
+		std::string line;
+		std::getline(ifile, line);
+		MTB_CHECK(line == banner);
+
+		mtx_to_mtb(mtx_file, converted, options);
+		MTB_CHECK(read_file(converted) == expected);
+	}
+
+	std::remove(mtb_file.c_str());
+	std::remove(mtx_file.c_str());
+	std::remove(converted.c_str());
+}
+
+static void check_datatypes(std::mt19937_64 &rng)
+{
+	// More entries than a batch of one thread
+	uint64_t nrows = 2000, nz = 2 * MTX_FORMAT_SIZE + 77;
+	std::string banner = "%%MatrixMarket matrix coordinate ";
+
+	// Real values that need every digit, subnormal values, signed zeros and the limits
+	std::vector<double> extremes = {0.1, 1.0 / 3, -0.0, 0.0, DBL_MAX, -DBL_MAX, DBL_MIN, DBL_TRUE_MIN,
+	                                -5e-310, 123456789.123456789, 1e22, -1e-22};
+
+	auto real = [&](uint64_t i)
+	{
+		if (i < extremes.size()) return extremes[i];
+		return std::uniform_real_distribution<double>(-1e3, 1e3)(rng);
+	};
+
+	std::vector<Triplet<double>> data = make_entries<double>(nz, nrows, false, rng, real);
+
+	// Plain, chunked and delta encodings, narrow indices and checksums
+	MTXConvertOptions options;
+	options.sort_data = false;
+
+	MTBHeader header{kGeneralSparse, kReal, 8, nrows, nrows, data.size()};
+	check_round_trip(data, header, options, banner + "real general");
+
+	header.flags = kChecksum;
+	header.index_size = 2;
+	options.checksum = true;
+	options.index_size = 2;
+	check_round_trip(data, header, options, banner + "real general");
+
+	header.encoding = kChunkedEncoding;
+	options.compression = true;
+	check_round_trip(data, header, options, banner + "real general");
+
+	header.encoding = kDeltaEncoding;
+	options.compression = false;
+	options.delta_encoding = true;
+	options.sort_data = true;
+	check_round_trip(data, header, options, banner + "real general");
+
+	// Symmetric matrix (the lower triangle)
+	std::vector<Triplet<double>> lower = make_entries<double>(nz, nrows, true, rng, real);
+	header = MTBHeader{kSymmetricSparse, kReal, 8, nrows, nrows, lower.size()};
+	options = MTXConvertOptions();
+	options.sort_data = false;
+	check_round_trip(lower, header, options, banner + "real symmetric");
+
+	// Single precision values
+	std::vector<Triplet<double>> floats = make_entries<double>(nz, nrows, false, rng, [&](uint64_t i)
+	{
+		if (i == 0) return (double) FLT_MAX;
+		if (i == 1) return (double) FLT_TRUE_MIN;
+		return (double) std::uniform_real_distribution<float>(-1, 1)(rng);
+	});
+
+	header = MTBHeader{kGeneralSparse, kReal, 4, nrows, nrows, floats.size()};
+	options.narrow_values = true;
+	check_round_trip(floats, header, options, banner + "real general");
+
+	// Integers with 2 and 4 bytes
+	for (char type_size : {2, 4})
+	{
+		int limit = (type_size == 2) ? SHRT_MAX : INT_MAX;
+		std::vector<Triplet<int>> integers = make_entries<int>(nz, nrows, false, rng, [&](uint64_t i)
+		{
+			if (i == 0) return limit;
+			if (i == 1) return -limit - 1;
+			return (int) (rng() % 20000) - 10000;
+		});
+
+		header = MTBHeader{kGeneralSparse, kInteger, type_size, nrows, nrows, integers.size()};
+		check_round_trip(integers, header, options, banner + "integer general");
+	}
+
+	// Complex values
+	std::vector<Triplet<std::complex<double>>> complex = make_entries<std::complex<double>>(nz, nrows, false, rng,
+	                                                                                        [&](uint64_t i)
+	{
+		return std::complex<double>(real(i), real(i + 3));
+	});
+
+	header = MTBHeader{kGeneralSparse, kComplex, 8, nrows, nrows, complex.size()};
+	options.narrow_values = false;
+	check_round_trip(complex, header, options, banner + "complex general");
+
+	// Pattern matrix and an empty matrix
+	std::vector<Triplet<int>> pattern = make_entries<int>(nz, nrows, false, rng, [](uint64_t) { return 1; });
+	header = MTBHeader{kGeneralSparse, kPattern, 0, nrows, nrows, pattern.size()};
+	check_round_trip(pattern, header, options, banner + "pattern general");
+
+	header = MTBHeader{kGeneralSparse, kReal, 8, nrows, nrows, 0};
+	check_round_trip(std::vector<Triplet<double>>(), header, options, banner + "real general");
+
+	MTB_CHECK_THROWS(mtb_to_mtx("test_export_missing.mtb", "test_export.mtx"));
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	// Hide the progress of the converter (the failed checks are printed with stdio)
+	std::cerr.rdbuf(nullptr);
+
+	check_datatypes(rng);
+
+	return mtb_test_result("test_export");
+}
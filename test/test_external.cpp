@@ -0,0 +1,212 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// External sort of the converter (memory_budget): matrices split in several sorted runs, which
+// are merged through buffers smaller than the runs, create the same MTB file as the in-memory
+// sort (or the same matrix with the delta encoding) with every encoding, the row index, narrow
+// values and symmetry detection, including a repeated index found in the merge, which restarts
+// it as a general matrix. The temporary files of the runs are removed.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+static bool file_exists(const std::string &filename)
+{
+	return std::ifstream(filename).good();
+}
+
+static void write_mtx(const std::string &filename, const std::vector<Triplet<double>> &entries,
+                      uint64_t nrows, const std::string &field)
+{
+	std::ofstream ofile(filename);
+	ofile << "%%MatrixMarket matrix coordinate " << field << " general\n";
+	ofile << nrows << " " << nrows << " " << entries.size() << "\n";
+
+	char line[128];
+
+	for (const Triplet<double> &entry : entries)
+	{
+		int size = (field == "pattern")
+		           ? std::snprintf(line, sizeof(line), "%td %td\n", entry.row + 1, entry.col + 1)
+		           : std::snprintf(line, sizeof(line), "%td %td %.17g\n", entry.row + 1, entry.col + 1, entry.val);
+		ofile.write(line, size);
+	}
+}
+
+// Reads the header and the entries of the file (without the mirrors of symmetric matrices)
+static std::vector<Triplet<double>> read_matrix(const std::string &filename, MTBHeader &header)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	mtb_read_header(ifile, header);
+
+	std::vector<Triplet<double>> data(header.nz);
+	mtb_read_data(ifile, data.data(), header, kLowerTriangle);
+
+	return data;
+}
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Converts the MTX file with the in-memory sort and with the external sort (one run per
+// MTX_MIN_RUN_SIZE entries and larger runs), and compares the MTB files. With the delta
+// encoding, a row split by a flush of the merge starts a new run, so only the header and the
+// entries are compared.
+static void check_conversion(const MTXConvertOptions &options)
+{
+	std::string mtx_file = "test_external.mtx", mtb_file = "test_external.mtb";
+	std::string reference = "test_external_ref.mtb";
+
+	MTXConvertOptions in_memory = options;
+	in_memory.memory_budget = 0;
+	mtx_to_mtb(mtx_file, reference, in_memory);
+
+	std::vector<char> expected = read_file(reference);
+
+	for (uint64_t run_size : {MTX_MIN_RUN_SIZE, 3 * MTX_MIN_RUN_SIZE / 2})
+	{
+		MTXConvertOptions external = options;
+		external.memory_budget = 2 * run_size * sizeof(Triplet<double>);
+		mtx_to_mtb(mtx_file, mtb_file, external);
+
+		if (options.delta_encoding)
+		{
+			MTBHeader header, expected_header;
+			MTB_CHECK(same_entries(read_matrix(mtb_file, header), read_matrix(reference, expected_header)));
+			MTB_CHECK(header.nz == expected_header.nz && header.mat_type == expected_header.mat_type
+			          && header.type_size == expected_header.type_size
+			          && header.index_size == expected_header.index_size && header.flags == expected_header.flags);
+		}
+		else
+			MTB_CHECK(read_file(mtb_file) == expected);
+
+		MTB_CHECK(!file_exists(mtb_file + ".run0") && !file_exists(mtb_file + ".run1"));
+	}
+
+	std::remove(mtb_file.c_str());
+	std::remove(reference.c_str());
+}
+
+static void check_matrices(std::mt19937_64 &rng)
+{
+	std::string mtx_file = "test_external.mtx";
+	uint64_t nrows = 3000;
+
+	// Lower triangle without repeated indices (more than four runs of the smallest size),
+	// with empty rows
+	std::vector<Triplet<double>> lower;
+
+	for (uint64_t row = 0; row < nrows; ++row)
+		for (uint64_t col = rng() % 20; col <= row; col += 1 + rng() % 40)
+			if (row % 100 != 7) lower.push_back({(std::ptrdiff_t) row, (std::ptrdiff_t) col, (double) (rng() % 200) - 100});
+
+	// General matrix with more than twice as many entries, and its symmetric version
+	std::vector<Triplet<double>> general = lower, symmetric = lower;
+
+	for (const Triplet<double> &entry : lower)
+	{
+		if (entry.col == entry.row) continue;
+
+		general.push_back({entry.col, entry.row, (double) (rng() % 200) - 100});
+		symmetric.push_back({entry.col, entry.row, entry.val});
+	}
+
+	std::shuffle(general.begin(), general.end(), rng);
+	std::shuffle(symmetric.begin(), symmetric.end(), rng);
+
+	// General matrix with every option
+	write_mtx(mtx_file, general, nrows, "real");
+
+	for (char index_size : {0, 8})
+	{
+		for (bool checksum : {false, true})
+		{
+			MTXConvertOptions options;
+			options.index_size = index_size;
+			options.checksum = checksum;
+			options.nthreads = 3;
+
+			check_conversion(options);
+
+			options.narrow_values = true;
+			options.row_index = true;
+			check_conversion(options);
+
+			options.row_index = false;
+			options.delta_encoding = true;
+			check_conversion(options);
+
+			options.delta_encoding = false;
+			options.compression = true;
+			check_conversion(options);
+		}
+	}
+
+	write_mtx(mtx_file, general, nrows, "pattern");
+	check_conversion(MTXConvertOptions());
+
+	// Symmetric matrix, stored as its lower triangle
+	MTXConvertOptions options;
+	options.detect_symmetry = true;
+	options.index_size = 0;
+
+	write_mtx(mtx_file, symmetric, nrows, "real");
+	check_conversion(options);
+
+	options.row_index = true;
+	check_conversion(options);
+
+	// A repeated index (with the same value, so the order of the repeated entries does not
+	// matter) in the middle of the matrix
+	symmetric.push_back(lower[lower.size() / 2]);
+	std::shuffle(symmetric.begin(), symmetric.end(), rng);
+	write_mtx(mtx_file, symmetric, nrows, "real");
+	check_conversion(options);
+
+	options.row_index = false;
+	options.compression = true;
+	check_conversion(options);
+
+	std::remove(mtx_file.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	// Hide the progress of the converter (the failed checks are printed with stdio)
+	std::cerr.rdbuf(nullptr);
+
+	check_matrices(rng);
+
+	return mtb_test_result("test_external");
+}
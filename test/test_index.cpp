@@ -0,0 +1,221 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Row index (kRowIndex) written by the serial writer, the parallel writer and the converter
+// (-r), and the reads of ranges of rows (mtb_read_rows): empty rows and ranges, the first and
+// last rows, narrow indices, checksums and symmetric files.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_index.hpp"
+#include "../include/mtb_parallel.hpp"
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Reads many ranges of rows and compares them with the entries of the file (sorted by row)
+static void check_ranges(const std::string &filename, const std::vector<Triplet<double>> &data,
+                         uint64_t nrows, std::mt19937_64 &rng)
+{
+	std::vector<std::pair<uint64_t, uint64_t>> ranges = {{0, nrows}, {0, 0}, {nrows, nrows}, {0, 1},
+	                                                     {nrows - 1, nrows}, {5, 6}, {5, 5}};
+
+	for (int k = 0; k < 50; ++k)
+	{
+		uint64_t a = rng() % (nrows + 1), b = rng() % (nrows + 1);
+		ranges.push_back({std::min(a, b), std::max(a, b)});
+	}
+
+	bool is_same = true;
+
+	for (auto [row_begin, row_end] : ranges)
+	{
+		std::vector<Triplet<double>> rows = {{-1, -1, -1.0}}, expected;
+
+		for (const Triplet<double> &entry : data)
+			if ((uint64_t) entry.row >= row_begin && (uint64_t) entry.row < row_end) expected.push_back(entry);
+
+		mtb_read_rows(filename, row_begin, row_end, rows);
+		is_same &= same_entries(rows, expected);
+	}
+
+	MTB_CHECK(is_same);
+}
+
+static void check_writers(std::mt19937_64 &rng)
+{
+	std::string filename = "test_index.mtb";
+	uint64_t nrows = 2000;
+
+	// Sorted entries with empty rows (row 5, the first rows and the last rows among them)
+	for (uint64_t nz : {0, 10, 2 * MTB_CHECKSUM_BLOCK + 77})
+	{
+		std::vector<Triplet<double>> data(nz);
+
+		for (Triplet<double> &entry : data)
+		{
+			entry.row = 3 + rng() % (nrows - 10);
+			if (entry.row == 5) entry.row = 6;
+			entry.col = rng() % (entry.row + 1);
+			entry.val = std::uniform_real_distribution<double>(-1, 1)(rng);
+		}
+
+		std::sort(data.begin(), data.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+		{
+			return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+		});
+
+		for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+		{
+			for (char index_size : {2, 8})
+			{
+				for (bool checksum : {false, true})
+				{
+					MTBHeader header{mat_type, kReal, 8, nrows, nrows, nz};
+					header.index_size = index_size;
+					header.flags = kRowIndex | (checksum ? kChecksum : 0);
+
+					// Serial writer
+					{
+						std::ofstream ofile(filename, std::ios::binary);
+						mtb_write_header(ofile, header);
+						mtb_write_data(ofile, data.data(), header);
+						mtb_write_row_index(ofile, data.data(), nz, nrows);
+					}
+
+					check_ranges(filename, data, nrows, rng);
+
+					// Parallel writer
+					for (int nthreads : {1, 3})
+					{
+						mtb_write_data_parallel(filename, data.data(), header, nthreads);
+						check_ranges(filename, data, nrows, rng);
+					}
+				}
+			}
+		}
+	}
+
+	std::remove(filename.c_str());
+}
+
+static void check_converter(std::mt19937_64 &rng)
+{
+	std::string mtx_file = "test_index.mtx", mtb_file = "test_index.mtb";
+	uint64_t nrows = 300;
+	std::vector<Triplet<double>> data;
+
+	// Entries in a random order in the MTX file
+	for (uint64_t row = 0; row < nrows; ++row)
+		for (uint64_t col = 0; col < nrows; col += 1 + rng() % 40)
+			if (row % 10 != 4) data.push_back({(std::ptrdiff_t) row, (std::ptrdiff_t) col, (double) (rng() % 100)});
+
+	std::vector<Triplet<double>> shuffled = data;
+	std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+	{
+		std::ofstream ofile(mtx_file);
+		ofile << "%%MatrixMarket matrix coordinate real general\n";
+		ofile << nrows << " " << nrows << " " << data.size() << "\n";
+
+		for (const Triplet<double> &entry : shuffled)
+			ofile << entry.row + 1 << " " << entry.col + 1 << " " << entry.val << "\n";
+	}
+
+	// Sorted in memory and with the external sort, with checksums
+	for (uint64_t memory_budget : {uint64_t(0), uint64_t(1)})
+	{
+		for (bool checksum : {false, true})
+		{
+			MTXConvertOptions options;
+			options.row_index = true;
+			options.index_size = 0;
+			options.checksum = checksum;
+			options.memory_budget = memory_budget;
+
+			mtx_to_mtb(mtx_file, mtb_file, options);
+			check_ranges(mtb_file, data, nrows, rng);
+		}
+	}
+
+	std::remove(mtx_file.c_str());
+	std::remove(mtb_file.c_str());
+}
+
+static void check_errors()
+{
+	std::string filename = "test_index.mtb";
+	std::vector<Triplet<double>> data = {{0, 0, 1.0}, {2, 1, 2.0}, {2, 2, 3.0}}, rows;
+	MTBHeader header{kGeneralSparse, kReal, 8, 3, 3, 3};
+
+	// No row index
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+	MTB_CHECK_THROWS(mtb_read_rows(filename, 0, 1, rows));
+
+	// Rows out of bounds
+	header.flags = kRowIndex;
+	mtb_write_data_parallel(filename, data.data(), header, 1);
+	mtb_read_rows(filename, 2, 3, rows);
+	MTB_CHECK(rows.size() == 2 && rows[0].col == 1 && rows[1].col == 2);
+	MTB_CHECK_THROWS(mtb_read_rows(filename, 0, 4, rows));
+	MTB_CHECK_THROWS(mtb_read_rows(filename, 2, 1, rows));
+
+	// A position after the last entry in the row index
+	{
+		std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+		uint64_t position = 4;
+		file.seekp(mtb_row_index_offset(header) + 2 * sizeof(uint64_t));
+		file.write((const char *) &position, sizeof(uint64_t));
+	}
+	MTB_CHECK_THROWS(mtb_read_rows(filename, 2, 3, rows));
+
+	// The index requires the entries sorted by row and within the bounds
+	std::vector<Triplet<double>> unsorted = {{2, 0, 1.0}, {1, 1, 2.0}}, outside = {{0, 0, 1.0}, {3, 0, 2.0}};
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		MTB_CHECK_THROWS(mtb_write_row_index(ofile, unsorted.data(), 2, 3));
+		MTB_CHECK_THROWS(mtb_write_row_index(ofile, outside.data(), 2, 3));
+	}
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	// Hide the progress of the converter (the failed checks are printed with stdio)
+	std::cerr.rdbuf(nullptr);
+
+	check_writers(rng);
+	check_converter(rng);
+	check_errors();
+
+	return mtb_test_result("test_index");
+}
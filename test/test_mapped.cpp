@@ -0,0 +1,201 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Access to the entries of a MappedMatrix (index sizes, value sizes, datatypes and symmetric
+// files), the access hints, the move operations, and the rejection of files that cannot be
+// mapped (missing, truncated or with a variable-size encoding).
+
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_mapped.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+template<typename T>
+static void write_matrix(const std::string &filename, const std::vector<Triplet<T>> &data,
+                         const MTBHeader &header)
+{
+	std::ofstream ofile(filename, std::ios::binary);
+	mtb_write_header(ofile, header);
+	mtb_write_data(ofile, data.data(), header);
+}
+
+// Writes the entries with the given header and checks every accessor of the mapping
+template<typename T>
+static void check_entries(const std::vector<Triplet<T>> &data, const MTBHeader &header)
+{
+	std::string filename = "test_mapped.mtb";
+	write_matrix(filename, data, header);
+
+	for (auto access : {MappedMatrix::kNormal, MappedMatrix::kSequential, MappedMatrix::kRandom,
+	                    MappedMatrix::kWillNeed})
+	{
+		MappedMatrix matrix(filename, access);
+
+		MTB_CHECK(matrix.mat_type() == header.mat_type && matrix.datatype() == header.datatype);
+		MTB_CHECK(matrix.type_size() == header.type_size && matrix.header().index_size == header.index_size);
+		MTB_CHECK(matrix.nrows() == header.nrows && matrix.ncols() == header.ncols && matrix.nz() == data.size());
+		MTB_CHECK(matrix.entry_size() == mtb_entry_size(header));
+
+		bool is_same = true;
+
+		for (uint64_t i = 0; i < data.size(); ++i)
+		{
+			Triplet<T> entry = matrix.entry<T>(i);
+
+			is_same &= (matrix.row(i) == (uint64_t) data[i].row && matrix.col(i) == (uint64_t) data[i].col);
+			is_same &= (matrix.value<T>(i) == data[i].val);
+			is_same &= (entry.row == data[i].row && entry.col == data[i].col && entry.val == data[i].val);
+		}
+
+		MTB_CHECK(is_same);
+
+		// Hints for ranges that are not aligned with the pages, clamped or empty
+		matrix.advise(MappedMatrix::kWillNeed, data.size() / 3, data.size() / 2);
+		matrix.advise(MappedMatrix::kRandom, data.size() / 2);
+		matrix.advise(MappedMatrix::kNormal, data.size(), data.size() + 10);
+	}
+
+	std::remove(filename.c_str());
+}
+
+static void check_datatypes(std::mt19937_64 &rng)
+{
+	uint64_t nz = 5000, nrows = 300;
+	std::vector<Triplet<double>> reals(nz), lower;
+	std::vector<Triplet<int>> integers(nz);
+	std::vector<Triplet<std::complex<double>>> complexes(nz);
+
+	for (uint64_t i = 0; i < nz; ++i)
+	{
+		std::ptrdiff_t row = rng() % nrows, col = rng() % nrows;
+		double val = (double) (rng() % 2000) * 0.25 - 250;
+
+		reals[i] = {row, col, val};
+		integers[i] = {row, col, (int) (rng() % 60000) - 30000};
+		complexes[i] = {row, col, {val, -val * 0.5}};
+
+		if (col <= row) lower.push_back(reals[i]);
+	}
+
+	// MTB v1 file, narrow indices and values (MTB v2), and an empty matrix
+	check_entries(reals, MTBHeader{kGeneralSparse, kReal, 8, nrows, nrows, nz});
+
+	for (char index_size : {1, 2, 4})
+	{
+		MTBHeader header{kGeneralSparse, kReal, 4, nrows, nrows, nz};
+		header.index_size = index_size;
+
+		if (index_size == 1)
+		{
+			// The indices of the first 256 rows and columns fit in 1 byte
+			std::vector<Triplet<double>> small;
+			for (const Triplet<double> &entry : reals)
+				if (entry.row < 256 && entry.col < 256) small.push_back(entry);
+
+			header.nrows = header.ncols = 256;
+			header.nz = small.size();
+			check_entries(small, header);
+
+		} else
+		{
+			check_entries(reals, header);
+		}
+	}
+
+	check_entries(std::vector<Triplet<double>>(), MTBHeader{kGeneralSparse, kReal, 8, nrows, nrows, 0});
+
+	// Only the lower triangle of symmetric matrices
+	check_entries(lower, MTBHeader{kSymmetricSparse, kReal, 8, nrows, nrows, lower.size()});
+
+	for (char type_size : {2, 4})
+		check_entries(integers, MTBHeader{kGeneralSparse, kInteger, type_size, nrows, nrows, nz});
+
+	check_entries(complexes, MTBHeader{kGeneralSparse, kComplex, 8, nrows, nrows, nz});
+}
+
+static void check_move()
+{
+	std::string filename = "test_mapped.mtb";
+	std::vector<Triplet<double>> data = {{0, 1, 1.5}, {2, 0, -3.0}};
+	write_matrix(filename, data, MTBHeader{kGeneralSparse, kReal, 8, 3, 3, 2});
+
+	MappedMatrix a(filename);
+	MappedMatrix b(std::move(a));
+	MTB_CHECK(a.data() == nullptr && b.data() != nullptr);
+	MTB_CHECK(b.nz() == 2 && b.value<double>(1) == -3.0);
+
+	// Hints on a moved-from mapping are ignored
+	a.advise(MappedMatrix::kWillNeed);
+
+	MappedMatrix c(filename);
+	c = std::move(b);
+	MTB_CHECK(b.data() == nullptr && c.row(1) == 2 && c.col(0) == 1);
+
+	// The mapping stays valid after the file is removed
+	std::remove(filename.c_str());
+	MTB_CHECK(c.value<double>(0) == 1.5);
+}
+
+static void check_errors()
+{
+	std::string filename = "test_mapped.mtb";
+	std::vector<Triplet<double>> data = {{0, 1, 1.5}, {1, 0, -3.0}, {2, 2, 4.0}};
+	MTBHeader header{kGeneralSparse, kReal, 8, 3, 3, 3};
+
+	MTB_CHECK_THROWS(MappedMatrix("test_mapped_missing.mtb"));
+
+	// Shorter than the header
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		ofile.write("\0\0\0\0", 4);
+	}
+	MTB_CHECK_THROWS(MappedMatrix{filename});
+
+	// The last entry is truncated
+	write_matrix(filename, data, header);
+	{
+		std::ifstream ifile(filename, std::ios::binary);
+		std::vector<char> bytes(MTB_HEADER_SIZE + 3 * mtb_entry_size(header) - 1);
+		ifile.read(bytes.data(), bytes.size());
+
+		std::ofstream ofile(filename, std::ios::binary);
+		ofile.write(bytes.data(), bytes.size());
+	}
+	MTB_CHECK_THROWS(MappedMatrix{filename});
+
+	// Entries with a variable size
+	for (char encoding : {kDeltaEncoding, kChunkedEncoding})
+	{
+		MTBHeader encoded = header;
+		encoded.encoding = encoding;
+		encoded.version = 2;
+		write_matrix(filename, data, encoded);
+		MTB_CHECK_THROWS(MappedMatrix{filename});
+	}
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_datatypes(rng);
+	check_move();
+	check_errors();
+
+	return mtb_test_result("test_mapped");
+}
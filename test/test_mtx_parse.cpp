@@ -0,0 +1,195 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Number and line parsers of MTX files (mtx_parse.hpp and mtx_parse_lines), compared with
+// strtoull/strtod. The inputs are copied to buffers of their exact size, so a read past
+// `end` is caught by the address sanitizer (-fsanitize=address).
+
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+// Copy of a string without the null terminator
+static std::unique_ptr<char[]> exact_copy(const std::string &str)
+{
+	std::unique_ptr<char[]> copy(new char[str.size()]);
+	std::memcpy(copy.get(), str.data(), str.size());
+
+	return copy;
+}
+
+static void check_uint()
+{
+	std::mt19937_64 rng(42);
+
+	for (int ndigits = 1; ndigits <= 19; ++ndigits)
+	{
+		for (int trail = 0; trail <= 9; ++trail)
+		{
+			std::string digits = std::to_string(1 + rng() % 9);
+			while ((int) digits.size() < ndigits)
+				digits += (char) ('0' + rng() % 10);
+
+			// The integer ends exactly at `end` if there are no trailing characters
+			std::string str = digits + std::string(trail, ' ');
+			auto buf = exact_copy(str);
+			uint64_t val;
+
+			const char *next = mtx_parse_uint(buf.get(), buf.get() + str.size(), val);
+			MTB_CHECK(val == std::strtoull(digits.c_str(), nullptr, 10));
+			MTB_CHECK(next == buf.get() + ndigits);
+		}
+	}
+
+	// Maximum number of digits and leading zeros
+	std::string max = "9999999999999999999", zeros = "00000000000000000012";
+	uint64_t val;
+	mtx_parse_uint(max.data(), max.data() + max.size(), val);
+	MTB_CHECK(val == 9999999999999999999ull);
+
+	// More than 19 digits, at the end of the buffer or not
+	std::string longer = "12345678901234567890";
+	MTB_CHECK_THROWS(mtx_parse_uint(longer.data(), longer.data() + longer.size(), val));
+	longer += " 1\n";
+	MTB_CHECK_THROWS(mtx_parse_uint(longer.data(), longer.data() + longer.size(), val));
+	MTB_CHECK_THROWS(mtx_parse_uint(zeros.data(), zeros.data() + zeros.size(), val));
+
+	// No digits
+	std::string letters = "abc";
+	MTB_CHECK_THROWS(mtx_parse_uint(letters.data(), letters.data() + letters.size(), val));
+	MTB_CHECK_THROWS(mtx_parse_uint(letters.data(), letters.data(), val));
+}
+
+static void check_int()
+{
+	for (std::string str : {"-42", "+42", "42", "-9223372036854775807", "0"})
+	{
+		auto buf = exact_copy(str);
+		int64_t val;
+
+		const char *next = mtx_parse_int(buf.get(), buf.get() + str.size(), val);
+		MTB_CHECK(val == std::strtoll(str.c_str(), nullptr, 10));
+		MTB_CHECK(next == buf.get() + str.size());
+	}
+
+	std::string sign = "-";
+	int64_t val;
+	MTB_CHECK_THROWS(mtx_parse_int(sign.data(), sign.data() + sign.size(), val));
+}
+
+static void check_real()
+{
+	std::mt19937_64 rng(7);
+	const char *formats[] = {"%.17g", "%.6e", "%.3E", "%f", "%+.10g"};
+	char str[512];
+
+	for (int i = 0; i < 10000; ++i)
+	{
+		uint64_t bits = rng();
+		double val;
+		std::memcpy(&val, &bits, sizeof(double));
+		if (!std::isfinite(val)) continue;
+
+		int size = std::snprintf(str, sizeof(str), formats[i % 5], val);
+		auto buf = exact_copy(std::string(str, size));
+		double parsed;
+
+		const char *next = mtx_parse_real(buf.get(), buf.get() + size, parsed);
+		MTB_CHECK(parsed == std::strtod(str, nullptr));
+		MTB_CHECK(next == buf.get() + size);
+	}
+
+	// Out of the range of double: underflow to zero and overflow to infinity
+	struct { const char *str; double val; } limits[] = {
+		{"1e-400", 0.0}, {"-1E-400", -0.0}, {"1e400", HUGE_VAL}, {"-1e+400", -HUGE_VAL},
+		{"+1e400", HUGE_VAL}, {"4.9e-324", 4.9e-324}
+	};
+
+	for (auto &limit : limits)
+	{
+		std::string number = limit.str;
+		auto buf = exact_copy(number);
+		double parsed;
+
+		const char *next = mtx_parse_real(buf.get(), buf.get() + number.size(), parsed);
+		MTB_CHECK(parsed == limit.val && std::signbit(parsed) == std::signbit(limit.val));
+		MTB_CHECK(next == buf.get() + number.size());
+	}
+
+	std::string wrong = "+-1";
+	double parsed;
+	MTB_CHECK_THROWS(mtx_parse_real(wrong.data(), wrong.data() + wrong.size(), parsed));
+	MTB_CHECK_THROWS(mtx_parse_real(wrong.data() + 1, wrong.data() + 1, parsed));
+}
+
+template<typename T>
+static std::vector<Triplet<T>> parse_lines(const std::string &text, bool is_weighted)
+{
+	auto buf = exact_copy(text);
+	std::vector<Triplet<T>> out(std::count(text.begin(), text.end(), '\n') + 1);
+
+	out.resize(mtx_parse_lines(buf.get(), buf.get() + text.size(), out.data(), is_weighted));
+	return out;
+}
+
+template<typename T>
+static bool same_entries(const std::vector<Triplet<T>> &a, const std::vector<Triplet<T>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+static void check_lines()
+{
+	// Tabs, repeated spaces, blank lines, CRLF, E notation and a leading plus sign
+	std::string clean = "1 2 0.5\n3 4 -250\n5 6 1000\n7 8 0.0125\n";
+	std::string messy = "1\t2\t5e-1\r\n  3   4  -2.5E+2 \r\n\r\n5 \t 6\t+1e3\n7 8 +0.0125";
+
+	MTB_CHECK(same_entries(parse_lines<double>(messy, true), parse_lines<double>(clean, true)));
+	MTB_CHECK(parse_lines<double>(clean, true).size() == 4);
+
+	std::string clean_int = "1 2 -3\n4 5 6\n";
+	std::string messy_int = "1\t 2 \t-3\r\n\n4 5 +6\r\n";
+	MTB_CHECK(same_entries(parse_lines<int>(messy_int, true), parse_lines<int>(clean_int, true)));
+
+	std::string clean_cplx = "1 1 1.5 -2\n2 1 0 1e-3\n";
+	std::string messy_cplx = "1 1\t+1.5  -2E0\r\n2\t1 0 1E-3";
+	MTB_CHECK(same_entries(parse_lines<std::complex<double>>(messy_cplx, true),
+	                       parse_lines<std::complex<double>>(clean_cplx, true)));
+
+	std::string pattern = "1 2\r\n3\t4\n\n5 6";
+	auto entries = parse_lines<int>(pattern, false);
+	MTB_CHECK(entries.size() == 3 && entries[2].row == 4 && entries[2].col == 5 && entries[2].val == 1);
+
+	// Missing numbers and an index with too many digits
+	MTB_CHECK_THROWS(parse_lines<double>("1 2\n", true));
+	MTB_CHECK_THROWS(parse_lines<double>("1 x 3\n", true));
+	MTB_CHECK_THROWS(parse_lines<int>("1 123456789012345678901\n", false));
+}
+
+int main()
+{
+	check_uint();
+	check_int();
+	check_real();
+	check_lines();
+
+	return mtb_test_result("test_mtx_parse");
+}
@@ -0,0 +1,198 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Lossless narrowing of the values (mtb_min_type_size and the -n option of the converter). Real
+// and complex values that are exact in a float take 4 bytes and integers take 1, 2 or 4 bytes,
+// while values such as 0.1 and 1e-300 keep 8 bytes. The converted files are read back and must
+// have exactly the values (bitwise) of the MTX file, with the sorted, unsorted and external paths.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+template<typename T>
+static char min_type_size(std::vector<T> values, char datatype)
+{
+	std::vector<Triplet<T>> data;
+	for (const T &val : values)
+		data.push_back({0, 0, val});
+
+	return mtb_min_type_size(data.data(), data.size(), datatype);
+}
+
+static void check_min_type_size()
+{
+	double inf = std::numeric_limits<double>::infinity(), nan = std::numeric_limits<double>::quiet_NaN();
+
+	// Reals: exact binary fractions, powers of two and float subnormals fit in a float
+	MTB_CHECK(min_type_size<double>({}, kReal) == 4);
+	MTB_CHECK(min_type_size<double>({0.5, -2.0, 1024.25, -0.0, std::ldexp(1.0, 100), std::ldexp(1.0, -140), inf}, kReal) == 4);
+	MTB_CHECK(min_type_size<double>({0.5, 0.1}, kReal) == 8);
+	MTB_CHECK(min_type_size<double>({1e-300}, kReal) == 8);
+	MTB_CHECK(min_type_size<double>({1e300}, kReal) == 8);
+	MTB_CHECK(min_type_size<double>({16777217.0}, kReal) == 8);
+	MTB_CHECK(min_type_size<double>({nan}, kReal) == 8);
+
+	// Complex values: both parts must fit
+	using Complex = std::complex<double>;
+	MTB_CHECK(min_type_size<Complex>({{1.5, -0.25}, {0, 3}}, kComplex) == 4);
+	MTB_CHECK(min_type_size<Complex>({{1.5, 0.1}}, kComplex) == 8);
+	MTB_CHECK(min_type_size<Complex>({{0.1, 1.5}}, kComplex) == 8);
+
+	// Integers: the range of the values
+	MTB_CHECK(min_type_size<int>({}, kInteger) == 1);
+	MTB_CHECK(min_type_size<int>({0, 127, -128}, kInteger) == 1);
+	MTB_CHECK(min_type_size<int>({128}, kInteger) == 2);
+	MTB_CHECK(min_type_size<int>({-129}, kInteger) == 2);
+	MTB_CHECK(min_type_size<int>({32767, -32768}, kInteger) == 2);
+	MTB_CHECK(min_type_size<int>({32768}, kInteger) == 4);
+	MTB_CHECK(min_type_size<int>({-40000}, kInteger) == 4);
+	MTB_CHECK(min_type_size<int64_t>({int64_t(1) << 40}, kInteger) == 8);
+	MTB_CHECK(min_type_size<int64_t>({INT32_MIN}, kInteger) == 4);
+
+	MTB_CHECK(min_type_size<int>({1, 2}, kPattern) == 0);
+}
+
+static void write_value(std::ofstream &ofile, int val) { ofile << val; }
+
+static void write_value(std::ofstream &ofile, double val)
+{
+	char str[32];
+	ofile.write(str, std::snprintf(str, sizeof(str), "%.17g", val));
+}
+
+static void write_value(std::ofstream &ofile, const std::complex<double> &val)
+{
+	write_value(ofile, val.real());
+	ofile << " ";
+	write_value(ofile, val.imag());
+}
+
+// Order of the entries, with the values compared bitwise
+template<typename T>
+static bool less(const Triplet<T> &a, const Triplet<T> &b)
+{
+	if (a.row != b.row) return a.row < b.row;
+	if (a.col != b.col) return a.col < b.col;
+	return std::memcmp(&a.val, &b.val, sizeof(T)) < 0;
+}
+
+// Converts a matrix with the given values (at random positions) with every path, and checks the
+// value size and the values read back
+template<typename T>
+static void check_conversion(const char *datatype, const std::vector<T> &values, char type_size,
+                             std::mt19937_64 &rng)
+{
+	std::string mtx_file = "test_narrow.mtx", mtb_file = "test_narrow.mtb";
+	uint64_t nrows = 1000;
+
+	// More entries than a run of the external sort, which repeat the given values
+	std::vector<Triplet<T>> entries(2 * MTX_MIN_RUN_SIZE + 7);
+
+	for (uint64_t i = 0; i < entries.size(); ++i)
+		entries[i] = {(std::ptrdiff_t) (rng() % nrows), (std::ptrdiff_t) (rng() % nrows), values[i % values.size()]};
+
+	{
+		std::ofstream ofile(mtx_file);
+		ofile << "%%MatrixMarket matrix coordinate " << datatype << " general\n";
+		ofile << nrows << " " << nrows << " " << entries.size() << "\n";
+
+		for (const Triplet<T> &entry : entries)
+		{
+			ofile << entry.row + 1 << " " << entry.col + 1 << " ";
+			write_value(ofile, entry.val);
+			ofile << "\n";
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), less<T>);
+
+	// Sorted in memory, unsorted and with the external sort
+	for (int path = 0; path < 3; ++path)
+	{
+		MTXConvertOptions options;
+		options.narrow_values = true;
+		options.sort_data = (path != 1);
+		options.memory_budget = (path == 2) ? 1 : 0;
+		options.nthreads = 2;
+
+		mtx_to_mtb(mtx_file, mtb_file, options);
+
+		std::ifstream ifile(mtb_file, std::ios::binary);
+		MTBHeader header;
+		mtb_read_header(ifile, header);
+		mtb_check_header(header);
+		MTB_CHECK(header.type_size == type_size && header.nz == entries.size());
+
+		uint64_t data_begin = ifile.tellg();
+		std::vector<Triplet<T>> data(header.nz);
+		mtb_read_data(ifile, data.data(), header);
+		std::sort(data.begin(), data.end(), less<T>);
+
+		MTB_CHECK(std::equal(data.begin(), data.end(), entries.begin(), entries.end(), [](const Triplet<T> &a, const Triplet<T> &b)
+		{
+			return !less(a, b) && !less(b, a);
+		}));
+
+		// The entries take the narrowed size in the file
+		ifile.clear();
+		ifile.seekg(0, std::ios::end);
+		MTB_CHECK((uint64_t) ifile.tellg() == data_begin + header.nz * mtb_entry_size(header));
+	}
+
+	std::remove(mtx_file.c_str());
+	std::remove(mtb_file.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	// Hide the progress of the converter (the failed checks are printed with stdio)
+	std::cerr.rdbuf(nullptr);
+
+	check_min_type_size();
+
+	std::vector<double> exact;
+	for (int k = -500; k <= 500; ++k)
+		exact.push_back(k * 0.375);
+	exact.insert(exact.end(), {-0.0, std::ldexp(1.0, 100), std::ldexp(-1.0, -140), 1e30f});
+
+	check_conversion<double>("real", exact, 4, rng);
+
+	for (double inexact : {0.1, 1e-300})
+	{
+		std::vector<double> values = exact;
+		values.push_back(inexact);
+		check_conversion<double>("real", values, 8, rng);
+	}
+
+	std::vector<std::complex<double>> complex_exact = {{1.5, -0.25}, {0, 3}, {-0.0, 1e30f}};
+	check_conversion<std::complex<double>>("complex", complex_exact, 4, rng);
+	complex_exact.push_back({2.0, 0.1});
+	check_conversion<std::complex<double>>("complex", complex_exact, 8, rng);
+
+	check_conversion<int>("integer", {-128, 0, 5, 127}, 1, rng);
+	check_conversion<int>("integer", {-128, 0, 5, 200}, 2, rng);
+	check_conversion<int>("integer", {-40000, 0, 5}, 4, rng);
+
+	return mtb_test_result("test_narrow");
+}
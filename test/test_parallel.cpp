@@ -0,0 +1,314 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Parallel reader (mtb_read_data_parallel) against the serial reader: matrix sizes around the
+// checksum blocks that split the file among the threads, narrow indices, checksums, symmetric
+// files (with the same layout as mtb_read_data) and partial reads. Parallel writer
+// (mtb_write_data_parallel), with and without O_DIRECT, against the serial writer, and the
+// RangeWriter that writes the slices of the threads.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_index.hpp"
+#include "../include/mtb_io.hpp"
+#include "../include/mtb_parallel.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+static std::vector<Triplet<double>> random_entries(uint64_t nz, uint64_t nrows, bool is_lower,
+                                                   std::mt19937_64 &rng)
+{
+	std::vector<Triplet<double>> data(nz);
+
+	for (Triplet<double> &entry : data)
+	{
+		entry.row = rng() % nrows;
+		entry.col = rng() % (is_lower ? entry.row + 1 : nrows);
+		entry.val = std::uniform_real_distribution<double>(-1, 1)(rng);
+	}
+
+	return data;
+}
+
+// Output of a reader, with the holes of symmetric matrices set to a marker
+static std::vector<Triplet<double>> empty_output(uint64_t size)
+{
+	return std::vector<Triplet<double>>(size, Triplet<double>{-1, -1, -1.0});
+}
+
+static void check_read(std::mt19937_64 &rng)
+{
+	std::string filename = "test_parallel.mtb";
+	uint64_t nrows = 5000;
+
+	for (uint64_t nz : {0, 1, MTB_CHECKSUM_BLOCK - 1, MTB_CHECKSUM_BLOCK, 3 * MTB_CHECKSUM_BLOCK + 17})
+	{
+		for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+		{
+			for (char index_size : {2, 8})
+			{
+				for (bool checksum : {false, true})
+				{
+					std::vector<Triplet<double>> data = random_entries(nz, nrows, mat_type == kSymmetricSparse, rng);
+					MTBHeader header{mat_type, kReal, 8, nrows, nrows, nz};
+					header.index_size = index_size;
+					if (checksum) header.flags = kChecksum;
+
+					{
+						std::ofstream ofile(filename, std::ios::binary);
+						mtb_write_header(ofile, header);
+						mtb_write_data(ofile, data.data(), header);
+					}
+
+					uint64_t step_size = 1 + (mat_type == kSymmetricSparse);
+					std::vector<Triplet<double>> expected = empty_output(step_size * nz);
+
+					{
+						std::ifstream ifile(filename, std::ios::binary);
+						MTBHeader file_header;
+						mtb_read_header(ifile, file_header);
+						mtb_read_data(ifile, expected.data(), file_header);
+					}
+
+					for (int nthreads : {1, 2, 3, 8})
+					{
+						std::vector<Triplet<double>> out = empty_output(step_size * nz);
+						mtb_read_data_parallel(filename, out.data(), step_size * nz, mat_type, kReal, 8, nthreads);
+						MTB_CHECK(same_entries(out, expected));
+					}
+
+					// Only the first entries, which end in the middle of a checksum block
+					if (nz > MTB_CHECKSUM_BLOCK)
+					{
+						uint64_t count = MTB_CHECKSUM_BLOCK + 100;
+						std::vector<Triplet<double>> out = empty_output(step_size * nz);
+						mtb_read_data_parallel(filename, out.data(), step_size * count, mat_type, kReal, 8, 3);
+
+						std::vector<Triplet<double>> partial = expected;
+						std::fill(partial.begin() + step_size * count, partial.end(), Triplet<double>{-1, -1, -1.0});
+						MTB_CHECK(same_entries(out, partial));
+					}
+				}
+			}
+		}
+	}
+
+	std::remove(filename.c_str());
+}
+
+static void check_read_errors(std::mt19937_64 &rng)
+{
+	std::string filename = "test_parallel.mtb";
+	std::vector<Triplet<double>> data = random_entries(100, 10, false, rng), out(200);
+	MTBHeader header{kGeneralSparse, kReal, 8, 10, 10, 100};
+
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+
+	// Properties that do not match the header, and more entries than the file has
+	MTB_CHECK_THROWS(mtb_read_data_parallel(filename, out.data(), 100, kSymmetricSparse, kReal, 8));
+	MTB_CHECK_THROWS(mtb_read_data_parallel(filename, out.data(), 100, kGeneralSparse, kReal, 4));
+	MTB_CHECK_THROWS(mtb_read_data_parallel(filename, out.data(), 101, kGeneralSparse, kReal, 8));
+	MTB_CHECK_THROWS(mtb_read_data_parallel("test_parallel_missing.mtb", out.data(), 100, kGeneralSparse, kReal, 8));
+
+	// A file with the chunked encoding
+	header.encoding = kChunkedEncoding;
+	header.version = 2;
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+	MTB_CHECK_THROWS(mtb_read_data_parallel(filename, out.data(), 100, kGeneralSparse, kReal, 8));
+
+	std::remove(filename.c_str());
+}
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+// Regions that start and end inside a page, written in pieces of random sizes through buffers
+// of a few pages, with the pages inside the region written with and without O_DIRECT
+static void check_range_writer(std::mt19937_64 &rng)
+{
+	std::string filename = "test_parallel.bin";
+
+	for (bool direct_io : {false, true})
+	{
+		for (uint64_t offset : {0, 1, MTB_DIRECT_ALIGN - 1, 3 * MTB_DIRECT_ALIGN + 100})
+		{
+			for (uint64_t size : {0, 10, MTB_DIRECT_ALIGN, 20 * MTB_DIRECT_ALIGN + 7})
+			{
+				std::vector<char> expected(offset + size + 50, 'x');
+
+				{
+					File file(filename, O_WRONLY | O_CREAT | O_TRUNC);
+					std::unique_ptr<File> direct(direct_io ? new File(filename, O_WRONLY | O_DIRECT) : nullptr);
+
+					// The bytes around the region are not overwritten
+					file.write_at(expected.data(), expected.size(), 0);
+
+					RangeWriter writer(file, direct.get(), offset, 3 * MTB_DIRECT_ALIGN);
+
+					for (uint64_t pos = offset; pos < offset + size; )
+					{
+						uint64_t piece = std::min<uint64_t>(1 + rng() % (2 * MTB_DIRECT_ALIGN), offset + size - pos);
+						char *out = writer.reserve(piece);
+
+						for (uint64_t i = 0; i < piece; ++i)
+							expected[pos + i] = out[i] = (char) rng();
+
+						writer.commit(piece);
+						pos += piece;
+					}
+
+					writer.finish();
+				}
+
+				MTB_CHECK(read_file(filename) == expected);
+			}
+		}
+	}
+
+	std::remove(filename.c_str());
+}
+
+// The parallel writer creates the same file as the serial writer (header, entries, checksum
+// section and row index), with any number of threads
+template<typename T>
+static void check_write(const std::vector<Triplet<T>> &data, const MTBHeader &header)
+{
+	std::string filename = "test_parallel.mtb", reference = "test_parallel_ref.mtb";
+
+	{
+		std::ofstream ofile(reference, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+		if (header.flags & kRowIndex) mtb_write_row_index(ofile, data.data(), header.nz, header.nrows);
+	}
+
+	std::vector<char> expected = read_file(reference);
+
+	for (bool direct_io : {false, true})
+	{
+		for (int nthreads : {1, 2, 3, 5})
+		{
+			// The previous file is larger, so it must be truncated
+			{
+				std::ofstream ofile(filename, std::ios::binary);
+				ofile << std::string(expected.size() + 1000, 'x');
+			}
+
+			mtb_write_data_parallel(filename, data.data(), header, nthreads, direct_io);
+			MTB_CHECK(read_file(filename) == expected);
+		}
+	}
+
+	std::remove(filename.c_str());
+	std::remove(reference.c_str());
+}
+
+static void check_writes(std::mt19937_64 &rng)
+{
+	uint64_t nrows = 100000;
+
+	for (uint64_t nz : {0, 1, MTB_CHECKSUM_BLOCK - 1, 5 * MTB_CHECKSUM_BLOCK + 3})
+	{
+		// Sorted entries (for the row index)
+		std::vector<Triplet<double>> data = random_entries(nz, nrows, false, rng);
+		std::sort(data.begin(), data.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+		{
+			return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+		});
+
+		for (char index_size : {4, 8})
+		{
+			for (int flags : {0, (int) kChecksum, (int) kRowIndex, kChecksum | kRowIndex})
+			{
+				MTBHeader header{kGeneralSparse, kReal, 8, nrows, nrows, nz};
+				header.index_size = index_size;
+				header.flags = flags;
+				check_write(data, header);
+			}
+		}
+
+		if (nz > MTB_CHECKSUM_BLOCK)
+		{
+			// Narrow values of odd sizes, which do not align the slices of the threads with the pages
+			std::vector<Triplet<int>> integers(nz);
+			for (uint64_t i = 0; i < nz; ++i)
+				integers[i] = {data[i].row, data[i].col, (int) (rng() % 200) - 100};
+
+			MTBHeader header{kGeneralSparse, kInteger, 1, nrows, nrows, nz};
+			header.index_size = 4;
+			header.flags = kChecksum;
+			check_write(integers, header);
+
+			header = MTBHeader{kGeneralSparse, kReal, 4, nrows, nrows, nz};
+			check_write(data, header);
+		}
+	}
+}
+
+static void check_write_errors()
+{
+	std::string filename = "test_parallel.mtb";
+	std::vector<Triplet<double>> unsorted = {{2, 0, 1.0}, {1, 1, 2.0}}, large = {{0, 300, 1.0}};
+
+	MTBHeader header{kGeneralSparse, kReal, 8, 3, 3, 2};
+	header.encoding = kChunkedEncoding;
+	header.version = 2;
+	MTB_CHECK_THROWS(mtb_write_data_parallel(filename, unsorted.data(), header, 2));
+
+	// Unsorted entries with a row index, and indices that do not fit in the index size
+	header = MTBHeader{kGeneralSparse, kReal, 8, 3, 3, 2};
+	header.flags = kRowIndex;
+	MTB_CHECK_THROWS(mtb_write_data_parallel(filename, unsorted.data(), header, 2));
+
+	header = MTBHeader{kGeneralSparse, kReal, 8, 200, 200, 1};
+	header.index_size = 1;
+	MTB_CHECK_THROWS(mtb_write_data_parallel(filename, large.data(), header, 2));
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_read(rng);
+	check_read_errors(rng);
+	check_range_writer(rng);
+	check_writes(rng);
+	check_write_errors();
+
+	return mtb_test_result("test_parallel");
+}
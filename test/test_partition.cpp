@@ -0,0 +1,169 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Partition of a MTB file among cooperating readers. Each reader is a separate process (as
+// the MPI ranks would be) that computes its own range of rows, without communication. The
+// ranges must be contiguous and every entry must be read by exactly one reader, with and
+// without a row index.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_parallel.hpp"
+#include "../include/mtb_partition.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static std::string result_file(int rank)
+{
+	return "test_partition." + std::to_string(rank);
+}
+
+// Reads the partition of `rank` and stores it in its result file. The exit code is not zero
+// if the reader throws or the partition differs from the one of the shared row counts.
+static int run_reader(const std::string &filename, int rank, int nranks,
+                      const std::vector<uint64_t> &row_ptr)
+{
+	try
+	{
+		std::vector<Triplet<double>> data;
+		RowPartition part = mtb_read_partition(filename, rank, nranks, data);
+		RowPartition shared = mtb_partition_rows(row_ptr, rank, nranks);
+
+		std::ofstream ofile(result_file(rank), std::ios::binary);
+		ofile.write((const char *) &part, sizeof(RowPartition));
+		ofile.write((const char *) data.data(), data.size() * sizeof(Triplet<double>));
+
+		bool is_same = part.row_begin == shared.row_begin && part.row_end == shared.row_end
+		               && part.nz == shared.nz;
+		return (ofile && is_same) ? 0 : 1;
+
+	} catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "rank %d: %s\n", rank, e.what());
+		return 1;
+	}
+}
+
+static void check_partition(const std::string &filename, const std::vector<Triplet<double>> &entries,
+                            uint64_t nrows, int nranks)
+{
+	std::vector<uint64_t> row_ptr = mtb_count_rows(filename);
+	std::vector<pid_t> children;
+
+	for (int rank = 0; rank < nranks; ++rank)
+	{
+		pid_t pid = fork();
+		if (pid == 0) _exit(run_reader(filename, rank, nranks, row_ptr));
+
+		MTB_CHECK(pid > 0);
+		children.push_back(pid);
+	}
+
+	for (pid_t pid : children)
+	{
+		int status = 0;
+		MTB_CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+
+	std::vector<Triplet<double>> all;
+	uint64_t row_end = 0;
+
+	for (int rank = 0; rank < nranks; ++rank)
+	{
+		std::ifstream ifile(result_file(rank), std::ios::binary);
+		RowPartition part{};
+		ifile.read((char *) &part, sizeof(RowPartition));
+
+		// The ranges are contiguous and each entry belongs to the range of its reader
+		MTB_CHECK(part.row_begin == row_end && part.row_begin <= part.row_end);
+		row_end = part.row_end;
+
+		std::vector<Triplet<double>> data(part.nz);
+		ifile.read((char *) data.data(), data.size() * sizeof(Triplet<double>));
+		MTB_CHECK(ifile && ifile.peek() == EOF);
+
+		for (const Triplet<double> &entry : data)
+			MTB_CHECK((uint64_t) entry.row >= part.row_begin && (uint64_t) entry.row < part.row_end);
+
+		all.insert(all.end(), data.begin(), data.end());
+		std::remove(result_file(rank).c_str());
+	}
+
+	MTB_CHECK(row_end == nrows);
+
+	// Every entry is read exactly once
+	auto less = [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return std::tie(a.row, a.col, a.val) < std::tie(b.row, b.col, b.val);
+	};
+
+	std::vector<Triplet<double>> expected = entries;
+	std::sort(expected.begin(), expected.end(), less);
+	std::sort(all.begin(), all.end(), less);
+
+	MTB_CHECK(all.size() == expected.size());
+	MTB_CHECK(std::equal(all.begin(), all.end(), expected.begin(), expected.end(),
+	                     [](const Triplet<double> &a, const Triplet<double> &b)
+	                     { return a.row == b.row && a.col == b.col && a.val == b.val; }));
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+	std::string filename = "test_partition.mtb";
+	uint64_t nrows = 1000;
+	std::vector<Triplet<double>> entries;
+
+	// Rows of different sizes: empty rows, a dense row and rows with a few entries
+	for (uint64_t row = 0; row < nrows; ++row)
+	{
+		uint64_t count = (row % 7 == 3) ? 0 : (row == 500) ? nrows : rng() % 40;
+
+		for (uint64_t col = 0; col < nrows && count > 0; ++col)
+		{
+			if (row != 500 && rng() % (nrows / count) != 0) continue;
+			entries.push_back({(std::ptrdiff_t) row, (std::ptrdiff_t) col, (double) entries.size()});
+		}
+	}
+
+	std::vector<Triplet<double>> shuffled = entries;
+	std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+	for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+	{
+		for (bool is_indexed : {true, false})
+		{
+			// The entries of symmetric matrices are only those stored in the file
+			std::vector<Triplet<double>> data;
+
+			for (const Triplet<double> &entry : (is_indexed ? entries : shuffled))
+				if (mat_type == kGeneralSparse || entry.col <= entry.row) data.push_back(entry);
+
+			MTBHeader header{mat_type, kReal, 8, nrows, nrows, data.size()};
+			if (is_indexed) header.flags = kRowIndex;
+			mtb_write_data_parallel(filename, data.data(), header, 2);
+
+			for (int nranks : {1, 2, 5, 16})
+				check_partition(filename, data, nrows, nranks);
+		}
+	}
+
+	std::remove(filename.c_str());
+
+	return mtb_test_result("test_partition");
+}
@@ -0,0 +1,226 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Pipelined MTX parser (mtx_parse_parallel) reading a file stream and a file mapped in memory
+// (MTXMappedFile): the entries must be passed in file order whatever the number of parser
+// threads, with blank lines, CRLF, lines split by the blocks of MTX_CHUNK_SIZE bytes (at every
+// position of a line), files of exactly one block and files that do not end with a newline.
+
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Separator of the numbers of a line
+static const char *separator(std::mt19937_64 &rng)
+{
+	static const char *separators[] = {" ", " ", " ", "\t", "  ", " \t "};
+	return separators[rng() % 6];
+}
+
+// Appends random entries and their lines (one-based indices in the text, random separators
+// and line endings, and blank lines between them) until the text has at least `size` bytes
+static void append_lines(std::vector<Triplet<double>> &entries, std::string &body, uint64_t size,
+                         std::mt19937_64 &rng)
+{
+	static const char *blanks[] = {"\n", "\r\n", "   \n", "\t\r\n"};
+	char line[128];
+
+	while (body.size() < size)
+	{
+		Triplet<double> entry;
+		entry.row = rng() % 1000000;
+		entry.col = rng() % (1 + rng() % 1000000);
+		entry.val = (rng() % 2) ? (double) (rng() % 1000) : std::uniform_real_distribution<double>(-1, 1)(rng);
+		entries.push_back(entry);
+
+		if (rng() % 20 == 0) body += blanks[rng() % 4];
+
+		std::snprintf(line, sizeof(line), "%td%s%td%s%.17g%s", entry.row + 1, separator(rng),
+		              entry.col + 1, separator(rng), entry.val, (rng() % 4 == 0) ? " \r\n" : "\n");
+		body += line;
+	}
+}
+
+static void write_mtx(const std::string &filename, uint64_t nz, const std::string &body)
+{
+	std::ofstream ofile(filename, std::ios::binary);
+	ofile << "%%MatrixMarket matrix coordinate real general\n% comment\n";
+	ofile << 1000000 << " " << 1000000 << " " << nz << "\n";
+	ofile << body;
+}
+
+// Parses the entries of the file from the stream or from a mapping (into an array of `nz`
+// entries, or with the buffers of the blocks if `use_array == false`) and checks that the
+// blocks are passed in file order
+static std::vector<Triplet<double>> parse_file(const std::string &filename, uint64_t nz, bool is_mapped,
+                                               bool use_array, int nthreads)
+{
+	std::ifstream ifile(filename);
+	std::vector<std::string> properties;
+	uint64_t nrows, ncols, file_nz;
+	mtx_read_header(ifile, properties, nrows, ncols, file_nz);
+
+	std::vector<Triplet<double>> array(use_array ? nz : 0), out;
+	bool is_ordered = true;
+
+	auto parse = [&](auto &input)
+	{
+		mtx_parse_parallel<double>(input, nz, true, use_array ? array.data() : nullptr, nthreads,
+		                           [&](const Triplet<double> *entries, uint64_t first, uint64_t count)
+		                           {
+			                           is_ordered &= (first == out.size());
+			                           if (use_array) is_ordered &= (entries == array.data() + first);
+			                           out.insert(out.end(), entries, entries + count);
+		                           });
+	};
+
+	if (is_mapped)
+	{
+		MTXMappedFile input(filename, ifile.tellg());
+		parse(input);
+
+	} else
+		parse(ifile);
+
+	MTB_CHECK(is_ordered);
+	return out;
+}
+
+static void check_parse(const std::string &filename, const std::vector<Triplet<double>> &entries,
+                        const std::string &body, std::initializer_list<int> nthreads_list)
+{
+	write_mtx(filename, entries.size(), body);
+
+	for (bool is_mapped : {false, true})
+	{
+		for (int nthreads : nthreads_list)
+		{
+			MTB_CHECK(same_entries(parse_file(filename, entries.size(), is_mapped, true, nthreads), entries));
+			MTB_CHECK(same_entries(parse_file(filename, entries.size(), is_mapped, false, nthreads), entries));
+		}
+	}
+}
+
+static void check_blocks(std::mt19937_64 &rng)
+{
+	std::string filename = "test_pipeline.mtx";
+	std::vector<Triplet<double>> entries;
+	std::string body;
+
+	// Several blocks, with any number of parser threads
+	append_lines(entries, body, 3 * MTX_CHUNK_SIZE + MTX_CHUNK_SIZE / 3, rng);
+	check_parse(filename, entries, body, {1, 2, 5});
+
+	// Without a newline at the end, and with blank lines at the end
+	check_parse(filename, entries, body.substr(0, body.size() - 1), {3});
+	check_parse(filename, entries, body + "\n  \r\n\n", {3});
+
+	// The end of the first block at every position of the lines around it (the leading
+	// spaces shift the lines)
+	entries.clear();
+	body.clear();
+	append_lines(entries, body, MTX_CHUNK_SIZE + 1000, rng);
+
+	for (int shift = 0; shift < 64; ++shift)
+		check_parse(filename, entries, std::string(shift, ' ') + body, {2});
+
+	// The end of the first block in a long run of blank lines
+	entries.clear();
+	body.clear();
+	append_lines(entries, body, MTX_CHUNK_SIZE - 300, rng);
+
+	for (int k = 0; k < 200; ++k)
+		body += (k % 2) ? "\r\n" : " \n";
+
+	append_lines(entries, body, body.size() + 100000, rng);
+	check_parse(filename, entries, body, {1, 3});
+
+	// Files of exactly one block (with and without a newline at the end), and one byte less
+	// or more (the leading spaces pad the first line)
+	entries.clear();
+	body.clear();
+	append_lines(entries, body, MTX_CHUNK_SIZE - 2000, rng);
+
+	for (uint64_t size : {MTX_CHUNK_SIZE - 1, MTX_CHUNK_SIZE, MTX_CHUNK_SIZE + 1})
+	{
+		check_parse(filename, entries, std::string(size - body.size(), ' ') + body, {1, 3});
+		check_parse(filename, entries, std::string(size - body.size() + 1, ' ') + body.substr(0, body.size() - 1), {3});
+	}
+
+	// An empty matrix
+	check_parse(filename, {}, "", {1, 3});
+	check_parse(filename, {}, "\n\n", {3});
+
+	std::remove(filename.c_str());
+}
+
+static void check_errors(std::mt19937_64 &rng)
+{
+	std::string filename = "test_pipeline.mtx";
+	std::vector<Triplet<double>> entries;
+	std::string body;
+	append_lines(entries, body, 2 * MTX_CHUNK_SIZE, rng);
+
+	for (bool is_mapped : {false, true})
+	{
+		// More entries than the array, in the last block
+		write_mtx(filename, entries.size(), body);
+		MTB_CHECK_THROWS(parse_file(filename, entries.size() - 1, is_mapped, true, 3));
+
+		// A wrong line in the last block
+		write_mtx(filename, entries.size(), body + "1 x 2\n");
+		MTB_CHECK_THROWS(parse_file(filename, entries.size(), is_mapped, false, 3));
+	}
+
+	// A line longer than a block (the mapped blocks are only split at line boundaries)
+	std::string long_body = std::string(MTX_CHUNK_SIZE + 10, ' ') + "1 1 1\n2 2 2\n";
+	write_mtx(filename, 2, long_body);
+	MTB_CHECK_THROWS(parse_file(filename, 2, false, false, 3));
+	MTB_CHECK(parse_file(filename, 2, true, false, 3).size() == 2);
+
+	// Files that cannot be mapped, and an empty file
+	MTB_CHECK_THROWS(MTXMappedFile{"test_pipeline_missing.mtx"});
+	{
+		std::ofstream ofile(filename);
+	}
+	MTXMappedFile empty(filename, 10);
+	MTB_CHECK(empty.begin() == empty.end());
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	// Hide the progress bar (the failed checks are printed with stdio)
+	std::cerr.rdbuf(nullptr);
+
+	check_blocks(rng);
+	check_errors(rng);
+
+	return mtb_test_result("test_pipeline");
+}
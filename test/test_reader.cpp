@@ -0,0 +1,167 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Streaming reader (Reader): the concatenated batches must contain every entry in file order
+// and, for symmetric matrices, the mirror of each entry below the diagonal right after it, even
+// if the mirror does not fit in the batch or the entry is the last one of the read buffer.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_reader.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Reads every batch of the file and checks their sizes
+static std::vector<Triplet<double>> read_batches(Reader &reader, uint64_t capacity)
+{
+	std::vector<Triplet<double>> all, batch(capacity);
+	bool is_valid = true;
+
+	while (!reader.eof())
+	{
+		uint64_t size = reader.next_batch(batch.data(), capacity);
+
+		// Only the last batch may be smaller (the mirror of its last entry is pending if it
+		// does not fit, so a batch never has a free slot if entries remain)
+		is_valid &= (size > 0 && size <= capacity);
+		all.insert(all.end(), batch.begin(), batch.begin() + size);
+		if (size < capacity) is_valid &= reader.eof();
+	}
+
+	MTB_CHECK(is_valid);
+	MTB_CHECK(reader.next_batch(batch.data(), capacity) == 0);
+
+	return all;
+}
+
+static void check_batches(std::mt19937_64 &rng)
+{
+	std::string filename = "test_reader.mtb";
+	uint64_t nrows = 1000, nz = 3000;
+
+	// Sorted entries (for the delta encoding) with random values, at or below the diagonal
+	std::vector<Triplet<double>> data(nz);
+
+	for (uint64_t i = 0; i < nz; ++i)
+	{
+		std::ptrdiff_t row = i * nrows / nz;
+		data[i] = {row, (std::ptrdiff_t) (rng() % (row + 1)), std::uniform_real_distribution<double>(-1, 1)(rng)};
+	}
+
+	std::sort(data.begin(), data.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+	});
+
+	// Every fourth row only has its diagonal entry
+	for (Triplet<double> &entry : data)
+		if (entry.row % 4 == 1) entry.col = entry.row;
+
+	data.erase(std::unique(data.begin(), data.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return a.row == b.row && a.col == b.col;
+	}), data.end());
+	nz = data.size();
+
+	for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+	{
+		std::vector<Triplet<double>> expected;
+
+		for (const Triplet<double> &entry : data)
+		{
+			expected.push_back(entry);
+			if (mat_type == kSymmetricSparse && entry.col < entry.row) expected.push_back({entry.col, entry.row, entry.val});
+		}
+
+		for (char encoding : {kPlainEncoding, kDeltaEncoding, kChunkedEncoding})
+		{
+			MTBHeader header{mat_type, kReal, 8, nrows, nrows, nz};
+			header.encoding = encoding;
+			if (encoding != kPlainEncoding) header.version = 2;
+
+			{
+				std::ofstream ofile(filename, std::ios::binary);
+				mtb_write_header(ofile, header);
+				mtb_write_data(ofile, data.data(), header);
+			}
+
+			// Read buffers and batches of odd and even sizes, smaller and larger than the other
+			for (uint64_t buffer_size : {1, 2, 7, 64, 100000})
+			{
+				Reader reader(filename, buffer_size);
+				MTB_CHECK(reader.nz() == nz && reader.mat_type() == mat_type);
+
+				for (uint64_t capacity : {1, 2, 3, 8, 63, 4096})
+				{
+					reader.rewind();
+					MTB_CHECK(same_entries(read_batches(reader, capacity), expected));
+				}
+
+				// A rewind in the middle of the file, with a pending mirror
+				reader.rewind();
+				Triplet<double> batch[3];
+				for (int k = 0; k < 10; ++k)
+					reader.next_batch(batch, 3);
+
+				MTB_CHECK(reader.next_batch(batch, 0) == 0);
+				reader.rewind();
+				MTB_CHECK(same_entries(read_batches(reader, 5), expected));
+			}
+		}
+	}
+
+	std::remove(filename.c_str());
+}
+
+static void check_errors()
+{
+	std::string filename = "test_reader.mtb";
+	std::vector<Triplet<double>> data = {{0, 0, 1.0}, {1, 0, 2.0}, {2, 1, 3.0}, {2, 2, 4.0}};
+	MTBHeader header{kSymmetricSparse, kReal, 8, 3, 3, 4};
+
+	MTB_CHECK_THROWS(Reader("test_reader_missing.mtb"));
+
+	// The last entry is missing from the file
+	{
+		std::ofstream ofile(filename, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), 3, kSymmetricSparse, kReal, 8);
+	}
+
+	Reader reader(filename, 2);
+	std::vector<Triplet<double>> batch(8);
+	MTB_CHECK_THROWS(while (!reader.eof()) reader.next_batch(batch.data(), 8));
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_batches(rng);
+	check_errors();
+
+	return mtb_test_result("test_reader");
+}
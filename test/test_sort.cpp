@@ -0,0 +1,163 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Radix sort of triplets (mtb_sort.hpp), compared with std::stable_sort above and below
+// MTB_RADIX_MIN_SIZE, and the CSR/CSC builders of mtb_csr.hpp.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../include/mtb_csr.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+// The values are the positions of the triplets before sorting, so the stability is checked
+static std::vector<Triplet<int64_t>> random_triplets(uint64_t count, uint64_t nrows, uint64_t ncols,
+                                                     std::mt19937_64 &rng)
+{
+	std::vector<Triplet<int64_t>> data(count);
+
+	for (uint64_t i = 0; i < count; ++i)
+		data[i] = {(std::ptrdiff_t) (rng() % nrows), (std::ptrdiff_t) (rng() % ncols), (int64_t) i};
+
+	return data;
+}
+
+static std::vector<Triplet<int64_t>> reference_sort(std::vector<Triplet<int64_t>> data, bool by_col)
+{
+	std::stable_sort(data.begin(), data.end(), [by_col](const Triplet<int64_t> &a, const Triplet<int64_t> &b)
+	{
+		if (by_col) return (a.col == b.col) ? (a.row < b.row) : (a.col < b.col);
+		else return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+	});
+
+	return data;
+}
+
+static bool same_triplets(const std::vector<Triplet<int64_t>> &a, const std::vector<Triplet<int64_t>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Non-power-of-two dimensions, with few and many bits (several digits) in each index
+static const std::pair<uint64_t, uint64_t> kDims[] = {
+	{1, 1}, {3, 1000}, {1000, 7}, {12345, 6789}, {(uint64_t(1) << 33) + 5, 3}, {100, (uint64_t(1) << 40) - 1}
+};
+
+static const uint64_t kCounts[] = {0, 1, 2, 100, MTB_RADIX_MIN_SIZE - 1, MTB_RADIX_MIN_SIZE,
+                                   MTB_RADIX_MIN_SIZE + 1, 50000};
+
+static void check_sort(std::mt19937_64 &rng)
+{
+	for (auto dims : kDims)
+	{
+		for (uint64_t count : kCounts)
+		{
+			for (bool by_col : {false, true})
+			{
+				std::vector<Triplet<int64_t>> data = random_triplets(count, dims.first, dims.second, rng);
+				std::vector<Triplet<int64_t>> expected = reference_sort(data, by_col);
+
+				for (int nthreads : {1, 3})
+				{
+					std::vector<Triplet<int64_t>> sorted = data;
+					mtb_sort_triplets(sorted.data(), count, dims.first, dims.second, by_col, nthreads);
+
+					// The radix sort is also used directly below MTB_RADIX_MIN_SIZE
+					std::vector<Triplet<int64_t>> radix = data, tmp(count);
+					mtb_radix_sort(radix.data(), tmp.data(), count, dims.first, dims.second, by_col, nthreads);
+
+					bool is_same = same_triplets(sorted, expected) && same_triplets(radix, expected);
+
+					if (!is_same)
+						std::fprintf(stderr, "nrows=%lu ncols=%lu count=%lu by_col=%d nthreads=%d\n",
+						             dims.first, dims.second, count, by_col, nthreads);
+					MTB_CHECK(is_same);
+				}
+			}
+		}
+	}
+
+	// Indices out of bounds, above and below MTB_RADIX_MIN_SIZE
+	for (uint64_t count : {uint64_t(10), uint64_t(2 * MTB_RADIX_MIN_SIZE)})
+	{
+		std::vector<Triplet<int64_t>> data = random_triplets(count, 10, 10, rng);
+		data[count / 2].row = 10;
+		MTB_CHECK_THROWS(mtb_sort_triplets(data.data(), count, 10, 10));
+
+		data[count / 2].row = 0;
+		data[count - 1].col = 10;
+		MTB_CHECK_THROWS(mtb_sort_triplets(data.data(), count, 10, 10, true));
+	}
+}
+
+template<typename I>
+static void check_build(uint64_t count, uint64_t nrows, uint64_t ncols, bool by_col, std::mt19937_64 &rng)
+{
+	std::vector<Triplet<int64_t>> data = random_triplets(count, nrows, ncols, rng);
+	std::vector<Triplet<int64_t>> expected = reference_sort(data, by_col);
+	std::vector<I> ptr, idx;
+	std::vector<int64_t> val;
+
+	if (by_col) mtb_build_csc(data.data(), count, nrows, ncols, ptr, idx, val);
+	else mtb_build_csr(data.data(), count, nrows, ncols, ptr, idx, val);
+
+	uint64_t size = by_col ? ncols : nrows;
+	bool is_same = same_triplets(data, expected) && ptr.size() == size + 1 && ptr[0] == 0
+	               && (uint64_t) ptr[size] == count && idx.size() == count && val.size() == count;
+
+	for (uint64_t i = 0; is_same && i < size; ++i)
+	{
+		for (uint64_t k = ptr[i]; k < (uint64_t) ptr[i + 1]; ++k)
+		{
+			uint64_t major = by_col ? expected[k].col : expected[k].row;
+			uint64_t minor = by_col ? expected[k].row : expected[k].col;
+
+			is_same &= (major == i && (uint64_t) idx[k] == minor && val[k] == expected[k].val);
+		}
+	}
+
+	if (!is_same) std::fprintf(stderr, "count=%lu nrows=%lu ncols=%lu by_col=%d\n", count, nrows, ncols, by_col);
+	MTB_CHECK(is_same);
+}
+
+static void check_builders(std::mt19937_64 &rng)
+{
+	for (bool by_col : {false, true})
+	{
+		for (uint64_t count : {uint64_t(0), uint64_t(100), uint64_t(3 * MTB_RADIX_MIN_SIZE + 7)})
+		{
+			check_build<uint64_t>(count, 1234, 567, by_col, rng);
+			check_build<int32_t>(count, 77, 3001, by_col, rng);
+		}
+	}
+
+	// The index type cannot hold the dimensions or the number of entries
+	std::vector<Triplet<int64_t>> data = random_triplets(200, 100, 100, rng);
+	std::vector<int8_t> ptr, idx;
+	std::vector<int64_t> val;
+
+	MTB_CHECK_THROWS(mtb_build_csr(data.data(), 10, 200, 100, ptr, idx, val));
+	MTB_CHECK_THROWS(mtb_build_csc(data.data(), 200, 100, 100, ptr, idx, val));
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_sort(rng);
+	check_builders(rng);
+
+	return mtb_test_result("test_sort");
+}
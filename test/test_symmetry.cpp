@@ -0,0 +1,191 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Symmetry detection of the converter (mtx_is_symmetric on the sorted data, and MTXSymmetryHash
+// on the unsorted data and in the external sort). A symmetric "general" matrix is stored as its
+// lower triangle, while a matrix that differs in a single value, or that has repeated indices
+// (even if the entries are symmetric as a multiset), is stored as general by every path.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_index.hpp"
+#include "../include/mtx.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static void write_mtx(const std::string &filename, const std::vector<Triplet<double>> &entries,
+                      uint64_t nrows)
+{
+	std::ofstream ofile(filename);
+	ofile << "%%MatrixMarket matrix coordinate real general\n";
+	ofile << nrows << " " << nrows << " " << entries.size() << "\n";
+
+	char line[128];
+
+	for (const Triplet<double> &entry : entries)
+	{
+		int size = std::snprintf(line, sizeof(line), "%td %td %.17g\n", entry.row + 1, entry.col + 1,
+		                         entry.val);
+		ofile.write(line, size);
+	}
+}
+
+static std::vector<Triplet<double>> sorted(std::vector<Triplet<double>> entries)
+{
+	std::sort(entries.begin(), entries.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+	{
+		return std::tie(a.row, a.col, a.val) < std::tie(b.row, b.col, b.val);
+	});
+
+	return entries;
+}
+
+static bool same_entries(const std::vector<Triplet<double>> &a, const std::vector<Triplet<double>> &b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const Triplet<double> &x, const Triplet<double> &y)
+	{
+		return x.row == y.row && x.col == y.col && x.val == y.val;
+	});
+}
+
+// Converts the entries with the given options and checks that the MTB file has the expected
+// matrix type and entries (only the lower triangle if it is symmetric)
+static void check_conversion(const std::vector<Triplet<double>> &entries, uint64_t nrows,
+                             const MTXConvertOptions &options, bool is_symmetric)
+{
+	std::string mtx_file = "test_symmetry.mtx", mtb_file = "test_symmetry.mtb";
+	write_mtx(mtx_file, entries, nrows);
+	mtx_to_mtb(mtx_file, mtb_file, options);
+
+	std::vector<Triplet<double>> expected;
+	for (const Triplet<double> &entry : entries)
+		if (!is_symmetric || entry.col <= entry.row) expected.push_back(entry);
+
+	std::ifstream ifile(mtb_file, std::ios::binary);
+	MTBHeader header;
+	mtb_read_header(ifile, header);
+	mtb_check_header(header);
+
+	MTB_CHECK(header.mat_type == (is_symmetric ? kSymmetricSparse : kGeneralSparse));
+	MTB_CHECK(header.nz == expected.size());
+
+	std::vector<Triplet<double>> data(header.nz);
+	mtb_read_data(ifile, data.data(), header, kLowerTriangle);
+	MTB_CHECK(same_entries(sorted(data), sorted(expected)));
+
+	// The row index points to the entries of the stored matrix
+	if (header.flags & kRowIndex)
+	{
+		std::vector<Triplet<double>> rows, expected_rows;
+		uint64_t row_begin = nrows / 3, row_end = nrows / 2;
+
+		for (const Triplet<double> &entry : expected)
+			if ((uint64_t) entry.row >= row_begin && (uint64_t) entry.row < row_end) expected_rows.push_back(entry);
+
+		mtb_read_rows(mtb_file, row_begin, row_end, rows);
+		MTB_CHECK(same_entries(sorted(rows), sorted(expected_rows)));
+	}
+
+	std::remove(mtx_file.c_str());
+	std::remove(mtb_file.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+	uint64_t nrows = 2000;
+
+	// Hide the progress of the converter (the failed checks are printed with stdio)
+	std::cerr.rdbuf(nullptr);
+
+	// Random symmetric matrix in a random order, with more entries than a run of the external
+	// sort (@ref MTX_MIN_RUN_SIZE)
+	std::vector<Triplet<double>> lower_triangle, symmetric;
+
+	for (uint64_t i = 0; i < 2 * MTX_MIN_RUN_SIZE; ++i)
+	{
+		std::ptrdiff_t row = rng() % nrows, col = rng() % (row + 1);
+		lower_triangle.push_back({row, col, std::uniform_real_distribution<double>(-1, 1)(rng)});
+	}
+
+	// Without repeated indices
+	lower_triangle = sorted(lower_triangle);
+	lower_triangle.erase(std::unique(lower_triangle.begin(), lower_triangle.end(),
+	                                 [](const Triplet<double> &a, const Triplet<double> &b)
+	                                 {
+		                                 return a.row == b.row && a.col == b.col;
+	                                 }), lower_triangle.end());
+
+	for (const Triplet<double> &entry : lower_triangle)
+	{
+		symmetric.push_back(entry);
+		if (entry.col != entry.row) symmetric.push_back({entry.col, entry.row, entry.val});
+	}
+
+	std::shuffle(symmetric.begin(), symmetric.end(), rng);
+
+	// A single value above the diagonal differs from its mirror
+	std::vector<Triplet<double>> asymmetric = symmetric;
+	auto upper = std::find_if(asymmetric.begin(), asymmetric.end(), [](const Triplet<double> &entry)
+	{
+		return entry.col > entry.row;
+	});
+	upper->val = std::nextafter(upper->val, 2.0);
+
+	// Repeated indices, which are symmetric as a multiset: an entry and its mirror are repeated
+	// at both ends of the file (in different runs of the external sort), and a diagonal entry
+	// is repeated next to it
+	std::vector<Triplet<double>> repeated = symmetric;
+	auto lower = std::find_if(repeated.begin() + repeated.size() / 2, repeated.end(), [](const Triplet<double> &entry)
+	{
+		return entry.col < entry.row;
+	});
+	auto diagonal = std::find_if(repeated.begin(), repeated.end(), [](const Triplet<double> &entry)
+	{
+		return entry.col == entry.row;
+	});
+	Triplet<double> pair = *lower, mirror{lower->col, lower->row, lower->val}, diag = *diagonal;
+
+	repeated.insert(repeated.begin(), {pair, mirror});
+	repeated.push_back(diag);
+
+	std::vector<Triplet<double>> repeated_diagonal = symmetric;
+	repeated_diagonal.push_back(diag);
+
+	// Sorted in memory, unsorted and with the external sort, with the plain (and row index)
+	// and chunked encodings
+	for (int path = 0; path < 3; ++path)
+	{
+		for (bool compression : {false, true})
+		{
+			MTXConvertOptions options;
+			options.detect_symmetry = true;
+			options.sort_data = (path != 1);
+			options.memory_budget = (path == 2) ? 1 : 0;
+			options.compression = compression;
+			options.row_index = options.sort_data && !compression;
+			options.nthreads = 2;
+
+			check_conversion(symmetric, nrows, options, true);
+			check_conversion(asymmetric, nrows, options, false);
+			check_conversion(repeated, nrows, options, false);
+			check_conversion(repeated_diagonal, nrows, options, false);
+		}
+	}
+
+	return mtb_test_result("test_symmetry");
+}
@@ -0,0 +1,235 @@
+/*************************************************************************
+ Copyright (C) 2022 Instituto Superior Tecnico
+
+ This file is part of the MTB library, which is licensed under the
+ terms contained in the LICENSE file.
+ **************************************************************************/
+
+// Streaming writer (Writer): the entries written one at a time and in batches, through buffers
+// of any size, create the same matrix as the serial writer, with the number of entries and the
+// checksums written when the file is closed (plain and delta encodings, narrow indices).
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/mtb.hpp"
+#include "../include/mtb_writer.hpp"
+#include "test.hpp"
+
+using namespace mtb;
+
+static std::vector<char> read_file(const std::string &filename)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+}
+
+// Writes the entries with a mix of single entries and batches of random sizes
+template<typename T>
+static void write_pieces(Writer &writer, const std::vector<Triplet<T>> &data, std::mt19937_64 &rng)
+{
+	for (uint64_t i = 0; i < data.size(); )
+	{
+		uint64_t size = std::min<uint64_t>(rng() % 300, data.size() - i);
+
+		if (size == 0)
+			writer.write(data[i++]);
+		else if (size == 1)
+			writer.write(data[i].row, data[i].col, data[i].val), ++i;
+		else
+		{
+			writer.write(data.data() + i, size);
+			i += size;
+		}
+	}
+}
+
+template<typename T>
+static bool same_entries(const std::vector<Triplet<T>> &a, const std::vector<Triplet<T>> &b)
+{
+	if (a.size() != b.size()) return false;
+
+	for (uint64_t i = 0; i < a.size(); ++i)
+		if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].val != b[i].val) return false;
+
+	return true;
+}
+
+// Reads the header and the entries of the file (without the mirrors of symmetric matrices),
+// which checks the checksums
+template<typename T>
+static std::vector<Triplet<T>> read_matrix(const std::string &filename, MTBHeader &header)
+{
+	std::ifstream ifile(filename, std::ios::binary);
+	mtb_read_header(ifile, header);
+
+	std::vector<Triplet<T>> data(header.nz);
+	mtb_read_data(ifile, data.data(), header, kLowerTriangle);
+
+	return data;
+}
+
+// The written file is the same as the file of the serial writer. With the delta encoding,
+// a row split by a flush of the buffer starts a new run, so the file only has the same
+// header and entries unless the buffer holds every entry.
+template<typename T>
+static void check_file(const std::string &filename, const std::string &reference,
+                       const std::vector<Triplet<T>> &data, uint64_t buffer_size)
+{
+	MTBHeader header, expected_header;
+	std::vector<Triplet<T>> expected = read_matrix<T>(reference, expected_header);
+
+	if (expected_header.encoding == kPlainEncoding || buffer_size >= data.size())
+	{
+		MTB_CHECK(read_file(filename) == read_file(reference));
+		return;
+	}
+
+	MTB_CHECK(same_entries(read_matrix<T>(filename, header), expected));
+	MTB_CHECK(header.nz == expected_header.nz && header.encoding == expected_header.encoding
+	          && header.index_size == expected_header.index_size && header.flags == expected_header.flags);
+}
+
+template<typename T>
+static void check_write(const std::vector<Triplet<T>> &data, const MTBHeader &header, std::mt19937_64 &rng)
+{
+	std::string filename = "test_writer.mtb", reference = "test_writer_ref.mtb";
+
+	{
+		std::ofstream ofile(reference, std::ios::binary);
+		mtb_write_header(ofile, header);
+		mtb_write_data(ofile, data.data(), header);
+	}
+
+	for (uint64_t buffer_size : {1, 7, 1000, 1 << 20})
+	{
+		// The number of entries of the header is ignored
+		MTBHeader writer_header = header;
+		writer_header.nz = 12345;
+
+		Writer writer(filename, writer_header, buffer_size);
+		write_pieces(writer, data, rng);
+		MTB_CHECK(writer.nz() == data.size());
+
+		writer.close();
+		check_file(filename, reference, data, buffer_size);
+
+		// Any further write fails
+		MTB_CHECK_THROWS(writer.write(data.data(), 1));
+	}
+
+	// Closed by the destructor
+	{
+		Writer writer(filename, header, 100);
+		write_pieces(writer, data, rng);
+	}
+	check_file(filename, reference, data, 100);
+
+	std::remove(filename.c_str());
+	std::remove(reference.c_str());
+}
+
+static void check_writes(std::mt19937_64 &rng)
+{
+	uint64_t nrows = 50000;
+
+	for (uint64_t nz : {0, 1, MTB_CHECKSUM_BLOCK - 1, 2 * MTB_CHECKSUM_BLOCK + 5})
+	{
+		// Sorted entries (for the delta encoding)
+		std::vector<Triplet<double>> data(nz);
+
+		for (Triplet<double> &entry : data)
+		{
+			entry.row = rng() % nrows;
+			entry.col = rng() % (entry.row + 1);
+			entry.val = std::uniform_real_distribution<double>(-1, 1)(rng);
+		}
+
+		std::sort(data.begin(), data.end(), [](const Triplet<double> &a, const Triplet<double> &b)
+		{
+			return (a.row == b.row) ? (a.col < b.col) : (a.row < b.row);
+		});
+
+		for (char mat_type : {kGeneralSparse, kSymmetricSparse})
+		{
+			for (char encoding : {kPlainEncoding, kDeltaEncoding})
+			{
+				for (char index_size : {4, 8})
+				{
+					for (bool checksum : {false, true})
+					{
+						MTBHeader header{mat_type, kReal, 8, nrows, nrows, nz};
+						header.encoding = encoding;
+						header.index_size = index_size;
+						if (encoding != kPlainEncoding) header.version = 2;
+						if (checksum) header.flags = kChecksum;
+						check_write(data, header, rng);
+					}
+				}
+			}
+		}
+
+		// Integers with a narrow value size
+		if (nz > 1)
+		{
+			std::vector<Triplet<int>> integers(nz);
+			for (uint64_t i = 0; i < nz; ++i)
+				integers[i] = {data[i].row, data[i].col, (int) (rng() % 200) - 100};
+
+			MTBHeader header{kGeneralSparse, kInteger, 1, nrows, nrows, nz};
+			header.flags = kChecksum;
+			check_write(integers, header, rng);
+		}
+	}
+}
+
+static void check_errors()
+{
+	std::string filename = "test_writer.mtb";
+	std::vector<Triplet<double>> unsorted = {{2, 0, 1.0}, {1, 1, 2.0}};
+
+	// The chunked encoding and the row index need the number of entries in advance
+	MTBHeader header{kGeneralSparse, kReal, 8, 3, 3, 2};
+	header.encoding = kChunkedEncoding;
+	header.version = 2;
+	MTB_CHECK_THROWS(Writer(filename, header));
+
+	header = MTBHeader{kGeneralSparse, kReal, 8, 3, 3, 2};
+	header.flags = kRowIndex;
+	MTB_CHECK_THROWS(Writer(filename, header));
+
+	// Unsorted entries with the delta encoding, and indices that do not fit in the index size
+	header = MTBHeader{kGeneralSparse, kReal, 8, 3, 3, 2};
+	header.encoding = kDeltaEncoding;
+	header.version = 2;
+	{
+		Writer writer(filename, header);
+		writer.write(unsorted.data(), 2);
+		MTB_CHECK_THROWS(writer.close());
+	}
+
+	header = MTBHeader{kGeneralSparse, kReal, 8, 300, 300, 1};
+	header.index_size = 1;
+	{
+		Writer writer(filename, header);
+		writer.write(0, 299, 1.0);
+		MTB_CHECK_THROWS(writer.close());
+	}
+
+	std::remove(filename.c_str());
+}
+
+int main()
+{
+	std::mt19937_64 rng(42);
+
+	check_writes(rng);
+	check_errors();
+
+	return mtb_test_result("test_writer");
+}